@@ -0,0 +1,87 @@
+# Player sources shared by the application and the benchmark executable
+
+SOURCES += \
+    qt_port/src/PlayerDialog.cpp \
+    qt_port/src/MediaPlayerWrapper.cpp \
+    qt_port/src/watermarkdialog.cpp \
+    qt_port/src/RtpDepacketizer.cpp \
+    qt_port/src/RtspClient.cpp \
+    qt_port/src/StreamIngestReactor.cpp \
+    qt_port/src/StreamRingBuffer.cpp \
+    qt_port/src/StreamFeeder.cpp \
+    qt_port/src/StreamBufferBudget.cpp \
+    qt_port/src/PlayerPool.cpp \
+    qt_port/src/CpuTime.cpp \
+    qt_port/src/PlaybackClock.cpp \
+    qt_port/src/ThumbnailCache.cpp \
+    qt_port/src/PlaylistPlayer.cpp \
+    qt_port/src/TimelineIndex.cpp \
+    qt_port/src/VideoWallWidget.cpp \
+    qt_port/src/PortPool.cpp \
+    qt_port/src/FileRefCache.cpp \
+    qt_port/src/CacheFile.cpp \
+    qt_port/src/KeyFrameIndex.cpp \
+    qt_port/src/SpeedController.cpp \
+    qt_port/src/YuvConvert.cpp \
+    qt_port/src/SnapshotService.cpp \
+    qt_port/src/BurstCapture.cpp \
+    qt_port/src/JpegEncoder.cpp \
+    qt_port/src/RangeExporter.cpp \
+    qt_port/src/WatermarkVerifier.cpp \
+    qt_port/src/WatermarkIndex.cpp
+
+HEADERS += \
+    qt_port/src/PlayerDialog.h \
+    qt_port/src/MediaPlayerWrapper.h \
+    qt_port/src/watermarkdialog.h \
+    qt_port/src/RtpDepacketizer.h \
+    qt_port/src/RtspClient.h \
+    qt_port/src/StreamIngestReactor.h \
+    qt_port/src/StreamRingBuffer.h \
+    qt_port/src/StreamFeeder.h \
+    qt_port/src/StreamBufferBudget.h \
+    qt_port/src/PlayerPool.h \
+    qt_port/src/CpuTime.h \
+    qt_port/src/PlaybackClock.h \
+    qt_port/src/ThumbnailCache.h \
+    qt_port/src/PlaylistPlayer.h \
+    qt_port/src/TimelineIndex.h \
+    qt_port/src/VideoWallWidget.h \
+    qt_port/src/PortPool.h \
+    qt_port/src/FileRefCache.h \
+    qt_port/src/CacheFile.h \
+    qt_port/src/KeyFrameIndex.h \
+    qt_port/src/SpeedController.h \
+    qt_port/src/FrameConsumer.h \
+    qt_port/src/YuvConvert.h \
+    qt_port/src/SnapshotService.h \
+    qt_port/src/BurstCapture.h \
+    qt_port/src/JpegEncoder.h \
+    qt_port/src/RangeExporter.h \
+    qt_port/src/SeqLock.h \
+    qt_port/src/WatermarkVerifier.h \
+    qt_port/src/WatermarkIndex.h
+
+FORMS += \
+    qt_port/forms/PlayerDialog.ui
+
+# PlayM4 SDK configuration
+# DEFINES += _FOR_HIKPLAYM4_DLL_  # Commented out - using standard PlayM4 functions
+
+# Include paths
+INCLUDEPATH += $$PWD/SDK
+DEPENDPATH += $$PWD/SDK
+
+# Library paths and libraries
+win32 {
+
+        # 64-bit build
+        LIBS += -L$$PWD/SDK -lShinPlayCtrl
+        
+        # Copy required DLLs to output directory
+        CONFIG(debug, debug|release) {
+            DESTDIR = $$PWD/debug
+        } else {
+            DESTDIR = $$PWD/release
+        }
+}
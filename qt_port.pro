@@ -16,41 +16,11 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
-SOURCES += \
-    qt_port/src/main.cpp \
-    qt_port/src/PlayerDialog.cpp \
-    qt_port/src/MediaPlayerWrapper.cpp \
-    qt_port/src/watermarkdialog.cpp
-
-HEADERS += \
-    qt_port/src/PlayerDialog.h \
-    qt_port/src/MediaPlayerWrapper.h \
-    qt_port/src/watermarkdialog.h
-
-FORMS += \
-    qt_port/forms/PlayerDialog.ui
-
-# PlayM4 SDK configuration
-# DEFINES += _FOR_HIKPLAYM4_DLL_  # Commented out - using standard PlayM4 functions
-
-# Include paths
-INCLUDEPATH += $$PWD/SDK
-DEPENDPATH += $$PWD/SDK
-
-# Library paths and libraries
-win32 {
-
-        # 64-bit build
-        LIBS += -L$$PWD/SDK -lShinPlayCtrl
-        
-        # Copy required DLLs to output directory
-        CONFIG(debug, debug|release) {
-            DESTDIR = $$PWD/debug
-        } else {
-            DESTDIR = $$PWD/release
-        }
-}
+# Everything but main(), shared with the benchmark executable
+include(qt_port.pri)
 
+SOURCES += \
+    qt_port/src/main.cpp
 
 RESOURCES += \
     resource.qrc
@@ -0,0 +1,88 @@
+#include "AllocationCounter.h"
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+#if defined(_MSC_VER) && defined(_DEBUG)
+#include <crtdbg.h>
+#endif
+
+static std::atomic<bool> g_counting(false);
+static std::atomic<quint64> g_allocations(0);
+
+#if defined(_MSC_VER) && defined(_DEBUG)
+
+// The debug CRT routes operator new through malloc, so the hook sees both
+static int allocHook(int type, void *, size_t, int, long, const unsigned char *, int)
+{
+    if ((type == _HOOK_ALLOC || type == _HOOK_REALLOC) && g_counting.load(std::memory_order_relaxed)) {
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    return TRUE;
+}
+
+void AllocationCounter::start()
+{
+    g_allocations = 0;
+    _CrtSetAllocHook(allocHook);
+    g_counting = true;
+}
+
+quint64 AllocationCounter::stop()
+{
+    g_counting = false;
+    _CrtSetAllocHook(nullptr);
+    return g_allocations.load();
+}
+
+bool AllocationCounter::countsMalloc()
+{
+    return true;
+}
+
+void AllocationCounter::noteMalloc()
+{
+}
+
+#else
+
+void *operator new(size_t size)
+{
+    if (g_counting.load(std::memory_order_relaxed)) {
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void *p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void AllocationCounter::start()
+{
+    g_allocations = 0;
+    g_counting = true;
+}
+
+quint64 AllocationCounter::stop()
+{
+    g_counting = false;
+    return g_allocations.load();
+}
+
+bool AllocationCounter::countsMalloc()
+{
+    return false;
+}
+
+void AllocationCounter::noteMalloc()
+{
+    if (g_counting.load(std::memory_order_relaxed)) {
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <QtGlobal>
+
+// Process-wide heap allocation count, linked into ShinPlayerBench only.
+// Replaces the global operator new; with the MSVC debug CRT an allocation
+// hook also sees malloc(), which is where QByteArray and the other Qt
+// containers allocate.
+class AllocationCounter
+{
+public:
+    static void start();
+    // Allocations since start()
+    static quint64 stop();
+    // False in release builds, where malloc() goes uncounted
+    static bool countsMalloc();
+    // Instrumented code reports a malloc() it made; counted only where the
+    // CRT hook cannot see it, so nothing is counted twice
+    static void noteMalloc();
+};
+
+#endif // ALLOCATIONCOUNTER_H
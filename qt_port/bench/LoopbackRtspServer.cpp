@@ -0,0 +1,305 @@
+#include "LoopbackRtspServer.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QDebug>
+#include <string.h>
+
+static const int kMaxPayload = 1400;
+static const quint32 kSsrc = 0x53485031;       // "SHP1"
+static const int kPayloadType = 96;
+
+// Splits an Annex-B stream at its start codes
+static QVector<QByteArray> splitNalUnits(const QByteArray &stream)
+{
+    QVector<QByteArray> nals;
+    const char *data = stream.constData();
+    const int size = stream.size();
+    int start = -1;
+    int i = 0;
+    while (i + 2 < size) {
+        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+            if (start >= 0) {
+                int end = i;
+                while (end > start && data[end - 1] == 0) {
+                    --end;
+                }
+                nals.append(stream.mid(start, end - start));
+            }
+            i += 3;
+            start = i;
+        } else {
+            ++i;
+        }
+    }
+    if (start >= 0 && start < size) {
+        nals.append(stream.mid(start));
+    }
+    return nals;
+}
+
+LoopbackRtspServer::LoopbackRtspServer(QObject *parent)
+    : QObject(parent)
+    , m_server(new QTcpServer(this))
+    , m_client(nullptr)
+    , m_paceTimer(new QTimer(this))
+    , m_h265(false)
+    , m_frameRate(25)
+    , m_nextUnit(0)
+    , m_sequence(0)
+    , m_timestamp(0)
+    , m_unitsSent(0)
+    , m_packetsSent(0)
+    , m_bytesSent(0)
+{
+    m_packet.reserve(4 + 12 + 3 + kMaxPayload);
+    m_paceTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_server, &QTcpServer::newConnection, this, &LoopbackRtspServer::onNewConnection);
+    connect(m_paceTimer, &QTimer::timeout, this, &LoopbackRtspServer::sendNextAccessUnit);
+}
+
+LoopbackRtspServer::~LoopbackRtspServer()
+{
+    m_paceTimer->stop();
+}
+
+bool LoopbackRtspServer::load(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "Loopback RTSP server: cannot read" << filePath;
+        return false;
+    }
+    const QString suffix = QFileInfo(filePath).suffix().toLower();
+    m_h265 = suffix == "h265" || suffix == "265" || suffix == "hevc";
+    m_name = QFileInfo(filePath).fileName();
+    m_units.clear();
+
+    // An access unit ends where the next one's leading non-VCL unit or
+    // first slice begins
+    AccessUnit unit;
+    bool unitHasSlice = false;
+    for (const QByteArray &nal : splitNalUnits(file.readAll())) {
+        if (nal.size() < (m_h265 ? 3 : 2)) {
+            continue;
+        }
+        const uchar *bytes = reinterpret_cast<const uchar *>(nal.constData());
+        const int type = m_h265 ? (bytes[0] >> 1) & 0x3F : bytes[0] & 0x1F;
+        const bool slice = m_h265 ? type <= 31 : (type >= 1 && type <= 5);
+        const bool firstSlice = slice && (bytes[m_h265 ? 2 : 1] & 0x80) != 0;
+        const bool trailing = m_h265 ? (type == 36 || type == 37 || type == 38) : (type >= 10 && type <= 12);
+        if (unitHasSlice && (firstSlice || (!slice && !trailing))) {
+            m_units.append(unit);
+            unit.clear();
+            unitHasSlice = false;
+        }
+        unit.append(nal);
+        unitHasSlice = unitHasSlice || slice;
+    }
+    if (unitHasSlice) {
+        m_units.append(unit);
+    }
+
+    qDebug() << "Loopback RTSP server:" << m_name << (m_h265 ? "H.265," : "H.264,") << m_units.size()
+             << "access units";
+    return !m_units.isEmpty();
+}
+
+bool LoopbackRtspServer::listen()
+{
+    if (!m_server->listen(QHostAddress::LocalHost)) {
+        qDebug() << "Loopback RTSP server: cannot listen:" << m_server->errorString();
+        return false;
+    }
+    return true;
+}
+
+QString LoopbackRtspServer::url() const
+{
+    return QString("rtsp://127.0.0.1:%1/%2").arg(m_server->serverPort()).arg(m_name);
+}
+
+bool LoopbackRtspServer::isPlaying() const
+{
+    return m_paceTimer->isActive();
+}
+
+void LoopbackRtspServer::onNewConnection()
+{
+    while (m_server->hasPendingConnections()) {
+        QTcpSocket *socket = m_server->nextPendingConnection();
+        if (m_client) {
+            socket->deleteLater();
+            continue;
+        }
+        m_client = socket;
+        m_client->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        m_request.clear();
+        connect(m_client, &QTcpSocket::readyRead, this, &LoopbackRtspServer::onReadyRead);
+        connect(m_client, &QTcpSocket::disconnected, this, &LoopbackRtspServer::onDisconnected);
+    }
+}
+
+void LoopbackRtspServer::onDisconnected()
+{
+    m_paceTimer->stop();
+    m_client->deleteLater();
+    m_client = nullptr;
+}
+
+void LoopbackRtspServer::onReadyRead()
+{
+    m_request += m_client->readAll();
+    int end = m_request.indexOf("\r\n\r\n");
+    while (end >= 0) {
+        const QByteArray request = m_request.left(end);
+        m_request.remove(0, end + 4);
+        handleRequest(request);
+        if (!m_client) {
+            return;
+        }
+        end = m_request.indexOf("\r\n\r\n");
+    }
+}
+
+void LoopbackRtspServer::handleRequest(const QByteArray &request)
+{
+    const QList<QByteArray> lines = request.split('\n');
+    const QByteArray method = lines.first().trimmed().split(' ').first();
+    QByteArray cseq;
+    QByteArray transport;
+    for (int i = 1; i < lines.size(); ++i) {
+        const QByteArray line = lines.at(i).trimmed();
+        const int colon = line.indexOf(':');
+        const QByteArray name = line.left(colon).trimmed().toLower();
+        if (name == "cseq") {
+            cseq = line.mid(colon + 1).trimmed();
+        } else if (name == "transport") {
+            transport = line.mid(colon + 1).trimmed();
+        }
+    }
+
+    const QByteArray session = "Session: 53485031;timeout=60\r\n";
+    if (method == "OPTIONS") {
+        reply(cseq, 200, "OK", "Public: OPTIONS, DESCRIBE, SETUP, PLAY, GET_PARAMETER, TEARDOWN\r\n");
+    } else if (method == "DESCRIBE") {
+        const QByteArray sdp = "v=0\r\n"
+                               "o=- 0 0 IN IP4 127.0.0.1\r\n"
+                               "s=ShinPlayer loopback\r\n"
+                               "c=IN IP4 127.0.0.1\r\n"
+                               "t=0 0\r\n"
+                               "a=control:*\r\n"
+                               "m=video 0 RTP/AVP " + QByteArray::number(kPayloadType) + "\r\n"
+                               "a=rtpmap:" + QByteArray::number(kPayloadType) + (m_h265 ? " H265" : " H264") + "/90000\r\n"
+                               "a=control:track1\r\n";
+        reply(cseq, 200, "OK", "Content-Base: " + url().toUtf8() + "/\r\nContent-Type: application/sdp\r\n", sdp);
+    } else if (method == "SETUP") {
+        if (!transport.contains("TCP")) {
+            reply(cseq, 461, "Unsupported Transport");
+            return;
+        }
+        reply(cseq, 200, "OK", session + "Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n");
+    } else if (method == "PLAY") {
+        reply(cseq, 200, "OK", session + "Range: npt=0.000-\r\n");
+        m_paceTimer->start(1000 / m_frameRate);
+    } else if (method == "TEARDOWN") {
+        m_paceTimer->stop();
+        reply(cseq, 200, "OK", session);
+    } else if (method == "GET_PARAMETER") {
+        reply(cseq, 200, "OK", session);
+    } else {
+        reply(cseq, 405, "Method Not Allowed");
+    }
+}
+
+void LoopbackRtspServer::reply(const QByteArray &cseq, int status, const QByteArray &reason,
+                               const QByteArray &headers, const QByteArray &body)
+{
+    QByteArray response = "RTSP/1.0 " + QByteArray::number(status) + ' ' + reason + "\r\n"
+                        + "CSeq: " + cseq + "\r\n" + headers
+                        + "Content-Length: " + QByteArray::number(body.size()) + "\r\n\r\n" + body;
+    m_client->write(response);
+}
+
+void LoopbackRtspServer::sendNextAccessUnit()
+{
+    if (!m_client || m_units.isEmpty()) {
+        return;
+    }
+
+    const AccessUnit &unit = m_units.at(m_nextUnit);
+    m_nextUnit = (m_nextUnit + 1) % m_units.size();
+    emit accessUnitStarted(m_timestamp);
+    for (int i = 0; i < unit.size(); ++i) {
+        sendNal(unit.at(i), i + 1 == unit.size());
+    }
+    ++m_unitsSent;
+    m_timestamp += 90000 / m_frameRate;
+}
+
+void LoopbackRtspServer::sendNal(const QByteArray &nal, bool lastOfUnit)
+{
+    if (nal.size() <= kMaxPayload) {
+        sendPacket(nullptr, 0, nal.constData(), nal.size(), lastOfUnit);
+        return;
+    }
+
+    // Fragmentation units: FU-A (RFC 6184) or FU (RFC 7798)
+    const uchar *bytes = reinterpret_cast<const uchar *>(nal.constData());
+    const int nalHeaderSize = m_h265 ? 2 : 1;
+    char header[3];
+    int headerSize;
+    if (m_h265) {
+        header[0] = static_cast<char>((bytes[0] & 0x81) | (49 << 1));
+        header[1] = static_cast<char>(bytes[1]);
+        headerSize = 3;
+    } else {
+        header[0] = static_cast<char>((bytes[0] & 0xE0) | 28);
+        headerSize = 2;
+    }
+    const uchar type = m_h265 ? (bytes[0] >> 1) & 0x3F : bytes[0] & 0x1F;
+
+    int pos = nalHeaderSize;
+    while (pos < nal.size()) {
+        const int chunk = qMin(kMaxPayload - headerSize, nal.size() - pos);
+        const bool first = pos == nalHeaderSize;
+        const bool last = pos + chunk == nal.size();
+        header[headerSize - 1] = static_cast<char>(type | (first ? 0x80 : 0) | (last ? 0x40 : 0));
+        sendPacket(header, headerSize, nal.constData() + pos, chunk, last && lastOfUnit);
+        pos += chunk;
+    }
+}
+
+void LoopbackRtspServer::sendPacket(const char *header, int headerSize, const char *data, int size, bool marker)
+{
+    const int rtpSize = 12 + headerSize + size;
+    m_packet.resize(4 + rtpSize);
+    uchar *p = reinterpret_cast<uchar *>(m_packet.data());
+    p[0] = '$';
+    p[1] = 0;
+    p[2] = static_cast<uchar>(rtpSize >> 8);
+    p[3] = static_cast<uchar>(rtpSize);
+    p[4] = 0x80;
+    p[5] = static_cast<uchar>(kPayloadType | (marker ? 0x80 : 0));
+    p[6] = static_cast<uchar>(m_sequence >> 8);
+    p[7] = static_cast<uchar>(m_sequence);
+    p[8] = static_cast<uchar>(m_timestamp >> 24);
+    p[9] = static_cast<uchar>(m_timestamp >> 16);
+    p[10] = static_cast<uchar>(m_timestamp >> 8);
+    p[11] = static_cast<uchar>(m_timestamp);
+    p[12] = static_cast<uchar>(kSsrc >> 24);
+    p[13] = static_cast<uchar>(kSsrc >> 16);
+    p[14] = static_cast<uchar>(kSsrc >> 8);
+    p[15] = static_cast<uchar>(kSsrc);
+    if (headerSize > 0) {
+        memcpy(p + 16, header, static_cast<size_t>(headerSize));
+    }
+    memcpy(p + 16 + headerSize, data, static_cast<size_t>(size));
+    ++m_sequence;
+
+    m_client->write(m_packet);
+    ++m_packetsSent;
+    m_bytesSent += static_cast<quint64>(m_packet.size());
+}
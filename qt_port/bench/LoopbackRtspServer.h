@@ -0,0 +1,75 @@
+#ifndef LOOPBACKRTSPSERVER_H
+#define LOOPBACKRTSPSERVER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QVector>
+#include <QString>
+
+class QTcpServer;
+class QTcpSocket;
+class QTimer;
+
+// Local RTSP stand-in for the ingest benchmarks. Serves one recorded H.264 or
+// H.265 elementary stream (Annex-B, as "ffmpeg -f h264" wrote it) to one
+// client on 127.0.0.1 over RTP/AVP/TCP interleaved, paced at a fixed frame
+// rate and looped at its end. Answers OPTIONS, DESCRIBE, SETUP, PLAY,
+// GET_PARAMETER and TEARDOWN.
+class LoopbackRtspServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LoopbackRtspServer(QObject *parent = nullptr);
+    ~LoopbackRtspServer();
+
+    // .h265/.hevc files are served as H.265, anything else as H.264
+    bool load(const QString &filePath);
+    bool listen();
+    QString url() const;
+    void setFrameRate(int fps) { m_frameRate = qMax(1, fps); }
+
+    int accessUnitCount() const { return m_units.size(); }
+    bool isPlaying() const;
+    quint64 accessUnitsSent() const { return m_unitsSent; }
+    quint64 packetsSent() const { return m_packetsSent; }
+    quint64 bytesSent() const { return m_bytesSent; }
+
+signals:
+    // RTP timestamp of an access unit whose first packet is about to be written
+    void accessUnitStarted(quint32 timestamp);
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+    void sendNextAccessUnit();
+
+private:
+    typedef QVector<QByteArray> AccessUnit;     // NAL units without start codes
+
+    void handleRequest(const QByteArray &request);
+    void reply(const QByteArray &cseq, int status, const QByteArray &reason,
+               const QByteArray &headers = QByteArray(), const QByteArray &body = QByteArray());
+    void sendNal(const QByteArray &nal, bool lastOfUnit);
+    void sendPacket(const char *header, int headerSize, const char *data, int size, bool marker);
+
+    QTcpServer *m_server;
+    QTcpSocket *m_client;
+    QTimer *m_paceTimer;
+    QString m_name;
+    bool m_h265;
+    int m_frameRate;
+    QVector<AccessUnit> m_units;
+
+    QByteArray m_request;
+    QByteArray m_packet;
+    int m_nextUnit;
+    quint16 m_sequence;
+    quint32 m_timestamp;
+    quint64 m_unitsSent;
+    quint64 m_packetsSent;
+    quint64 m_bytesSent;
+};
+
+#endif // LOOPBACKRTSPSERVER_H
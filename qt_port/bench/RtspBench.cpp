@@ -0,0 +1,446 @@
+#include "RtspBench.h"
+#include "AllocationCounter.h"
+#include "LoopbackRtspServer.h"
+#include "RtspClient.h"
+#include "StreamIngestReactor.h"
+#include "MediaPlayerWrapper.h"
+#include "CpuTime.h"
+#include "FrameConsumer.h"
+#include "StreamRingBuffer.h"
+#include <QAtomicInt>
+#include <QEventLoop>
+#include <QTimer>
+#include <QThread>
+#include <QMutex>
+#include <QHash>
+#include <QScopedPointer>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <string.h>
+
+// Old hand-off: every chunk became a heap array that was passed on and dropped
+class ChunkCopySink : public RtpDepacketizer::Sink
+{
+public:
+    ChunkCopySink() : m_bytes(0) {}
+
+    void write(const uchar *data, int size) override
+    {
+        m_last = QByteArray(reinterpret_cast<const char *>(data), size);
+        AllocationCounter::noteMalloc();
+        m_bytes += static_cast<quint64>(m_last.size());
+    }
+    void endAccessUnit(bool keyFrame) override { Q_UNUSED(keyFrame) }
+    void discardAccessUnit() override {}
+
+    QByteArray m_last;
+    quint64 m_bytes;
+};
+
+// Counts what the headless decoder hands back
+class FrameCountConsumer : public FrameConsumer
+{
+public:
+    FrameCountConsumer() : m_frames(0) {}
+
+    void onFrame(const DecodedFrame &frame) override
+    {
+        Q_UNUSED(frame)
+        m_frames.fetchAndAddRelaxed(1);
+    }
+
+    QAtomicInt m_frames;
+};
+
+void RtspBench::runLoopback(const QString &filePath)
+{
+    static const int kRunMs = 10000;
+    static const int kHandshakeMs = 3000;
+
+    LoopbackRtspServer server;
+    if (!server.load(filePath) || !server.listen()) {
+        return;
+    }
+
+    MediaPlayerWrapper player;
+    if (!player.initialize() || !player.openStream(server.url())) {
+        qDebug() << "Loopback RTSP benchmark: cannot open a stream player";
+        return;
+    }
+
+    FrameCountConsumer consumer;
+    RtspClient client(&player, server.url());
+    QEventLoop loop;
+    QElapsedTimer handshake;
+    qint64 handshakeMs = -1;
+    QObject::connect(&client, &RtspClient::streamStarted, [&]() {
+        handshakeMs = handshake.elapsed();
+        player.startHeadless(&consumer);
+    });
+    QObject::connect(&client, &RtspClient::streamError, [&](const QString &error) {
+        qDebug() << "Loopback RTSP benchmark: client failed:" << error;
+        loop.quit();
+    });
+    QTimer::singleShot(kRunMs, &loop, &QEventLoop::quit);
+    QTimer::singleShot(kHandshakeMs, &loop, [&]() {
+        if (handshakeMs < 0) {
+            qDebug() << "Loopback RTSP benchmark: no PLAY within" << kHandshakeMs << "ms";
+            loop.quit();
+        }
+    });
+
+    handshake.start();
+    client.start();
+    loop.exec();
+
+    const quint64 received = client.m_depacketizer.receivedPackets();
+    const quint64 lost = client.m_depacketizer.lostPackets();
+    const quint64 committed = player.streamRing() ? player.streamRing()->totalCommitted() : 0;
+    client.stop();
+    player.stopHeadless();
+    player.closeStream();
+
+    qDebug().noquote() << QString("Loopback RTSP benchmark: handshake %1 ms; server sent %2 access units, "
+                                  "%3 RTP packets, %4 bytes; client depacketized %5 packets, %6 lost, "
+                                  "%7 bytes committed to the input ring; %8 frames decoded")
+        .arg(handshakeMs).arg(server.accessUnitsSent()).arg(server.packetsSent()).arg(server.bytesSent())
+        .arg(received).arg(lost).arg(committed).arg(consumer.m_frames.load());
+}
+
+// Send time of each access unit against the moment the client handed it to
+// the ring, matched by RTP timestamp
+class IngestLatencyLog
+{
+public:
+    void noteSent(quint32 timestamp, qint64 ns)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_sentNs.insert(timestamp, ns);
+    }
+
+    void noteHandedOff(quint32 timestamp, qint64 ns)
+    {
+        QMutexLocker locker(&m_mutex);
+        QHash<quint32, qint64>::iterator it = m_sentNs.find(timestamp);
+        if (it != m_sentNs.end()) {
+            m_latenciesUs.append((ns - it.value()) / 1000);
+            m_sentNs.erase(it);
+        }
+    }
+
+    QVector<qint64> takeLatencies()
+    {
+        QMutexLocker locker(&m_mutex);
+        QVector<qint64> latencies;
+        latencies.swap(m_latenciesUs);
+        return latencies;
+    }
+
+private:
+    QMutex m_mutex;
+    QHash<quint32, qint64> m_sentNs;
+    QVector<qint64> m_latenciesUs;
+};
+
+// Sits between the depacketizer and the client's own sink
+class LatencySink : public RtpDepacketizer::Sink
+{
+public:
+    LatencySink(RtpDepacketizer::Sink *client, const RtpDepacketizer *depacketizer,
+                IngestLatencyLog *log, const QElapsedTimer *clock)
+        : m_client(client)
+        , m_depacketizer(depacketizer)
+        , m_log(log)
+        , m_clock(clock)
+    {
+    }
+
+    void write(const uchar *data, int size) override { m_client->write(data, size); }
+    void endAccessUnit(bool keyFrame) override
+    {
+        m_client->endAccessUnit(keyFrame);
+        m_log->noteHandedOff(m_depacketizer->currentTimestamp(), m_clock->nsecsElapsed());
+    }
+    void discardAccessUnit() override { m_client->discardAccessUnit(); }
+
+private:
+    RtpDepacketizer::Sink *m_client;
+    const RtpDepacketizer *m_depacketizer;
+    IngestLatencyLog *m_log;
+    const QElapsedTimer *m_clock;
+};
+
+// One live source of the ingest benchmark
+struct IngestSource
+{
+    IngestSource() : sourceId(-1), pollThread(nullptr), pollWakeups(0) {}
+
+    LoopbackRtspServer server;
+    MediaPlayerWrapper player;
+    FrameCountConsumer consumer;
+    IngestLatencyLog log;
+    QScopedPointer<LatencySink> sink;
+    int sourceId;
+    QThread *pollThread;
+    std::atomic<quint64> pollWakeups;
+};
+
+void RtspBench::runIngest(const QString &filePath, int sources)
+{
+    static const int kPhaseMs = 10000;
+    static const int kHandshakeMs = 3000;
+
+    sources = qMax(1, sources);
+    QElapsedTimer clock;
+    clock.start();
+
+    auto wait = [](int ms) {
+        QEventLoop loop;
+        QTimer::singleShot(ms, &loop, &QEventLoop::quit);
+        loop.exec();
+    };
+
+    auto openSources = [&](QVector<IngestSource *> *opened) -> bool {
+        for (int i = 0; i < sources; ++i) {
+            IngestSource *source = new IngestSource;
+            opened->append(source);
+            if (!source->server.load(filePath) || !source->server.listen()
+                || !source->player.initialize() || !source->player.openStream(source->server.url())) {
+                qDebug() << "Ingest benchmark: cannot set up source" << i;
+                return false;
+            }
+            QObject::connect(&source->server, &LoopbackRtspServer::accessUnitStarted, [source, &clock](quint32 timestamp) {
+                source->log.noteSent(timestamp, clock.nsecsElapsed());
+            });
+        }
+        return true;
+    };
+
+    auto closeSources = [](QVector<IngestSource *> *opened) {
+        for (IngestSource *source : *opened) {
+            source->player.stopHeadless();
+            source->player.closeStream();
+        }
+        qDeleteAll(*opened);
+        opened->clear();
+    };
+
+    // Wake-ups are read at both ends so the handshake is left out
+    auto measure = [&](const char *name, const QVector<IngestSource *> &opened,
+                       const std::function<quint64()> &wakeups) {
+        wait(kHandshakeMs);
+        for (IngestSource *source : opened) {
+            source->log.takeLatencies();
+        }
+        const quint64 wakeupsStart = wakeups();
+        const quint64 cpuStart = CpuTime::processUs();
+        wait(kPhaseMs);
+        const quint64 cpuUs = CpuTime::processUs() - cpuStart;
+        const quint64 wakeupCount = wakeups() - wakeupsStart;
+
+        QVector<qint64> latencies;
+        int frames = 0;
+        for (IngestSource *source : opened) {
+            latencies += source->log.takeLatencies();
+            frames += source->consumer.m_frames.load();
+        }
+        if (latencies.isEmpty()) {
+            qDebug() << "Ingest benchmark," << name << ": no access units handed off";
+            return;
+        }
+        std::sort(latencies.begin(), latencies.end());
+        qint64 totalUs = 0;
+        for (qint64 us : latencies) {
+            totalUs += us;
+        }
+        auto percentile = [&latencies](int p) { return latencies.at((latencies.size() - 1) * p / 100); };
+        qDebug().noquote() << QString("Ingest benchmark, %1: %2 sources, %3 access units, send to ring latency "
+                                      "avg %4 us p50 %5 us p99 %6 us max %7 us, %8 wakeups/s, %9% CPU, "
+                                      "%10 frames decoded")
+            .arg(name).arg(sources).arg(latencies.size()).arg(totalUs / latencies.size())
+            .arg(percentile(50)).arg(percentile(99)).arg(latencies.last())
+            .arg(wakeupCount * 1000 / kPhaseMs)
+            .arg(QString::number(cpuUs * 100.0 / (kPhaseMs * 1000.0), 'f', 2))
+            .arg(frames);
+    };
+
+    // Old path: a client per thread that sleeps in waitForReadyRead(100)
+    {
+        QVector<IngestSource *> opened;
+        std::atomic<bool> running(true);
+        if (openSources(&opened)) {
+            for (IngestSource *source : opened) {
+                source->pollThread = QThread::create([source, &running, &clock]() {
+                    RtspClient client(&source->player, source->server.url());
+                    LatencySink sink(&client, &client.m_depacketizer, &source->log, &clock);
+                    client.m_depacketizer.setSink(&sink);
+                    QObject::connect(&client, &RtspClient::streamStarted, &source->player, [source]() {
+                        source->player.startHeadless(&source->consumer);
+                    });
+
+                    // The handshake runs on a local event loop; after PLAY the
+                    // socket is only polled, and readyRead fires from inside
+                    // waitForReadyRead()
+                    QEventLoop handshake;
+                    QObject::connect(&client, &RtspClient::streamStarted, &handshake, &QEventLoop::quit);
+                    QObject::connect(&client, &RtspClient::streamError, &handshake, &QEventLoop::quit);
+                    QTimer::singleShot(kHandshakeMs, &handshake, &QEventLoop::quit);
+                    client.start();
+                    handshake.exec();
+
+                    while (running && client.m_state == RtspClient::Playing) {
+                        ++source->pollWakeups;
+                        client.m_socket->waitForReadyRead(100);
+                    }
+                    client.stop();
+                });
+                source->pollThread->start(QThread::TimeCriticalPriority);
+            }
+            measure("waitForReadyRead(100) per source", opened, [&opened]() -> quint64 {
+                quint64 total = 0;
+                for (IngestSource *source : opened) {
+                    total += source->pollWakeups;
+                }
+                return total;
+            });
+        }
+        running = false;
+        for (IngestSource *source : opened) {
+            if (source->pollThread) {
+                source->pollThread->wait(3000);
+                delete source->pollThread;
+            }
+        }
+        closeSources(&opened);
+    }
+
+    // New path: every client on the reactor thread
+    {
+        QVector<IngestSource *> opened;
+        StreamIngestReactor reactor;
+        QObject::connect(&reactor, &StreamIngestReactor::sourceStarted, [&opened](int sourceId) {
+            for (IngestSource *source : opened) {
+                if (source->sourceId == sourceId) {
+                    source->player.startHeadless(&source->consumer);
+                }
+            }
+        });
+        if (openSources(&opened)) {
+            for (IngestSource *source : opened) {
+                source->sourceId = reactor.addSource(&source->player, source->server.url());
+                RtspClient *client = reactor.m_sources.value(source->sourceId);
+                if (!client) {
+                    continue;
+                }
+                // Queued behind start(), well before PLAY has been answered
+                QMetaObject::invokeMethod(client, [client, source, &clock]() {
+                    source->sink.reset(new LatencySink(client, &client->m_depacketizer, &source->log, &clock));
+                    client->m_depacketizer.setSink(source->sink.data());
+                }, Qt::BlockingQueuedConnection);
+            }
+            measure("StreamIngestReactor, one thread", opened, [&reactor]() -> quint64 {
+                quint64 total = 0;
+                for (RtspClient *client : reactor.m_sources) {
+                    quint64 wakeups = 0;
+                    QMetaObject::invokeMethod(client, [client, &wakeups]() {
+                        wakeups = client->m_statWakeups;
+                    }, Qt::BlockingQueuedConnection);
+                    total += wakeups;
+                }
+                return total;
+            });
+        }
+        reactor.removeAllSources();
+        closeSources(&opened);
+    }
+}
+
+void RtspBench::runAllocation()
+{
+    static const int kPhaseMs = 3000;
+    static const int kPayloadBytes = 1400;
+    static const int kGop = 30;
+    static const int kKeyFrameBytes = 64 * 1024;
+    static const int kFrameBytes = 8 * 1024;
+
+    // One access unit per timestamp: FU-A fragments of an IDR or P slice,
+    // marker on the last; sequence and timestamp are patched in place
+    uchar packet[12 + 2 + kPayloadBytes];
+    memset(packet, 0x5A, sizeof(packet));
+    packet[0] = 0x80;
+    packet[8] = packet[9] = packet[10] = packet[11] = 0x42;
+    quint16 sequence = 0;
+    quint32 timestamp = 0;
+
+    auto sendAccessUnit = [&](RtpDepacketizer &depacketizer, int frame) {
+        const bool keyFrame = frame % kGop == 0;
+        int remaining = keyFrame ? kKeyFrameBytes : kFrameBytes;
+        bool first = true;
+        timestamp += 3000;
+        while (remaining > 0) {
+            const int chunk = qMin(remaining, kPayloadBytes);
+            remaining -= chunk;
+            packet[1] = static_cast<uchar>(96 | (remaining == 0 ? 0x80 : 0));
+            packet[2] = static_cast<uchar>(sequence >> 8);
+            packet[3] = static_cast<uchar>(sequence);
+            ++sequence;
+            packet[4] = static_cast<uchar>(timestamp >> 24);
+            packet[5] = static_cast<uchar>(timestamp >> 16);
+            packet[6] = static_cast<uchar>(timestamp >> 8);
+            packet[7] = static_cast<uchar>(timestamp);
+            packet[12] = 0x7C;
+            packet[13] = static_cast<uchar>((keyFrame ? 5 : 1) | (first ? 0x80 : 0) | (remaining == 0 ? 0x40 : 0));
+            first = false;
+            depacketizer.inputRtpPacket(packet, 14 + chunk);
+        }
+    };
+
+    auto runPhase = [&](const char *name, RtpDepacketizer &depacketizer, const std::function<void()> &drain) {
+        QElapsedTimer timer;
+        int frames = 0;
+        const quint64 packetsBefore = depacketizer.receivedPackets();
+        timer.start();
+        AllocationCounter::start();
+        while (timer.elapsed() < kPhaseMs) {
+            sendAccessUnit(depacketizer, frames++);
+            drain();
+        }
+        const quint64 allocations = AllocationCounter::stop();
+        const qint64 elapsedMs = qMax<qint64>(1, timer.elapsed());
+        qDebug().noquote() << QString("Sink allocation benchmark, %1: %2 access units, %3 RTP packets, "
+                                      "%4 allocations/s, %5 per access unit")
+            .arg(name).arg(frames).arg(depacketizer.receivedPackets() - packetsBefore)
+            .arg(allocations * 1000 / elapsedMs)
+            .arg(QString::number(static_cast<double>(allocations) / qMax(1, frames), 'f', 2));
+    };
+
+    qDebug() << "Sink allocation benchmark counts"
+             << (AllocationCounter::countsMalloc() ? "every heap allocation (debug CRT hook)"
+                                                   : "operator new and the arrays the sinks report");
+
+    {
+        ChunkCopySink sink;
+        RtpDepacketizer depacketizer;
+        depacketizer.setPayloadType(96);
+        depacketizer.setSink(&sink);
+        runPhase("heap array per chunk", depacketizer, []() {});
+    }
+
+    {
+        StreamRingBuffer ring(4 * 1024 * 1024);
+        RtspClient client(nullptr, "rtsp://127.0.0.1/bench");
+        client.m_ring = &ring;
+        client.m_depacketizer.setPayloadType(96);
+        runPhase("client sink into input ring", client.m_depacketizer, [&ring]() {
+            int size = 0;
+            while (ring.peek(&size) && size > 0) {
+                ring.consume(size);
+            }
+        });
+        client.m_ring = nullptr;
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef RTSPBENCH_H
+#define RTSPBENCH_H
+
+#include <QString>
+
+// Benchmarks of the live ingest path. A friend of RtspClient, so it can
+// drive the client's sink and sockets without a player behind them.
+class RtspBench
+{
+public:
+    // Serves an H.264/H.265 elementary stream from a LoopbackRtspServer on
+    // 127.0.0.1, pulls it with RtspClient through OPTIONS, DESCRIBE, SETUP
+    // and PLAY into a headless player and logs packets sent against packets
+    // depacketized and lost, bytes committed and frames decoded.
+    static void runLoopback(const QString &filePath);
+
+    // Serves the same file from one loopback server per source and ingests
+    // it first with an RtspClient per thread polled by waitForReadyRead(100),
+    // as RtspStreamThread read the ffmpeg pipe, then through
+    // StreamIngestReactor, each into a headless player with its feeder.
+    // Logs send to ring hand-off latency, wake-ups and CPU of both.
+    static void runIngest(const QString &filePath, int sources);
+
+    // Drives the depacketizer with synthetic H.264 RTP for a few seconds per
+    // path and logs heap allocations per second: first with a new QByteArray
+    // per chunk as the ffmpeg pipe loop handed data on, then through the
+    // client's sink into an input ring that is drained as the feeder does.
+    static void runAllocation();
+};
+
+#endif // RTSPBENCH_H
@@ -0,0 +1,68 @@
+#include <QApplication>
+#include <QStringList>
+#include <QTextStream>
+#include "YuvConvert.h"
+#include "JpegEncoder.h"
+#include "RangeExporter.h"
+#include "MediaPlayerWrapper.h"
+#include "PlaybackClock.h"
+#include "ThumbnailCache.h"
+#include "PlaylistPlayer.h"
+#include "TimelineIndex.h"
+#include "PlayerPool.h"
+#include "RtspBench.h"
+
+// One row per benchmark: ShinPlayerBench <name> [arguments]
+struct Benchmark
+{
+    const char *name;
+    const char *usage;
+    int minArguments;
+    void (*run)(const QStringList &arguments);
+};
+
+static const Benchmark kBenchmarks[] = {
+    { "yuv", "", 0, [](const QStringList &) { YuvConvert::runBenchmark(); } },
+    { "jpeg", "", 0, [](const QStringList &) { JpegEncoder::runBenchmark(); } },
+    { "watermark", "", 0, [](const QStringList &) { MediaPlayerWrapper::runWatermarkBenchmark(); } },
+    { "export", "<file> <startMs> <endMs>", 3, [](const QStringList &args) {
+        RangeExporter::runBenchmark(args.at(0), args.at(1).toLongLong(), args.at(2).toLongLong());
+    } },
+    { "clock", "<file> <players>", 2, [](const QStringList &args) {
+        PlaybackClock::runBenchmark(args.at(0), args.at(1).toInt());
+    } },
+    { "scan", "<file>", 1, [](const QStringList &args) { MediaPlayerWrapper::runFastScanBenchmark(args.at(0)); } },
+    { "speed", "<file>", 1, [](const QStringList &args) { MediaPlayerWrapper::runSpeedBenchmark(args.at(0)); } },
+    { "seek", "<file> [file...]", 1, [](const QStringList &args) { MediaPlayerWrapper::runSeekBenchmark(args); } },
+    { "headless", "<file>", 1, [](const QStringList &args) { MediaPlayerWrapper::runHeadlessBenchmark(args.at(0)); } },
+    { "thumbs", "<file>", 1, [](const QStringList &args) { ThumbnailCache::runBenchmark(args.at(0)); } },
+    { "playlist", "<directory>", 1, [](const QStringList &args) { PlaylistPlayer::runBenchmark(args.at(0)); } },
+    { "timeline", "<directory>", 1, [](const QStringList &args) { TimelineIndex::runBenchmark(args.at(0)); } },
+    { "ingest", "<.h264/.h265 file> [sources]", 1, [](const QStringList &args) {
+        RtspBench::runIngest(args.at(0), args.size() > 1 ? args.at(1).toInt() : 8);
+    } },
+    { "wall", "<file or rtsp:// URL>", 1, [](const QStringList &args) { PlayerPool::runBenchmark(args.at(0)); } },
+    { "alloc", "", 0, [](const QStringList &) { RtspBench::runAllocation(); } },
+    { "rtsp", "<.h264/.h265 file>", 1, [](const QStringList &args) { RtspBench::runLoopback(args.at(0)); } },
+};
+
+int main(int argc, char *argv[])
+{
+    QApplication app(argc, argv);
+
+    const QStringList args = app.arguments().mid(1);
+    for (const Benchmark &benchmark : kBenchmarks) {
+        if (!args.isEmpty() && args.first() == QLatin1String(benchmark.name)
+            && args.size() - 1 >= benchmark.minArguments) {
+            benchmark.run(args.mid(1));
+            return 0;
+        }
+    }
+
+    QTextStream err(stderr);
+    err << "Usage: ShinPlayerBench <benchmark> [arguments]\n";
+    for (const Benchmark &benchmark : kBenchmarks) {
+        err << "  " << benchmark.name << " " << benchmark.usage << "\n";
+    }
+    return 1;
+}
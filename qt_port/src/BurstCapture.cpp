@@ -0,0 +1,262 @@
+#include "BurstCapture.h"
+#include "MediaPlayerWrapper.h"
+#include "YuvConvert.h"
+#include <QRunnable>
+#include <QImage>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QDir>
+#include <QDateTime>
+#include <QMutexLocker>
+#include <QDebug>
+#include <string.h>
+
+static const int kJpegQuality = 90;
+
+// Converts and writes one copied frame, then hands its buffer back.
+class BurstEncodeTask : public QRunnable
+{
+public:
+    BurstEncodeTask(BurstCapture *capture, QByteArray buffer, const DecodedFrame &frame,
+                    const QString &filePath)
+        : m_capture(capture)
+        , m_buffer(std::move(buffer))
+        , m_frame(frame)
+        , m_filePath(filePath)
+    {
+        m_frame.data = reinterpret_cast<const uchar *>(m_buffer.constData());
+    }
+
+    void run() override
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        bool ok = false;
+        QByteArray jpeg;
+        if (m_capture->m_format == BurstCapture::Jpeg && m_capture->m_jpegEncoder.encode(m_frame, &jpeg)) {
+            QFile file(m_filePath);
+            ok = file.open(QIODevice::WriteOnly) && file.write(jpeg) == jpeg.size();
+        } else {
+            // BMP, or a frame layout the JPEG encoder does not take
+            const QImage image = YuvConvert::toImage(m_frame);
+            const bool asJpeg = (m_capture->m_format == BurstCapture::Jpeg);
+            ok = !image.isNull() && image.save(m_filePath, asJpeg ? "JPG" : "BMP", asJpeg ? kJpegQuality : -1);
+        }
+        m_capture->m_encodeUs.fetch_add(timer.nsecsElapsed() / 1000, std::memory_order_relaxed);
+        if (!ok) {
+            qDebug() << "Failed to write burst frame" << m_filePath;
+        }
+
+        // Moved, so the pooled copy is the only reference and stays reusable
+        m_capture->releaseBuffer(std::move(m_buffer));
+        QMetaObject::invokeMethod(m_capture, "onFrameEncoded", Qt::QueuedConnection, Q_ARG(bool, ok));
+    }
+
+private:
+    BurstCapture *m_capture;
+    QByteArray m_buffer;
+    DecodedFrame m_frame;
+    QString m_filePath;
+};
+
+BurstCapture::BurstCapture(MediaPlayerWrapper *player, QObject *parent)
+    : QObject(parent)
+    , m_player(player)
+    , m_jpegEncoder(kJpegQuality)
+    , m_encodeUs(0)
+    , m_format(Jpeg)
+    , m_active(false)
+    , m_captureComplete(false)
+    , m_frameLimit(0)
+    , m_intervalMs(0)
+    , m_durationMs(0)
+    , m_taken(0)
+    , m_firstStamp(-1)
+    , m_nextStamp(0)
+    , m_accepting(false)
+    , m_saved(0)
+    , m_failed(0)
+{
+    m_encodePool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+    connect(m_player, &MediaPlayerWrapper::statusChanged, this, &BurstCapture::onPlayerStatusChanged);
+}
+
+BurstCapture::~BurstCapture()
+{
+    cancel();
+    m_encodePool.waitForDone();
+}
+
+bool BurstCapture::startBurst(const QString &directory, int frameCount, int format)
+{
+    if (frameCount <= 0) {
+        return false;
+    }
+    m_frameLimit = frameCount;
+    m_intervalMs = 0;
+    m_durationMs = 0;
+    return start(directory, format);
+}
+
+bool BurstCapture::startInterval(const QString &directory, int intervalMs, int durationMs, int format)
+{
+    if (intervalMs <= 0 || durationMs <= 0) {
+        return false;
+    }
+    m_frameLimit = 0;
+    m_intervalMs = intervalMs;
+    m_durationMs = durationMs;
+    return start(directory, format);
+}
+
+bool BurstCapture::start(const QString &directory, int format)
+{
+    if (m_active || !QDir().mkpath(directory)) {
+        return false;
+    }
+
+    m_directory = directory;
+    m_namePrefix = QString("burst_%1").arg(QDateTime::currentDateTime().toString("yyyyMMddhhmmsszzz"));
+    m_format = format;
+    m_captureComplete = false;
+    m_taken = 0;
+    m_firstStamp = -1;
+    m_nextStamp = 0;
+    m_saved = 0;
+    m_failed = 0;
+    m_encodeUs = 0;
+    m_active = true;
+    m_accepting = true;
+
+    if (!m_player->setDisplayConsumer(this)) {
+        m_active = false;
+        m_accepting = false;
+        return false;
+    }
+    return true;
+}
+
+void BurstCapture::cancel()
+{
+    if (!m_active) {
+        return;
+    }
+    m_accepting = false;
+    onCaptureComplete();
+}
+
+void BurstCapture::onFrame(const DecodedFrame &frame)
+{
+    if (!m_accepting.load(std::memory_order_acquire) || !frame.data || frame.size <= 0) {
+        return;
+    }
+
+    if (m_firstStamp < 0) {
+        m_firstStamp = frame.timestampMs;
+        m_nextStamp = frame.timestampMs;
+        m_timer.start();
+    }
+
+    bool last = false;
+    if (m_intervalMs > 0) {
+        if (frame.timestampMs - m_firstStamp > m_durationMs) {
+            m_accepting = false;
+            QMetaObject::invokeMethod(this, "onCaptureComplete", Qt::QueuedConnection);
+            return;
+        }
+        if (frame.timestampMs < m_nextStamp) {
+            return;
+        }
+        // Stay on the original grid even when frames arrive late
+        while (m_nextStamp <= frame.timestampMs) {
+            m_nextStamp += m_intervalMs;
+        }
+    } else {
+        last = (m_taken.load(std::memory_order_relaxed) + 1 >= m_frameLimit);
+    }
+
+    QByteArray buffer = acquireBuffer(frame.size);
+    memcpy(buffer.data(), frame.data, static_cast<size_t>(frame.size));
+
+    const int index = m_taken.fetch_add(1, std::memory_order_relaxed);
+    const QString filePath = QString("%1/%2_%3_f%4.%5").arg(m_directory, m_namePrefix)
+        .arg(index, 4, 10, QChar('0')).arg(frame.frameNum).arg(m_format == Jpeg ? "jpg" : "bmp");
+    m_encodePool.start(new BurstEncodeTask(this, std::move(buffer), frame, filePath));
+
+    if (last) {
+        m_accepting = false;
+        QMetaObject::invokeMethod(this, "onCaptureComplete", Qt::QueuedConnection);
+    }
+}
+
+QByteArray BurstCapture::acquireBuffer(int size)
+{
+    {
+        QMutexLocker locker(&m_bufferMutex);
+        for (int i = 0; i < m_freeBuffers.size(); ++i) {
+            if (m_freeBuffers.at(i).size() == size) {
+                return m_freeBuffers.takeAt(i);
+            }
+        }
+    }
+    return QByteArray(size, Qt::Uninitialized);
+}
+
+void BurstCapture::releaseBuffer(QByteArray buffer)
+{
+    QMutexLocker locker(&m_bufferMutex);
+    // Two per encoder covers the frame being copied while all encode
+    if (m_freeBuffers.size() < m_encodePool.maxThreadCount() * 2) {
+        m_freeBuffers.append(std::move(buffer));
+    }
+}
+
+void BurstCapture::onCaptureComplete()
+{
+    if (!m_active || m_captureComplete) {
+        return;
+    }
+    m_captureComplete = true;
+    // Returns once no onFrame() is running, so m_taken is final afterwards
+    if (m_player) {
+        m_player->setDisplayConsumer(nullptr);
+    }
+    finishIfDone();
+}
+
+void BurstCapture::onFrameEncoded(bool ok)
+{
+    if (ok) {
+        ++m_saved;
+    } else {
+        ++m_failed;
+    }
+    emit progress(m_saved, m_frameLimit > 0 ? m_frameLimit : m_taken.load(std::memory_order_relaxed));
+    finishIfDone();
+}
+
+void BurstCapture::onPlayerStatusChanged(int state)
+{
+    // Playback stopped or the file closed before the plan was complete
+    if (state == MediaPlayerWrapper::Stopped && m_active) {
+        cancel();
+    }
+}
+
+void BurstCapture::finishIfDone()
+{
+    if (!m_active || !m_captureComplete || m_saved + m_failed < m_taken.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    m_active = false;
+    const qint64 elapsedMs = m_timer.isValid() ? m_timer.elapsed() : 0;
+    const double fps = elapsedMs > 0 ? m_saved * 1000.0 / elapsedMs : 0.0;
+    const int encoded = m_saved + m_failed;
+    qDebug() << "Burst capture:" << m_saved << "frames saved," << m_failed << "failed in" << elapsedMs
+             << "ms =" << QString::number(fps, 'f', 1) << "fps on" << m_encodePool.maxThreadCount() << "encoders,"
+             << (encoded ? m_encodeUs.load(std::memory_order_relaxed) / 1000.0 / encoded : 0.0) << "ms per frame";
+    m_timer.invalidate();
+    emit finished(m_saved, m_failed, fps, m_directory);
+}
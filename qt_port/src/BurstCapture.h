@@ -0,0 +1,94 @@
+#ifndef BURSTCAPTURE_H
+#define BURSTCAPTURE_H
+
+#include <QObject>
+#include <QMutex>
+#include <QVector>
+#include <QByteArray>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QString>
+#include <QPointer>
+#include <atomic>
+#include "FrameConsumer.h"
+#include "JpegEncoder.h"
+
+class MediaPlayerWrapper;
+
+// Captures a run of frames from the YUV display callback of a playing
+// port: either N consecutive frames or one frame every T ms for a given
+// time range. The callback only copies the frame into a reused buffer;
+// conversion and image encoding run on a pool of one thread per core and
+// write numbered files into the target directory.
+class BurstCapture : public QObject, public FrameConsumer
+{
+    Q_OBJECT
+
+public:
+    enum Format {
+        Bmp = 0,
+        Jpeg = 1
+    };
+
+    explicit BurstCapture(MediaPlayerWrapper *player, QObject *parent = nullptr);
+    ~BurstCapture();
+
+    bool startBurst(const QString &directory, int frameCount, int format);
+    bool startInterval(const QString &directory, int intervalMs, int durationMs, int format);
+    void cancel();
+    bool isActive() const { return m_active; }
+
+    // FrameConsumer, on the SDK display thread
+    void onFrame(const DecodedFrame &frame) override;
+
+signals:
+    void progress(int saved, int total);
+    // fps is saved frames over the time from the first frame taken to the
+    // last file written.
+    void finished(int saved, int failed, double fps, const QString &directory);
+
+private slots:
+    void onCaptureComplete();
+    void onFrameEncoded(bool ok);
+    void onPlayerStatusChanged(int state);
+
+private:
+    friend class BurstEncodeTask;
+
+    bool start(const QString &directory, int format);
+    QByteArray acquireBuffer(int size);
+    void releaseBuffer(QByteArray buffer);
+    void finishIfDone();
+
+    QPointer<MediaPlayerWrapper> m_player;
+    QThreadPool m_encodePool;
+    // YV12 frames go straight to JPEG; one thread per encode since the
+    // pool already spreads frames over the cores
+    JpegEncoder m_jpegEncoder;
+    std::atomic<qint64> m_encodeUs;
+    QString m_directory;
+    QString m_namePrefix;
+    int m_format;
+    bool m_active;
+    bool m_captureComplete;
+
+    // Capture plan; 0 disables the respective limit
+    int m_frameLimit;
+    int m_intervalMs;
+    int m_durationMs;
+
+    // Written by the display thread only while accepting
+    std::atomic<int> m_taken;
+    qint64 m_firstStamp;
+    qint64 m_nextStamp;
+    std::atomic<bool> m_accepting;
+
+    int m_saved;
+    int m_failed;
+    QElapsedTimer m_timer;
+
+    QMutex m_bufferMutex;
+    QVector<QByteArray> m_freeBuffers;
+};
+
+#endif // BURSTCAPTURE_H
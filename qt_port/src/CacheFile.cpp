@@ -0,0 +1,32 @@
+#include "CacheFile.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+QString CacheFile::path(const QString &kind, const QString &key, const QString &suffix)
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/" + kind + "/"
+        + QString::fromLatin1(QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex()) + suffix;
+}
+
+bool CacheFile::write(const QString &path, const std::function<void(QDataStream &)> &serialize)
+{
+    if (!QDir().mkpath(QFileInfo(path).absolutePath())) {
+        return false;
+    }
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QDataStream out(&file);
+    serialize(out);
+    if (out.status() != QDataStream::Ok) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
@@ -0,0 +1,22 @@
+#ifndef CACHEFILE_H
+#define CACHEFILE_H
+
+#include <QString>
+#include <functional>
+
+class QDataStream;
+
+// Locations and writes shared by the on-disk indexes and caches
+class CacheFile
+{
+public:
+    // <app cache>/<kind>/<SHA-1 of key><suffix>, for entries that cannot or
+    // should not sit next to the file they describe
+    static QString path(const QString &kind, const QString &key, const QString &suffix);
+
+    // Streams a whole file through QSaveFile, creating its directory. The
+    // old content is only replaced, atomically, if every write succeeded.
+    static bool write(const QString &path, const std::function<void(QDataStream &)> &serialize);
+};
+
+#endif // CACHEFILE_H
@@ -0,0 +1,13 @@
+#include "CpuTime.h"
+#include <Windows.h>
+
+quint64 CpuTime::processUs()
+{
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime)) {
+        return 0;
+    }
+    const quint64 kernel = (static_cast<quint64>(kernelTime.dwHighDateTime) << 32) | kernelTime.dwLowDateTime;
+    const quint64 user = (static_cast<quint64>(userTime.dwHighDateTime) << 32) | userTime.dwLowDateTime;
+    return (kernel + user) / 10;    // 100 ns units
+}
@@ -0,0 +1,14 @@
+#ifndef CPUTIME_H
+#define CPUTIME_H
+
+#include <QtGlobal>
+
+// CPU time of the whole process, for statistics and benchmarks
+class CpuTime
+{
+public:
+    // User plus kernel time of all threads, in microseconds
+    static quint64 processUs();
+};
+
+#endif // CPUTIME_H
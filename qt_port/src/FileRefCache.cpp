@@ -0,0 +1,146 @@
+#include "FileRefCache.h"
+#include "CacheFile.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QDebug>
+
+static const quint32 kEntryMagic = 0x53524631;  // "SRF1"
+static const qint64 kIdentityHeadBytes = 64 * 1024;
+
+FileRefCache *FileRefCache::instance()
+{
+    static FileRefCache cache;
+    return &cache;
+}
+
+FileRefCache::FileRefCache()
+    : m_directory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/fileref")
+    , m_maxEntries(256)
+    , m_maxBytes(256 * 1024 * 1024)
+{
+}
+
+void FileRefCache::setDirectory(const QString &path)
+{
+    QMutexLocker locker(&m_mutex);
+    m_directory = path;
+}
+
+QString FileRefCache::directory() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_directory;
+}
+
+void FileRefCache::setLimits(int maxEntries, qint64 maxBytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxEntries = qMax(1, maxEntries);
+    m_maxBytes = qMax<qint64>(0, maxBytes);
+    evict();
+}
+
+QString FileRefCache::entryName(const QString &filePath)
+{
+    QFileInfo info(filePath);
+    QFile file(filePath);
+    if (!info.isFile() || !file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::number(info.size()));
+    hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+    hash.addData(file.read(kIdentityHeadBytes));
+
+    return QString::fromLatin1(hash.result().toHex()) + ".ref";
+}
+
+bool FileRefCache::load(const QString &filePath, QByteArray *refValue)
+{
+    // Reading the media file stays outside the lock
+    const QString name = entryName(filePath);
+    if (name.isEmpty()) {
+        return false;
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    const QString path = m_directory + "/" + name;
+    QFile entry(path);
+    if (!entry.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&entry);
+    quint32 magic = 0;
+    QByteArray data;
+    in >> magic >> data;
+    entry.close();
+    if (in.status() != QDataStream::Ok || magic != kEntryMagic || data.isEmpty()) {
+        QFile::remove(path);
+        return false;
+    }
+
+    // The modification time is the LRU stamp; a miss never creates a file
+    QFile stamp(path);
+    if (stamp.open(QIODevice::ReadWrite | QIODevice::ExistingOnly)) {
+        stamp.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    }
+    *refValue = data;
+    return true;
+}
+
+void FileRefCache::store(const QString &filePath, const QByteArray &refValue)
+{
+    const QString name = entryName(filePath);
+    if (name.isEmpty() || refValue.isEmpty()) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    if (refValue.size() > m_maxBytes) {
+        return;
+    }
+
+    const QString path = m_directory + "/" + name;
+    if (!CacheFile::write(path, [&refValue](QDataStream &out) { out << kEntryMagic << refValue; })) {
+        qDebug() << "Failed to write file index cache entry" << path;
+        return;
+    }
+
+    evict();
+}
+
+void FileRefCache::remove(const QString &filePath)
+{
+    const QString name = entryName(filePath);
+    if (name.isEmpty()) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    QFile::remove(m_directory + "/" + name);
+}
+
+void FileRefCache::evict()
+{
+    QDir dir(m_directory);
+    const QFileInfoList entries = dir.entryInfoList(QStringList() << "*.ref", QDir::Files, QDir::Time);
+
+    // Newest first; keep a prefix that fits both limits
+    qint64 totalBytes = 0;
+    for (int i = 0; i < entries.size(); ++i) {
+        totalBytes += entries.at(i).size();
+        if (i >= m_maxEntries || totalBytes > m_maxBytes) {
+            QFile::remove(entries.at(i).absoluteFilePath());
+        }
+    }
+}
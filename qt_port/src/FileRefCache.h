@@ -0,0 +1,40 @@
+#ifndef FILEREFCACHE_H
+#define FILEREFCACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QMutex>
+
+// On-disk cache of PlayM4 file reference (index) blobs, so a file that was
+// indexed once can be seeked and stepped backwards right after opening.
+// Entries are keyed by file identity (size, modification time and a hash of
+// the first 64 KB), not by path, and evicted least-recently-used when the
+// cache exceeds its entry or byte limit.
+class FileRefCache
+{
+public:
+    static FileRefCache *instance();
+
+    void setDirectory(const QString &path);
+    QString directory() const;
+    void setLimits(int maxEntries, qint64 maxBytes);
+
+    bool load(const QString &filePath, QByteArray *refValue);
+    void store(const QString &filePath, const QByteArray &refValue);
+    void remove(const QString &filePath);
+
+private:
+    FileRefCache();
+    Q_DISABLE_COPY(FileRefCache)
+
+    // Identity of the media file; reads it, so called without the lock
+    static QString entryName(const QString &filePath);
+    void evict();
+
+    mutable QMutex m_mutex;
+    QString m_directory;
+    int m_maxEntries;
+    qint64 m_maxBytes;
+};
+
+#endif // FILEREFCACHE_H
@@ -0,0 +1,41 @@
+#ifndef FRAMECONSUMER_H
+#define FRAMECONSUMER_H
+
+#include <QtGlobal>
+
+struct WatermarkData;
+
+// One decoded video picture as handed out by the PlayM4 decode callback.
+// The planes are only valid for the duration of FrameConsumer::onFrame().
+struct DecodedFrame
+{
+    const uchar *data;      // YV12: Y plane, then V, then U
+    int size;
+    int width;
+    int height;
+    int type;               // T_YV12, T_UYVY or T_RGB32
+    qint64 timestampMs;
+    quint32 frameNum;
+};
+
+// Receiver for headless decoding (MediaPlayerWrapper::startHeadless).
+// Called on the SDK decode thread; a slow consumer slows the decoder down
+// rather than dropping frames.
+class FrameConsumer
+{
+public:
+    virtual ~FrameConsumer() {}
+
+    virtual void onFrame(const DecodedFrame &frame) = 0;
+    virtual void onEndOfStream() {}
+    // Every watermark record met while decoding headlessly, with the frame
+    // it belongs to and whether its RSA signature checked out
+    virtual void onWatermark(const WatermarkData &data, quint32 frameNum, bool rsaValid)
+    {
+        Q_UNUSED(data)
+        Q_UNUSED(frameNum)
+        Q_UNUSED(rsaValid)
+    }
+};
+
+#endif // FRAMECONSUMER_H
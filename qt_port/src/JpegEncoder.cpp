@@ -0,0 +1,707 @@
+#include "JpegEncoder.h"
+#include "FrameConsumer.h"
+#include "MediaPlayerWrapper.h"
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <vector>
+#include <string.h>
+
+// SSE2 is part of every x64 target, so no runtime dispatch is needed here
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JPEG_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+static std::atomic<bool> s_simdEnabled(true);
+
+// ---- Tables (ITU-T T.81 Annex K) -------------------------------------------
+
+static const uchar kLumaQuant[64] = {
+    16, 11, 10, 16, 24, 40, 51, 61,
+    12, 12, 14, 19, 26, 58, 60, 55,
+    14, 13, 16, 24, 40, 57, 69, 56,
+    14, 17, 22, 29, 51, 87, 80, 62,
+    18, 22, 37, 56, 68, 109, 103, 77,
+    24, 35, 55, 64, 81, 104, 113, 92,
+    49, 64, 78, 87, 103, 121, 120, 101,
+    72, 92, 95, 98, 112, 100, 103, 99
+};
+
+static const uchar kChromaQuant[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99,
+    18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99,
+    47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99
+};
+
+// Natural (row-major) index of each zigzag position
+static const uchar kZigzag[64] = {
+    0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+static const uchar kDcLumaBits[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+static const uchar kDcChromaBits[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+static const uchar kDcValues[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static const uchar kAcLumaBits[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+static const uchar kAcLumaValues[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa
+};
+
+static const uchar kAcChromaBits[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+static const uchar kAcChromaValues[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa
+};
+
+// AAN DCT output scale per frequency
+static const float kAanScale[8] = {
+    1.0f, 1.387039845f, 1.306562965f, 1.175875602f, 1.0f, 0.785694958f, 0.541196100f, 0.275899379f
+};
+
+struct HuffTable {
+    quint16 code[256];
+    uchar length[256];
+};
+
+static void buildHuffTable(const uchar *bits, const uchar *values, HuffTable *table)
+{
+    memset(table, 0, sizeof(*table));
+    int code = 0;
+    int k = 0;
+    for (int length = 1; length <= 16; ++length) {
+        for (int i = 0; i < bits[length - 1]; ++i) {
+            table->code[values[k]] = static_cast<quint16>(code++);
+            table->length[values[k]] = static_cast<uchar>(length);
+            ++k;
+        }
+        code <<= 1;
+    }
+}
+
+struct HuffTables {
+    HuffTable dcLuma;
+    HuffTable dcChroma;
+    HuffTable acLuma;
+    HuffTable acChroma;
+
+    HuffTables()
+    {
+        buildHuffTable(kDcLumaBits, kDcValues, &dcLuma);
+        buildHuffTable(kDcChromaBits, kDcValues, &dcChroma);
+        buildHuffTable(kAcLumaBits, kAcLumaValues, &acLuma);
+        buildHuffTable(kAcChromaBits, kAcChromaValues, &acChroma);
+    }
+};
+
+static const HuffTables &huffTables()
+{
+    static const HuffTables tables;
+    return tables;
+}
+
+// ---- Entropy coding --------------------------------------------------------
+
+class BitWriter
+{
+public:
+    explicit BitWriter(QByteArray *out)
+        : m_out(out)
+        , m_acc(0)
+        , m_bits(0)
+    {
+    }
+
+    void put(quint32 value, int length)
+    {
+        m_acc = (m_acc << length) | (value & ((1u << length) - 1));
+        m_bits += length;
+        while (m_bits >= 8) {
+            m_bits -= 8;
+            const char byte = static_cast<char>(m_acc >> m_bits);
+            m_out->append(byte);
+            if (byte == static_cast<char>(0xff)) {
+                m_out->append('\0');
+            }
+        }
+        m_acc &= (1u << m_bits) - 1;
+    }
+
+    // Pads the last byte with one bits, as T.81 requires before a marker
+    void flush()
+    {
+        if (m_bits > 0) {
+            put(0x7f, 8 - m_bits);
+        }
+    }
+
+private:
+    QByteArray *m_out;
+    quint32 m_acc;
+    int m_bits;
+};
+
+static inline int bitLength(int value)
+{
+    unsigned int magnitude = static_cast<unsigned int>(value < 0 ? -value : value);
+    int length = 0;
+    while (magnitude) {
+        ++length;
+        magnitude >>= 1;
+    }
+    return length;
+}
+
+static void encodeBlock(BitWriter &writer, const int *zz, int *prevDc, const HuffTable &dc, const HuffTable &ac)
+{
+    const int diff = zz[0] - *prevDc;
+    *prevDc = zz[0];
+    const int dcLength = bitLength(diff);
+    writer.put(dc.code[dcLength], dc.length[dcLength]);
+    if (dcLength) {
+        writer.put(static_cast<quint32>(diff < 0 ? diff - 1 : diff), dcLength);
+    }
+
+    int run = 0;
+    for (int k = 1; k < 64; ++k) {
+        const int value = zz[k];
+        if (value == 0) {
+            ++run;
+            continue;
+        }
+        while (run > 15) {
+            writer.put(ac.code[0xf0], ac.length[0xf0]);
+            run -= 16;
+        }
+        const int length = bitLength(value);
+        const int symbol = (run << 4) | length;
+        writer.put(ac.code[symbol], ac.length[symbol]);
+        writer.put(static_cast<quint32>(value < 0 ? value - 1 : value), length);
+        run = 0;
+    }
+    if (run > 0) {
+        writer.put(ac.code[0x00], ac.length[0x00]);
+    }
+}
+
+// ---- Forward DCT and quantisation ------------------------------------------
+
+static inline float vadd(float a, float b) { return a + b; }
+static inline float vsub(float a, float b) { return a - b; }
+static inline float vmul(float a, float k) { return a * k; }
+
+#ifdef JPEG_HAVE_SSE2
+static inline __m128 vadd(__m128 a, __m128 b) { return _mm_add_ps(a, b); }
+static inline __m128 vsub(__m128 a, __m128 b) { return _mm_sub_ps(a, b); }
+static inline __m128 vmul(__m128 a, float k) { return _mm_mul_ps(a, _mm_set1_ps(k)); }
+#endif
+
+// One AAN pass (IJG jfdctflt) over d[0..7]; T is a float or four columns.
+template <typename T>
+static inline void forwardDct8(T *d)
+{
+    const T tmp0 = vadd(d[0], d[7]);
+    const T tmp7 = vsub(d[0], d[7]);
+    const T tmp1 = vadd(d[1], d[6]);
+    const T tmp6 = vsub(d[1], d[6]);
+    const T tmp2 = vadd(d[2], d[5]);
+    const T tmp5 = vsub(d[2], d[5]);
+    const T tmp3 = vadd(d[3], d[4]);
+    const T tmp4 = vsub(d[3], d[4]);
+
+    // Even part
+    const T tmp10 = vadd(tmp0, tmp3);
+    const T tmp13 = vsub(tmp0, tmp3);
+    const T tmp11 = vadd(tmp1, tmp2);
+    const T tmp12 = vsub(tmp1, tmp2);
+    d[0] = vadd(tmp10, tmp11);
+    d[4] = vsub(tmp10, tmp11);
+    const T z1 = vmul(vadd(tmp12, tmp13), 0.707106781f);
+    d[2] = vadd(tmp13, z1);
+    d[6] = vsub(tmp13, z1);
+
+    // Odd part
+    const T odd10 = vadd(tmp4, tmp5);
+    const T odd11 = vadd(tmp5, tmp6);
+    const T odd12 = vadd(tmp6, tmp7);
+    const T z5 = vmul(vsub(odd10, odd12), 0.382683433f);
+    const T z2 = vadd(vmul(odd10, 0.541196100f), z5);
+    const T z4 = vadd(vmul(odd12, 1.306562965f), z5);
+    const T z3 = vmul(odd11, 0.707106781f);
+    const T z11 = vadd(tmp7, z3);
+    const T z13 = vsub(tmp7, z3);
+    d[5] = vadd(z13, z2);
+    d[3] = vsub(z13, z2);
+    d[1] = vadd(z11, z4);
+    d[7] = vsub(z11, z4);
+}
+
+// Both paths run the column pass, transpose, and the column pass again, so
+// the coefficients come out transposed; the divisors and the zigzag lookup
+// are laid out to match.
+static void dctQuantScalar(const uchar *src, int stride, const float *divisors, int *out)
+{
+    float block[64];
+    for (int r = 0; r < 8; ++r) {
+        for (int c = 0; c < 8; ++c) {
+            block[r * 8 + c] = static_cast<float>(src[r * stride + c]) - 128.0f;
+        }
+    }
+
+    float column[8];
+    float transposed[64];
+    for (int c = 0; c < 8; ++c) {
+        for (int r = 0; r < 8; ++r) {
+            column[r] = block[r * 8 + c];
+        }
+        forwardDct8(column);
+        for (int r = 0; r < 8; ++r) {
+            transposed[c * 8 + r] = column[r];
+        }
+    }
+    for (int c = 0; c < 8; ++c) {
+        for (int r = 0; r < 8; ++r) {
+            column[r] = transposed[r * 8 + c];
+        }
+        forwardDct8(column);
+        for (int r = 0; r < 8; ++r) {
+            block[r * 8 + c] = column[r];
+        }
+    }
+
+    for (int i = 0; i < 64; ++i) {
+        out[i] = static_cast<int>(std::lrint(block[i] * divisors[i]));
+    }
+}
+
+#ifdef JPEG_HAVE_SSE2
+static void dctQuantSse2(const uchar *src, int stride, const float *divisors, int *out)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 bias = _mm_set1_ps(128.0f);
+
+    __m128 lo[8];
+    __m128 hi[8];
+    for (int r = 0; r < 8; ++r) {
+        const __m128i row = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + r * stride)), zero);
+        lo[r] = _mm_sub_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(row, zero)), bias);
+        hi[r] = _mm_sub_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(row, zero)), bias);
+    }
+
+    forwardDct8(lo);
+    forwardDct8(hi);
+
+    // [[A B][C D]] -> [[A' C'][B' D']]
+    _MM_TRANSPOSE4_PS(lo[0], lo[1], lo[2], lo[3]);
+    _MM_TRANSPOSE4_PS(hi[0], hi[1], hi[2], hi[3]);
+    _MM_TRANSPOSE4_PS(lo[4], lo[5], lo[6], lo[7]);
+    _MM_TRANSPOSE4_PS(hi[4], hi[5], hi[6], hi[7]);
+    __m128 tlo[8] = { lo[0], lo[1], lo[2], lo[3], hi[0], hi[1], hi[2], hi[3] };
+    __m128 thi[8] = { lo[4], lo[5], lo[6], lo[7], hi[4], hi[5], hi[6], hi[7] };
+
+    forwardDct8(tlo);
+    forwardDct8(thi);
+
+    for (int r = 0; r < 8; ++r) {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + r * 8),
+                         _mm_cvtps_epi32(_mm_mul_ps(tlo[r], _mm_loadu_ps(divisors + r * 8))));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + r * 8 + 4),
+                         _mm_cvtps_epi32(_mm_mul_ps(thi[r], _mm_loadu_ps(divisors + r * 8 + 4))));
+    }
+}
+#endif
+
+// Zigzag position -> index in the transposed coefficient block
+struct TransposedZigzag {
+    uchar index[64];
+
+    TransposedZigzag()
+    {
+        for (int k = 0; k < 64; ++k) {
+            index[k] = static_cast<uchar>((kZigzag[k] % 8) * 8 + kZigzag[k] / 8);
+        }
+    }
+};
+
+static const uchar *transposedZigzag()
+{
+    static const TransposedZigzag table;
+    return table.index;
+}
+
+// Copies an 8x8 block that runs off the plane edge, repeating the last
+// row and column.
+static const uchar *edgeBlock(const uchar *plane, int stride, int planeWidth, int planeHeight,
+                              int x0, int y0, uchar *scratch)
+{
+    if (x0 + 8 <= planeWidth && y0 + 8 <= planeHeight) {
+        return plane + static_cast<ptrdiff_t>(y0) * stride + x0;
+    }
+    for (int r = 0; r < 8; ++r) {
+        const uchar *row = plane + static_cast<ptrdiff_t>(qMin(y0 + r, planeHeight - 1)) * stride;
+        for (int c = 0; c < 8; ++c) {
+            scratch[r * 8 + c] = row[qMin(x0 + c, planeWidth - 1)];
+        }
+    }
+    return scratch;
+}
+
+// ---- Encoder ---------------------------------------------------------------
+
+JpegEncoder::JpegEncoder(int quality)
+    : m_quality(0)
+    , m_threads(1)
+{
+    setQuality(quality);
+}
+
+void JpegEncoder::setQuality(int quality)
+{
+    m_quality = qBound(1, quality, 100);
+    const int scale = (m_quality < 50) ? 5000 / m_quality : 200 - m_quality * 2;
+
+    for (int k = 0; k < 64; ++k) {
+        const int natural = kZigzag[k];
+        m_lumaTable[k] = static_cast<uchar>(qBound(1, (kLumaQuant[natural] * scale + 50) / 100, 255));
+        m_chromaTable[k] = static_cast<uchar>(qBound(1, (kChromaQuant[natural] * scale + 50) / 100, 255));
+    }
+
+    // Divisors in the transposed layout the DCT produces
+    for (int k = 0; k < 64; ++k) {
+        const int natural = kZigzag[k];
+        const int row = natural / 8;
+        const int col = natural % 8;
+        const float aan = kAanScale[row] * kAanScale[col] * 8.0f;
+        m_lumaDivisors[col * 8 + row] = 1.0f / (m_lumaTable[k] * aan);
+        m_chromaDivisors[col * 8 + row] = 1.0f / (m_chromaTable[k] * aan);
+    }
+}
+
+void JpegEncoder::setThreadCount(int threads)
+{
+    m_threads = qMax(1, threads);
+}
+
+void JpegEncoder::setSimdEnabled(bool enabled)
+{
+    s_simdEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool JpegEncoder::simdAvailable()
+{
+#ifdef JPEG_HAVE_SSE2
+    return true;
+#else
+    return false;
+#endif
+}
+
+void JpegEncoder::encodeStrip(const uchar *y, int yStride, const uchar *u, const uchar *v, int uvStride,
+                              int width, int height, int firstMcuRow, int mcuRows, QByteArray *out) const
+{
+    typedef void (*DctQuant)(const uchar *, int, const float *, int *);
+    DctQuant dctQuant = dctQuantScalar;
+#ifdef JPEG_HAVE_SSE2
+    if (s_simdEnabled.load(std::memory_order_relaxed)) {
+        dctQuant = dctQuantSse2;
+    }
+#endif
+
+    const HuffTables &huff = huffTables();
+    const uchar *zigzag = transposedZigzag();
+    const int chromaWidth = (width + 1) / 2;
+    const int chromaHeight = (height + 1) / 2;
+    const int mcusPerRow = (width + 15) / 16;
+
+    BitWriter writer(out);
+    int prevDc[3] = { 0, 0, 0 };
+    uchar scratch[64];
+    int coefficients[64];
+    int zz[64];
+
+    for (int my = firstMcuRow; my < firstMcuRow + mcuRows; ++my) {
+        for (int mx = 0; mx < mcusPerRow; ++mx) {
+            for (int b = 0; b < 4; ++b) {
+                const uchar *src = edgeBlock(y, yStride, width, height, mx * 16 + (b & 1) * 8, my * 16 + (b >> 1) * 8, scratch);
+                dctQuant(src, src == scratch ? 8 : yStride, m_lumaDivisors, coefficients);
+                for (int k = 0; k < 64; ++k) {
+                    zz[k] = coefficients[zigzag[k]];
+                }
+                encodeBlock(writer, zz, &prevDc[0], huff.dcLuma, huff.acLuma);
+            }
+
+            const uchar *chroma[2] = { u, v };
+            for (int c = 0; c < 2; ++c) {
+                const uchar *src = edgeBlock(chroma[c], uvStride, chromaWidth, chromaHeight, mx * 8, my * 8, scratch);
+                dctQuant(src, src == scratch ? 8 : uvStride, m_chromaDivisors, coefficients);
+                for (int k = 0; k < 64; ++k) {
+                    zz[k] = coefficients[zigzag[k]];
+                }
+                encodeBlock(writer, zz, &prevDc[c + 1], huff.dcChroma, huff.acChroma);
+            }
+        }
+    }
+    writer.flush();
+}
+
+namespace {
+
+class JpegStripTask : public QRunnable
+{
+public:
+    JpegStripTask(const std::function<void()> &work, QSemaphore *done)
+        : m_work(work)
+        , m_done(done)
+    {
+    }
+
+    void run() override
+    {
+        m_work();
+        m_done->release();
+    }
+
+private:
+    std::function<void()> m_work;
+    QSemaphore *m_done;
+};
+
+void appendMarker(QByteArray *out, uchar marker)
+{
+    out->append(static_cast<char>(0xff));
+    out->append(static_cast<char>(marker));
+}
+
+void appendWord(QByteArray *out, int value)
+{
+    out->append(static_cast<char>((value >> 8) & 0xff));
+    out->append(static_cast<char>(value & 0xff));
+}
+
+void appendHuffTable(QByteArray *out, int tableClassId, const uchar *bits, const uchar *values, int count)
+{
+    appendMarker(out, 0xc4);
+    appendWord(out, 2 + 1 + 16 + count);
+    out->append(static_cast<char>(tableClassId));
+    out->append(reinterpret_cast<const char *>(bits), 16);
+    out->append(reinterpret_cast<const char *>(values), count);
+}
+
+} // namespace
+
+bool JpegEncoder::encode(const uchar *y, int yStride, const uchar *u, const uchar *v, int uvStride,
+                         int width, int height, QByteArray *out) const
+{
+    if (!y || !u || !v || !out || width <= 0 || height <= 0 || width > 65535 || height > 65535) {
+        return false;
+    }
+
+    const int mcusPerRow = (width + 15) / 16;
+    const int mcuRows = (height + 15) / 16;
+
+    // Strip layout: one restart interval per strip
+    int strips = qMin(m_threads, mcuRows);
+    int rowsPerStrip = (mcuRows + strips - 1) / strips;
+    if (rowsPerStrip * mcusPerRow > 65535) {
+        rowsPerStrip = mcuRows;
+    }
+    strips = (mcuRows + rowsPerStrip - 1) / rowsPerStrip;
+
+    // resize() rather than clear() keeps the capacity of a reused buffer
+    out->resize(0);
+    out->reserve(width * height / 4 + 1024);
+
+    appendMarker(out, 0xd8);    // SOI
+
+    appendMarker(out, 0xe0);    // APP0 JFIF 1.01, no density
+    appendWord(out, 16);
+    out->append("JFIF", 5);
+    out->append(static_cast<char>(1));
+    out->append(static_cast<char>(1));
+    out->append(static_cast<char>(0));
+    appendWord(out, 1);
+    appendWord(out, 1);
+    out->append(static_cast<char>(0));
+    out->append(static_cast<char>(0));
+
+    appendMarker(out, 0xdb);    // DQT, both tables
+    appendWord(out, 2 + 2 * 65);
+    out->append(static_cast<char>(0));
+    out->append(reinterpret_cast<const char *>(m_lumaTable), 64);
+    out->append(static_cast<char>(1));
+    out->append(reinterpret_cast<const char *>(m_chromaTable), 64);
+
+    appendMarker(out, 0xc0);    // SOF0, Y 2x2 and Cb/Cr 1x1
+    appendWord(out, 17);
+    out->append(static_cast<char>(8));
+    appendWord(out, height);
+    appendWord(out, width);
+    out->append(static_cast<char>(3));
+    const char components[9] = { 1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1 };
+    out->append(components, 9);
+
+    appendHuffTable(out, 0x00, kDcLumaBits, kDcValues, 12);
+    appendHuffTable(out, 0x10, kAcLumaBits, kAcLumaValues, 162);
+    appendHuffTable(out, 0x01, kDcChromaBits, kDcValues, 12);
+    appendHuffTable(out, 0x11, kAcChromaBits, kAcChromaValues, 162);
+
+    if (strips > 1) {
+        appendMarker(out, 0xdd);    // DRI
+        appendWord(out, 4);
+        appendWord(out, rowsPerStrip * mcusPerRow);
+    }
+
+    appendMarker(out, 0xda);    // SOS
+    appendWord(out, 12);
+    out->append(static_cast<char>(3));
+    const char scan[9] = { 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0 };
+    out->append(scan, 9);
+
+    if (strips == 1) {
+        encodeStrip(y, yStride, u, v, uvStride, width, height, 0, mcuRows, out);
+    } else {
+        QVector<QByteArray> pieces(strips);
+        QSemaphore done;
+        for (int s = 1; s < strips; ++s) {
+            const int first = s * rowsPerStrip;
+            const int rows = qMin(rowsPerStrip, mcuRows - first);
+            QByteArray *piece = &pieces[s];
+            QThreadPool::globalInstance()->start(new JpegStripTask([=]() {
+                encodeStrip(y, yStride, u, v, uvStride, width, height, first, rows, piece);
+            }, &done));
+        }
+        encodeStrip(y, yStride, u, v, uvStride, width, height, 0, rowsPerStrip, &pieces[0]);
+        done.acquire(strips - 1);
+
+        for (int s = 0; s < strips; ++s) {
+            if (s > 0) {
+                appendMarker(out, static_cast<uchar>(0xd0 + ((s - 1) & 7)));  // RSTn
+            }
+            out->append(pieces.at(s));
+        }
+    }
+
+    appendMarker(out, 0xd9);    // EOI
+    return true;
+}
+
+bool JpegEncoder::encode(const DecodedFrame &frame, QByteArray *out) const
+{
+    if (frame.type != T_YV12 || !frame.data || frame.width <= 0 || frame.height <= 0) {
+        return false;
+    }
+
+    // YV12: Y, then V, then U, each chroma plane a quarter of the luma
+    const int chromaWidth = (frame.width + 1) / 2;
+    const int chromaHeight = (frame.height + 1) / 2;
+    const int required = frame.width * frame.height + 2 * chromaWidth * chromaHeight;
+    if (frame.size < required) {
+        return false;
+    }
+    const uchar *y = frame.data;
+    const uchar *v = y + frame.width * frame.height;
+    const uchar *u = v + chromaWidth * chromaHeight;
+    return encode(y, frame.width, u, v, chromaWidth, frame.width, frame.height, out);
+}
+
+void JpegEncoder::runBenchmark()
+{
+    struct Resolution {
+        int width;
+        int height;
+        const char *name;
+    };
+    static const Resolution resolutions[] = {
+        { 1280, 720, "720p" },
+        { 1920, 1080, "1080p" },
+        { 3840, 2160, "4K" }
+    };
+    static const int kIterations = 10;
+
+    const bool previousSimd = s_simdEnabled.load(std::memory_order_relaxed);
+    const int cores = qMax(1, QThread::idealThreadCount());
+    qDebug() << "JPEG encoder benchmark, quality 85, SIMD" << (simdAvailable() ? "SSE2" : "unavailable")
+             << "," << cores << "cores";
+
+    for (const Resolution &res : resolutions) {
+        // Smooth gradients with a little texture, roughly camera-like
+        const int chromaWidth = res.width / 2;
+        const int chromaHeight = res.height / 2;
+        std::vector<uchar> planes(static_cast<size_t>(res.width * res.height + 2 * chromaWidth * chromaHeight));
+        uchar *y = planes.data();
+        uchar *v = y + res.width * res.height;
+        uchar *u = v + chromaWidth * chromaHeight;
+        for (int row = 0; row < res.height; ++row) {
+            for (int col = 0; col < res.width; ++col) {
+                y[row * res.width + col] = static_cast<uchar>(16 + (col * 200 / res.width + row * 19 / res.height
+                                                                    + ((col * 7 + row * 13) & 15)));
+            }
+        }
+        for (int i = 0; i < chromaWidth * chromaHeight; ++i) {
+            u[i] = static_cast<uchar>(96 + (i % chromaWidth) * 64 / chromaWidth);
+            v[i] = static_cast<uchar>(160 - (i / chromaWidth) * 64 / chromaHeight);
+        }
+
+        struct Variant {
+            bool simd;
+            int threads;
+        };
+        const Variant variants[] = { { false, 1 }, { true, 1 }, { true, cores } };
+        for (int i = 0; i < 3; ++i) {
+            const Variant &variant = variants[i];
+            if ((variant.simd && !simdAvailable()) || (i == 2 && cores == 1)) {
+                continue;
+            }
+            setSimdEnabled(variant.simd);
+            JpegEncoder encoder(85);
+            encoder.setThreadCount(variant.threads);
+
+            QByteArray jpeg;
+            QElapsedTimer timer;
+            timer.start();
+            for (int i = 0; i < kIterations; ++i) {
+                encoder.encode(y, res.width, u, v, chromaWidth, res.width, res.height, &jpeg);
+            }
+            const double msPerFrame = timer.nsecsElapsed() / 1e6 / kIterations;
+            qDebug().nospace() << res.name << " " << (variant.simd ? "SIMD" : "scalar") << " x" << variant.threads
+                               << ": " << QString::number(msPerFrame, 'f', 2) << " ms/frame, "
+                               << jpeg.size() / 1024 << " KB";
+        }
+    }
+
+    setSimdEnabled(previousSimd);
+}
@@ -0,0 +1,56 @@
+#ifndef JPEGENCODER_H
+#define JPEGENCODER_H
+
+#include <QtGlobal>
+#include <QByteArray>
+
+struct DecodedFrame;
+
+// Baseline JPEG encoder (4:2:0, standard Huffman tables) that reads YUV420
+// planes directly, so frames from the decode or display callback are never
+// turned into RGB just to be compressed again. The forward DCT and the
+// quantisation run four columns at a time in SSE on x86; elsewhere, or after
+// setSimdEnabled(false), a scalar path with the same arithmetic is used.
+//
+// With more than one thread the picture is cut into strips of MCU rows
+// separated by restart markers, and the strips are entropy coded in
+// parallel on the global thread pool.
+class JpegEncoder
+{
+public:
+    explicit JpegEncoder(int quality = 85);
+
+    // 1..100 with the IJG scaling of the Annex K tables
+    void setQuality(int quality);
+    int quality() const { return m_quality; }
+
+    void setThreadCount(int threads);
+    int threadCount() const { return m_threads; }
+
+    bool encode(const uchar *y, int yStride, const uchar *u, const uchar *v, int uvStride,
+                int width, int height, QByteArray *out) const;
+    // YV12 frames as delivered by the PlayM4 callbacks
+    bool encode(const DecodedFrame &frame, QByteArray *out) const;
+
+    static void setSimdEnabled(bool enabled);
+    static bool simdAvailable();
+
+    // Times 720p, 1080p and 4K encodes, scalar and SIMD, one thread and all
+    // cores, and logs ms per frame and the output size.
+    static void runBenchmark();
+
+private:
+    void encodeStrip(const uchar *y, int yStride, const uchar *u, const uchar *v, int uvStride,
+                     int width, int height, int firstMcuRow, int mcuRows, QByteArray *out) const;
+
+    int m_quality;
+    int m_threads;
+    // Quantisation tables in zigzag order for the headers, and the matching
+    // reciprocal divisors (with the AAN scale folded in) for the DCT output
+    uchar m_lumaTable[64];
+    uchar m_chromaTable[64];
+    float m_lumaDivisors[64];
+    float m_chromaDivisors[64];
+};
+
+#endif // JPEGENCODER_H
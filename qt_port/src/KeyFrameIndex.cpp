@@ -0,0 +1,69 @@
+#include "KeyFrameIndex.h"
+#include "MediaPlayerWrapper.h"
+#include <algorithm>
+#include <string.h>
+
+bool KeyFrameIndex::build(LONG port)
+{
+    m_entries.clear();
+
+    FRAME_POS pos;
+    memset(&pos, 0, sizeof(pos));
+    if (!NAME(PlayM4_GetKeyFramePos)(port, 0, BY_FRAMENUM, &pos)
+            && !NAME(PlayM4_GetNextKeyFramePos)(port, 0, BY_FRAMENUM, &pos)) {
+        return false;
+    }
+
+    for (;;) {
+        Entry entry;
+        entry.filePos = pos.nFilePos;
+        entry.frameNum = static_cast<quint32>(pos.nFrameNum);
+        entry.timeMs = static_cast<quint32>(pos.nFrameTime);
+        m_entries.append(entry);
+
+        FRAME_POS next;
+        memset(&next, 0, sizeof(next));
+        if (!NAME(PlayM4_GetNextKeyFramePos)(port, entry.frameNum + 1, BY_FRAMENUM, &next)
+                || static_cast<quint32>(next.nFrameNum) <= entry.frameNum) {
+            break;
+        }
+        pos = next;
+    }
+
+    m_entries.squeeze();
+    return true;
+}
+
+int KeyFrameIndex::floorByTime(quint32 timeMs) const
+{
+    QVector<Entry>::const_iterator it = std::upper_bound(m_entries.constBegin(), m_entries.constEnd(), timeMs,
+        [](quint32 value, const Entry &entry) { return value < entry.timeMs; });
+    return static_cast<int>(it - m_entries.constBegin()) - 1;
+}
+
+int KeyFrameIndex::floorByFrame(quint32 frameNum) const
+{
+    QVector<Entry>::const_iterator it = std::upper_bound(m_entries.constBegin(), m_entries.constEnd(), frameNum,
+        [](quint32 value, const Entry &entry) { return value < entry.frameNum; });
+    return static_cast<int>(it - m_entries.constBegin()) - 1;
+}
+
+quint32 KeyFrameIndex::frameForTime(quint32 timeMs, quint32 totalFrames, quint32 totalMs) const
+{
+    const int i = floorByTime(timeMs);
+    if (i < 0) {
+        return 0;
+    }
+
+    const Entry &key = m_entries.at(i);
+    const quint32 endFrame = i + 1 < m_entries.size() ? m_entries.at(i + 1).frameNum : totalFrames;
+    const quint32 endMs = i + 1 < m_entries.size() ? m_entries.at(i + 1).timeMs : totalMs;
+    if (endFrame <= key.frameNum || endMs <= key.timeMs) {
+        return key.frameNum;
+    }
+
+    // Frames are evenly spaced within one GOP
+    const quint64 offset = static_cast<quint64>(timeMs - key.timeMs) * (endFrame - key.frameNum)
+                         / (endMs - key.timeMs);
+    return qMin(key.frameNum + static_cast<quint32>(offset), endFrame - 1);
+}
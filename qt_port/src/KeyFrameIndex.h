@@ -0,0 +1,38 @@
+#ifndef KEYFRAMEINDEX_H
+#define KEYFRAMEINDEX_H
+
+#include <QVector>
+#include <Windows.h>
+
+// Table of the I-frames of an indexed file, ordered by frame number, built
+// from PlayM4_GetKeyFramePos / PlayM4_GetNextKeyFramePos once the SDK file
+// reference exists. Used to turn a timestamp into an exact frame number
+// without going through the whole-file float ratio of PlayM4_SetPlayPos.
+class KeyFrameIndex
+{
+public:
+    struct Entry {
+        qint64 filePos;
+        quint32 frameNum;
+        quint32 timeMs;
+    };
+
+    bool build(LONG port);
+    void clear() { m_entries.clear(); }
+    bool isEmpty() const { return m_entries.isEmpty(); }
+    int size() const { return m_entries.size(); }
+    const Entry &at(int i) const { return m_entries.at(i); }
+
+    // Index of the last key frame at or before the target, or -1.
+    int floorByTime(quint32 timeMs) const;
+    int floorByFrame(quint32 frameNum) const;
+
+    // Exact frame shown at timeMs, interpolated inside the containing GOP;
+    // the last GOP ends at totalFrames/totalMs.
+    quint32 frameForTime(quint32 timeMs, quint32 totalFrames, quint32 totalMs) const;
+
+private:
+    QVector<Entry> m_entries;
+};
+
+#endif // KEYFRAMEINDEX_H
@@ -1,8 +1,162 @@
 #include "MediaPlayerWrapper.h"
+#include "StreamRingBuffer.h"
+#include "StreamFeeder.h"
+#include "StreamBufferBudget.h"
+#include "PortPool.h"
+#include "FileRefCache.h"
+#include "FrameConsumer.h"
+#include "SnapshotService.h"
+#include "CpuTime.h"
+#include "StreamIngestReactor.h"
 #include <QDebug>
 #include <QFileInfo>
 #include <QDateTime>
 #include <QFile>
+#include <QRunnable>
+#include <QEventLoop>
+#include <QWidget>
+#include <QSharedPointer>
+#include <QRandomGenerator>
+#include <algorithm>
+#include <functional>
+#include <string.h>
+
+// Stream source buffer sizing
+static const DWORD kInitialStreamPoolSize = 2 * 1024 * 1024;
+static const quint64 kStreamPoolSeconds = 2;
+
+// The DirectDraw device is process wide; wrappers share it by reference count.
+static QMutex s_sdkMutex;
+static int s_sdkUsers = 0;
+
+// Open-to-first-frame samples, split by whether the port pool was enabled
+struct FirstFrameStats {
+    int count;
+    qint64 totalMs;
+    qint64 maxMs;
+};
+static FirstFrameStats s_firstFrameStats[2] = { { 0, 0, 0 }, { 0, 0, 0 } };
+static const int kFirstFramePollMs = 5;
+// Watermark records queued between two drains; about 20 s of 25 fps video
+static const int kWatermarkRingBytes = 16 * 1024;
+static const int kWatermarkDrainMs = 250;
+static const qint64 kFirstFrameTimeoutMs = 10000;
+// PlayM4_SetDecodeFrameType: decode every frame, or I-frames only
+static const DWORD kDecodeAllFrames = 0;
+static const DWORD kDecodeKeyFrames = 1;
+// PlayM4_Fast stops at x16; from there on only I-frames are decoded, and
+// faster speeds are reached by jumping between them this often
+static const float kMaxSdkSpeed = 16.0f;
+static const float kKeyFramesOnlySpeed = 16.0f;
+static const int kFastScanTickMs = 100;
+// After a speed change the shown frame stamps are measured over this long
+// and should advance at the requested rate within the tolerance
+static const int kSpeedCheckMs = 3000;
+static const float kSpeedTolerance = 0.25f;
+
+// Seek latency/accuracy samples per file length: < 10 min, < 1 h, longer
+struct SeekStats {
+    int count;
+    qint64 totalMs;
+    qint64 maxMs;
+    qint64 totalAbsFrameError;
+    int exact;
+};
+static SeekStats s_seekStats[3] = { { 0, 0, 0, 0, 0 }, { 0, 0, 0, 0, 0 }, { 0, 0, 0, 0, 0 } };
+static const qint64 kSeekProbeTimeoutMs = 3000;
+// An armed snapshot fails when the port shows no frame within this time
+static const int kSnapshotFrameTimeoutMs = 1000;
+
+// Probe read on open; the same bytes identify the file in the index cache
+static const qint64 kOpenProbeBytes = 64 * 1024;
+
+// Worker half of MediaPlayerWrapper::openFileAsync(). Everything that can
+// block on slow storage happens here; the wrapper adopts the finished port
+// on its own thread.
+class FileOpenTask : public QRunnable
+{
+public:
+    FileOpenTask(MediaPlayerWrapper *player, int serial, const QString &filePath)
+        : m_player(player), m_serial(serial), m_filePath(filePath)
+    {
+    }
+
+    void run() override
+    {
+        progress(0, "Checking file");
+        QFile file(m_filePath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            finish(-1, false, "File does not exist: " + m_filePath);
+            return;
+        }
+
+        progress(15, "Reading header");
+        file.read(kOpenProbeBytes);
+        file.close();
+        if (cancelled()) {
+            finish(-1, false, QString());
+            return;
+        }
+
+        progress(35, "Acquiring port");
+        const LONG port = PortPool::instance()->acquire();
+        if (port < 0) {
+            finish(-1, false, "Failed to get play port");
+            return;
+        }
+        m_player->m_asyncOpenPort = port;
+
+        NAME(PlayM4_SetFileRefCallBack)(port, MediaPlayerWrapper::fileRefCallBack, m_player);
+        NAME(PlayM4_SetCheckWatermarkCallBack)(port, MediaPlayerWrapper::watermarkCallBack, m_player);
+
+        progress(55, "Opening file");
+        QByteArray filePathBytes = m_filePath.toLocal8Bit();
+        if (!NAME(PlayM4_OpenFile)(port, filePathBytes.data())) {
+            const DWORD error = NAME(PlayM4_GetLastError)(port);
+            PortPool::instance()->release(port);
+            finish(-1, false, QString("Failed to open file: %1").arg(m_player->getErrorString(error)));
+            return;
+        }
+        if (cancelled()) {
+            NAME(PlayM4_CloseFile)(port);
+            PortPool::instance()->release(port);
+            finish(-1, false, QString());
+            return;
+        }
+
+        progress(85, "Restoring index");
+        const bool refFromCache = m_player->restoreFileRef(port, m_filePath);
+        {
+            QMutexLocker locker(&m_player->m_handedOverMutex);
+            m_player->m_handedOverPorts.append(port);
+        }
+        finish(port, refFromCache, QString());
+    }
+
+private:
+    bool cancelled() const
+    {
+        return m_player->m_asyncOpenSerial.load() != m_serial;
+    }
+
+    void progress(int percent, const QString &stage)
+    {
+        QMetaObject::invokeMethod(m_player, "onAsyncOpenProgress", Qt::QueuedConnection,
+                                  Q_ARG(int, m_serial), Q_ARG(QString, m_filePath),
+                                  Q_ARG(int, percent), Q_ARG(QString, stage));
+    }
+
+    void finish(LONG port, bool refFromCache, const QString &error)
+    {
+        QMetaObject::invokeMethod(m_player, "onAsyncOpenFinished", Qt::QueuedConnection,
+                                  Q_ARG(int, m_serial), Q_ARG(long, port), Q_ARG(QString, m_filePath),
+                                  Q_ARG(bool, refFromCache), Q_ARG(QString, error));
+    }
+
+    MediaPlayerWrapper *m_player;
+    int m_serial;
+    QString m_filePath;
+};
 
 MediaPlayerWrapper::MediaPlayerWrapper(QObject *parent)
     : QObject(parent)
@@ -14,13 +168,81 @@ MediaPlayerWrapper::MediaPlayerWrapper(QObject *parent)
     , m_bStreamOpened(false)
     , m_displayWnd(nullptr)
     , m_currentSpeed(1.0f)
+    , m_armedSnapshotCount(0)
+    , m_streamRing(nullptr)
+    , m_streamFeeder(nullptr)
+    , m_streamRingCapacity(4 * 1024 * 1024)
+    , m_ingestSourceId(-1)
+    , m_streamPoolSize(2 * 1024 * 1024)
+    , m_droppedGops(0)
+    , m_poolResizePending(false)
+    , m_streamGeneration(0)
+    , m_bSoundOn(false)
+    , m_firstFrameTimer(new QTimer(this))
+    , m_fileRefFromCache(false)
+    , m_asyncOpenSerial(0)
+    , m_asyncOpenPort(-1)
+    , m_asyncOpenPending(false)
+    , m_earlyFileRefPort(-1)
+    , m_bHeadless(false)
+    , m_headlessFastDecode(true)
+    , m_frameConsumer(nullptr)
+    , m_displayConsumer(nullptr)
+    , m_consumerCallsInFlight(0)
+    , m_displayCallBackSet(false)
+    , m_headlessFrames(0)
+    , m_keyFramesOnly(false)
+    , m_seekProbeTimer(new QTimer(this))
+    , m_seekTargetFrame(0)
+    , m_seekTargetMs(0)
+    , m_watermarkRing(new StreamRingBuffer(kWatermarkRingBytes))
+    , m_recordWatermarks(false)
+    , m_watermarkOverflows(0)
+    , m_watermarkDrainTimer(new QTimer(this))
+    , m_fastScanTimer(new QTimer(this))
+    , m_fastScanTargetMs(-1)
+    , m_fastScanJumps(0)
+    , m_speedCheckTimer(new QTimer(this))
+    , m_speedCheckStartMs(0)
+    , m_measuredSpeed(0.0f)
 {
+    m_seekProbeTimer->setTimerType(Qt::PreciseTimer);
+    m_seekProbeTimer->setInterval(kFirstFramePollMs);
+    connect(m_seekProbeTimer, &QTimer::timeout, this, &MediaPlayerWrapper::checkSeekLanded);
+    m_firstFrameTimer->setTimerType(Qt::PreciseTimer);
+    m_firstFrameTimer->setInterval(kFirstFramePollMs);
+    connect(m_firstFrameTimer, &QTimer::timeout, this, &MediaPlayerWrapper::checkFirstFrame);
+    m_watermarkDrainTimer->setInterval(kWatermarkDrainMs);
+    connect(m_watermarkDrainTimer, &QTimer::timeout, this, &MediaPlayerWrapper::drainWatermarkRecords);
+    m_fastScanTimer->setTimerType(Qt::PreciseTimer);
+    m_fastScanTimer->setInterval(kFastScanTickMs);
+    connect(m_fastScanTimer, &QTimer::timeout, this, &MediaPlayerWrapper::onFastScanTick);
+    m_speedCheckTimer->setSingleShot(true);
+    m_speedCheckTimer->setInterval(kSpeedCheckMs);
+    connect(m_speedCheckTimer, &QTimer::timeout, this, &MediaPlayerWrapper::checkSpeed);
+    connect(SnapshotService::instance(), &SnapshotService::snapshotFinished,
+            this, &MediaPlayerWrapper::onSnapshotFinished);
     qDebug() << "[Ctor] MediaPlayerWrapper created at" << this;
 }
 
 MediaPlayerWrapper::~MediaPlayerWrapper()
 {
+    // A running open task still refers to this wrapper
+    cancelPendingOpen();
+    m_openPool.waitForDone();
+    // A task past its last cancel check opened a port whose result is
+    // queued to this object and will never be delivered; its callbacks
+    // still point here
+    for (long port : m_handedOverPorts) {
+        NAME(PlayM4_SetFileRefCallBack)(port, nullptr, nullptr);
+        NAME(PlayM4_SetCheckWatermarkCallBack)(port, nullptr, nullptr);
+        NAME(PlayM4_CloseFile)(port);
+        PortPool::instance()->release(port);
+    }
+    m_handedOverPorts.clear();
+    m_asyncOpenPort = -1;
     cleanup();
+    delete m_watermarkRing;
 }
 
 bool MediaPlayerWrapper::initialize()
@@ -29,19 +251,22 @@ bool MediaPlayerWrapper::initialize()
         return true;
     }
 
-    // Initialize DirectDraw device (from original code)
-    NAME(PlayM4_InitDDrawDevice)();
-    
-    // Get DirectDraw device info
-    DWORD deviceCount = NAME(PlayM4_GetDDrawDeviceTotalNums)();
-    qDebug() << "DirectDraw devices found:" << deviceCount;
-    
-    if (deviceCount > 0) {
-        char driverDesc[50];
-        char driverName[50];
-        HMONITOR hMonitor;
-        NAME(PlayM4_GetDDrawDeviceInfo)(0, driverDesc, 50, driverName, 50, &hMonitor);
-        qDebug() << "Using DirectDraw device:" << driverDesc;
+    QMutexLocker locker(&s_sdkMutex);
+    if (s_sdkUsers++ == 0) {
+        // Initialize DirectDraw device (from original code)
+        NAME(PlayM4_InitDDrawDevice)();
+
+        // Get DirectDraw device info
+        DWORD deviceCount = NAME(PlayM4_GetDDrawDeviceTotalNums)();
+        qDebug() << "DirectDraw devices found:" << deviceCount;
+
+        if (deviceCount > 0) {
+            char driverDesc[50];
+            char driverName[50];
+            HMONITOR hMonitor;
+            NAME(PlayM4_GetDDrawDeviceInfo)(0, driverDesc, 50, driverName, 50, &hMonitor);
+            qDebug() << "Using DirectDraw device:" << driverDesc;
+        }
     }
 
     m_bInitialized = true;
@@ -59,7 +284,12 @@ void MediaPlayerWrapper::cleanup()
     }
 
     if (m_bInitialized) {
-        NAME(PlayM4_RealeseDDraw)();
+        QMutexLocker locker(&s_sdkMutex);
+        if (--s_sdkUsers == 0) {
+            SnapshotService::instance()->shutdown();
+            PortPool::instance()->clear();
+            NAME(PlayM4_RealeseDDraw)();
+        }
         m_bInitialized = false;
     }
 }
@@ -70,30 +300,37 @@ bool MediaPlayerWrapper::getPort()
         return true;
     }
 
-    if (!NAME(PlayM4_GetPort)(&m_lPort)) {
+    // Pre-warmed ports already have their DirectDraw device set
+    m_lPort = PortPool::instance()->acquire();
+    if (m_lPort < 0) {
         qDebug() << "Failed to get play port";
         emit errorOccurred("Failed to get play port");
         return false;
     }
 
     qDebug() << "Got play port:" << m_lPort;
-    
-    // Set DirectDraw device for this port
-    NAME(PlayM4_SetDDrawDevice)(m_lPort, 0);
-    
+
     return true;
 }
 
 void MediaPlayerWrapper::releasePort()
 {
     if (m_lPort >= 0) {
-        NAME(PlayM4_FreePort)(m_lPort);
+        PortPool::instance()->release(m_lPort);
         m_lPort = -1;
     }
 }
 
 bool MediaPlayerWrapper::openFile(const QString &filePath)
 {
+    cancelPendingOpen();
+
+    if (m_bStreamOpened) {
+        closeStream();
+        if (m_bStreamOpened) {
+            return false;
+        }
+    }
     if (m_bFileOpened) {
         closeFile();
     }
@@ -103,6 +340,8 @@ bool MediaPlayerWrapper::openFile(const QString &filePath)
         return false;
     }
 
+    m_openTimer.start();
+
     if (!getPort()) {
         return false;
     }
@@ -127,6 +366,10 @@ bool MediaPlayerWrapper::openFile(const QString &filePath)
 
     m_currentFile = filePath;
     m_bFileOpened = true;
+
+    // A cached index makes seeking and reverse stepping usable right away
+    m_fileRefFromCache = restoreFileRef(m_lPort, filePath);
+    loadWatermarkIndex();
     
     qDebug() << "File opened successfully:" << filePath;
     emit statusChanged(Stopped);
@@ -134,12 +377,101 @@ bool MediaPlayerWrapper::openFile(const QString &filePath)
     return true;
 }
 
+void MediaPlayerWrapper::openFileAsync(const QString &filePath)
+{
+    cancelPendingOpen();
+
+    const int serial = ++m_asyncOpenSerial;
+    m_openTimer.start();
+    m_asyncOpenPending = true;
+    m_asyncOpenPort = -1;
+    m_earlyFileRefPort = -1;
+    m_openPool.setMaxThreadCount(1);
+    m_openPool.start(new FileOpenTask(this, serial, filePath));
+}
+
+void MediaPlayerWrapper::cancelPendingOpen()
+{
+    if (!m_asyncOpenPending) {
+        return;
+    }
+
+    // The task notices between stages; a port it already opened is handed
+    // back through onAsyncOpenFinished() and closed there.
+    ++m_asyncOpenSerial;
+    m_asyncOpenPending = false;
+    qDebug() << "Pending file open cancelled";
+}
+
+void MediaPlayerWrapper::onAsyncOpenProgress(int serial, const QString &filePath, int percent, const QString &stage)
+{
+    if (serial == m_asyncOpenSerial.load()) {
+        emit openProgress(filePath, percent, stage);
+    }
+}
+
+void MediaPlayerWrapper::onAsyncOpenFinished(int serial, long port, const QString &filePath,
+                                             bool refFromCache, const QString &error)
+{
+    if (port >= 0) {
+        QMutexLocker locker(&m_handedOverMutex);
+        m_handedOverPorts.removeOne(port);
+    }
+    if (serial != m_asyncOpenSerial.load()) {
+        if (port >= 0) {
+            NAME(PlayM4_SetFileRefCallBack)(port, nullptr, nullptr);
+            NAME(PlayM4_CloseFile)(port);
+            PortPool::instance()->release(port);
+        }
+        return;
+    }
+    m_asyncOpenPending = false;
+
+    if (port < 0) {
+        m_openTimer.invalidate();
+        emit errorOccurred(error);
+        emit fileOpenFailed(filePath, error);
+        return;
+    }
+
+    if (m_bStreamOpened) {
+        closeStream();
+    }
+    if (m_bStreamOpened) {
+        NAME(PlayM4_SetFileRefCallBack)(port, nullptr, nullptr);
+        NAME(PlayM4_CloseFile)(port);
+        PortPool::instance()->release(port);
+        m_openTimer.invalidate();
+        emit fileOpenFailed(filePath, "The live stream could not be closed");
+        return;
+    }
+    if (m_bFileOpened) {
+        closeFile();
+    }
+
+    m_lPort = port;
+    m_currentFile = filePath;
+    m_bFileOpened = true;
+    m_fileRefFromCache = refFromCache;
+    loadWatermarkIndex();
+
+    qDebug() << "File opened successfully:" << filePath;
+    emit statusChanged(Stopped);
+    emit fileOpened(filePath);
+
+    if (m_earlyFileRefPort == port) {
+        m_earlyFileRefPort = -1;
+        onFileRefReady(port);
+    }
+}
+
 void CALLBACK MediaPlayerWrapper::fileRefCallBack(DWORD nPort, void* nUser)
 {
     MediaPlayerWrapper* self = reinterpret_cast<MediaPlayerWrapper*>(nUser);
     if (self) {
         qDebug() << "File reference created!";
-        QMetaObject::invokeMethod(self, "onFileRefCreated", Qt::QueuedConnection);
+        QMetaObject::invokeMethod(self, "onFileRefReady", Qt::QueuedConnection,
+                                  Q_ARG(long, static_cast<long>(nPort)));
     }
 }
 
@@ -148,37 +480,302 @@ void CALLBACK MediaPlayerWrapper::watermarkCallBack(long nPort, WATERMARK_INFO*
     MediaPlayerWrapper* wrapper = reinterpret_cast<MediaPlayerWrapper*>(nUser);
     if (!wrapper || !pInfo || !pInfo->pDataBuf) return;
 
-    auto data = QSharedPointer<WatermarkData>::create();
-    char* pBuf = (char*)pInfo->pDataBuf;
+    WatermarkData data;
+    const char* pBuf = pInfo->pDataBuf;
+
+    memcpy(&data.globalTime, pBuf, sizeof(DWORD)); pBuf += sizeof(DWORD);
+    memcpy(&data.deviceSN, pBuf, sizeof(DWORD)); pBuf += sizeof(DWORD);
+    memcpy(data.mac, pBuf, sizeof(data.mac)); pBuf += sizeof(data.mac);
+    data.deviceType = static_cast<unsigned char>(*pBuf++);
+    data.deviceInfo = static_cast<unsigned char>(*pBuf++);
+    data.channelNum = static_cast<unsigned char>(*pBuf++);
+
+    wrapper->m_watermark.store(data);
+
+    if (wrapper->m_recordWatermarks.load(std::memory_order_acquire)) {
+        WatermarkRecord record;
+        record.frameNum = static_cast<quint32>(pInfo->nFrameNum);
+        record.rsaValid = pInfo->bRsaRight != FALSE;
+        record.data = data;
+        // Lost records only keep the index from completing
+        if (wrapper->m_watermarkRing->write(reinterpret_cast<const uchar *>(&record), sizeof(record))) {
+            wrapper->m_watermarkRing->commit();
+        }
+    }
 
-    data->globalTime = *(DWORD*)pBuf; pBuf += sizeof(DWORD);
-    data->deviceSN = *(DWORD*)pBuf; pBuf += sizeof(DWORD);
+    // Verification scans want every record, not just the latest
+    wrapper->m_consumerCallsInFlight.fetch_add(1);
+    if (FrameConsumer *consumer = wrapper->m_frameConsumer.load()) {
+        consumer->onWatermark(data, static_cast<quint32>(pInfo->nFrameNum), pInfo->bRsaRight != FALSE);
+    }
+    wrapper->m_consumerCallsInFlight.fetch_sub(1);
+}
 
-    QString mac;
-    for (int i = 0; i < 6; ++i) {
-        mac += QString("%1").arg((unsigned char)pBuf[i], 2, 16, QChar('0'));
-        if (i < 5) mac += ":";
+void MediaPlayerWrapper::onFileRefCreated()
+{
+    emit fileRefCreated();
+}
+
+void MediaPlayerWrapper::onFileRefReady(long port)
+{
+    // Ignore an index finished for a file that has since been closed; one
+    // that beat its asynchronous open is applied when the open is adopted.
+    if (!m_bFileOpened || m_bStreamMode || port != m_lPort) {
+        if (m_asyncOpenPending && port == m_asyncOpenPort.load()) {
+            m_earlyFileRefPort = port;
+        }
+        return;
     }
-    pBuf += 6;
 
-    data->mac = mac;
-    data->deviceType = *(unsigned char*)pBuf++;
-    data->deviceInfo = *(unsigned char*)pBuf++;
-    data->channelNum = *(unsigned char*)pBuf++;
+    if (!m_fileRefFromCache) {
+        saveFileRef();
+    }
 
-    QMutexLocker locker(&wrapper->m_watermarkMutex);
-    wrapper->m_watermarkData = data;
+    QElapsedTimer buildTimer;
+    buildTimer.start();
+    if (m_keyFrameIndex.build(m_lPort)) {
+        qDebug() << "Key frame table:" << m_keyFrameIndex.size() << "entries in" << buildTimer.elapsed() << "ms";
+    }
+    onFileRefCreated();
 }
 
-void MediaPlayerWrapper::onFileRefCreated()
+bool MediaPlayerWrapper::restoreFileRef(LONG port, const QString &filePath)
 {
-    emit fileRefCreated();
+    QByteArray refValue;
+    if (!FileRefCache::instance()->load(filePath, &refValue)) {
+        return false;
+    }
+
+    if (!NAME(PlayM4_SetRefValue)(port, reinterpret_cast<BYTE *>(refValue.data()),
+                                  static_cast<DWORD>(refValue.size()))) {
+        // Written by another SDK build or damaged; rebuild and overwrite it
+        qDebug() << "Cached file index rejected:" << getErrorString(NAME(PlayM4_GetLastError)(port));
+        FileRefCache::instance()->remove(filePath);
+        return false;
+    }
+
+    qDebug() << "File index restored from cache," << refValue.size() << "bytes";
+    QMetaObject::invokeMethod(this, "onFileRefReady", Qt::QueuedConnection,
+                              Q_ARG(long, static_cast<long>(port)));
+    return true;
+}
+
+void MediaPlayerWrapper::saveFileRef()
+{
+    // Ask for the size first; some SDK builds only report it on failure
+    DWORD size = 0;
+    NAME(PlayM4_GetRefValue)(m_lPort, nullptr, &size);
+    if (size == 0) {
+        size = 4 * 1024 * 1024;
+    }
+
+    QByteArray refValue(static_cast<int>(size), Qt::Uninitialized);
+    DWORD needed = size;
+    if (!NAME(PlayM4_GetRefValue)(m_lPort, reinterpret_cast<BYTE *>(refValue.data()), &needed)) {
+        if (needed <= size) {
+            qDebug() << "Failed to read file index:" << getErrorString(NAME(PlayM4_GetLastError)(m_lPort));
+            return;
+        }
+        refValue.resize(static_cast<int>(needed));
+        if (!NAME(PlayM4_GetRefValue)(m_lPort, reinterpret_cast<BYTE *>(refValue.data()), &needed)) {
+            qDebug() << "Failed to read file index:" << getErrorString(NAME(PlayM4_GetLastError)(m_lPort));
+            return;
+        }
+    }
+    refValue.resize(static_cast<int>(needed));
+
+    FileRefCache::instance()->store(m_currentFile, refValue);
+    qDebug() << "File index cached," << refValue.size() << "bytes";
+}
+
+bool MediaPlayerWrapper::getWatermarkData(WatermarkData *data) const
+{
+    return m_watermark.load(data);
+}
+
+bool MediaPlayerWrapper::currentWatermark(WatermarkData *data)
+{
+    if (m_bFileOpened && !m_bStreamMode) {
+        drainWatermarkRecords();
+        const WatermarkRecord *record = m_watermarkIndex.recordAt(getCurrentFrameNum());
+        if (record) {
+            *data = record->data;
+            return true;
+        }
+    }
+    return getWatermarkData(data);
+}
+
+void MediaPlayerWrapper::loadWatermarkIndex()
+{
+    stopWatermarkRecording();
+
+    QElapsedTimer loadTimer;
+    loadTimer.start();
+    if (m_watermarkIndex.load(m_currentFile)) {
+        qDebug() << "Watermark index loaded:" << m_watermarkIndex.size() << "records in" << loadTimer.elapsed() << "ms";
+        return;
+    }
+
+    // Build it from this playback; the ring is empty, nothing is decoding yet
+    m_watermarkOverflows = m_watermarkRing->overflowCount();
+    m_recordWatermarks = true;
+    m_watermarkDrainTimer->start();
 }
 
-QSharedPointer<WatermarkData> MediaPlayerWrapper::getWatermarkData()
+void MediaPlayerWrapper::stopWatermarkRecording()
 {
-    QMutexLocker locker(&m_watermarkMutex);
-    return m_watermarkData;
+    m_recordWatermarks = false;
+    m_watermarkDrainTimer->stop();
+    m_watermarkIndex.clear();
+
+    // Drop what a previous file left behind
+    int size = 0;
+    while (m_watermarkRing->peek(&size) && size > 0) {
+        m_watermarkRing->consume(size);
+    }
+}
+
+void MediaPlayerWrapper::drainWatermarkRecords()
+{
+    WatermarkRecord record;
+    while (m_watermarkRing->fillLevel() >= static_cast<int>(sizeof(record))) {
+        // A record may wrap around the end of the ring
+        uchar *target = reinterpret_cast<uchar *>(&record);
+        int copied = 0;
+        while (copied < static_cast<int>(sizeof(record))) {
+            int size = 0;
+            const uchar *span = m_watermarkRing->peek(&size);
+            size = qMin(size, static_cast<int>(sizeof(record)) - copied);
+            memcpy(target + copied, span, static_cast<size_t>(size));
+            m_watermarkRing->consume(size);
+            copied += size;
+        }
+        m_watermarkIndex.add(record);
+    }
+}
+
+namespace {
+
+// Polls the watermark as fast as it can, the worst case for the writer
+class WatermarkPoller : public QThread
+{
+public:
+    explicit WatermarkPoller(const std::function<void()> &poll)
+        : m_poll(poll)
+        , m_stop(false)
+        , m_reads(0)
+    {
+    }
+
+    void stop() { m_stop = true; wait(); }
+    quint64 reads() const { return m_reads; }
+
+protected:
+    void run() override
+    {
+        while (!m_stop.load(std::memory_order_relaxed)) {
+            m_poll();
+            ++m_reads;
+        }
+    }
+
+private:
+    std::function<void()> m_poll;
+    std::atomic<bool> m_stop;
+    quint64 m_reads;
+};
+
+// What the callback used to publish: a heap object with a formatted MAC
+// swapped in under a mutex the reader also takes
+struct LegacyWatermark
+{
+    DWORD globalTime;
+    DWORD deviceSN;
+    QString mac;
+    unsigned char deviceType;
+    unsigned char deviceInfo;
+    unsigned char channelNum;
+};
+
+} // namespace
+
+void MediaPlayerWrapper::runWatermarkBenchmark()
+{
+    static const int kCalls = 1000000;
+
+    char payload[17] = { 0x21, 0x43, 0x65, 0x07, 0x78, 0x56, 0x34, 0x12,
+                         0x00, 0x40, 0x48, 0x1a, 0x2b, 0x3c, 0x01, 0x02, 0x03 };
+    WATERMARK_INFO info;
+    memset(&info, 0, sizeof(info));
+    info.pDataBuf = payload;
+    info.nSize = sizeof(payload);
+
+    MediaPlayerWrapper player;
+    QMutex legacyMutex;
+    QSharedPointer<LegacyWatermark> legacyData;
+
+    auto legacyCallback = [&]() {
+        auto data = QSharedPointer<LegacyWatermark>::create();
+        const char *pBuf = info.pDataBuf;
+        memcpy(&data->globalTime, pBuf, sizeof(DWORD)); pBuf += sizeof(DWORD);
+        memcpy(&data->deviceSN, pBuf, sizeof(DWORD)); pBuf += sizeof(DWORD);
+        QString mac;
+        for (int i = 0; i < 6; ++i) {
+            mac += QString("%1").arg(static_cast<unsigned char>(pBuf[i]), 2, 16, QChar('0'));
+            if (i < 5) mac += ":";
+        }
+        pBuf += 6;
+        data->mac = mac;
+        data->deviceType = static_cast<unsigned char>(*pBuf++);
+        data->deviceInfo = static_cast<unsigned char>(*pBuf++);
+        data->channelNum = static_cast<unsigned char>(*pBuf++);
+        QMutexLocker locker(&legacyMutex);
+        legacyData = data;
+    };
+    auto legacyRead = [&]() {
+        QMutexLocker locker(&legacyMutex);
+        QSharedPointer<LegacyWatermark> data = legacyData;
+        Q_UNUSED(data)
+    };
+    auto seqlockCallback = [&]() {
+        watermarkCallBack(0, &info, &player);
+    };
+    auto seqlockRead = [&]() {
+        WatermarkData data;
+        player.getWatermarkData(&data);
+    };
+
+    auto measure = [&](const char *name, const std::function<void()> &callback, const std::function<void()> &read,
+                       bool contended) {
+        WatermarkPoller poller(read);
+        if (contended) {
+            poller.start();
+        }
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < kCalls; ++i) {
+            callback();
+        }
+        const qint64 ns = timer.nsecsElapsed();
+        if (contended) {
+            poller.stop();
+        }
+        qDebug().noquote() << QString("Watermark %1%2: %3 ns per callback%4")
+                              .arg(name).arg(contended ? " with reader" : "")
+                              .arg(static_cast<double>(ns) / kCalls, 0, 'f', 1)
+                              .arg(contended ? QString(", %1 reads").arg(poller.reads()) : QString());
+    };
+
+    measure("mutex+alloc", legacyCallback, legacyRead, false);
+    measure("mutex+alloc", legacyCallback, legacyRead, true);
+    measure("seqlock", seqlockCallback, seqlockRead, false);
+    measure("seqlock", seqlockCallback, seqlockRead, true);
+
+    WatermarkData data;
+    if (player.getWatermarkData(&data)) {
+        qDebug() << "Watermark read back: MAC" << data.macString() << "SN" << data.deviceSN;
+    }
 }
 
 void MediaPlayerWrapper::closeFile()
@@ -187,8 +784,19 @@ void MediaPlayerWrapper::closeFile()
         return;
     }
 
+    m_firstFrameTimer->stop();
+    m_openTimer.invalidate();
+    m_seekProbeTimer->stop();
+    m_keyFrameIndex.clear();
+
+    stopHeadless();
+    setDisplayConsumer(nullptr);
     stop();
+    cancelSnapshots();
+    stopWatermarkRecording();
+    setKeyFramesOnly(false);
 
+    NAME(PlayM4_SetFileRefCallBack)(m_lPort, nullptr, nullptr);
     NAME(PlayM4_CloseFile)(m_lPort);
     releasePort();
 
@@ -201,14 +809,20 @@ void MediaPlayerWrapper::closeFile()
 
 bool MediaPlayerWrapper::openStream(const QString &url)
 {
+    cancelPendingOpen();
+
     if (m_bStreamOpened) {
         closeStream();
+        if (m_bStreamOpened) {
+            return false;
+        }
     }
 
     if (m_bFileOpened) {
         closeFile();
     }
 
+    m_openTimer.start();
     if (!getPort()) {
         return false;
     }
@@ -221,12 +835,15 @@ bool MediaPlayerWrapper::openStream(const QString &url)
         return false;
     }
 
-    // Open stream with empty header (will be filled when data arrives)
-    // Buffer pool size: 2MB for real-time streaming
-    if (!NAME(PlayM4_OpenStream)(m_lPort, nullptr, 0, 2 * 1024 * 1024)) {
+    // Open stream with empty header (will be filled when data arrives).
+    // Start from 2MB, or less when the budget is shared by many ports; the
+    // feeder re-sizes it once the real bitrate is known.
+    m_streamPoolSize = StreamBufferBudget::instance()->acquire(this, kInitialStreamPoolSize);
+    if (!NAME(PlayM4_OpenStream)(m_lPort, nullptr, 0, m_streamPoolSize)) {
         DWORD error = NAME(PlayM4_GetLastError)(m_lPort);
         QString errorMsg = QString("Failed to open stream: %1").arg(getErrorString(error));
         emit streamError(errorMsg);
+        StreamBufferBudget::instance()->release(this);
         releasePort();
         return false;
     }
@@ -236,6 +853,15 @@ bool MediaPlayerWrapper::openStream(const QString &url)
     m_bStreamMode = true;
     m_bFileOpened = true;  // Mark as "file opened" for playback compatibility
 
+    configurePort();
+    m_droppedGops.store(0, std::memory_order_relaxed);
+    m_poolResizePending = false;
+
+    // Preallocated input ring and the thread that feeds PlayM4 from it
+    m_streamRing = new StreamRingBuffer(m_streamRingCapacity);
+    m_streamFeeder = new StreamFeeder(this, m_streamRing);
+    m_streamFeeder->start(QThread::HighPriority);
+
     qDebug() << "Stream opened successfully for URL:" << url;
     emit streamOpened();
     emit statusChanged(Stopped);
@@ -243,68 +869,582 @@ bool MediaPlayerWrapper::openStream(const QString &url)
     return true;
 }
 
-void MediaPlayerWrapper::closeStream()
+void MediaPlayerWrapper::closeStream()
+{
+    if (!m_bStreamOpened) {
+        return;
+    }
+
+    // The RTSP client writes into the ring from the reactor thread until
+    // its source is stopped; the ring must outlive it
+    if (!detachIngestSource()) {
+        qDebug() << "Ingest source" << m_ingestSourceId << "is still attached, stream left open";
+        return;
+    }
+
+    m_firstFrameTimer->stop();
+    m_openTimer.invalidate();
+    stopHeadless();
+    setDisplayConsumer(nullptr);
+
+    NAME(PlayM4_SetSourceBufCallBack)(m_lPort, 0, nullptr, nullptr, nullptr);
+    if (m_streamFeeder) {
+        qDebug() << "Stream feeder stalled" << m_streamFeeder->stallCount() << "times,"
+                 << m_streamFeeder->stalledUs() / 1000 << "ms total,"
+                 << droppedGopCount() << "GOPs dropped";
+        m_streamFeeder->stopFeeding();
+        m_streamFeeder->wait();
+        delete m_streamFeeder;
+        m_streamFeeder = nullptr;
+    }
+    delete m_streamRing;
+    m_streamRing = nullptr;
+
+    stop();
+    cancelSnapshots();
+
+    NAME(PlayM4_CloseStream)(m_lPort);
+    releasePort();
+    StreamBufferBudget::instance()->release(this);
+
+    m_bStreamOpened = false;
+    m_bStreamMode = false;
+    m_bFileOpened = false;
+    m_streamUrl.clear();
+
+    emit statusChanged(Stopped);
+}
+
+void MediaPlayerWrapper::setIngestSource(StreamIngestReactor *reactor, int sourceId)
+{
+    m_ingestReactor = reactor;
+    m_ingestSourceId = reactor ? sourceId : -1;
+}
+
+bool MediaPlayerWrapper::detachIngestSource()
+{
+    if (m_ingestSourceId < 0) {
+        return true;
+    }
+    // removeSource() blocks until the client has stopped and dropped the
+    // ring, and clears the source here; from the reactor thread it would
+    // deadlock instead
+    if (m_ingestReactor && QThread::currentThread() == thread()) {
+        m_ingestReactor->removeSource(m_ingestSourceId);
+    }
+    return m_ingestSourceId < 0;
+}
+
+bool MediaPlayerWrapper::inputStreamData(PBYTE pBuf, DWORD nSize)
+{
+    return feedStreamData(pBuf, nSize, streamGeneration()) == InputOk;
+}
+
+MediaPlayerWrapper::InputResult MediaPlayerWrapper::feedStreamData(PBYTE pBuf, DWORD nSize, quint32 generation)
+{
+    QMutexLocker locker(&m_streamInputMutex);
+    if (!m_bStreamOpened || m_lPort < 0) {
+        return InputFailed;
+    }
+    // A feeder that was blocked here across a re-open holds the middle of
+    // a GOP the new decoder cannot use
+    if (generation != m_streamGeneration.load(std::memory_order_relaxed)) {
+        return InputStale;
+    }
+
+    if (!NAME(PlayM4_InputData)(m_lPort, pBuf, nSize)) {
+        DWORD error = NAME(PlayM4_GetLastError)(m_lPort);
+        if (error == PLAYM4_BUF_OVER) {
+            // Nothing was taken; re-arm the drain callback and let the
+            // caller hold on to the span.
+            NAME(PlayM4_ResetSourceBufFlag)(m_lPort);
+            return InputBufferFull;
+        }
+        qDebug() << "Failed to input stream data:" << getErrorString(error);
+        return InputFailed;
+    }
+
+    return InputOk;
+}
+
+DWORD MediaPlayerWrapper::sourceBufferFree() const
+{
+    QMutexLocker locker(&m_streamInputMutex);
+    if (!m_bStreamOpened || m_lPort < 0) {
+        return 0;
+    }
+
+    const DWORD remain = NAME(PlayM4_GetSourceBufferRemain)(m_lPort);
+    return remain < m_streamPoolSize ? m_streamPoolSize - remain : 0;
+}
+
+void MediaPlayerWrapper::updateStreamPoolEstimate(quint64 bytesPerSecond)
+{
+    // Hold a couple of seconds of input, and never less than two large key
+    // frames (an I-frame rarely exceeds half a byte per pixel).
+    LONG width = 0;
+    LONG height = 0;
+    quint64 current = 0;
+    {
+        QMutexLocker locker(&m_streamInputMutex);
+        if (!m_bStreamOpened || m_lPort < 0) {
+            return;
+        }
+        NAME(PlayM4_GetPictureSize)(m_lPort, &width, &height);
+        current = m_streamPoolSize;
+    }
+    const quint64 keyFrameBytes = static_cast<quint64>(qMax(0L, width)) * static_cast<quint64>(qMax(0L, height));
+    quint64 desired = qMax(bytesPerSecond * kStreamPoolSeconds, keyFrameBytes);
+    desired = qBound<quint64>(SOURCE_BUF_MIN, desired, SOURCE_BUF_MAX);
+
+    // Ignore small drifts; a re-open costs a GOP.
+    const quint64 delta = desired > current ? desired - current : current - desired;
+    if (delta * 4 < current) {
+        return;
+    }
+
+    if (!m_poolResizePending.exchange(true)) {
+        qDebug() << "Stream input" << bytesPerSecond * 8 / 1000 << "kbit/s," << width << "x" << height
+                 << ": source buffer" << current << "->" << desired << "bytes requested";
+        QMetaObject::invokeMethod(this, "resizeStreamPool", Qt::QueuedConnection,
+                                  Q_ARG(uint, static_cast<uint>(desired)));
+    }
+}
+
+void MediaPlayerWrapper::resizeStreamPool(uint desiredBytes)
+{
+    if (!m_bStreamOpened || m_lPort < 0) {
+        m_poolResizePending = false;
+        return;
+    }
+
+    const DWORD oldSize = m_streamPoolSize;
+    const DWORD newSize = StreamBufferBudget::instance()->acquire(this, desiredBytes);
+    if (newSize == oldSize) {
+        m_poolResizePending = false;
+        return;
+    }
+
+    QMutexLocker locker(&m_streamInputMutex);
+
+    NAME(PlayM4_SetSourceBufCallBack)(m_lPort, 0, nullptr, nullptr, nullptr);
+    NAME(PlayM4_Stop)(m_lPort);
+    NAME(PlayM4_CloseStream)(m_lPort);
+
+    DWORD openedSize = newSize;
+    NAME(PlayM4_SetStreamOpenMode)(m_lPort, STREAME_REALTIME);
+    if (!NAME(PlayM4_OpenStream)(m_lPort, nullptr, 0, openedSize)) {
+        qDebug() << "Failed to re-open stream with" << newSize << "byte buffer:"
+                 << getErrorString(NAME(PlayM4_GetLastError)(m_lPort));
+        openedSize = oldSize;
+        if (!NAME(PlayM4_OpenStream)(m_lPort, nullptr, 0, openedSize)) {
+            const QString error = "Failed to re-open stream: " + getErrorString(NAME(PlayM4_GetLastError)(m_lPort));
+            m_poolResizePending = false;
+            locker.unlock();
+            // No decoder is left behind the port; tear the stream down so
+            // the ingest source, feeder, ring, port and budget grant go with
+            // it. PlayM4_Stop has run already.
+            m_playState = Stopped;
+            closeStream();
+            emit streamError(error);
+            emit errorOccurred(error);
+            return;
+        }
+    }
+    m_streamPoolSize = StreamBufferBudget::instance()->acquire(this, openedSize);
+    // Whatever is queued or in the feeder's hands belongs to the GOP the
+    // old decoder was in
+    m_streamRing->requestResync();
+    m_streamGeneration.fetch_add(1, std::memory_order_release);
+
+    // The new stream knows nothing of the old one's setup
+    configurePort();
+
+    if (m_playState != Stopped) {
+        NAME(PlayM4_Play)(m_lPort, m_bHeadless ? nullptr : m_displayWnd);
+        if (m_playState == Paused) {
+            NAME(PlayM4_Pause)(m_lPort, TRUE);
+        }
+        if (m_bSoundOn) {
+            NAME(PlayM4_PlaySound)(m_lPort);
+        }
+        // Play starts the SDK over at x1
+        const int step = m_speed.step();
+        m_speed.reset();
+        m_speed.moveTo(m_lPort, step);
+    }
+    m_poolResizePending = false;
+
+    qDebug() << "Stream source buffer resized" << oldSize << "->" << m_streamPoolSize << "bytes,"
+             << StreamBufferBudget::instance()->allocatedBytes() << "of"
+             << StreamBufferBudget::instance()->totalBytes() << "budget bytes in use";
+}
+
+qint64 MediaPlayerWrapper::streamStalledMs() const
+{
+    return m_streamFeeder ? m_streamFeeder->stalledUs() / 1000 : 0;
+}
+
+quint64 MediaPlayerWrapper::streamStallCount() const
+{
+    return m_streamFeeder ? m_streamFeeder->stallCount() : 0;
+}
+
+void CALLBACK MediaPlayerWrapper::sourceBufCallBack(long nPort, DWORD nBufSize, void *dwUser, void *pReserved)
+{
+    Q_UNUSED(nPort)
+    Q_UNUSED(nBufSize)
+    Q_UNUSED(pReserved)
+
+    MediaPlayerWrapper *player = static_cast<MediaPlayerWrapper *>(dwUser);
+    if (player && player->m_streamFeeder) {
+        player->m_streamFeeder->notifySpaceAvailable();
+    }
+}
+
+bool MediaPlayerWrapper::play(HWND displayWnd)
+{
+    if (!m_bFileOpened && !m_bStreamOpened) {
+        emit errorOccurred("No file or stream opened");
+        return false;
+    }
+
+    if (displayWnd) {
+        m_displayWnd = displayWnd;
+    }
+    
+    if (m_playState == Paused) {
+        // Resume from pause
+        return resume();
+    }
+
+    configurePort();
+
+    if (!NAME(PlayM4_Play)(m_lPort, m_displayWnd)) {
+        DWORD error = NAME(PlayM4_GetLastError)(m_lPort);
+        emit errorOccurred("Failed to start playback: " + getErrorString(error));
+        return false;
+    }
+    m_speed.reset();
+    m_currentSpeed = 1.0f;
+    updateFastScan();
+
+    m_playState = Playing;
+    m_playClock.start();
+    emit statusChanged(Playing);
+
+    if (m_openTimer.isValid()) {
+        m_firstFrameTimer->start();
+    }
+
+    return true;
+}
+
+void MediaPlayerWrapper::checkFirstFrame()
+{
+    if (!m_openTimer.isValid() || m_lPort < 0) {
+        m_firstFrameTimer->stop();
+        return;
+    }
+
+    const qint64 elapsedMs = m_openTimer.elapsed();
+    if (getPlayedFrames() == 0) {
+        if (elapsedMs > kFirstFrameTimeoutMs) {
+            m_firstFrameTimer->stop();
+            m_openTimer.invalidate();
+        }
+        return;
+    }
+
+    m_firstFrameTimer->stop();
+    m_openTimer.invalidate();
+
+    // Resolution is the poll interval, which is well below the port cost
+    const bool pooled = PortPool::instance()->isEnabled();
+    FirstFrameStats &stats = s_firstFrameStats[pooled ? 1 : 0];
+    ++stats.count;
+    stats.totalMs += elapsedMs;
+    stats.maxMs = qMax(stats.maxMs, elapsedMs);
+    qDebug() << "Open-to-first-frame" << elapsedMs << "ms, port pool" << (pooled ? "on" : "off")
+             << ": avg" << stats.totalMs / stats.count << "ms max" << stats.maxMs
+             << "ms over" << stats.count << "opens";
+
+    emit firstFrameDisplayed(elapsedMs);
+}
+
+bool MediaPlayerWrapper::startHeadless(FrameConsumer *consumer)
+{
+    if ((!m_bFileOpened && !m_bStreamOpened) || !consumer) {
+        emit errorOccurred("No file or stream opened");
+        return false;
+    }
+    if (m_playState != Stopped) {
+        stop();
+    }
+
+    m_frameConsumer = consumer;
+    m_headlessFrames = 0;
+    m_bHeadless = true;
+
+    // Video only
+    if (!configurePort()) {
+        DWORD error = NAME(PlayM4_GetLastError)(m_lPort);
+        emit errorOccurred("Failed to set decode callback: " + getErrorString(error));
+        stopHeadless();
+        return false;
+    }
+
+    if (!NAME(PlayM4_Play)(m_lPort, nullptr)) {
+        DWORD error = NAME(PlayM4_GetLastError)(m_lPort);
+        emit errorOccurred("Failed to start headless decode: " + getErrorString(error));
+        stopHeadless();
+        return false;
+    }
+    m_speed.reset();
+    // Without a window nothing paces the decoder but the SDK clock; step
+    // that to the top so files decode as fast as the decoder goes. A live
+    // stream only has what the source sends.
+    if (m_headlessFastDecode && !m_bStreamMode && !m_speed.moveTo(m_lPort, SpeedController::kMaxStep)) {
+        qDebug() << "Headless decode: SDK stopped at x" << m_speed.speed();
+    }
+    m_currentSpeed = m_speed.speed();
+
+    m_playState = Playing;
+    m_playClock.start();
+    emit statusChanged(Playing);
+    return true;
+}
+
+void MediaPlayerWrapper::stopHeadless()
+{
+    if (!m_bHeadless) {
+        return;
+    }
+
+    NAME(PlayM4_SetDecCallBackMend)(m_lPort, nullptr, nullptr);
+    stop();
+
+    detachConsumer(m_frameConsumer);
+    m_bHeadless = false;
+}
+
+void MediaPlayerWrapper::detachConsumer(std::atomic<FrameConsumer *> &consumer)
+{
+    // Sequentially consistent on both sides: a callback either sees the
+    // consumer gone or is counted here
+    consumer = nullptr;
+    while (m_consumerCallsInFlight.load() > 0) {
+        QThread::yieldCurrentThread();
+    }
+}
+
+void CALLBACK MediaPlayerWrapper::decodeCallBack(long nPort, char *pBuf, long nSize, FRAME_INFO *pFrameInfo,
+                                                 void *nUser, void *nReserved2)
+{
+    Q_UNUSED(nPort)
+    Q_UNUSED(nReserved2)
+
+    MediaPlayerWrapper *player = static_cast<MediaPlayerWrapper *>(nUser);
+    if (!player || !pBuf || !pFrameInfo || pFrameInfo->nType != T_YV12) {
+        return;
+    }
+
+    DecodedFrame frame;
+    frame.data = reinterpret_cast<const uchar *>(pBuf);
+    frame.size = static_cast<int>(nSize);
+    frame.width = static_cast<int>(pFrameInfo->nWidth);
+    frame.height = static_cast<int>(pFrameInfo->nHeight);
+    frame.type = static_cast<int>(pFrameInfo->nType);
+    frame.timestampMs = pFrameInfo->nStamp;
+    frame.frameNum = pFrameInfo->dwFrameNum;
+
+    player->m_consumerCallsInFlight.fetch_add(1);
+    if (FrameConsumer *consumer = player->m_frameConsumer.load()) {
+        player->m_headlessFrames.fetch_add(1, std::memory_order_relaxed);
+        consumer->onFrame(frame);
+    }
+    player->m_consumerCallsInFlight.fetch_sub(1);
+}
+
+bool MediaPlayerWrapper::configurePort()
+{
+    if (m_lPort < 0) {
+        return false;
+    }
+
+    setCheckWatermarkCallback(MediaPlayerWrapper::watermarkCallBack, this);
+    if (m_bStreamOpened) {
+        // Wake the feeder once the decoder has drained the source buffer
+        // below half full, so a stalled feeder resumes without polling.
+        if (!NAME(PlayM4_SetSourceBufCallBack)(m_lPort, m_streamPoolSize / 2, sourceBufCallBack, this, nullptr)) {
+            qDebug() << "Failed to set source buffer callback:" << getErrorString(NAME(PlayM4_GetLastError)(m_lPort));
+        }
+    } else if (m_bFileOpened) {
+        NAME(PlayM4_SetFileEndCallback)(m_lPort, fileEndCallBack, this);
+    }
+    if (m_displayCallBackSet) {
+        NAME(PlayM4_SetDisplayCallBackYUV)(m_lPort, displayYuvCallBack, TRUE, this);
+    }
+    if (m_keyFramesOnly) {
+        NAME(PlayM4_SetDecodeFrameType)(m_lPort, kDecodeKeyFrames);
+    }
+    if (m_bHeadless) {
+        NAME(PlayM4_SetDecCBStream)(m_lPort, 1);
+        if (!NAME(PlayM4_SetDecCallBackMend)(m_lPort, decodeCallBack, this)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MediaPlayerWrapper::setKeyFramesOnly(bool keyFramesOnly)
+{
+    if (m_lPort < 0 || keyFramesOnly == m_keyFramesOnly) {
+        return keyFramesOnly == m_keyFramesOnly;
+    }
+
+    if (!NAME(PlayM4_SetDecodeFrameType)(m_lPort, keyFramesOnly ? kDecodeKeyFrames : kDecodeAllFrames)) {
+        DWORD error = NAME(PlayM4_GetLastError)(m_lPort);
+        qDebug() << "Failed to set decode frame type:" << getErrorString(error);
+        return false;
+    }
+    m_keyFramesOnly = keyFramesOnly;
+    return true;
+}
+
+bool MediaPlayerWrapper::setDisplayConsumer(FrameConsumer *consumer)
+{
+    if (!consumer) {
+        detachConsumer(m_displayConsumer);
+        updateDisplayCallBack();
+        return true;
+    }
+
+    if ((!m_bFileOpened && !m_bStreamOpened) || m_lPort < 0) {
+        return false;
+    }
+
+    m_displayConsumer = consumer;
+    if (!updateDisplayCallBack()) {
+        m_displayConsumer = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool MediaPlayerWrapper::updateDisplayCallBack()
+{
+    if (m_lPort < 0) {
+        return false;
+    }
+
+    const bool wanted = m_armedSnapshotCount.load() > 0 || m_displayConsumer.load();
+    if (wanted == m_displayCallBackSet) {
+        return true;
+    }
+
+    if (!wanted) {
+        NAME(PlayM4_SetDisplayCallBackYUV)(m_lPort, nullptr, TRUE, nullptr);
+        m_displayCallBackSet = false;
+        return true;
+    }
+    // Stitched YV12, one buffer per frame
+    if (!NAME(PlayM4_SetDisplayCallBackYUV)(m_lPort, displayYuvCallBack, TRUE, this)) {
+        qDebug() << "Failed to set YUV display callback:" << getErrorString(NAME(PlayM4_GetLastError)(m_lPort));
+        return false;
+    }
+    m_displayCallBackSet = true;
+    return true;
+}
+
+bool MediaPlayerWrapper::refreshDisplay()
+{
+    if (m_lPort < 0 || m_playState == Stopped) {
+        return false;
+    }
+    if (!NAME(PlayM4_RefreshPlay)(m_lPort)) {
+        qDebug() << "Failed to refresh display:" << getErrorString(NAME(PlayM4_GetLastError)(m_lPort));
+        return false;
+    }
+    return true;
+}
+
+void CALLBACK MediaPlayerWrapper::displayYuvCallBack(DISPLAY_INFO_YUV *pInfo)
 {
-    if (!m_bStreamOpened) {
+    if (!pInfo || !pInfo->pBuf) {
+        return;
+    }
+    MediaPlayerWrapper *player = static_cast<MediaPlayerWrapper *>(pInfo->pUser);
+    if (!player) {
         return;
     }
 
-    stop();
-
-    NAME(PlayM4_CloseStream)(m_lPort);
-    releasePort();
+    DecodedFrame frame;
+    frame.data = reinterpret_cast<const uchar *>(pInfo->pBuf);
+    frame.size = static_cast<int>(pInfo->nBufLen);
+    frame.width = static_cast<int>(pInfo->nWidth);
+    frame.height = static_cast<int>(pInfo->nHeight);
+    frame.type = static_cast<int>(pInfo->nType);
+    frame.timestampMs = pInfo->nStamp;
+    frame.frameNum = pInfo->reserved[0];
 
-    m_bStreamOpened = false;
-    m_bStreamMode = false;
-    m_bFileOpened = false;
-    m_streamUrl.clear();
+    if (player->m_armedSnapshotCount.load(std::memory_order_acquire) > 0) {
+        player->takeArmedSnapshots(frame);
+    }
 
-    emit statusChanged(Stopped);
+    player->m_consumerCallsInFlight.fetch_add(1);
+    if (FrameConsumer *consumer = player->m_displayConsumer.load()) {
+        consumer->onFrame(frame);
+    }
+    player->m_consumerCallsInFlight.fetch_sub(1);
 }
 
-bool MediaPlayerWrapper::inputStreamData(PBYTE pBuf, DWORD nSize)
+void CALLBACK MediaPlayerWrapper::fileEndCallBack(long nPort, void *pUser)
 {
-    if (!m_bStreamOpened || m_lPort < 0) {
-        return false;
-    }
+    Q_UNUSED(nPort)
 
-    if (!NAME(PlayM4_InputData)(m_lPort, pBuf, nSize)) {
-        DWORD error = NAME(PlayM4_GetLastError)(m_lPort);
-        if (error != PLAYM4_BUF_OVER) {  // Ignore buffer overflow warnings
-            qDebug() << "Failed to input stream data:" << getErrorString(error);
-        }
-        return false;
+    MediaPlayerWrapper *player = static_cast<MediaPlayerWrapper *>(pUser);
+    if (!player) {
+        return;
     }
 
-    return true;
+    player->m_consumerCallsInFlight.fetch_add(1);
+    if (FrameConsumer *consumer = player->m_frameConsumer.load()) {
+        consumer->onEndOfStream();
+    }
+    player->m_consumerCallsInFlight.fetch_sub(1);
+    QMetaObject::invokeMethod(player, "onFileEnd", Qt::QueuedConnection);
 }
 
-bool MediaPlayerWrapper::play(HWND displayWnd)
+void MediaPlayerWrapper::onFileEnd()
 {
-    if (!m_bFileOpened && !m_bStreamOpened) {
-        emit errorOccurred("No file or stream opened");
-        return false;
+    if (!m_bFileOpened) {
+        return;
     }
 
-    if (displayWnd) {
-        m_displayWnd = displayWnd;
-    }
-    
-    if (m_playState == Paused) {
-        // Resume from pause
-        return resume();
+    // A playback that saw the watermark of every frame completes the index
+    if (m_recordWatermarks) {
+        drainWatermarkRecords();
+        if (m_watermarkRing->overflowCount() == m_watermarkOverflows && !m_watermarkIndex.isEmpty()
+            && m_watermarkIndex.coversWholeFile()) {
+            m_watermarkIndex.setComplete(true);
+            m_recordWatermarks = false;
+            m_watermarkDrainTimer->stop();
+            if (m_watermarkIndex.save(m_currentFile)) {
+                qDebug() << "Watermark index saved:" << m_watermarkIndex.size() << "records";
+            }
+        }
     }
-    
-    if (!NAME(PlayM4_Play)(m_lPort, m_displayWnd)) {
-        DWORD error = NAME(PlayM4_GetLastError)(m_lPort);
-        emit errorOccurred("Failed to start playback: " + getErrorString(error));
-        return false;
+
+    // Decoded frames per wall-clock second, headless or display paced
+    const qint64 elapsedMs = m_playClock.isValid() ? m_playClock.elapsed() : 0;
+    const quint64 frames = m_bHeadless ? headlessFrameCount() : static_cast<quint64>(getPlayedFrames());
+    if (elapsedMs > 0) {
+        qDebug() << (m_bHeadless ? "Headless decode:" : "Display-paced playback:") << frames << "frames in"
+                 << elapsedMs << "ms =" << QString::number(frames * 1000.0 / elapsedMs, 'f', 1) << "fps";
     }
 
-    m_playState = Playing;
-    emit statusChanged(Playing);
-    
-    return true;
+    emit fileEnded();
 }
 
 bool MediaPlayerWrapper::pause()
@@ -320,6 +1460,7 @@ bool MediaPlayerWrapper::pause()
     }
 
     m_playState = Paused;
+    m_speedCheckTimer->stop();
     emit statusChanged(Paused);
     
     return true;
@@ -355,7 +1496,11 @@ bool MediaPlayerWrapper::stop()
         return false;
     }
 
-    m_watermarkData.clear();
+    // Decoding has stopped, so the callback is not writing
+    m_watermark.reset();
+    m_fastScanTimer->stop();
+    m_speedCheckTimer->stop();
+    setKeyFramesOnly(false);
     m_playState = Stopped;
     emit statusChanged(Stopped);
     
@@ -373,6 +1518,7 @@ bool MediaPlayerWrapper::seek(float fRelativePos)
         emit errorOccurred("Failed to seek: " + getErrorString(error));
         return false;
     }
+    noteSeek();
 
     emit positionChanged(fRelativePos);
     return true;
@@ -384,16 +1530,123 @@ bool MediaPlayerWrapper::seekMs(qint64 ms)
         return false;
     }
 
-    qint64 totalMs = duration();
-    if (totalMs <= 0) {
+    return seekToTime(ms);
+}
+
+bool MediaPlayerWrapper::seekToTime(qint64 ms)
+{
+    if (!m_bFileOpened || m_bStreamMode) {
+        return false;
+    }
+
+    const qint64 totalMs = duration() * 1000;
+    ms = qBound<qint64>(0, ms, qMax<qint64>(0, totalMs));
+
+    if (!m_keyFrameIndex.isEmpty()) {
+        const quint32 frame = m_keyFrameIndex.frameForTime(static_cast<quint32>(ms), getTotalFrames(),
+                                                           static_cast<quint32>(totalMs));
+        return seekToFrame(frame);
+    }
+
+    // No index yet: the millisecond API still beats a whole-file float ratio
+    if (!NAME(PlayM4_SetPlayedTimeEx)(m_lPort, static_cast<DWORD>(ms))) {
+        DWORD error = NAME(PlayM4_GetLastError)(m_lPort);
+        emit errorOccurred("Failed to seek: " + getErrorString(error));
+        return false;
+    }
+    noteSeek();
+
+    if (totalMs > 0) {
+        emit positionChanged(static_cast<float>(ms) / totalMs);
+    }
+    return true;
+}
+
+bool MediaPlayerWrapper::seekToFrame(quint32 frameNum)
+{
+    if (!m_bFileOpened || m_bStreamMode) {
+        return false;
+    }
+
+    const DWORD totalFrames = getTotalFrames();
+    if (totalFrames > 0) {
+        frameNum = qMin<quint32>(frameNum, totalFrames - 1);
+    }
+
+    // The SDK restarts decoding at the I-frame at or before frameNum and
+    // decodes forward to it; the table tells us which one that is and the
+    // exact time we are aiming for.
+    qint64 targetMs = -1;
+    const int key = m_keyFrameIndex.floorByFrame(frameNum);
+    if (key >= 0) {
+        const KeyFrameIndex::Entry &entry = m_keyFrameIndex.at(key);
+        if (entry.frameNum == frameNum) {
+            targetMs = entry.timeMs;
+        }
+    }
+
+    if (!NAME(PlayM4_SetCurrentFrameNum)(m_lPort, frameNum)) {
+        DWORD error = NAME(PlayM4_GetLastError)(m_lPort);
+        emit errorOccurred("Failed to seek: " + getErrorString(error));
         return false;
     }
+    noteSeek();
+
+    startSeekProbe(frameNum, targetMs);
+    if (totalFrames > 0) {
+        emit positionChanged(static_cast<float>(frameNum) / totalFrames);
+    }
+    return true;
+}
+
+void MediaPlayerWrapper::startSeekProbe(quint32 targetFrame, qint64 targetMs)
+{
+    m_seekTargetFrame = targetFrame;
+    m_seekTargetMs = targetMs;
+    m_seekTimer.start();
+    m_seekProbeTimer->start();
+}
+
+void MediaPlayerWrapper::checkSeekLanded()
+{
+    if (!m_bFileOpened) {
+        m_seekProbeTimer->stop();
+        return;
+    }
+
+    // While playing the frame keeps advancing; a couple of frames past the
+    // target within the poll interval still counts as landed.
+    const qint64 elapsedMs = m_seekTimer.elapsed();
+    const int frameError = static_cast<int>(getCurrentFrameNum()) - static_cast<int>(m_seekTargetFrame);
+    const bool landed = frameError >= 0 && frameError <= (isPlaying() ? 2 : 0);
+    if (!landed && elapsedMs < kSeekProbeTimeoutMs) {
+        return;
+    }
+    m_seekProbeTimer->stop();
+
+    const qint64 fileSeconds = duration();
+    SeekStats &stats = s_seekStats[fileSeconds < 600 ? 0 : (fileSeconds < 3600 ? 1 : 2)];
+    ++stats.count;
+    stats.totalMs += elapsedMs;
+    stats.maxMs = qMax(stats.maxMs, elapsedMs);
+    stats.totalAbsFrameError += qAbs(frameError);
+    if (frameError == 0) {
+        ++stats.exact;
+    }
 
-    float relativePos = (float)ms / totalMs;
-    if (relativePos < 0.0f) relativePos = 0.0f;
-    if (relativePos > 1.0f) relativePos = 1.0f;
+    QString timeError;
+    if (m_seekTargetMs >= 0) {
+        timeError = QString(", time error %1 ms").arg(static_cast<qint64>(NAME(PlayM4_GetPlayedTimeEx)(m_lPort)) - m_seekTargetMs);
+    }
+    qDebug().noquote() << QString("Seek to frame %1 %2 in %3 ms, frame error %4%5 (%6 s file: avg %7 ms, max %8 ms, "
+                                  "mean |error| %9 frames, %10/%11 exact)")
+                          .arg(m_seekTargetFrame).arg(landed ? "landed" : "timed out").arg(elapsedMs)
+                          .arg(frameError).arg(timeError).arg(fileSeconds)
+                          .arg(stats.totalMs / stats.count).arg(stats.maxMs)
+                          .arg(static_cast<double>(stats.totalAbsFrameError) / stats.count, 0, 'f', 2)
+                          .arg(stats.exact).arg(stats.count);
 
-    return seek(relativePos);
+    emit seekCompleted(elapsedMs, frameError);
 }
 
 bool MediaPlayerWrapper::stepForward()
@@ -444,15 +1697,26 @@ bool MediaPlayerWrapper::stepFrame(int direction)
 
 bool MediaPlayerWrapper::setPlaySpeed(float speed)
 {
-    if (!m_bFileOpened) {
+    if (!m_bFileOpened || speed <= 0.0f) {
         return false;
     }
 
-    m_currentSpeed = speed;
-    // Note: PlayM4_SetPlaySpeed may not be available in this SDK version
-    // Using PlayM4_Fast/Slow instead or implementing custom speed control
-    qDebug() << "Set PlaySpeed to normal";
-    return true;
+    // PlayM4_Play starts at x1, so a stopped port has nothing to step
+    if (m_playState == Stopped) {
+        return speed == 1.0f;
+    }
+    if (speed > kMaxSdkSpeed && m_keyFrameIndex.isEmpty()) {
+        qDebug() << "Fast scan needs the file index";
+        return false;
+    }
+
+    // Above the ladder the port stays on its top rung and fast scan jumps
+    const bool moved = m_speed.moveTo(m_lPort, SpeedController::stepFor(qMin(speed, kMaxSdkSpeed)));
+    m_currentSpeed = (moved && speed > kMaxSdkSpeed) ? speed : m_speed.speed();
+    updateFastScan();
+    startSpeedCheck();
+    qDebug() << "Speed set to" << m_currentSpeed << "for" << speed << "requested, SDK rung" << m_speed.step();
+    return moved;
 }
 
 float MediaPlayerWrapper::getPlaySpeed() const
@@ -461,79 +1725,341 @@ float MediaPlayerWrapper::getPlaySpeed() const
         return 1.0f;
     }
 
-    // Note: PlayM4_GetPlaySpeed may not be available in this SDK version
     return m_currentSpeed;
 }
 
 bool MediaPlayerWrapper::setSpeedMultiplier(float multiplier)
 {
-    if (!m_bFileOpened) {
-        return false;
+    return setPlaySpeed(multiplier);
+}
+
+void MediaPlayerWrapper::startSpeedCheck()
+{
+    m_speedCheckTimer->stop();
+    if (m_playState != Playing) {
+        return;
     }
-/*
-    // Store the speed for reporting
-    m_currentSpeed = multiplier;
-    
-    // Try to use PlayM4 speed functions if available
-    if (multiplier > 1.0f) {
-        // Faster playback
-        if (NAME(PlayM4_Fast)(m_lPort) == TRUE) {
-            qDebug() << "Speed increased to" << multiplier;
-            return true;
+    m_speedCheckStartMs = NAME(PlayM4_GetPlayedTimeEx)(m_lPort);
+    m_speedCheckClock.start();
+    m_speedCheckTimer->start();
+}
+
+void MediaPlayerWrapper::checkSpeed()
+{
+    const qint64 wallMs = m_speedCheckClock.elapsed();
+    if (!m_bFileOpened || m_playState != Playing || wallMs <= 0) {
+        return;
+    }
+
+    // Time stamps of the frames shown, against the wall clock
+    const qint64 playedMs = static_cast<qint64>(NAME(PlayM4_GetPlayedTimeEx)(m_lPort)) - m_speedCheckStartMs;
+    m_measuredSpeed = static_cast<float>(playedMs) / wallMs;
+    const bool off = qAbs(m_measuredSpeed - m_currentSpeed) > m_currentSpeed * kSpeedTolerance;
+    qDebug() << "Speed x" << m_currentSpeed << "measured x" << QString::number(m_measuredSpeed, 'f', 2)
+             << (off ? "- decoder does not keep the requested speed" : "");
+}
+
+void MediaPlayerWrapper::noteSeek()
+{
+    // Both would see the jump as playback progress
+    m_fastScanTargetMs = -1;
+    m_speedCheckTimer->stop();
+}
+
+void MediaPlayerWrapper::updateFastScan()
+{
+    // At x16 every frame would saturate a core on 4K; I-frames keep up
+    setKeyFramesOnly(m_currentSpeed >= kKeyFramesOnlySpeed);
+
+    if (m_currentSpeed > kMaxSdkSpeed) {
+        if (!m_fastScanTimer->isActive()) {
+            m_fastScanTargetMs = -1;
+            m_fastScanJumps = 0;
+            m_fastScanClock.start();
+            m_fastScanTimer->start();
         }
-    } else if (multiplier < 1.0f) {
-        // Slower playback
-        if (NAME(PlayM4_Slow)(m_lPort) == TRUE) {
-            qDebug() << "Speed decreased to" << multiplier;
-            return true;
+    } else if (m_fastScanTimer->isActive()) {
+        m_fastScanTimer->stop();
+        qDebug() << "Fast scan ended after" << m_fastScanJumps << "key frame jumps";
+    }
+}
+
+void MediaPlayerWrapper::onFastScanTick()
+{
+    const qint64 elapsedMs = m_fastScanClock.restart();
+    if (!m_bFileOpened || m_playState != Playing || m_keyFrameIndex.isEmpty()) {
+        return;
+    }
+
+    // Start from, or after a seek resync to, wherever the port is
+    const qint64 playedMs = NAME(PlayM4_GetPlayedTimeEx)(m_lPort);
+    if (m_fastScanTargetMs < 0 || playedMs > m_fastScanTargetMs) {
+        m_fastScanTargetMs = playedMs;
+        return;
+    }
+    m_fastScanTargetMs = qMin<qint64>(m_fastScanTargetMs + qRound64(m_currentSpeed * elapsedMs), duration() * 1000);
+
+    // The port plays on at x16 by itself; jump only once the target has
+    // moved past the next key frame, which then is the only frame decoded
+    const int key = m_keyFrameIndex.floorByTime(static_cast<quint32>(m_fastScanTargetMs));
+    if (key < 0 || m_keyFrameIndex.at(key).timeMs <= playedMs) {
+        return;
+    }
+    if (NAME(PlayM4_SetCurrentFrameNum)(m_lPort, m_keyFrameIndex.at(key).frameNum)) {
+        ++m_fastScanJumps;
+    }
+}
+
+void MediaPlayerWrapper::runFastScanBenchmark(const QString &filePath)
+{
+    static const int kSettleMs = 500;
+    static const int kMeasureMs = 3000;
+    static const float kSpeeds[] = { 1, 2, 4, 8, 16, 32, 64, 128, 256 };
+
+    auto wait = [](int ms) {
+        QEventLoop loop;
+        QTimer::singleShot(ms, &loop, &QEventLoop::quit);
+        loop.exec();
+    };
+
+    QWidget window;
+    window.resize(1280, 720);
+    window.show();
+
+    MediaPlayerWrapper player;
+    player.initialize();
+    if (!player.openFile(filePath)) {
+        qDebug() << "Fast scan benchmark: cannot open" << filePath;
+        return;
+    }
+    // Scanning above x16 goes by the key frame table
+    for (int waited = 0; player.keyFrameIndex().isEmpty() && waited < 10000; waited += 100) {
+        wait(100);
+    }
+    if (!player.play(reinterpret_cast<HWND>(window.winId()))) {
+        return;
+    }
+
+    for (float speed : kSpeeds) {
+        if (speed != 1.0f && !player.setSpeedMultiplier(speed)) {
+            qDebug() << "Fast scan benchmark: x" << speed << "not available";
+            break;
         }
-    } else {
-        // Normal speed - PlayM4_Normal doesn't exist, so we simulate it
-        // by stopping and restarting at normal speed
-        bool wasPlaying = (m_playState == Playing);
-        if (wasPlaying) {
-            // Get current position before stopping
-            float currentPos = getPlayPos();
-            
-            // Stop and restart at normal speed
-            NAME(PlayM4_Stop)(m_lPort);
-            if (NAME(PlayM4_Play)(m_lPort, m_displayWnd) == TRUE) {
-                // Restore position
-                NAME(PlayM4_SetPlayPos)(m_lPort, currentPos);
-                m_playState = Playing;
-                qDebug() << "Speed reset to normal";
-                return true;
-            }
-        } else {
-            // Not playing, just reset the speed tracker
-            qDebug() << "Speed reset to normal (not playing)";
-            return true;
+        if (!player.isPlaying()) {
+            qDebug() << "Fast scan benchmark: file ended, use a longer recording";
+            break;
         }
+        player.seekToTime(0);
+        wait(kSettleMs);
+
+        const qint64 startMs = NAME(PlayM4_GetPlayedTimeEx)(player.m_lPort);
+        const quint64 cpuStart = CpuTime::processUs();
+        wait(kMeasureMs);
+        const quint64 cpuUs = CpuTime::processUs() - cpuStart;
+        const qint64 coveredMs = static_cast<qint64>(NAME(PlayM4_GetPlayedTimeEx)(player.m_lPort)) - startMs;
+
+        qDebug().noquote() << QString("Fast scan benchmark x%1: %2% CPU, %3x file time covered%4%5")
+                              .arg(speed).arg(cpuUs * 100.0 / (kMeasureMs * 1000.0), 0, 'f', 1)
+                              .arg(static_cast<double>(coveredMs) / kMeasureMs, 0, 'f', 1)
+                              .arg(player.isKeyFramesOnly() ? ", I-frames only" : "")
+                              .arg(player.isFastScan() ? QString(", %1 jumps").arg(player.m_fastScanJumps) : QString());
+    }
+    player.closeFile();
+}
+
+void MediaPlayerWrapper::runSpeedBenchmark(const QString &filePath)
+{
+    static const int kSettleMs = 500;
+    // Direct jumps in both directions, across the ladder and into fast scan
+    static const float kSpeeds[] = { 1, 8, 2, 16, 0.25f, 64, 4, 0.0625f, 256, 3, 1 };
+
+    auto wait = [](int ms) {
+        QEventLoop loop;
+        QTimer::singleShot(ms, &loop, &QEventLoop::quit);
+        loop.exec();
+    };
+
+    QWidget window;
+    window.resize(1280, 720);
+    window.show();
+
+    MediaPlayerWrapper player;
+    player.initialize();
+    if (!player.openFile(filePath)) {
+        qDebug() << "Speed benchmark: cannot open" << filePath;
+        return;
+    }
+    for (int waited = 0; player.keyFrameIndex().isEmpty() && waited < 10000; waited += 100) {
+        wait(100);
+    }
+    if (!player.play(reinterpret_cast<HWND>(window.winId()))) {
+        return;
     }
-    */
 
-    if(multiplier>m_currentSpeed)
-    {
-        if (NAME(PlayM4_Fast)(m_lPort) == TRUE) {
-            qDebug() << "Speed increased to" << multiplier;
-            m_currentSpeed = multiplier;
-            return true;
+    int off = 0;
+    for (float speed : kSpeeds) {
+        player.seekToTime(0);
+        wait(kSettleMs);
+        if (!player.setPlaySpeed(speed)) {
+            qDebug() << "Speed benchmark: x" << speed << "not available";
+            continue;
+        }
+        // The check timer measures the shown frame stamps
+        wait(kSpeedCheckMs + kSettleMs);
+        if (!player.isPlaying()) {
+            qDebug() << "Speed benchmark: file ended, use a longer recording";
+            break;
+        }
+        const float applied = player.getPlaySpeed();
+        const float measured = player.measuredSpeed();
+        const bool inTolerance = qAbs(measured - applied) <= applied * kSpeedTolerance;
+        off += inTolerance ? 0 : 1;
+        qDebug().noquote() << QString("Speed benchmark: requested x%1, applied x%2 (SDK rung %3), measured x%4%5")
+                              .arg(speed).arg(applied).arg(player.m_speed.step())
+                              .arg(measured, 0, 'f', 2).arg(inTolerance ? "" : " - OFF");
+    }
+    qDebug() << "Speed benchmark:" << off << "speeds outside" << kSpeedTolerance * 100 << "%";
+    player.closeFile();
+}
+
+void MediaPlayerWrapper::runSeekBenchmark(const QStringList &filePaths)
+{
+    static const int kSeeks = 50;
+
+    auto wait = [](int ms) {
+        QEventLoop loop;
+        QTimer::singleShot(ms, &loop, &QEventLoop::quit);
+        loop.exec();
+    };
+
+    QWidget window;
+    window.resize(1280, 720);
+    window.show();
+
+    for (const QString &filePath : filePaths) {
+        MediaPlayerWrapper player;
+        player.initialize();
+        if (!player.openFile(filePath)) {
+            qDebug() << "Seek benchmark: cannot open" << filePath;
+            continue;
+        }
+        for (int waited = 0; player.keyFrameIndex().isEmpty() && waited < 10000; waited += 100) {
+            wait(100);
+        }
+        if (player.keyFrameIndex().isEmpty()) {
+            // Without the table seekToTime takes the millisecond API and
+            // nothing probes where it landed
+            qDebug() << "Seek benchmark: no file index for" << filePath;
+            player.closeFile();
+            continue;
+        }
+        if (!player.play(reinterpret_cast<HWND>(window.winId()))) {
+            player.closeFile();
+            continue;
+        }
+        wait(500);
+        player.pause();
+
+        // Same targets for every file of the same length
+        QRandomGenerator random(1);
+        const qint64 totalMs = player.duration() * 1000;
+        QVector<qint64> latencies;
+        qint64 totalAbsError = 0;
+        int exact = 0;
+        int timedOut = 0;
+        for (int i = 0; i < kSeeks; ++i) {
+            const qint64 targetMs = static_cast<qint64>(random.bounded(static_cast<double>(qMax<qint64>(1, totalMs))));
+            QEventLoop loop;
+            qint64 latencyMs = -1;
+            int frameError = 0;
+            QMetaObject::Connection done = connect(&player, &MediaPlayerWrapper::seekCompleted, &loop,
+                                                   [&](qint64 ms, int error) {
+                latencyMs = ms;
+                frameError = error;
+                loop.quit();
+            });
+            QTimer::singleShot(kSeekProbeTimeoutMs + 1000, &loop, &QEventLoop::quit);
+            if (player.seekToTime(targetMs)) {
+                loop.exec();
+            }
+            disconnect(done);
+
+            if (latencyMs < 0 || latencyMs >= kSeekProbeTimeoutMs) {
+                ++timedOut;
+                continue;
+            }
+            latencies.append(latencyMs);
+            totalAbsError += qAbs(frameError);
+            exact += frameError == 0 ? 1 : 0;
+        }
+        player.closeFile();
+
+        if (latencies.isEmpty()) {
+            qDebug() << "Seek benchmark:" << filePath << "no seek landed";
+            continue;
+        }
+        std::sort(latencies.begin(), latencies.end());
+        qint64 totalLatencyMs = 0;
+        for (qint64 ms : latencies) {
+            totalLatencyMs += ms;
         }
+        qDebug().noquote() << QString("Seek benchmark: %1 (%2 s): %3 seeks, latency avg %4 ms p50 %5 ms p95 %6 ms "
+                                      "max %7 ms, mean |frame error| %8, %9 exact, %10 timed out")
+                              .arg(QFileInfo(filePath).fileName()).arg(totalMs / 1000).arg(latencies.size())
+                              .arg(totalLatencyMs / latencies.size())
+                              .arg(latencies.at((latencies.size() - 1) / 2))
+                              .arg(latencies.at((latencies.size() - 1) * 95 / 100)).arg(latencies.last())
+                              .arg(static_cast<double>(totalAbsError) / latencies.size(), 0, 'f', 2)
+                              .arg(exact).arg(timedOut);
     }
-    else if(multiplier<m_currentSpeed)
+}
+
+void MediaPlayerWrapper::runHeadlessBenchmark(const QString &filePath)
+{
+    static const int kMaxRunMs = 10000;
+
+    // Frames are only counted; what they cost downstream is not measured here
+    class NullConsumer : public FrameConsumer
     {
-        // Slower playback
-        if (NAME(PlayM4_Slow)(m_lPort) == TRUE) {
-            qDebug() << "Speed decreased to" << multiplier;
-            m_currentSpeed = multiplier;
-            return true;
+    public:
+        void onFrame(const DecodedFrame &) override {}
+    };
+
+    for (bool fast : { false, true }) {
+        MediaPlayerWrapper player;
+        player.initialize();
+        if (!player.openFile(filePath)) {
+            qDebug() << "Headless benchmark: cannot open" << filePath;
+            return;
+        }
+        player.setHeadlessFastDecode(fast);
+
+        NullConsumer consumer;
+        QEventLoop loop;
+        connect(&player, &MediaPlayerWrapper::fileEnded, &loop, &QEventLoop::quit);
+        QTimer::singleShot(kMaxRunMs, &loop, &QEventLoop::quit);
+
+        QElapsedTimer clock;
+        clock.start();
+        const quint64 cpuStart = CpuTime::processUs();
+        if (!player.startHeadless(&consumer)) {
+            player.closeFile();
+            return;
         }
+        const float speed = player.m_currentSpeed;
+        loop.exec();
+        const quint64 frames = player.headlessFrameCount();
+        const qint64 elapsedMs = qMax<qint64>(1, clock.elapsed());
+        const quint64 cpuUs = CpuTime::processUs() - cpuStart;
+        player.stopHeadless();
+        player.closeFile();
+
+        qDebug().noquote() << QString("Headless benchmark %1 (x%2): %3 frames in %4 ms = %5 fps, %6% CPU%7")
+                              .arg(fast ? "fast" : "normal").arg(speed).arg(frames).arg(elapsedMs)
+                              .arg(frames * 1000.0 / elapsedMs, 0, 'f', 1)
+                              .arg(cpuUs * 100.0 / (elapsedMs * 1000.0), 0, 'f', 1)
+                              .arg(elapsedMs >= kMaxRunMs ? ", stopped before the end" : "");
     }
-    else
-        return true;
-
-    qDebug() << "Speed control failed";
-    return false;
 }
 
 bool MediaPlayerWrapper::playSound()
@@ -550,12 +2076,14 @@ bool MediaPlayerWrapper::playSound()
         return false;
     }
 
+    m_bSoundOn = true;
     qDebug() << "Sound playback started.";
     return true;
 }
 
 bool MediaPlayerWrapper::stopSound()
 {
+    m_bSoundOn = false;
     if (!NAME(PlayM4_StopSound)()) {
         DWORD error = NAME(PlayM4_GetLastError)(m_lPort);
         qDebug() << "Sound stop error:"<<getErrorString(error);
@@ -612,6 +2140,15 @@ DWORD MediaPlayerWrapper::getPlayedTime() const
     return NAME(PlayM4_GetPlayedTime)(m_lPort);
 }
 
+qint64 MediaPlayerWrapper::getPlayedTimeMs() const
+{
+    if (!m_bFileOpened) {
+        return 0;
+    }
+
+    return static_cast<qint64>(NAME(PlayM4_GetPlayedTimeEx)(m_lPort));
+}
+
 DWORD MediaPlayerWrapper::getCurrentFrameNum() const
 {
     if (!m_bFileOpened) {
@@ -630,6 +2167,15 @@ DWORD MediaPlayerWrapper::getTotalFrames() const
     return NAME(PlayM4_GetFileTotalFrames)(m_lPort);
 }
 
+DWORD MediaPlayerWrapper::getPlayedFrames() const
+{
+    if (!m_bFileOpened) {
+        return 0;
+    }
+
+    return NAME(PlayM4_GetPlayedFrames)(m_lPort);
+}
+
 bool MediaPlayerWrapper::getPictureSize(LONG *pWidth, LONG *pHeight) const
 {
     if (!m_bFileOpened || !pWidth || !pHeight) {
@@ -639,6 +2185,15 @@ bool MediaPlayerWrapper::getPictureSize(LONG *pWidth, LONG *pHeight) const
     return NAME(PlayM4_GetPictureSize)(m_lPort, pWidth, pHeight) == TRUE;
 }
 
+bool MediaPlayerWrapper::getFileTimeRange(PLAYM4_SYSTEM_TIME *begin, PLAYM4_SYSTEM_TIME *end) const
+{
+    if (!m_bFileOpened || !begin || !end) {
+        return false;
+    }
+
+    return NAME(PlayM4_GetFileTotalTime)(m_lPort, begin, end) == TRUE;
+}
+
 void MediaPlayerWrapper::setFileRefDoneCallback(FileRefDone callback, void* userData)
 {
     if (m_lPort >= 0) {
@@ -691,48 +2246,133 @@ bool MediaPlayerWrapper::snapshot(const QString filePath, int nPicFormat)
     if (!m_bFileOpened) {
         return false;
     }
+    // The picture comes from the display callback; a headless port shows none
+    if (m_bHeadless) {
+        qDebug() << "Failed to take snapshot: nothing is displayed";
+        return false;
+    }
 
     LONG w = 0, h = 0;
     getPictureSize(&w,&h);
+    if (w <= 0 || h <= 0) {
+        qDebug() << "Failed to take snapshot: no picture yet";
+        return false;
+    }
 
-    DWORD bufSize = w * h * 5;
-    QByteArray imageBuffer(bufSize, 0);
-    DWORD imageSize = 0;
-    QString snapshotPath = filePath;
-    
     QDateTime now = QDateTime::currentDateTime();
     QString timestamp = now.toString("yyyyMMddhhmmsszzz");
+    QString snapshotPath = filePath;
+    if (nPicFormat == Format_BMP) {
+        snapshotPath += QString("/snapshot_%1.bmp").arg(timestamp);
+    } else {
+        snapshotPath += QString("/snapshot_%1.jpeg").arg(timestamp);
+    }
 
-    // nType: 0 = BMP format
-    if(nPicFormat==Format_BMP)
+    // The next frame the port shows is copied for it: the one on screen, or
+    // while playing the one right after. Encode and write happen on the
+    // snapshot worker.
+    const int requestId = SnapshotService::instance()->reserveId();
     {
-        snapshotPath += QString("/snapshot_%1.bmp").arg(timestamp);
-        if (NAME(PlayM4_GetBMP)(m_lPort, reinterpret_cast<PBYTE>(imageBuffer.data()), bufSize, &imageSize) != TRUE) {
-            DWORD error = NAME(PlayM4_GetLastError)(m_lPort);
-            qDebug() << "Failed to take snapshot:" << getErrorString(error);
-            return false;
+        QMutexLocker locker(&m_snapshotMutex);
+        ArmedSnapshot armed;
+        armed.requestId = requestId;
+        armed.filePath = snapshotPath;
+        armed.format = nPicFormat == Format_BMP ? SnapshotService::Bmp : SnapshotService::Jpeg;
+        m_armedSnapshots.append(armed);
+        m_armedSnapshotCount.store(m_armedSnapshots.size(), std::memory_order_release);
+    }
+    if (!updateDisplayCallBack()) {
+        disarmSnapshot(requestId);
+        return false;
+    }
+    // A paused port shows nothing new by itself; have it show the current
+    // frame again
+    if (!isPlaying()) {
+        NAME(PlayM4_RefreshPlay)(m_lPort);
+    }
+
+    m_pendingSnapshots.insert(requestId);
+    m_lastSnapshotPath = snapshotPath;
+    QTimer::singleShot(kSnapshotFrameTimeoutMs, this, [this, requestId]() {
+        if (disarmSnapshot(requestId) && m_pendingSnapshots.remove(requestId)) {
+            qDebug() << "Failed to take snapshot: no frame displayed within" << kSnapshotFrameTimeoutMs << "ms";
+            emit snapshotFailed("No frame was displayed");
+        }
+    });
+    return true;
+}
+
+void MediaPlayerWrapper::takeArmedSnapshots(const DecodedFrame &frame)
+{
+    QVector<ArmedSnapshot> armed;
+    {
+        QMutexLocker locker(&m_snapshotMutex);
+        armed.swap(m_armedSnapshots);
+        m_armedSnapshotCount.store(0, std::memory_order_release);
+    }
+
+    for (const ArmedSnapshot &snapshot : armed) {
+        if (!SnapshotService::instance()->submit(snapshot.requestId, frame, snapshot.filePath, snapshot.format)) {
+            const int requestId = snapshot.requestId;
+            QMetaObject::invokeMethod(this, [this, requestId]() {
+                if (m_pendingSnapshots.remove(requestId)) {
+                    emit snapshotFailed("Too many snapshots queued");
+                }
+            }, Qt::QueuedConnection);
         }
     }
-    else
+    // Not from inside the SDK's own callback
+    QMetaObject::invokeMethod(this, [this]() { updateDisplayCallBack(); }, Qt::QueuedConnection);
+}
+
+bool MediaPlayerWrapper::disarmSnapshot(int requestId)
+{
+    bool found = false;
     {
-        snapshotPath += QString("/snapshot_%1.jpeg").arg(timestamp);
-        if (NAME(PlayM4_GetJPEG)(m_lPort, reinterpret_cast<PBYTE>(imageBuffer.data()), bufSize, &imageSize) != TRUE) {
-            DWORD error = NAME(PlayM4_GetLastError)(m_lPort);
-            qDebug() << "Failed to take snapshot:" << getErrorString(error);
-            return false;
+        QMutexLocker locker(&m_snapshotMutex);
+        for (int i = 0; i < m_armedSnapshots.size(); ++i) {
+            if (m_armedSnapshots.at(i).requestId == requestId) {
+                m_armedSnapshots.removeAt(i);
+                found = true;
+                break;
+            }
         }
+        m_armedSnapshotCount.store(m_armedSnapshots.size(), std::memory_order_release);
     }
+    if (found) {
+        updateDisplayCallBack();
+    }
+    return found;
+}
 
-    QFile file(snapshotPath);
-    if (file.open(QIODevice::WriteOnly)) {
-        file.write(imageBuffer.constData(), imageSize);
-        file.close();
-        m_lastSnapshotPath = snapshotPath;
-        return true;
+void MediaPlayerWrapper::cancelSnapshots()
+{
+    // Frames already copied are encoded and written regardless; the port is
+    // not needed for that
+    {
+        QMutexLocker locker(&m_snapshotMutex);
+        for (const ArmedSnapshot &armed : m_armedSnapshots) {
+            m_pendingSnapshots.remove(armed.requestId);
+        }
+        m_armedSnapshots.clear();
+        m_armedSnapshotCount.store(0, std::memory_order_release);
+    }
+    updateDisplayCallBack();
+}
+
+void MediaPlayerWrapper::onSnapshotFinished(int requestId, bool ok, const QString &filePath, qint64 elapsedMs)
+{
+    if (!m_pendingSnapshots.remove(requestId)) {
+        return;
+    }
+
+    if (ok) {
+        qDebug() << "Snapshot saved in" << elapsedMs << "ms:" << filePath;
+        emit snapshotSaved(filePath);
     } else {
-        DWORD error = NAME(PlayM4_GetLastError)(m_lPort);
-        qDebug() << "Failed to take snapshot:" << getErrorString(error);
-        return false;
+        const QString error = QString("Cannot write %1").arg(filePath);
+        qDebug() << "Failed to take snapshot:" << error;
+        emit snapshotFailed(error);
     }
 }
 
@@ -3,11 +3,21 @@
 
 #include <QObject>
 #include <QString>
+#include <QStringList>
 #include <QTimer>
 #include <QPointer>
 #include <QMutex>
+#include <atomic>
 #include <QThread>
 #include <QTcpSocket>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QSet>
+#include <QVector>
+#include "KeyFrameIndex.h"
+#include "SeqLock.h"
+#include "WatermarkIndex.h"
+#include "SpeedController.h"
 #include <Windows.h>
 
 // Include PlayM4 SDK headers
@@ -22,14 +32,11 @@ extern "C" {
     #define NAME(x) x
 #endif
 
-struct WatermarkData{
-    DWORD globalTime;
-    DWORD deviceSN;
-    QString mac;
-    unsigned char deviceType;
-    unsigned char deviceInfo;
-    unsigned char channelNum;
-};
+class StreamRingBuffer;
+class StreamFeeder;
+class StreamIngestReactor;
+class FrameConsumer;
+struct DecodedFrame;
 
 // Forward declarations - these are now defined in WindowsPlayM4.h
 typedef void (CALLBACK* FileRefDone)(DWORD nPort, void* nUser);
@@ -52,6 +59,14 @@ public:
         Step = 3
     };
 
+    // Outcome of handing one span to PlayM4_InputData
+    enum InputResult {
+        InputOk = 0,
+        InputBufferFull = 1,    // source buffer full, retry the same span later
+        InputFailed = 2,
+        InputStale = 3          // read before the port was re-opened; wait for the resync
+    };
+
     enum PicFormat{
         Format_BMP=0,
         Format_JPEG=1
@@ -68,12 +83,47 @@ public:
     bool openFile(const QString &filePath);
     void closeFile();
 
+    // Probes the file, sets up a port and opens it on a worker thread, then
+    // reports fileOpened() or fileOpenFailed(). A newer open, a synchronous
+    // open or cancelPendingOpen() abandons the pending one.
+    void openFileAsync(const QString &filePath);
+    void cancelPendingOpen();
+    bool isOpenPending() const { return m_asyncOpenPending; }
+
     // Stream operations
     bool openStream(const QString &url);
     void closeStream();
     bool inputStreamData(PBYTE pBuf, DWORD nSize);
+    // generation is streamGeneration() from before the span was read
+    InputResult feedStreamData(PBYTE pBuf, DWORD nSize, quint32 generation);
+    quint32 streamGeneration() const { return m_streamGeneration.load(std::memory_order_acquire); }
+    DWORD sourceBufferFree() const;
     bool isStreamMode() const { return m_bStreamMode; }
 
+    // Network readers write into this ring; a feeder thread drains it into
+    // PlayM4_InputData. Valid between openStream() and closeStream().
+    StreamRingBuffer *streamRing() const { return m_streamRing; }
+    void setStreamRingCapacity(int bytes) { m_streamRingCapacity = bytes; }
+    int streamRingCapacity() const { return m_streamRingCapacity; }
+
+    // The reactor source writing into the ring. Set by the reactor;
+    // closeStream() removes it before the ring goes away and refuses to
+    // close while it cannot.
+    void setIngestSource(StreamIngestReactor *reactor, int sourceId);
+    int ingestSourceId() const { return m_ingestSourceId; }
+
+    // PlayM4 source buffer size for the open stream. It starts from the
+    // budget's grant and is re-sized from the measured input rate and
+    // picture size; called with a fresh rate sample from the feeder thread.
+    DWORD streamPoolSize() const { return m_streamPoolSize; }
+    void updateStreamPoolEstimate(quint64 bytesPerSecond);
+
+    // Backpressure counters for the current stream
+    qint64 streamStalledMs() const;
+    quint64 streamStallCount() const;
+    quint64 droppedGopCount() const { return m_droppedGops.load(std::memory_order_relaxed); }
+    void noteDroppedGop() { m_droppedGops.fetch_add(1, std::memory_order_relaxed); }
+
     // Playback control
     bool play(HWND displayWnd = nullptr);
     bool pause();
@@ -81,14 +131,51 @@ public:
     bool stop();
     bool seek(float fRelativePos);
     bool seekMs(qint64 ms);
+    // Frame-accurate seeks resolved through the key frame table once the
+    // file index exists; seekToTime falls back to PlayM4_SetPlayedTimeEx.
+    bool seekToTime(qint64 ms);
+    bool seekToFrame(quint32 frameNum);
+    const KeyFrameIndex &keyFrameIndex() const { return m_keyFrameIndex; }
     bool stepForward();
     bool stepBackward();
     bool stepFrame(int direction); // +1 for forward, -1 for backward
 
-    // Speed control
+    // Headless decoding: no window, decode as fast as the decoder allows and
+    // hand every video frame to the consumer on the decode thread. Call
+    // after openFile()/openStream() instead of play().
+    bool startHeadless(FrameConsumer *consumer);
+    void stopHeadless();
+    bool isHeadless() const { return m_bHeadless; }
+    // Files decode headless at the top of the SDK speed ladder (x16 via
+    // PlayM4_Fast) unless this is switched off; live streams always at x1.
+    void setHeadlessFastDecode(bool fast) { m_headlessFastDecode = fast; }
+    quint64 headlessFrameCount() const { return m_headlessFrames.load(std::memory_order_relaxed); }
+
+    // Decode I-frames only (PlayM4_SetDecodeFrameType); everything else is
+    // skipped before the decoder. Reset when the file is closed, since the
+    // port goes back to the pool.
+    bool setKeyFramesOnly(bool keyFramesOnly);
+    bool isKeyFramesOnly() const { return m_keyFramesOnly; }
+
+    // Every displayed frame as YV12 alongside normal playback, on the SDK
+    // display thread; nullptr detaches. Closing the file or stream detaches.
+    bool setDisplayConsumer(FrameConsumer *consumer);
+    // Redraws the last frame, e.g. after the window was raised or uncovered
+    bool refreshDisplay();
+
+    // Speed control. Any speed can be set directly; up to x16 it goes to
+    // the nearest SDK rung (/16, /8, ... x16), which getPlaySpeed() then
+    // reports. From x16 on only I-frames are decoded. Above x16, where
+    // PlayM4_Fast ends, the port stays at x16 and a timer jumps ahead from
+    // key frame to key frame, so decode work does not grow with the speed;
+    // that needs the file index. Playback restarts at x1.
     bool setPlaySpeed(float speed);
     float getPlaySpeed() const;
-    bool setSpeedMultiplier(float multiplier); // 0.75, 1.0, 1.25, etc.
+    bool setSpeedMultiplier(float multiplier);
+    bool isFastScan() const { return m_fastScanTimer->isActive(); }
+    // Rate of the shown frame stamps against the wall clock, measured a few
+    // seconds after the last speed change; 0 before the first measurement
+    float measuredSpeed() const { return m_measuredSpeed; }
 
     // Volume control
     bool playSound();
@@ -98,6 +185,8 @@ public:
 
     // Get information
     bool isFileOpened() const { return m_bFileOpened; }
+    bool isStreamOpened() const { return m_bStreamOpened; }
+    QString currentFile() const { return m_currentFile; }
     bool isPlaying() const { return m_playState == Playing; }
     bool isPaused() const { return m_playState == Paused; }
     bool isStop() const { return m_playState == Stopped; }
@@ -107,6 +196,8 @@ public:
     float getPlayPos() const;
     DWORD getFileTime() const;
     DWORD getPlayedTime() const;
+    // Played time in milliseconds rather than whole seconds
+    qint64 getPlayedTimeMs() const;
     
     // Position in milliseconds
     qint64 position() const;
@@ -115,13 +206,19 @@ public:
     // Frame information
     DWORD getCurrentFrameNum() const;
     DWORD getTotalFrames() const;
+    DWORD getPlayedFrames() const;
     
-    // Snapshot functionality
+    // Snapshot functionality. Takes the frame on screen from the display
+    // callback, hands the copy to SnapshotService and returns at once; the
+    // outcome arrives as snapshotSaved/snapshotFailed.
     bool snapshot(const QString filePath, int nPicFormat);
     QString getLastSnapshotPath() const;
+    int pendingSnapshotCount() const { return m_pendingSnapshots.size(); }
     
     // Picture size
     bool getPictureSize(LONG *pWidth, LONG *pHeight) const;
+    // Device clock at the first and last frame, for files that carry one
+    bool getFileTimeRange(PLAYM4_SYSTEM_TIME *begin, PLAYM4_SYSTEM_TIME *end) const;
 
     // Callbacks setup
     void setFileRefDoneCallback(FileRefDone callback, void* userData);
@@ -130,10 +227,34 @@ public:
 
     static void CALLBACK fileRefCallBack(DWORD nPort, void* nUser);
     static void CALLBACK watermarkCallBack(long nPort, WATERMARK_INFO* pInfo, void *nUser);
-    QMutex m_watermarkMutex;
-    QSharedPointer<WatermarkData> m_watermarkData;
+    static void CALLBACK sourceBufCallBack(long nPort, DWORD nBufSize, void *dwUser, void *pReserved);
+    static void CALLBACK decodeCallBack(long nPort, char *pBuf, long nSize, FRAME_INFO *pFrameInfo, void *nUser, void *nReserved2);
+    static void CALLBACK fileEndCallBack(long nPort, void *pUser);
+    static void CALLBACK displayYuvCallBack(DISPLAY_INFO_YUV *pInfo);
 
-    QSharedPointer<WatermarkData> getWatermarkData();
+    // Latest watermark of the open file or stream, false before the first
+    // one. Never blocks the decode thread that publishes it.
+    bool getWatermarkData(WatermarkData *data) const;
+    // Watermark of the displayed frame, looked up in the file's watermark
+    // index so it is right straight after a seek; falls back to the latest
+    // decoded record where the index has no answer yet.
+    bool currentWatermark(WatermarkData *data);
+    const WatermarkIndex &watermarkIndex() const { return m_watermarkIndex; }
+    // Times the watermark callback alone and against a polling reader, and
+    // the previous allocate-format-lock publication for comparison.
+    static void runWatermarkBenchmark();
+    // Plays the file up the whole speed ladder, x1 to x256, and logs process
+    // CPU and the file time covered per second at each speed.
+    static void runFastScanBenchmark(const QString &filePath);
+    // Jumps between speeds in no particular order and logs requested,
+    // applied and measured speed for each.
+    static void runSpeedBenchmark(const QString &filePath);
+    // Seeks each paused file to the same series of random times and logs
+    // seek latency and landed-minus-target frames per file.
+    static void runSeekBenchmark(const QStringList &filePaths);
+    // Decodes the file headless at x1 and then in fast decode mode and logs
+    // frames per second and CPU of both.
+    static void runHeadlessBenchmark(const QString &filePath);
 
 
 signals:
@@ -144,9 +265,33 @@ signals:
     void fileRefCreated();
     void streamOpened();
     void streamError(const QString &error);
+    // Time from openFile()/openStream() to the first rendered frame
+    void firstFrameDisplayed(qint64 ms);
+    // A seekToTime/seekToFrame landed: latency and landed-minus-target frames
+    void seekCompleted(qint64 latencyMs, int frameError);
+    void openProgress(const QString &filePath, int percent, const QString &stage);
+    void fileOpened(const QString &filePath);
+    void fileOpenFailed(const QString &filePath, const QString &error);
+    void snapshotSaved(const QString &filePath);
+    void snapshotFailed(const QString &error);
 
 public slots:
     void onFileRefCreated();
+    // Re-opens the stream port with a new source buffer size, keeping the
+    // play state; the ingest side restarts at the next key frame.
+    void resizeStreamPool(uint desiredBytes);
+
+private slots:
+    void checkFirstFrame();
+    void onFileRefReady(long port);
+    void onAsyncOpenProgress(int serial, const QString &filePath, int percent, const QString &stage);
+    void onAsyncOpenFinished(int serial, long port, const QString &filePath, bool refFromCache, const QString &error);
+    void checkSeekLanded();
+    void onFastScanTick();
+    void checkSpeed();
+    void onFileEnd();
+    void drainWatermarkRecords();
+    void onSnapshotFinished(int requestId, bool ok, const QString &filePath, qint64 elapsedMs);
 
 private:
     LONG m_lPort;
@@ -160,10 +305,113 @@ private:
     HWND m_displayWnd;
     float m_currentSpeed;
     QString m_lastSnapshotPath;
+    QSet<int> m_pendingSnapshots;
+    // Snapshots waiting for the display callback, which copies the frame
+    // for them; the count lets it skip the mutex when there are none
+    struct ArmedSnapshot {
+        int requestId;
+        QString filePath;
+        int format;
+    };
+    QMutex m_snapshotMutex;
+    QVector<ArmedSnapshot> m_armedSnapshots;
+    std::atomic<int> m_armedSnapshotCount;
+    StreamRingBuffer *m_streamRing;
+    StreamFeeder *m_streamFeeder;
+    int m_streamRingCapacity;
+    QPointer<StreamIngestReactor> m_ingestReactor;
+    int m_ingestSourceId;
+    DWORD m_streamPoolSize;
+    std::atomic<quint64> m_droppedGops;
+    std::atomic<bool> m_poolResizePending;
+    // Bumped on every stream port re-open, under m_streamInputMutex
+    std::atomic<quint32> m_streamGeneration;
+    mutable QMutex m_streamInputMutex;  // InputData vs. port re-open
+    bool m_bSoundOn;
+    QElapsedTimer m_openTimer;
+    QTimer *m_firstFrameTimer;
+    bool m_fileRefFromCache;
+
+    // Asynchronous open; the serial identifies the only request still wanted
+    friend class FileOpenTask;
+    QThreadPool m_openPool;
+    std::atomic<int> m_asyncOpenSerial;
+    std::atomic<long> m_asyncOpenPort;
+    // Opened by a task, result not delivered yet; closed by the destructor
+    // if it never will be
+    QMutex m_handedOverMutex;
+    QVector<long> m_handedOverPorts;
+    bool m_asyncOpenPending;
+    long m_earlyFileRefPort;            // index finished before the open was adopted
+
+    // Headless decode and the frame rate it reaches against display pacing
+    std::atomic<bool> m_bHeadless;
+    bool m_headlessFastDecode;
+    // Read by the SDK callbacks without a lock, so a slow consumer holds up
+    // nobody else. A callback raises the in-flight count before it reads a
+    // consumer; detachConsumer() clears one and waits out the calls still
+    // using it.
+    std::atomic<FrameConsumer *> m_frameConsumer;   // decode, watermark, end of file
+    std::atomic<FrameConsumer *> m_displayConsumer;
+    std::atomic<int> m_consumerCallsInFlight;
+    bool m_displayCallBackSet;          // for the display consumer or snapshots
+    std::atomic<quint64> m_headlessFrames;
+    QElapsedTimer m_playClock;
+    bool m_keyFramesOnly;
+
+    SeqLock<WatermarkData> m_watermark;
+
+    // Watermark index of the open file. Until it is complete, the callback
+    // queues every record into the ring and the GUI thread files them.
+    WatermarkIndex m_watermarkIndex;
+    StreamRingBuffer *m_watermarkRing;
+    std::atomic<bool> m_recordWatermarks;
+    quint64 m_watermarkOverflows;       // ring overflows when recording began
+    QTimer *m_watermarkDrainTimer;
+
+    KeyFrameIndex m_keyFrameIndex;
+    QElapsedTimer m_seekTimer;
+    QTimer *m_seekProbeTimer;
+    quint32 m_seekTargetFrame;
+    qint64 m_seekTargetMs;
+
+    // Fast scan above the SDK's top speed; the target is the position the
+    // scan should have reached, -1 to take it from the port after a seek
+    QTimer *m_fastScanTimer;
+    QElapsedTimer m_fastScanClock;
+    qint64 m_fastScanTargetMs;
+    quint64 m_fastScanJumps;
+
+    // Rung of the SDK speed ladder the port is on, and the check that
+    // playback really runs at the speed set
+    SpeedController m_speed;
+    QTimer *m_speedCheckTimer;
+    QElapsedTimer m_speedCheckClock;
+    qint64 m_speedCheckStartMs;
+    float m_measuredSpeed;
 
     // Helper functions
     bool getPort();
     void releasePort();
+    bool detachIngestSource();
+    // Registers on m_lPort whatever the current mode needs: callbacks,
+    // consumers and the decode frame type. Run after every open or re-open.
+    bool configurePort();
+    // Installs the YUV display callback while a display consumer or an
+    // armed snapshot needs it, and removes it otherwise
+    bool updateDisplayCallBack();
+    void detachConsumer(std::atomic<FrameConsumer *> &consumer);
+    void takeArmedSnapshots(const DecodedFrame &frame);
+    bool disarmSnapshot(int requestId);
+    void cancelSnapshots();
+    void loadWatermarkIndex();
+    void stopWatermarkRecording();
+    bool restoreFileRef(LONG port, const QString &filePath);
+    void saveFileRef();
+    void startSeekProbe(quint32 targetFrame, qint64 targetMs);
+    void updateFastScan();
+    void noteSeek();
+    void startSpeedCheck();
     QString getErrorString(DWORD errorCode);
 };
 
@@ -0,0 +1,234 @@
+#include "PlaybackClock.h"
+#include "MediaPlayerWrapper.h"
+#include "CpuTime.h"
+#include <QTimer>
+#include <QEventLoop>
+#include <QDebug>
+
+// The old position timer's period: the frame counter moves five times a
+// second, the slider and time label by whole seconds
+static const int kDefaultTickMs = 200;
+
+bool PlaybackState::operator==(const PlaybackState &other) const
+{
+    // The status line shows the frame number, so a playing port differs on
+    // every tick
+    return frameNum == other.frameNum && totalFrames == other.totalFrames
+        && playedSeconds == other.playedSeconds && totalSeconds == other.totalSeconds
+        && playState == other.playState;
+}
+
+static bool isActive(const MediaPlayerWrapper *player)
+{
+    return player->isPlaying() || player->isStep();
+}
+
+PlaybackClock *PlaybackClock::instance()
+{
+    static PlaybackClock clock;
+    return &clock;
+}
+
+PlaybackClock::PlaybackClock()
+    : m_timer(new QTimer(this))
+{
+    m_timer->setTimerType(Qt::CoarseTimer);
+    m_timer->setInterval(kDefaultTickMs);
+    connect(m_timer, &QTimer::timeout, this, &PlaybackClock::onTick);
+}
+
+void PlaybackClock::watch(MediaPlayerWrapper *player)
+{
+    if (!player || indexOf(player) >= 0) {
+        return;
+    }
+
+    Entry entry;
+    entry.player = player;
+    entry.state.frameNum = 0;
+    entry.state.totalFrames = 0;
+    entry.state.playedSeconds = 0;
+    entry.state.totalSeconds = 0;
+    entry.state.playState = MediaPlayerWrapper::Stopped;
+    m_entries.append(entry);
+
+    // Everything that moves a paused or stopped player
+    connect(player, &MediaPlayerWrapper::statusChanged, this, [this, player]() { refresh(player); });
+    connect(player, &MediaPlayerWrapper::positionChanged, this, [this, player]() { refresh(player); });
+    connect(player, &MediaPlayerWrapper::seekCompleted, this, [this, player]() { refresh(player); });
+    connect(player, &MediaPlayerWrapper::fileRefCreated, this, [this, player]() { refresh(player); });
+    connect(player, &QObject::destroyed, this, [this, player]() { unwatch(player); });
+    refresh(player);
+}
+
+void PlaybackClock::unwatch(MediaPlayerWrapper *player)
+{
+    const int index = indexOf(player);
+    if (index < 0) {
+        return;
+    }
+    m_entries.remove(index);
+    disconnect(player, nullptr, this, nullptr);
+    updateTimer();
+}
+
+void PlaybackClock::refresh(MediaPlayerWrapper *player)
+{
+    const int index = indexOf(player);
+    if (index >= 0) {
+        sample(m_entries[index], true);
+        updateTimer();
+    }
+}
+
+PlaybackState PlaybackClock::state(MediaPlayerWrapper *player) const
+{
+    const int index = indexOf(player);
+    if (index >= 0) {
+        return m_entries.at(index).state;
+    }
+    PlaybackState empty = { 0, 0, 0, 0, MediaPlayerWrapper::Stopped };
+    return empty;
+}
+
+void PlaybackClock::setInterval(int ms)
+{
+    m_timer->setInterval(qMax(10, ms));
+}
+
+int PlaybackClock::interval() const
+{
+    return m_timer->interval();
+}
+
+int PlaybackClock::indexOf(MediaPlayerWrapper *player) const
+{
+    for (int i = 0; i < m_entries.size(); ++i) {
+        if (m_entries.at(i).player == player) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void PlaybackClock::sample(Entry &entry, bool full)
+{
+    MediaPlayerWrapper *player = entry.player;
+    PlaybackState next = entry.state;
+
+    if (player->isPlaying()) {
+        next.playState = MediaPlayerWrapper::Playing;
+    } else if (player->isPaused()) {
+        next.playState = MediaPlayerWrapper::Paused;
+    } else if (player->isStep()) {
+        next.playState = MediaPlayerWrapper::Step;
+    } else {
+        next.playState = MediaPlayerWrapper::Stopped;
+    }
+
+    next.frameNum = player->getCurrentFrameNum();
+    next.playedSeconds = player->getPlayedTime();
+    // Fixed per file, but unknown until the file index exists
+    if (full || next.totalFrames == 0 || next.totalSeconds == 0) {
+        next.totalFrames = player->getTotalFrames();
+        next.totalSeconds = player->getFileTime();
+    }
+
+    if (next != entry.state) {
+        entry.state = next;
+        emit stateChanged(player, next);
+    }
+}
+
+void PlaybackClock::onTick()
+{
+    // stateChanged() handlers may watch or unwatch; go by player
+    const QVector<Entry> entries = m_entries;
+    for (const Entry &entry : entries) {
+        const int index = indexOf(entry.player);
+        if (index >= 0 && isActive(entry.player)) {
+            sample(m_entries[index], false);
+        }
+    }
+    updateTimer();
+}
+
+void PlaybackClock::updateTimer()
+{
+    bool anyActive = false;
+    for (const Entry &entry : m_entries) {
+        if (isActive(entry.player)) {
+            anyActive = true;
+            break;
+        }
+    }
+    if (anyActive && !m_timer->isActive()) {
+        m_timer->start();
+    } else if (!anyActive && m_timer->isActive()) {
+        m_timer->stop();
+    }
+}
+
+void PlaybackClock::runBenchmark(const QString &filePath, int players)
+{
+    static const int kPhaseMs = 10000;
+
+    players = qMax(1, players);
+    QVector<MediaPlayerWrapper *> wrappers;
+    for (int i = 0; i < players; ++i) {
+        MediaPlayerWrapper *player = new MediaPlayerWrapper;
+        player->initialize();
+        if (!player->openFile(filePath) || !player->play(nullptr)) {
+            qDebug() << "Playback clock benchmark: cannot play" << filePath;
+            delete player;
+            break;
+        }
+        player->pause();
+        wrappers.append(player);
+    }
+
+    auto runPhase = [&](const char *name) {
+        QEventLoop loop;
+        QTimer::singleShot(kPhaseMs, &loop, &QEventLoop::quit);
+        const quint64 cpuStart = CpuTime::processUs();
+        loop.exec();
+        const quint64 cpuUs = CpuTime::processUs() - cpuStart;
+        qDebug() << "Playback clock benchmark," << name << ":" << wrappers.size() << "idle players,"
+                 << QString::number(cpuUs * 100.0 / (kPhaseMs * 1000.0) / qMax(1, wrappers.size()), 'f', 3)
+                 << "% CPU per player";
+    };
+
+    // What every dialog did: positions at 200 ms, status text at 500 ms,
+    // whether or not anything moved
+    {
+        QVector<QTimer *> timers;
+        for (MediaPlayerWrapper *player : wrappers) {
+            QTimer *posTimer = new QTimer;
+            connect(posTimer, &QTimer::timeout, [player]() {
+                const qint64 total = player->duration();
+                if (total > 0) {
+                    volatile int sliderValue = static_cast<int>(player->position() * 10000 / total);
+                    Q_UNUSED(sliderValue)
+                }
+            });
+            QTimer *statusTimer = new QTimer;
+            connect(statusTimer, &QTimer::timeout, [player]() {
+                const QString text = QString("Pos: %1/%2  ,  Time: %3/%4").arg(player->getCurrentFrameNum())
+                    .arg(player->getTotalFrames()).arg(player->getPlayedTime()).arg(player->getFileTime());
+                Q_UNUSED(text)
+            });
+            posTimer->start(200);
+            statusTimer->start(500);
+            timers << posTimer << statusTimer;
+        }
+        runPhase("polling timers");
+        qDeleteAll(timers);
+    }
+
+    for (MediaPlayerWrapper *player : wrappers) {
+        instance()->watch(player);
+    }
+    runPhase("playback clock");
+
+    qDeleteAll(wrappers);
+}
@@ -0,0 +1,81 @@
+#ifndef PLAYBACKCLOCK_H
+#define PLAYBACKCLOCK_H
+
+#include <QObject>
+#include <QVector>
+#include <QElapsedTimer>
+
+class MediaPlayerWrapper;
+class QTimer;
+
+// What position and status displays need from a port, sampled in one go.
+// Equal when a display would not change.
+struct PlaybackState
+{
+    quint32 frameNum;
+    quint32 totalFrames;
+    quint32 playedSeconds;
+    quint32 totalSeconds;
+    int playState;          // MediaPlayerWrapper::PlayState
+
+    bool operator==(const PlaybackState &other) const;
+    bool operator!=(const PlaybackState &other) const { return !(*this == other); }
+};
+
+// One clock for all players instead of a pair of polling timers per
+// window. Playing or stepping players are sampled once per tick on a single
+// coarse timer; a status change, seek or finished file index samples a
+// player at once. stateChanged() is only emitted when something differs,
+// and with no active player the timer does not run at all.
+//
+// Sampling stays on a timer rather than following the display callback:
+// PlayM4 renders to the window by itself, and a YUV display callback on
+// every port would copy each frame out and post it to the GUI thread, 25
+// to 60 times a second per tile, to update readouts nobody reads faster
+// than a few times a second.
+class PlaybackClock : public QObject
+{
+    Q_OBJECT
+
+public:
+    static PlaybackClock *instance();
+
+    void watch(MediaPlayerWrapper *player);
+    void unwatch(MediaPlayerWrapper *player);
+    // Samples now, e.g. after the caller changed something the clock
+    // cannot see
+    void refresh(MediaPlayerWrapper *player);
+    PlaybackState state(MediaPlayerWrapper *player) const;
+
+    void setInterval(int ms);
+    int interval() const;
+
+    // Opens the file in the given number of players, pauses them and logs
+    // the process CPU per idle player, first polled with two timers per
+    // player as the dialog used to, then through the clock.
+    static void runBenchmark(const QString &filePath, int players);
+
+signals:
+    void stateChanged(MediaPlayerWrapper *player, const PlaybackState &state);
+
+private slots:
+    void onTick();
+
+private:
+    PlaybackClock();
+    Q_DISABLE_COPY(PlaybackClock)
+
+    struct Entry {
+        MediaPlayerWrapper *player;
+        PlaybackState state;
+    };
+
+    int indexOf(MediaPlayerWrapper *player) const;
+    void sample(Entry &entry, bool full);
+    void updateTimer();
+
+    QVector<Entry> m_entries;
+    QTimer *m_timer;
+};
+
+#endif // PLAYBACKCLOCK_H
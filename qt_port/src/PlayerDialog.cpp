@@ -1,6 +1,16 @@
 #include "PlayerDialog.h"
 #include "ui_PlayerDialog.h"
 #include "MediaPlayerWrapper.h"
+#include "StreamIngestReactor.h"
+#include "PlayerPool.h"
+#include "VideoWallWidget.h"
+#include "PortPool.h"
+#include "BurstCapture.h"
+#include "RangeExporter.h"
+#include "WatermarkVerifier.h"
+#include "ThumbnailCache.h"
+#include "PlaylistPlayer.h"
+#include "TimelineIndex.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QPushButton>
@@ -42,7 +52,8 @@ PlayerDialog::PlayerDialog(QWidget *parent)
     , m_actionSetPath(nullptr)
     , m_actionAbout(nullptr)
     , m_actionWatermark(nullptr)
-    , m_rtspThread(nullptr)
+    , m_ingestReactor(nullptr)
+    , m_streamSourceId(-1)
     , m_actionPrev(nullptr)
     , m_actionPlayPause(nullptr)
     , m_actionStop(nullptr)
@@ -50,24 +61,97 @@ PlayerDialog::PlayerDialog(QWidget *parent)
     , m_actionSnap(nullptr)
     , m_actionSlower(nullptr)
     , m_actionFaster(nullptr)
-    , m_playTimer(nullptr)
-    , m_posTimer(nullptr)
     , m_mediaPlayer(nullptr)
     , m_bStartDraw(false)
     , m_sliderDragging(false)
+    , m_playerPool(nullptr)
+    , m_videoWall(nullptr)
+    , m_actionGroupWallLayout(nullptr)
+    , m_burstCapture(nullptr)
+    , m_rangeExporter(nullptr)
+    , m_watermarkVerifier(nullptr)
+    , m_thumbnailCache(nullptr)
+    , m_thumbnailPopup(nullptr)
+    , m_playlist(nullptr)
+    , m_timeline(nullptr)
+    , m_goToTimePending(false)
+    , m_pendingSeekMs(-1)
 {
     setWindowTitle("Media Player");
     resize(400, 400);
     setAcceptDrops(true);  // Enable drag and drop
     setupUI();
-    setupTimers();
     setupMenus();
     
     // Initialize media player
     m_mediaPlayer = new MediaPlayerWrapper(this);
     m_mediaPlayer->initialize();
+
+    // Slider and status text follow the shared clock, only when they change
+    PlaybackClock::instance()->watch(m_mediaPlayer);
+    connect(PlaybackClock::instance(), &PlaybackClock::stateChanged, this, &PlayerDialog::onPlaybackStateChanged);
+
+    // Ports are acquired up front so switching sources skips GetPort/SetDDrawDevice
+    PortPool::instance()->prewarm(4);
     
     m_watermarkDlg = new WatermarkDialog(m_mediaPlayer, this);
+
+    m_burstCapture = new BurstCapture(m_mediaPlayer, this);
+    connect(m_burstCapture, &BurstCapture::progress, this, [this](int saved, int total) {
+        m_statusBar->showMessage(QString("Capturing frames: %1/%2").arg(saved).arg(total));
+    });
+    connect(m_burstCapture, &BurstCapture::finished, this,
+            [this](int saved, int failed, double fps, const QString &directory) {
+        m_statusBar->showMessage(QString("Captured %1 frames (%2 failed) at %3 fps to %4")
+                                 .arg(saved).arg(failed).arg(fps, 0, 'f', 1).arg(directory));
+    });
+
+    m_rangeExporter = new RangeExporter(this);
+    connect(m_rangeExporter, &RangeExporter::progress, this, [this](int written, int total) {
+        m_statusBar->showMessage(total > 0 ? QString("Exporting frames: %1/%2").arg(written).arg(total)
+                                           : QString("Exporting frames: %1").arg(written));
+    });
+    connect(m_rangeExporter, &RangeExporter::finished, this,
+            [this](int written, int failed, double fps, const QString &directory) {
+        m_statusBar->showMessage(QString("Exported %1 frames (%2 failed) at %3 fps to %4")
+                                 .arg(written).arg(failed).arg(fps, 0, 'f', 1).arg(directory));
+    });
+    connect(m_rangeExporter, &RangeExporter::exportFailed, this, [this](const QString &error) {
+        QMessageBox::critical(this, "Export Range", error);
+    });
+
+    m_watermarkVerifier = new WatermarkVerifier(this);
+    connect(m_watermarkVerifier, &WatermarkVerifier::progress, this, [this](int done, int total) {
+        m_statusBar->showMessage(QString("Verifying watermarks: %1/%2 files").arg(done).arg(total));
+    });
+    connect(m_watermarkVerifier, &WatermarkVerifier::finished, this,
+            [this](int files, int failedFiles, const QString &reportPath) {
+        const QString summary = QString("%1 of %2 files passed.\nReport: %3")
+                                .arg(files - failedFiles).arg(files).arg(reportPath);
+        m_statusBar->showMessage(QString("Watermark verification: %1 of %2 files passed").arg(files - failedFiles).arg(files));
+        if (failedFiles > 0) {
+            QMessageBox::warning(this, "Verify Watermarks", summary);
+        } else {
+            QMessageBox::information(this, "Verify Watermarks", summary);
+        }
+    });
+
+    m_thumbnailCache = new ThumbnailCache(this);
+    m_thumbnailPopup = new QLabel(this, Qt::ToolTip);
+    m_thumbnailPopup->setFrameStyle(QFrame::Box | QFrame::Plain);
+    m_thumbnailPopup->hide();
+
+    m_timeline = new TimelineIndex(this);
+    connect(m_timeline, &TimelineIndex::progress, this, [this](int done, int total) {
+        m_statusBar->showMessage(QString("Indexing recordings: %1 of %2").arg(done).arg(total));
+    });
+    connect(m_timeline, &TimelineIndex::ready, this, [this]() {
+        if (m_goToTimePending) {
+            m_goToTimePending = false;
+            askGoToTime();
+        }
+    });
+
     // Connect media player signals
     connect(m_mediaPlayer, &MediaPlayerWrapper::statusChanged, this, [this](int state) {
         qDebug() << "Media player status changed:" << state;
@@ -91,6 +175,24 @@ PlayerDialog::PlayerDialog(QWidget *parent)
         m_statusBar->showMessage("Error: " + error);
     });
 
+    // Files open on a worker; the window stays responsive meanwhile
+    connect(m_mediaPlayer, &MediaPlayerWrapper::fileOpened, this, &PlayerDialog::onFileOpened);
+    connect(m_mediaPlayer, &MediaPlayerWrapper::openProgress, this,
+            [this](const QString &filePath, int percent, const QString &stage) {
+        m_statusBar->showMessage(QString("Opening %1: %2 (%3%)").arg(QFileInfo(filePath).fileName()).arg(stage).arg(percent));
+    });
+    connect(m_mediaPlayer, &MediaPlayerWrapper::fileOpenFailed, this, [this](const QString &filePath) {
+        m_statusBar->showMessage(QString("Failed to open %1").arg(QFileInfo(filePath).fileName()));
+    });
+
+    connect(m_mediaPlayer, &MediaPlayerWrapper::snapshotSaved, this, [this](const QString &filePath) {
+        m_statusBar->showMessage(QString("Snapshot saved: %1").arg(filePath));
+    });
+    connect(m_mediaPlayer, &MediaPlayerWrapper::snapshotFailed, this, [this](const QString &error) {
+        QMessageBox::critical(this, "Snapshot", "Failed to take snapshot: " + error);
+        m_statusBar->showMessage("Snapshot failed");
+    });
+
     connect(m_mediaPlayer, &MediaPlayerWrapper::fileRefCreated, this, [this]() {
         qDebug()<<"File reference create success";
         m_fileReferenceCreated = true;
@@ -99,25 +201,59 @@ PlayerDialog::PlayerDialog(QWidget *parent)
     connect(m_watermarkDlg, &QDialog::finished, this, [this]() {
         m_actionWatermark->setEnabled(true);
     });
+
+    // Live sources share one socket-driven ingest thread
+    m_ingestReactor = new StreamIngestReactor(this);
+    m_ingestReactor->setStatisticsInterval(10000);
+
+    connect(m_ingestReactor, &StreamIngestReactor::sourceStarted, this, [this](int sourceId) {
+        if (sourceId != m_streamSourceId) {
+            return;
+        }
+        qDebug() << "Stream started";
+        m_statusBar->showMessage("Stream connected");
+        this->setWindowTitle(m_currentStreamUrl);
+
+        // Start playback
+        HWND displayWnd = m_videoDisplayWidget ?
+            reinterpret_cast<HWND>(m_videoDisplayWidget->winId()) :
+            reinterpret_cast<HWND>(winId());
+        m_mediaPlayer->play(displayWnd);
+        m_mediaPlayer->playSound();
+    });
+
+    connect(m_ingestReactor, &StreamIngestReactor::sourceError, this, [this](int sourceId, const QString &error) {
+        if (sourceId != m_streamSourceId) {
+            return;
+        }
+        qDebug() << "Stream error:" << error;
+        m_statusBar->showMessage("Stream error: " + error);
+        QMessageBox::warning(this, "Stream Error", error);
+    });
+
+    connect(m_ingestReactor, &StreamIngestReactor::sourceStopped, this, [this](int sourceId) {
+        if (sourceId != m_streamSourceId) {
+            return;
+        }
+        qDebug() << "Stream stopped";
+        m_statusBar->showMessage("Stream disconnected");
+    });
+
+    // Wall tiles get their own ports; live tiles share the ingest reactor
+    m_playerPool = new PlayerPool(m_ingestReactor, this);
+    connect(m_playerPool, &PlayerPool::sourceError, this, [this](int index, const QString &error) {
+        qDebug() << "Wall tile" << index + 1 << "error:" << error;
+        m_statusBar->showMessage(QString("Tile %1: %2").arg(index + 1).arg(error));
+    });
 }
 
 PlayerDialog::~PlayerDialog()
 {
-    if (m_playTimer) {
-        m_playTimer->stop();
-    }
-    
-    if (m_posTimer) {
-        m_posTimer->stop();
-    }
-    
-    if (m_rtspThread) {
-        m_rtspThread->stopStream();
-        m_rtspThread->wait(3000);
-        delete m_rtspThread;
-        m_rtspThread = nullptr;
-    }
+    stopLiveStream();
 
+    if (m_playerPool) {
+        m_playerPool->resize(0);
+    }
     if (m_mediaPlayer) {
         m_mediaPlayer->cleanup();
     }
@@ -170,6 +306,8 @@ void PlayerDialog::setupUI()
         connect(m_seekSlider, &QSlider::valueChanged, this, &PlayerDialog::onSliderValueChanged);
 
         m_seekSlider->installEventFilter(this);
+        // Hover previews need moves without a button held
+        m_seekSlider->setMouseTracking(true);
     }
 
     m_seekSliderClickable = false;
@@ -203,7 +341,11 @@ void PlayerDialog::setupUI()
             2.0f,        // 5: x2  (2.0x)
             4.0f,        // 6: x4  (4.0x)
             8.0f,        // 7: x8  (8.0x)
-            16.0f        // 8: x16 (16.0x)
+            16.0f,       // 8: x16 (16.0x) - I-frames only from here
+            32.0f,       // 9: x32 - fast scan, key frame jumps
+            64.0f,       // 10: x64
+            128.0f,      // 11: x128
+            256.0f       // 12: x256
         };
     m_currentSpeedIndex = 4;
 
@@ -214,6 +356,41 @@ void PlayerDialog::setupUI()
     statusBar()->addPermanentWidget(m_rightLabel);
     ui->videoLayout->addWidget(m_videoDisplayWidget);
     m_videoDisplayWidget->setStyleSheet("background-color:black;");
+
+    m_videoWall = new VideoWallWidget(this);
+    ui->videoLayout->addWidget(m_videoWall);
+    m_videoWall->hide();
+    connect(m_videoWall, &VideoWallWidget::tileSelected, this, [this](int index) {
+        m_statusBar->showMessage(QString("Tile %1 selected").arg(index + 1), 2000);
+    });
+
+    m_playlist = new PlaylistPlayer(this);
+    ui->videoLayout->addWidget(m_playlist);
+    m_playlist->hide();
+    connect(m_playlist, &PlaylistPlayer::segmentChanged, this, [this](int index, const QString &filePath) {
+        m_statusBar->showMessage(QString("Playing segment %1/%2: %3")
+                                 .arg(index + 1).arg(m_playlist->count()).arg(QFileInfo(filePath).fileName()));
+        setWindowTitle(filePath);
+    });
+    connect(m_playlist, &PlaylistPlayer::positionChanged, this, [this](qint64 positionMs, qint64 durationMs) {
+        if (durationMs > 0 && !m_sliderDragging) {
+            m_seekSlider->setValue(static_cast<int>(positionMs * 10000 / durationMs));
+        }
+        m_rightLabel->setText(QString("Segment: %1/%2  ,  Time: %3/%4")
+                              .arg(m_playlist->currentIndex() + 1)
+                              .arg(m_playlist->count())
+                              .arg(formatTime(positionMs / 1000))
+                              .arg(formatTime(durationMs / 1000)));
+    });
+    connect(m_playlist, &PlaylistPlayer::stateChanged, this, [this]() {
+        updateButtonStates();
+    });
+    connect(m_playlist, &PlaylistPlayer::finished, this, [this]() {
+        m_statusBar->showMessage("Playlist finished");
+    });
+    connect(m_playlist, &PlaylistPlayer::errorOccurred, this, [this](const QString &error) {
+        m_statusBar->showMessage("Error: " + error);
+    });
 }
 
 void PlayerDialog::onPlayClicked()
@@ -223,6 +400,15 @@ void PlayerDialog::onPlayClicked()
     if (!m_mediaPlayer) {
         return;
     }
+
+    if (isPlaylistActive()) {
+        if (m_playlist->isPaused()) {
+            m_playlist->resume();
+        } else {
+            m_playlist->pause();
+        }
+        return;
+    }
     
     // If no file is opened, show file dialog
 //    if (!m_mediaPlayer->isFileOpened()) {
@@ -245,7 +431,6 @@ void PlayerDialog::onPlayClicked()
         if (m_mediaPlayer->resume()) {
 //            m_playButton->setText("⏸ Pause");
             m_mediaPlayer->playSound();
-            m_posTimer->start(200);
         }
     } else if (!m_mediaPlayer->isStep() && !m_mediaPlayer->isPlaying()) {
         // Start playing - use video display widget for rendering
@@ -258,8 +443,6 @@ void PlayerDialog::onPlayClicked()
             m_watermarkDlg->m_setTimer(true);
 //            adjustWindowSize();
 //            if (m_playButton) m_playButton->setText("⏸ Pause");
-            m_playTimer->start(500); // Start status update timer
-            m_posTimer->start(200);  // Start position update timer
         }
     }else if(m_mediaPlayer->isStep()){
         m_mediaPlayer->play();
@@ -271,7 +454,6 @@ void PlayerDialog::onPlayClicked()
         if (m_mediaPlayer->pause()) {
             m_mediaPlayer->stopSound();
 //            m_playButton->setText("▶ Resume");
-            m_posTimer->stop();
         }
     }
 }
@@ -279,12 +461,16 @@ void PlayerDialog::onPlayClicked()
 void PlayerDialog::onPauseClicked()
 {
     qDebug() << "Pause clicked";
+
+    if (isPlaylistActive()) {
+        m_playlist->pause();
+        return;
+    }
     
     if (m_mediaPlayer && m_mediaPlayer->isPlaying()) {
         if (m_mediaPlayer->pause()) {
             m_mediaPlayer->stopSound();
 //            m_playButton->setText("▶ Resume");
-            m_posTimer->stop();
         }
     }
 }
@@ -294,39 +480,24 @@ void PlayerDialog::onStopClicked()
     qDebug() << "Stop clicked";
 
     // Stop RTSP stream if active
-    if (m_rtspThread) {
-        m_rtspThread->stopStream();
-        m_rtspThread->wait(3000);
-        delete m_rtspThread;
-        m_rtspThread = nullptr;
-    }
+    stopLiveStream();
+    closePlaylist();
+    m_pendingSeekMs = -1;
 
     if (m_mediaPlayer) {
+        m_mediaPlayer->cancelPendingOpen();
         m_mediaPlayer->stopSound();
         if (m_mediaPlayer->isStreamMode()) {
             m_mediaPlayer->closeStream();
         } else {
             m_mediaPlayer->stop();
         }
-        m_playTimer->stop();
-        m_posTimer->stop();
         m_watermarkDlg->m_setTimer(false);
 //        m_playButton->setText("▶ Play");
         m_seekSlider->setValue(0);
     }
 }
 
-void PlayerDialog::setupTimers()
-{
-    // Create timer matching original SetTimer(PLAY_TIMER, 500, NULL)
-    m_playTimer = new QTimer(this);
-    connect(m_playTimer, &QTimer::timeout, this, &PlayerDialog::onTimerUpdate);
-    
-    // Create position update timer (200ms as requested)
-    m_posTimer = new QTimer(this);
-    connect(m_posTimer, &QTimer::timeout, this, &PlayerDialog::updatePosition);
-}
-
 void PlayerDialog::setupMenus()
 {
     // Create menu bar
@@ -341,6 +512,8 @@ void PlayerDialog::setupMenus()
 
     connect(m_actionOpen, &QAction::triggered, this, &PlayerDialog::onActionOpen);
     connect(m_actionOpenURL, &QAction::triggered, this, &PlayerDialog::onActionOpenURL);
+    connect(ui->actionOpenFolder, &QAction::triggered, this, &PlayerDialog::onActionOpenFolder);
+    connect(ui->actionGoToTime, &QAction::triggered, this, &PlayerDialog::onActionGoToTime);
     connect(m_actionExit, &QAction::triggered, this, &PlayerDialog::onActionExit);
     connect(m_actionSetPath, &QAction::triggered, this, &PlayerDialog::onActionSetPath);
     connect(m_actionAbout, &QAction::triggered, this, &PlayerDialog::onAcionAbout);
@@ -351,6 +524,37 @@ void PlayerDialog::setupMenus()
     m_actionGroupPicFormat->addAction(ui->actionJPEG);
     m_actionGroupPicFormat->setExclusive(true);
     ui->actionBMP->setChecked(true);
+
+    m_actionGroupWallLayout = new QActionGroup(this);
+    const QList<QPair<QAction *, int> > wallLayouts = {
+        qMakePair(ui->actionWall1x1, 1),
+        qMakePair(ui->actionWall2x2, 4),
+        qMakePair(ui->actionWall3x3, 9),
+        qMakePair(ui->actionWall4x4, 16),
+        qMakePair(ui->actionWall6x6, 36),
+        qMakePair(ui->actionWall8x8, 64)
+    };
+    for (const QPair<QAction *, int> &layout : wallLayouts) {
+        layout.first->setData(layout.second);
+        m_actionGroupWallLayout->addAction(layout.first);
+    }
+    m_actionGroupWallLayout->setExclusive(true);
+    ui->actionWall1x1->setChecked(true);
+    connect(m_actionGroupWallLayout, &QActionGroup::triggered, this, &PlayerDialog::onWallLayoutTriggered);
+    connect(ui->actionWallOpen, &QAction::triggered, this, &PlayerDialog::onActionWallOpen);
+    connect(ui->actionWallFill, &QAction::triggered, this, &PlayerDialog::onActionWallFill);
+    connect(ui->actionBurstCapture, &QAction::triggered, this, &PlayerDialog::onActionBurstCapture);
+    connect(ui->actionIntervalCapture, &QAction::triggered, this, &PlayerDialog::onActionIntervalCapture);
+    connect(ui->actionExportRange, &QAction::triggered, this, &PlayerDialog::onActionExportRange);
+    connect(ui->actionVerifyWatermarks, &QAction::triggered, this, &PlayerDialog::onActionVerifyWatermarks);
+
+    // Off releases the idle ports, to compare open-to-first-frame times
+    connect(ui->actionPortPool, &QAction::toggled, this, [](bool checked) {
+        PortPool::instance()->setEnabled(checked);
+        if (checked) {
+            PortPool::instance()->prewarm(4);
+        }
+    });
     
     // Add actions to File menu
 //    fileMenu->addAction(m_actionOpen);
@@ -375,10 +579,13 @@ void PlayerDialog::setupMenus()
 //    m_menuBar->addMenu("Help");
 }
 
-void PlayerDialog::onTimerUpdate()
+void PlayerDialog::onPlaybackStateChanged(MediaPlayerWrapper *player, const PlaybackState &state)
 {
-    // Call the wrapper function to maintain compatibility
-    OnTimer(PLAY_TIMER);
+    if (player != m_mediaPlayer) {
+        return;
+    }
+    DrawStatus(state);
+    updatePosition(state);
 }
 
 // Qt event handlers
@@ -444,6 +651,12 @@ void PlayerDialog::resizeEvent(QResizeEvent *event)
 {
     OnSize(0, event->size().width(), event->size().height());
     m_videoDisplayWidget->resize(event->size().width()-20, event->size().height()-110);
+    if (m_videoWall) {
+        m_videoWall->resize(m_videoDisplayWidget->size());
+    }
+    if (m_playlist) {
+        m_playlist->resize(m_videoDisplayWidget->size());
+    }
     QMainWindow::resizeEvent(event);
 }
 
@@ -473,6 +686,13 @@ void PlayerDialog::dropEvent(QDropEvent *event)
 
 bool PlayerDialog::eventFilter(QObject *obj, QEvent *event)
 {
+    if (obj == m_seekSlider) {
+        if (event->type() == QEvent::MouseMove) {
+            showSeekThumbnail(static_cast<QMouseEvent*>(event)->pos());
+        } else if (event->type() == QEvent::Leave || event->type() == QEvent::Hide) {
+            m_thumbnailPopup->hide();
+        }
+    }
     if (obj == m_seekSlider && m_seekSliderClickable) {
         if (event->type() == QEvent::MouseButtonPress) {
             QMouseEvent *mouseEvent = static_cast<QMouseEvent*>(event);
@@ -482,11 +702,14 @@ bool PlayerDialog::eventFilter(QObject *obj, QEvent *event)
                 m_seekSlider->setValue(sliderValue);
 
                 // 立即執行跳轉
-                if (m_mediaPlayer && m_mediaPlayer->isFileOpened()) {
+                if (isPlaylistActive()) {
+                    m_playlist->seek(sliderValue * m_playlist->duration() / 10000);
+                } else if (m_mediaPlayer && m_mediaPlayer->isFileOpened()) {
                     qint64 totalPos = m_mediaPlayer->duration();
                     if (totalPos > 0) {
-                        qint64 newPos = (sliderValue * totalPos) / 10000;  // 使用新的範圍
-                        m_mediaPlayer->seekMs(newPos);
+                        // duration() is in seconds; seek on the millisecond timeline
+                        qint64 newPosMs = (sliderValue * totalPos * 1000) / 10000;  // 使用新的範圍
+                        m_mediaPlayer->seekToTime(newPosMs);
 //                        m_statusBar->showMessage(QString("Seeking to: %1%").arg(sliderValue / 100.0, 0, 'f', 1), 1000);
                     }
                 }
@@ -500,8 +723,9 @@ bool PlayerDialog::eventFilter(QObject *obj, QEvent *event)
 // Wrapper functions matching original MFC names
 void PlayerDialog::OnTimer(int nIDEvent)
 {
-    if (nIDEvent == PLAY_TIMER) {
-        DrawStatus();
+    if (nIDEvent == PLAY_TIMER && m_mediaPlayer) {
+        PlaybackClock::instance()->refresh(m_mediaPlayer);
+        DrawStatus(PlaybackClock::instance()->state(m_mediaPlayer));
     }
 }
 
@@ -552,53 +776,32 @@ void PlayerDialog::OnDropFiles(const QStringList &files)
     if (files.isEmpty() || !m_mediaPlayer) {
         return;
     }
+
+    // Several files, or a folder, are the segments of one recording
+    if (files.size() > 1) {
+        startPlaylist(files);
+        return;
+    }
+    if (QFileInfo(files.first()).isDir()) {
+        startPlaylist(PlaylistPlayer::segmentsInDirectory(files.first()));
+        return;
+    }
+    closePlaylist();
+    m_pendingSeekMs = -1;
     
     // Stop current playback if any
+    stopLiveStream();
     if (m_mediaPlayer->isPlaying() || m_mediaPlayer->isStep()) {
         m_mediaPlayer->stopSound();
         m_mediaPlayer->stop();
         m_watermarkDlg->m_setTimer(false);
-        m_playTimer->stop();
     }
     
-    // Open the first dropped file
+    // Open the first dropped file; playback starts from onFileOpened()
     QString filePath = files.first();
-    if (m_mediaPlayer->openFile(filePath)) {
-        QFileInfo fileInfo(filePath);
-        QString status = QString("Playing: %1").arg(fileInfo.fileName());
-        m_statusBar->showMessage(status);
-        qDebug() << "Opened dropped file:" << filePath;
-        this->setWindowTitle(filePath);
-        
-        if (m_seekSlider) {
-            m_seekSlider->setValue(0);
-        }
-
-        // Reset volume to 80
-        if (m_volSlider) {
-            m_volSlider->setValue(80);
-            onVolumeChanged(80);
-        }
-
-        //Reset play speed
-        m_currentSpeedIndex = 4;
-        m_mediaPlayer->setPlaySpeed(1.0f);
-        
-        // Auto-play the dropped file
-        HWND displayWnd = m_videoDisplayWidget ? 
-            reinterpret_cast<HWND>(m_videoDisplayWidget->winId()) : 
-            reinterpret_cast<HWND>(winId());
-        m_mediaPlayer->play(displayWnd);
-        m_mediaPlayer->playSound();
-        adjustWindowSize();
-        m_watermarkDlg->m_setTimer(true);
-        if(!m_watermarkDlg->isVisible())
-            m_actionWatermark->setEnabled(true);
-        m_playTimer->start(500);
-        m_posTimer->start(200);
-    } else {
-        m_statusBar->showMessage("Failed to open dropped file");
-    }
+    m_fileReferenceCreated = false;
+    m_statusBar->showMessage(QString("Opening: %1").arg(QFileInfo(filePath).fileName()));
+    m_mediaPlayer->openFileAsync(filePath);
 }
 
 void PlayerDialog::OnClose()
@@ -613,24 +816,17 @@ void PlayerDialog::OnDestroy()
     // Original implementation performed final cleanup
 }
 
-void PlayerDialog::DrawStatus()
+void PlayerDialog::DrawStatus(const PlaybackState &state)
 {
-    if (!m_mediaPlayer || (!m_mediaPlayer->isPlaying() && !m_mediaPlayer->isStep())) {
+    if (state.playState != MediaPlayerWrapper::Playing && state.playState != MediaPlayerWrapper::Step) {
         return;
     }
     
-    // Get playback information
-    DWORD currentFrame = m_mediaPlayer->getCurrentFrameNum();
-    DWORD totalFrame = m_mediaPlayer->getTotalFrames();
-
-    DWORD playedTime = m_mediaPlayer->getPlayedTime();
-    DWORD totalTime = m_mediaPlayer->getFileTime();
-    
     QString sRightText = QString("Pos: %1/%2  ,  Time: %3/%4")
-        .arg(currentFrame)
-        .arg(totalFrame)
-        .arg(formatTime(playedTime))
-        .arg(formatTime(totalTime));
+        .arg(state.frameNum)
+        .arg(state.totalFrames)
+        .arg(formatTime(state.playedSeconds))
+        .arg(formatTime(state.totalSeconds));
     
     m_rightLabel->setText(sRightText);
     // Update UI elements here (progress bar, time display, etc.)
@@ -642,11 +838,17 @@ void PlayerDialog::updateButtonStates()
     if (!m_mediaPlayer) {
         return;
     }
+
+    // In a playlist the buttons follow the segment on screen
+    MediaPlayerWrapper *player = m_mediaPlayer;
+    if (isPlaylistActive() && m_playlist->currentPlayer()) {
+        player = m_playlist->currentPlayer();
+    }
     
-    bool isPlaying = m_mediaPlayer->isPlaying();
-    bool isPaused = m_mediaPlayer->isPaused();
-    bool isStep = m_mediaPlayer->isStep();
-    bool isStop = m_mediaPlayer->isStop();
+    bool isPlaying = player->isPlaying();
+    bool isPaused = player->isPaused();
+    bool isStep = player->isStep();
+    bool isStop = player->isStop();
     
     // Update button enabled states
     if(isStep)
@@ -668,17 +870,15 @@ void PlayerDialog::updateButtonStates()
     m_seekSlider->setEnabled(m_seekSliderClickable);
 }
 
-void PlayerDialog::updatePosition()
+void PlayerDialog::updatePosition(const PlaybackState &state)
 {
-    if (!m_mediaPlayer || !m_mediaPlayer->isFileOpened() || m_sliderDragging) {
+    // A paused slider stays where the user left it
+    if (state.playState != MediaPlayerWrapper::Playing || !m_mediaPlayer->isFileOpened() || m_sliderDragging) {
         return;
     }
     
-    qint64 currentPos = m_mediaPlayer->position();
-    qint64 totalPos = m_mediaPlayer->duration();
-    
-    if (totalPos > 0) {
-        int sliderValue = (int)((currentPos * 10000) / totalPos);
+    if (state.totalSeconds > 0) {
+        int sliderValue = (int)((qint64(state.playedSeconds) * 10000) / state.totalSeconds);
         m_seekSlider->setValue(sliderValue);
     }
 }
@@ -686,11 +886,16 @@ void PlayerDialog::updatePosition()
 void PlayerDialog::onSliderPressed()
 {
     m_sliderDragging = true;
-    m_posTimer->stop();
 }
 
 void PlayerDialog::onSliderReleased()
 {
+    if (isPlaylistActive()) {
+        m_playlist->seek(m_seekSlider->value() * m_playlist->duration() / 10000);
+        m_sliderDragging = false;
+        return;
+    }
+
     if (!m_mediaPlayer || !m_mediaPlayer->isFileOpened()) {
         m_sliderDragging = false;
         return;
@@ -699,14 +904,11 @@ void PlayerDialog::onSliderReleased()
     qint64 totalPos = m_mediaPlayer->duration();
     if (totalPos > 0) {
         int sliderValue = m_seekSlider->value();
-        qint64 newPos = (sliderValue * totalPos) / 10000;
-        m_mediaPlayer->seekMs(newPos);
+        qint64 newPosMs = (sliderValue * totalPos * 1000) / 10000;
+        m_mediaPlayer->seekToTime(newPosMs);
     }
     
     m_sliderDragging = false;
-    if (m_mediaPlayer->isPlaying()) {
-        m_posTimer->start(200);
-    }
 }
 
 void PlayerDialog::onSliderValueChanged(int value)
@@ -732,53 +934,59 @@ void PlayerDialog::onActionOpen()
     if (fileName.isEmpty()) {
         return;
     }
+    closePlaylist();
+    m_pendingSeekMs = -1;
     
     // Stop current playback if any
+    stopLiveStream();
     if (m_mediaPlayer->isPlaying() || m_mediaPlayer->isStep()) {
         m_mediaPlayer->stopSound();
         m_mediaPlayer->stop();
         m_watermarkDlg->m_setTimer(false);
-        m_playTimer->stop();
-        m_posTimer->stop();
     }
     
-    // Open the file
-    if (m_mediaPlayer->openFile(fileName)) {
-        QFileInfo fileInfo(fileName);
-        QString status = QString("Loaded: %1").arg(fileInfo.fileName());
-        m_statusBar->showMessage(status);
-        qDebug() << "Opened file:" << fileName;
-        this->setWindowTitle(fileName);
-        
-        // Reset UI
-        if (m_seekSlider) m_seekSlider->setValue(0);
-        
-        // Reset volume to 80
-        if (m_volSlider) {
-            m_volSlider->setValue(80);
-            // Trigger volume change to sync with media player
-            onVolumeChanged(80);
-        }
+    // Open the file; playback starts from onFileOpened()
+    m_fileReferenceCreated = false;
+    m_statusBar->showMessage(QString("Opening: %1").arg(QFileInfo(fileName).fileName()));
+    m_mediaPlayer->openFileAsync(fileName);
+}
 
-        //Reset play speed
-        m_currentSpeedIndex = 4;
-        m_mediaPlayer->setPlaySpeed(1.0f);
+void PlayerDialog::onFileOpened(const QString &filePath)
+{
+    QFileInfo fileInfo(filePath);
+    QString status = QString("Playing: %1").arg(fileInfo.fileName());
+    m_statusBar->showMessage(status);
+    qDebug() << "Opened file:" << filePath;
+    this->setWindowTitle(filePath);
 
-        HWND displayWnd = m_videoDisplayWidget ?
-            reinterpret_cast<HWND>(m_videoDisplayWidget->winId()) :
-            reinterpret_cast<HWND>(winId());
-        m_mediaPlayer->play(displayWnd);
-        m_mediaPlayer->playSound();
-        adjustWindowSize();
-        m_watermarkDlg->m_setTimer(true);
-        if(!m_watermarkDlg->isVisible())
-            m_actionWatermark->setEnabled(true);
-        m_playTimer->start(500);
-        m_posTimer->start(200);
+    // Reset UI
+    if (m_seekSlider) m_seekSlider->setValue(0);
+    m_thumbnailCache->open(filePath);
 
-    } else {
-        m_statusBar->showMessage("Failed to open file");
+    // Reset volume to 80
+    if (m_volSlider) {
+        m_volSlider->setValue(80);
+        // Trigger volume change to sync with media player
+        onVolumeChanged(80);
     }
+
+    //Reset play speed
+    m_currentSpeedIndex = 4;
+    m_mediaPlayer->setPlaySpeed(1.0f);
+
+    HWND displayWnd = m_videoDisplayWidget ?
+        reinterpret_cast<HWND>(m_videoDisplayWidget->winId()) :
+        reinterpret_cast<HWND>(winId());
+    m_mediaPlayer->play(displayWnd);
+    m_mediaPlayer->playSound();
+    if (m_pendingSeekMs >= 0) {
+        m_mediaPlayer->seekToTime(m_pendingSeekMs);
+        m_pendingSeekMs = -1;
+    }
+    adjustWindowSize();
+    m_watermarkDlg->m_setTimer(true);
+    if(!m_watermarkDlg->isVisible())
+        m_actionWatermark->setEnabled(true);
 }
 
 void PlayerDialog::onActionOpenURL()
@@ -792,7 +1000,7 @@ void PlayerDialog::onActionOpenURL()
     bool ok;
     QString url = QInputDialog::getText(this,
         "Open URL",
-        "Enter RTSP/HTTP stream URL:",
+        "Enter RTSP stream URL:",
         QLineEdit::Normal,
         m_currentStreamUrl.isEmpty() ? "rtsp://" : m_currentStreamUrl,
         &ok);
@@ -802,19 +1010,13 @@ void PlayerDialog::onActionOpenURL()
     }
 
     // Stop current playback if any
-    if (m_rtspThread) {
-        m_rtspThread->stopStream();
-        m_rtspThread->wait(3000);
-        delete m_rtspThread;
-        m_rtspThread = nullptr;
-    }
+    stopLiveStream();
+    closePlaylist();
 
     if (m_mediaPlayer->isPlaying() || m_mediaPlayer->isStep()) {
         m_mediaPlayer->stopSound();
         m_mediaPlayer->stop();
         m_watermarkDlg->m_setTimer(false);
-        m_playTimer->stop();
-        m_posTimer->stop();
     }
 
     m_currentStreamUrl = url;
@@ -827,35 +1029,231 @@ void PlayerDialog::onActionOpenURL()
         return;
     }
 
-    // Create and start RTSP thread
-    m_rtspThread = new RtspStreamThread(m_mediaPlayer, url, this);
+    // Hand the source to the ingest reactor
+    m_streamSourceId = m_ingestReactor->addSource(m_mediaPlayer, url);
+    if (m_streamSourceId < 0) {
+        m_statusBar->showMessage("Failed to start stream");
+    }
+}
 
-    connect(m_rtspThread, &RtspStreamThread::streamStarted, this, [this]() {
-        qDebug() << "Stream started";
-        m_statusBar->showMessage("Stream connected");
-        this->setWindowTitle(m_currentStreamUrl);
+void PlayerDialog::onActionOpenFolder()
+{
+    const QString dir = QFileDialog::getExistingDirectory(this,
+                    "Open Segment Folder",
+                    QString(),
+                    QFileDialog::ShowDirsOnly | QFileDialog::DontResolveSymlinks);
+    if (dir.isEmpty()) {
+        return;
+    }
 
-        // Start playback
-        HWND displayWnd = m_videoDisplayWidget ?
-            reinterpret_cast<HWND>(m_videoDisplayWidget->winId()) :
-            reinterpret_cast<HWND>(winId());
-        m_mediaPlayer->play(displayWnd);
-        m_mediaPlayer->playSound();
-        m_playTimer->start(500);
-    });
+    const QStringList files = PlaylistPlayer::segmentsInDirectory(dir);
+    if (files.isEmpty()) {
+        QMessageBox::warning(this, "Open Folder", "No media files in " + dir);
+        return;
+    }
+    startPlaylist(files);
+}
 
-    connect(m_rtspThread, &RtspStreamThread::streamError, this, [this](const QString &error) {
-        qDebug() << "Stream error:" << error;
-        m_statusBar->showMessage("Stream error: " + error);
-        QMessageBox::warning(this, "Stream Error", error);
-    });
+void PlayerDialog::startPlaylist(const QStringList &files)
+{
+    if (files.isEmpty()) {
+        return;
+    }
+    if (!m_videoWall->isHidden()) {
+        m_statusBar->showMessage("Switch the wall layout back to 1x1 to play a playlist");
+        return;
+    }
 
-    connect(m_rtspThread, &RtspStreamThread::streamStopped, this, [this]() {
-        qDebug() << "Stream stopped";
-        m_statusBar->showMessage("Stream disconnected");
-    });
+    // The single player hands the display area over to the playlist
+    onStopClicked();
+    m_thumbnailPopup->hide();
+    m_videoDisplayWidget->hide();
+    m_playlist->resize(m_videoDisplayWidget->size());
+    m_playlist->show();
+
+    m_statusBar->showMessage(QString("Opening playlist of %1 files").arg(files.size()));
+    if (!m_playlist->open(files)) {
+        closePlaylist();
+    }
+}
+
+void PlayerDialog::closePlaylist()
+{
+    if (!m_playlist || m_playlist->isHidden()) {
+        return;
+    }
+    m_playlist->stop();
+    m_playlist->hide();
+    m_videoDisplayWidget->show();
+    updateButtonStates();
+}
+
+bool PlayerDialog::isPlaylistActive() const
+{
+    return m_playlist && m_playlist->isActive();
+}
 
-    m_rtspThread->start();
+void PlayerDialog::onActionGoToTime()
+{
+    const QString dir = QFileDialog::getExistingDirectory(this,
+                    "Recordings Folder",
+                    m_timeline->directory(),
+                    QFileDialog::ShowDirsOnly | QFileDialog::DontResolveSymlinks);
+    if (dir.isEmpty()) {
+        return;
+    }
+
+    // Only new or changed files are opened; ready() may come at once
+    m_goToTimePending = true;
+    if (!m_timeline->open(dir)) {
+        m_goToTimePending = false;
+        QMessageBox::warning(this, "Go to Time", "Cannot read " + dir);
+    }
+}
+
+void PlayerDialog::askGoToTime()
+{
+    const QVector<int> channels = m_timeline->channels();
+    if (channels.isEmpty()) {
+        QMessageBox::warning(this, "Go to Time", "No recordings with a device time in " + m_timeline->directory());
+        return;
+    }
+
+    QStringList cameras;
+    for (int channel : channels) {
+        cameras << QString("Camera %1").arg(channel);
+    }
+    bool ok = false;
+    const QString camera = QInputDialog::getItem(this, "Go to Time", "Camera:", cameras, 0, false, &ok);
+    if (!ok) {
+        return;
+    }
+    const int channel = channels.at(cameras.indexOf(camera));
+
+    const QString format = "yyyy-MM-dd HH:mm:ss";
+    const QString text = QInputDialog::getText(this, "Go to Time",
+        QString("Time (%1 .. %2):").arg(m_timeline->firstTime(channel).toString(format))
+                                   .arg(m_timeline->lastTime(channel).toString(format)),
+        QLineEdit::Normal, m_timeline->firstTime(channel).toString(format), &ok);
+    if (!ok) {
+        return;
+    }
+    const QDateTime time = QDateTime::fromString(text.trimmed(), format);
+    if (!time.isValid()) {
+        QMessageBox::warning(this, "Go to Time", "Enter the time as " + format);
+        return;
+    }
+
+    TimelineIndex::Location location;
+    if (!m_timeline->locate(channel, time, &location)) {
+        QMessageBox::warning(this, "Go to Time", QString("Camera %1 has no recording at or after %2")
+                             .arg(channel).arg(time.toString(format)));
+        return;
+    }
+    qDebug() << "Go to" << time << "camera" << channel << "->" << location.filePath << location.offsetMs << "ms";
+
+    closePlaylist();
+    if (m_mediaPlayer->isFileOpened() && m_mediaPlayer->currentFile() == location.filePath) {
+        m_mediaPlayer->seekToTime(location.offsetMs);
+    } else {
+        stopLiveStream();
+        if (m_mediaPlayer->isPlaying() || m_mediaPlayer->isStep()) {
+            m_mediaPlayer->stopSound();
+            m_mediaPlayer->stop();
+            m_watermarkDlg->m_setTimer(false);
+        }
+        // Playback and the seek start from onFileOpened()
+        m_fileReferenceCreated = false;
+        m_pendingSeekMs = location.offsetMs;
+        m_mediaPlayer->openFileAsync(location.filePath);
+    }
+    if (!location.exact) {
+        m_statusBar->showMessage("Nothing recorded at that time; jumped to the next recording", 5000);
+    }
+}
+
+void PlayerDialog::stopLiveStream()
+{
+    if (m_ingestReactor && m_streamSourceId >= 0) {
+        m_ingestReactor->removeSource(m_streamSourceId);
+        m_streamSourceId = -1;
+    }
+}
+
+void PlayerDialog::onWallLayoutTriggered(QAction *action)
+{
+    const int tiles = action->data().toInt();
+    const bool wallMode = tiles > 1;
+
+    if (wallMode && m_videoWall->isHidden()) {
+        // The single player hands the display area over to the wall
+        onStopClicked();
+        m_videoDisplayWidget->hide();
+        m_videoWall->show();
+    }
+
+    // Shrink the pool before its tiles' windows go away
+    m_playerPool->resize(wallMode ? tiles : 0);
+    m_videoWall->setTileCount(wallMode ? tiles : 1);
+    m_playerPool->setStatisticsInterval(wallMode ? 5000 : 0);
+
+    if (!wallMode) {
+        m_videoWall->hide();
+        m_videoDisplayWidget->show();
+    }
+
+    ui->actionWallOpen->setEnabled(wallMode);
+    ui->actionWallFill->setEnabled(wallMode);
+    m_statusBar->showMessage(wallMode ? QString("Video wall: %1 tiles").arg(tiles) : QString("Ready"));
+}
+
+void PlayerDialog::onActionWallOpen()
+{
+    const int index = m_videoWall->selectedTile();
+    if (index < 0) {
+        return;
+    }
+
+    bool ok;
+    QString source = QInputDialog::getText(this,
+        "Open On Tile",
+        QString("File path or RTSP URL for tile %1:").arg(index + 1),
+        QLineEdit::Normal,
+        m_lastWallSource.isEmpty() ? "rtsp://" : m_lastWallSource,
+        &ok);
+    if (!ok || source.isEmpty()) {
+        return;
+    }
+
+    m_lastWallSource = source;
+    if (!m_playerPool->openSource(index, source, m_videoWall->tileWindow(index))) {
+        m_statusBar->showMessage(QString("Tile %1: failed to open source").arg(index + 1));
+    }
+}
+
+void PlayerDialog::onActionWallFill()
+{
+    // Same source on every tile; with the 5 s wall statistics log this is the
+    // load test for a growing grid.
+    bool ok;
+    QString source = QInputDialog::getText(this,
+        "Fill Wall",
+        "File path or RTSP URL for all tiles:",
+        QLineEdit::Normal,
+        m_lastWallSource.isEmpty() ? "rtsp://" : m_lastWallSource,
+        &ok);
+    if (!ok || source.isEmpty()) {
+        return;
+    }
+
+    m_lastWallSource = source;
+    int opened = 0;
+    for (int i = 0; i < m_videoWall->tileCount(); ++i) {
+        if (m_playerPool->openSource(i, source, m_videoWall->tileWindow(i))) {
+            ++opened;
+        }
+    }
+    m_statusBar->showMessage(QString("Opened %1 of %2 tiles").arg(opened).arg(m_videoWall->tileCount()));
 }
 
 void PlayerDialog::onActionExit()
@@ -875,6 +1273,113 @@ void PlayerDialog::onActionSetPath()
         m_SnapPath = dir;
 }
 
+void PlayerDialog::onActionBurstCapture()
+{
+    if (!m_mediaPlayer->isFileOpened() && !m_mediaPlayer->isStreamOpened()) {
+        QMessageBox::warning(this, "Burst Capture", "No media is currently playing.");
+        return;
+    }
+    if (m_burstCapture->isActive()) {
+        m_burstCapture->cancel();
+        return;
+    }
+
+    bool ok = false;
+    const int frames = QInputDialog::getInt(this, "Burst Capture", "Consecutive frames to capture:",
+                                            50, 1, 10000, 1, &ok);
+    if (!ok) {
+        return;
+    }
+
+    const int format = (m_actionGroupPicFormat->checkedAction() == ui->actionJPEG) ? BurstCapture::Jpeg : BurstCapture::Bmp;
+    if (!m_burstCapture->startBurst(m_SnapPath, frames, format)) {
+        QMessageBox::critical(this, "Burst Capture", "Failed to start capture.");
+    }
+}
+
+void PlayerDialog::onActionIntervalCapture()
+{
+    if (!m_mediaPlayer->isFileOpened() && !m_mediaPlayer->isStreamOpened()) {
+        QMessageBox::warning(this, "Interval Capture", "No media is currently playing.");
+        return;
+    }
+    if (m_burstCapture->isActive()) {
+        m_burstCapture->cancel();
+        return;
+    }
+
+    bool ok = false;
+    const int intervalMs = QInputDialog::getInt(this, "Interval Capture", "One frame every (ms):",
+                                                500, 1, 3600000, 10, &ok);
+    if (!ok) {
+        return;
+    }
+    const int durationSec = QInputDialog::getInt(this, "Interval Capture", "For a range of (seconds):",
+                                                 10, 1, 86400, 1, &ok);
+    if (!ok) {
+        return;
+    }
+
+    const int format = (m_actionGroupPicFormat->checkedAction() == ui->actionJPEG) ? BurstCapture::Jpeg : BurstCapture::Bmp;
+    if (!m_burstCapture->startInterval(m_SnapPath, intervalMs, durationSec * 1000, format)) {
+        QMessageBox::critical(this, "Interval Capture", "Failed to start capture.");
+    }
+}
+
+void PlayerDialog::onActionExportRange()
+{
+    if (m_rangeExporter->isActive()) {
+        m_rangeExporter->cancel();
+        return;
+    }
+    if (!m_mediaPlayer->isFileOpened() || m_mediaPlayer->isStreamMode()) {
+        QMessageBox::warning(this, "Export Range", "Open a recording first.");
+        return;
+    }
+
+    const int durationSec = static_cast<int>(m_mediaPlayer->duration());
+    bool ok = false;
+    const int startSec = QInputDialog::getInt(this, "Export Range", "From (seconds):",
+                                              static_cast<int>(m_mediaPlayer->position()), 0, durationSec, 1, &ok);
+    if (!ok) {
+        return;
+    }
+    const int endSec = QInputDialog::getInt(this, "Export Range", "To (seconds):",
+                                            qMin(startSec + 10, durationSec), startSec, durationSec, 1, &ok);
+    if (!ok) {
+        return;
+    }
+
+    // JPEG as selected for snapshots, otherwise the lossless PNG
+    const int format = (m_actionGroupPicFormat->checkedAction() == ui->actionJPEG) ? RangeExporter::Jpeg : RangeExporter::Png;
+    const QString filePath = m_mediaPlayer->currentFile();
+    const QString directory = QString("%1/%2_%3-%4s").arg(m_SnapPath, QFileInfo(filePath).completeBaseName())
+                              .arg(startSec).arg(endSec);
+    if (!m_rangeExporter->start(filePath, startSec * 1000LL, endSec * 1000LL, directory, format)) {
+        QMessageBox::critical(this, "Export Range", "Failed to start the export.");
+    }
+}
+
+void PlayerDialog::onActionVerifyWatermarks()
+{
+    if (m_watermarkVerifier->isActive()) {
+        m_watermarkVerifier->cancel();
+        return;
+    }
+
+    const QStringList files = QFileDialog::getOpenFileNames(this,
+        "Verify Watermarks",
+        QString(),
+        "Media Files (*.mp4 *.avi *.mkv *.264 *.h264);;All Files (*.*)");
+    if (files.isEmpty()) {
+        return;
+    }
+
+    const QString reportPath = QString("%1/watermark_report_%2.txt").arg(m_SnapPath)
+                               .arg(QDateTime::currentDateTime().toString("yyyyMMddhhmmss"));
+    m_watermarkVerifier->start(files, reportPath);
+}
+
 void PlayerDialog::onAcionAbout()
 {
     qDebug() << "Action About triggered";
@@ -966,6 +1471,30 @@ int PlayerDialog::calculateSliderValueFromPosition(const QPoint &pos)
     return qBound(m_seekSlider->minimum(), value, m_seekSlider->maximum());
 }
 
+void PlayerDialog::showSeekThumbnail(const QPoint &pos)
+{
+    // Only previews of the file being played
+    if (!m_seekSliderClickable || !m_mediaPlayer || !m_mediaPlayer->isFileOpened()
+        || m_mediaPlayer->currentFile() != m_thumbnailCache->filePath()) {
+        m_thumbnailPopup->hide();
+        return;
+    }
+
+    const qint64 totalPos = m_mediaPlayer->duration();
+    const int sliderValue = calculateSliderValueFromPosition(pos);
+    const QImage image = totalPos > 0 ? m_thumbnailCache->thumbnailAt(sliderValue * totalPos * 1000 / 10000) : QImage();
+    if (image.isNull()) {
+        m_thumbnailPopup->hide();
+        return;
+    }
+
+    m_thumbnailPopup->setPixmap(QPixmap::fromImage(image));
+    m_thumbnailPopup->adjustSize();
+    const QPoint topLeft(pos.x() - m_thumbnailPopup->width() / 2, -m_thumbnailPopup->height() - 4);
+    m_thumbnailPopup->move(m_seekSlider->mapToGlobal(topLeft));
+    m_thumbnailPopup->show();
+}
+
 QString PlayerDialog::formatTime(qint64 seconds)
 {
     qint64 minutes = seconds / 60;
@@ -996,6 +1525,7 @@ QString PlayerDialog::formatSpeedText(float speed)
         if (speed == 4.0f) return "Speed x4";
         if (speed == 8.0f) return "Speed x8";
         if (speed == 16.0f) return "Speed x16";
+        if (speed > 16.0f) return QString("Fast scan x%1").arg(static_cast<int>(speed));
         return QString("Speed x%1").arg(speed, 0, 'f', 1);
     } else {
         // 減速：/2, /4, /8, /16
@@ -1011,6 +1541,10 @@ QString PlayerDialog::formatSpeedText(float speed)
 void PlayerDialog::onActionPlayPause()
 {
     qDebug() << "Play/Pause toggle";
+    if (isPlaylistActive()) {
+        onPlayClicked();
+        return;
+    }
     if (!m_mediaPlayer || !m_mediaPlayer->isFileOpened()) {
         // No file opened, trigger file open
         onActionOpen();
@@ -1032,7 +1566,6 @@ void PlayerDialog::onActionPlayPause()
             m_mediaPlayer->play(displayWnd);
             m_mediaPlayer->playSound();
             adjustWindowSize();
-            m_posTimer->start(200);
         }
     }
 }
@@ -1043,7 +1576,6 @@ void PlayerDialog::onActionStop()
     if (m_mediaPlayer && m_mediaPlayer->isFileOpened()) {
         m_mediaPlayer->stopSound();
         m_mediaPlayer->stop();
-        m_posTimer->stop();
         m_seekSlider->setValue(0);
     }
 }
@@ -1084,7 +1616,7 @@ void PlayerDialog::onActionSnap()
     //QString exeDir = QCoreApplication::applicationDirPath();
     if (m_mediaPlayer->snapshot(m_SnapPath, nPicFormat)) {
         QString sSavePath = m_mediaPlayer->getLastSnapshotPath();
-        m_statusBar->showMessage(QString("Snapshot saved: %1").arg(sSavePath));
+        m_statusBar->showMessage(QString("Saving snapshot: %1").arg(sSavePath));
     } else {
         QMessageBox::critical(this, "Snapshot", "Failed to take snapshot.");
         m_statusBar->showMessage("Snapshot failed");
@@ -1132,6 +1664,7 @@ void PlayerDialog::onActionSlower()
     qDebug() << "Decrease speed";
     if (m_mediaPlayer && m_mediaPlayer->isFileOpened()) {
         //float currentSpeed = m_speedLevels[m_currentSpeedIndex];//m_mediaPlayer->getPlaySpeed();
+        const int previousIndex = m_currentSpeedIndex;
         if(m_currentSpeedIndex>0)
             m_currentSpeedIndex--;
 
@@ -1145,6 +1678,7 @@ void PlayerDialog::onActionSlower()
 //                m_statusBar->showMessage(QString("Speed: %1x").arg(newSpeed));
 //            }
         } else {
+            m_currentSpeedIndex = previousIndex;
             m_statusBar->showMessage("Speed control not available");
         }
     }
@@ -1155,6 +1689,7 @@ void PlayerDialog::onActionFaster()
     qDebug() << "Increase speed";
     if (m_mediaPlayer && m_mediaPlayer->isFileOpened()) {
 //        float currentSpeed = m_mediaPlayer->getPlaySpeed();
+        const int previousIndex = m_currentSpeedIndex;
         if (m_currentSpeedIndex < m_speedLevels.size() - 1)
                 m_currentSpeedIndex++;
 
@@ -1168,6 +1703,8 @@ void PlayerDialog::onActionFaster()
 //                m_statusBar->showMessage(QString("Speed: %1x").arg(newSpeed));
 //            }
         } else {
+            // e.g. fast scan before the file index is ready; stay in step
+            m_currentSpeedIndex = previousIndex;
             m_statusBar->showMessage("Speed control not available");
         }
     }
@@ -1209,83 +1746,3 @@ void PlayerDialog::onVolumeChanged(int value)
 
     updateVolumeButtonIcon();
 }
-
-// RtspStreamThread implementation
-RtspStreamThread::RtspStreamThread(MediaPlayerWrapper *player, const QString &url, QObject *parent)
-    : QThread(parent)
-    , m_player(player)
-    , m_url(url)
-    , m_ffmpegProcess(nullptr)
-    , m_running(false)
-{
-}
-
-RtspStreamThread::~RtspStreamThread()
-{
-    stopStream();
-}
-
-void RtspStreamThread::stopStream()
-{
-    m_running = false;
-    if (m_ffmpegProcess) {
-        m_ffmpegProcess->terminate();
-        if (!m_ffmpegProcess->waitForFinished(3000)) {
-            m_ffmpegProcess->kill();
-        }
-    }
-}
-
-void RtspStreamThread::run()
-{
-    m_running = true;
-
-    // Use FFmpeg to capture RTSP stream and output raw H.264 data
-    m_ffmpegProcess = new QProcess();
-
-    QStringList args;
-    args << "-rtsp_transport" << "tcp"    // Use TCP for RTSP (more reliable)
-         << "-i" << m_url                  // Input URL
-         << "-c:v" << "copy"               // Copy video codec (no re-encoding)
-         << "-an"                          // Disable audio for now
-         << "-f" << "h264"                 // Output format
-         << "-";                           // Output to stdout
-
-    m_ffmpegProcess->start("ffmpeg", args);
-
-    if (!m_ffmpegProcess->waitForStarted(5000)) {
-        emit streamError("Failed to start FFmpeg. Please ensure FFmpeg is installed and in PATH.");
-        delete m_ffmpegProcess;
-        m_ffmpegProcess = nullptr;
-        return;
-    }
-
-    emit streamStarted();
-
-    // Read data from FFmpeg and feed to PlayM4
-    while (m_running && m_ffmpegProcess->state() == QProcess::Running) {
-        if (m_ffmpegProcess->waitForReadyRead(100)) {
-            QByteArray data = m_ffmpegProcess->readAllStandardOutput();
-            if (!data.isEmpty() && m_player) {
-                m_player->inputStreamData(reinterpret_cast<PBYTE>(data.data()),
-                                          static_cast<DWORD>(data.size()));
-            }
-        }
-
-        // Check for errors
-        QByteArray errorData = m_ffmpegProcess->readAllStandardError();
-        if (!errorData.isEmpty()) {
-            QString errorStr = QString::fromLocal8Bit(errorData);
-            if (errorStr.contains("error", Qt::CaseInsensitive) ||
-                errorStr.contains("failed", Qt::CaseInsensitive)) {
-                qDebug() << "FFmpeg error:" << errorStr;
-            }
-        }
-    }
-
-    m_ffmpegProcess->waitForFinished(1000);
-    delete m_ffmpegProcess;
-    m_ffmpegProcess = nullptr;
-
-    emit streamStopped();
-}
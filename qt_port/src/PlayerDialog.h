@@ -17,10 +17,18 @@
 #include <QVector>
 #include <QDateTime>
 #include <QInputDialog>
-#include <QProcess>
 #include "watermarkdialog.h"
-
-class RtspStreamThread;
+#include "PlaybackClock.h"
+
+class StreamIngestReactor;
+class PlayerPool;
+class VideoWallWidget;
+class BurstCapture;
+class RangeExporter;
+class WatermarkVerifier;
+class ThumbnailCache;
+class PlaylistPlayer;
+class TimelineIndex;
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class PlayerDialog; }
@@ -64,9 +72,8 @@ private slots:
     void onPauseClicked();
     void onStopClicked();
     
-    // Timer slots
-    void onTimerUpdate();
-    void updatePosition();
+    // Position and status from the shared PlaybackClock
+    void onPlaybackStateChanged(MediaPlayerWrapper *player, const PlaybackState &state);
     
     // Slider slots
     void onSliderPressed();
@@ -80,10 +87,20 @@ private slots:
     // Menu slots
     void onActionOpen();
     void onActionOpenURL();
+    void onActionOpenFolder();
+    void onActionGoToTime();
     void onActionExit();
     void onActionSetPath();
     void onAcionAbout();
     void onAcionWatermark();
+    void onWallLayoutTriggered(QAction *action);
+    void onActionWallOpen();
+    void onActionWallFill();
+    void onActionBurstCapture();
+    void onActionIntervalCapture();
+    void onActionExportRange();
+    void onActionVerifyWatermarks();
+    void onFileOpened(const QString &filePath);
     
     // Toolbar slots
     void onActionPrev();
@@ -105,7 +122,6 @@ private:
     
     // Setup functions
     void setupUI();
-    void setupTimers();
     void setupMenus();
     
     // Wrapper functions matching original names
@@ -121,13 +137,22 @@ private:
     void OnDestroy();
     
     // Helper functions from original
-    void DrawStatus();
+    void DrawStatus(const PlaybackState &state);
+    void updatePosition(const PlaybackState &state);
     void updateButtonStates();
     void adjustWindowSize();
     int calculateSliderValueFromPosition(const QPoint &pos);
+    // Segment playlists take over the display area like the wall does
+    void startPlaylist(const QStringList &files);
+    void closePlaylist();
+    bool isPlaylistActive() const;
+    // Asks for camera and time once the timeline of the folder is ready
+    void askGoToTime();
+    void showSeekThumbnail(const QPoint &pos);
     QString formatTime(qint64 seconds);
     QString formatSpeedText(float speed);
     void updateVolumeButtonIcon();
+    void stopLiveStream();
 
     // UI elements
     QWidget *m_centralWidget;
@@ -168,10 +193,6 @@ private:
     QAction *m_actionSlower;
     QAction *m_actionFaster;
 
-    // Timers
-    QTimer *m_playTimer;
-    QTimer *m_posTimer;
-    
     // Media player
     class MediaPlayerWrapper *m_mediaPlayer;
     
@@ -192,34 +213,32 @@ private:
     WatermarkDialog *m_watermarkDlg;
 
     // RTSP streaming
-    RtspStreamThread *m_rtspThread;
+    StreamIngestReactor *m_ingestReactor;
+    int m_streamSourceId;
     QString m_currentStreamUrl;
-};
 
-// RTSP Stream Thread for handling network streaming
-class RtspStreamThread : public QThread
-{
-    Q_OBJECT
-
-public:
-    explicit RtspStreamThread(class MediaPlayerWrapper *player, const QString &url, QObject *parent = nullptr);
-    ~RtspStreamThread();
-
-    void stopStream();
-
-signals:
-    void streamStarted();
-    void streamError(const QString &error);
-    void streamStopped();
-
-protected:
-    void run() override;
-
-private:
-    class MediaPlayerWrapper *m_player;
-    QString m_url;
-    QProcess *m_ffmpegProcess;
-    volatile bool m_running;
+    // Video wall: one port per tile, shown instead of the single display
+    PlayerPool *m_playerPool;
+    VideoWallWidget *m_videoWall;
+    QActionGroup *m_actionGroupWallLayout;
+    QString m_lastWallSource;
+
+    // Multi-frame capture from the display callback
+    BurstCapture *m_burstCapture;
+    // Time range to image sequence, decoded on a port of its own
+    RangeExporter *m_rangeExporter;
+    // Whole-file watermark checks, several files at once
+    WatermarkVerifier *m_watermarkVerifier;
+    // Seek-bar previews of the open file, shown over the slider on hover
+    ThumbnailCache *m_thumbnailCache;
+    QLabel *m_thumbnailPopup;
+    // Consecutive segment files played gaplessly on two ports
+    PlaylistPlayer *m_playlist;
+    // Wall-clock index of the last recordings folder used with Go to Time
+    TimelineIndex *m_timeline;
+    bool m_goToTimePending;
+    // Applied in onFileOpened(), -1 for none
+    qint64 m_pendingSeekMs;
 };
 
 #endif // PLAYERDIALOG_H
@@ -0,0 +1,269 @@
+#include "PlayerPool.h"
+#include "CpuTime.h"
+#include "MediaPlayerWrapper.h"
+#include "StreamIngestReactor.h"
+#include "VideoWallWidget.h"
+#include <QTimer>
+#include <QEventLoop>
+#include <QDebug>
+
+PlayerPool::PlayerPool(StreamIngestReactor *reactor, QObject *parent)
+    : QObject(parent)
+    , m_reactor(reactor)
+    , m_statsTimer(new QTimer(this))
+    , m_statsCpuUs(0)
+{
+    connect(m_reactor, &StreamIngestReactor::sourceStarted, this, &PlayerPool::onSourceStarted);
+    connect(m_reactor, &StreamIngestReactor::sourceError, this, &PlayerPool::onSourceError);
+    connect(m_statsTimer, &QTimer::timeout, this, &PlayerPool::logStatistics);
+}
+
+PlayerPool::~PlayerPool()
+{
+    resize(0);
+}
+
+void PlayerPool::resize(int count)
+{
+    count = qBound(0, count, PLAYM4_MAX_SUPPORTS);
+
+    while (m_tiles.size() > count) {
+        closeSource(m_tiles.size() - 1);
+        Tile tile = m_tiles.takeLast();
+        tile.player->cleanup();
+        delete tile.player;
+    }
+
+    while (m_tiles.size() < count) {
+        Tile tile;
+        tile.player = new MediaPlayerWrapper(this);
+        tile.player->initialize();
+        tile.sourceId = -1;
+        tile.displayWnd = nullptr;
+        tile.playedFrames = 0;
+
+        const int index = m_tiles.size();
+        connect(tile.player, &MediaPlayerWrapper::errorOccurred, this, [this, index](const QString &error) {
+            emit sourceError(index, error);
+        });
+        m_tiles.append(tile);
+    }
+}
+
+int PlayerPool::activeCount() const
+{
+    int active = 0;
+    for (const Tile &tile : m_tiles) {
+        if (tile.player->isFileOpened()) {
+            ++active;
+        }
+    }
+    return active;
+}
+
+MediaPlayerWrapper *PlayerPool::player(int index) const
+{
+    return index >= 0 && index < m_tiles.size() ? m_tiles.at(index).player : nullptr;
+}
+
+bool PlayerPool::openSource(int index, const QString &source, HWND displayWnd)
+{
+    if (index < 0 || index >= m_tiles.size()) {
+        return false;
+    }
+
+    closeSource(index);
+
+    Tile &tile = m_tiles[index];
+    tile.source = source;
+    tile.displayWnd = displayWnd;
+    tile.playedFrames = 0;
+
+    if (source.startsWith("rtsp://", Qt::CaseInsensitive)) {
+        if (!tile.player->openStream(source)) {
+            return false;
+        }
+        // Playback starts once the reactor reports the session is up
+        tile.sourceId = m_reactor->addSource(tile.player, source);
+        return tile.sourceId >= 0;
+    }
+
+    if (!tile.player->openFile(source)) {
+        return false;
+    }
+    return tile.player->play(displayWnd);
+}
+
+void PlayerPool::closeSource(int index)
+{
+    if (index < 0 || index >= m_tiles.size()) {
+        return;
+    }
+
+    Tile &tile = m_tiles[index];
+    if (tile.sourceId >= 0) {
+        m_reactor->removeSource(tile.sourceId);
+        tile.sourceId = -1;
+    }
+    if (tile.player->isStreamMode()) {
+        tile.player->closeStream();
+    } else if (tile.player->isFileOpened()) {
+        tile.player->stop();
+        tile.player->closeFile();
+    }
+    tile.source.clear();
+}
+
+void PlayerPool::closeAll()
+{
+    for (int i = 0; i < m_tiles.size(); ++i) {
+        closeSource(i);
+    }
+}
+
+void PlayerPool::setStatisticsInterval(int ms)
+{
+    if (ms > 0) {
+        m_statsClock.start();
+        m_statsCpuUs = CpuTime::processUs();
+        for (Tile &tile : m_tiles) {
+            tile.playedFrames = tile.player->getPlayedFrames();
+        }
+        m_statsTimer->start(ms);
+    } else {
+        m_statsTimer->stop();
+    }
+}
+
+int PlayerPool::tileForSource(int sourceId) const
+{
+    for (int i = 0; i < m_tiles.size(); ++i) {
+        if (m_tiles.at(i).sourceId == sourceId) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void PlayerPool::onSourceStarted(int sourceId)
+{
+    const int index = tileForSource(sourceId);
+    if (index < 0) {
+        return;
+    }
+    m_tiles[index].player->play(m_tiles.at(index).displayWnd);
+}
+
+void PlayerPool::onSourceError(int sourceId, const QString &error)
+{
+    const int index = tileForSource(sourceId);
+    if (index >= 0) {
+        emit sourceError(index, error);
+    }
+}
+
+void PlayerPool::logStatistics()
+{
+    const qint64 wallUs = m_statsClock.nsecsElapsed() / 1000;
+    const quint64 cpuUs = CpuTime::processUs();
+    m_statsClock.restart();
+    if (wallUs <= 0) {
+        return;
+    }
+
+    quint64 frames = 0;
+    for (Tile &tile : m_tiles) {
+        const DWORD played = tile.player->getPlayedFrames();
+        if (played >= tile.playedFrames) {
+            frames += played - tile.playedFrames;
+        }
+        tile.playedFrames = played;
+    }
+
+    // CPU is process wide and given as a percentage of one core.
+    const int active = activeCount();
+    const double fps = frames * 1000000.0 / wallUs;
+    const double cpuPercent = (cpuUs - m_statsCpuUs) * 100.0 / wallUs;
+    m_statsCpuUs = cpuUs;
+
+    qDebug() << "Wall" << m_tiles.size() << "tiles," << active << "active:"
+             << QString::number(fps, 'f', 1) << "fps aggregate,"
+             << QString::number(active > 0 ? fps / active : 0.0, 'f', 1) << "fps/tile, CPU"
+             << QString::number(cpuPercent, 'f', 1) << "% total,"
+             << QString::number(active > 0 ? cpuPercent / active : 0.0, 'f', 1) << "% per tile";
+}
+
+void PlayerPool::runBenchmark(const QString &source)
+{
+    static const int kTileCounts[] = { 1, 4, 9, 16, 36, 64 };
+    static const int kWarmUpMs = 3000;
+    static const int kPhaseMs = 10000;
+
+    auto wait = [](int ms) {
+        QEventLoop loop;
+        QTimer::singleShot(ms, &loop, &QEventLoop::quit);
+        loop.exec();
+    };
+
+    StreamIngestReactor reactor;
+    PlayerPool pool(&reactor);
+    VideoWallWidget wall;
+    wall.resize(1280, 720);
+    wall.show();
+
+    for (int tiles : kTileCounts) {
+        wall.setTileCount(tiles);
+        pool.resize(tiles);
+        wait(100);
+
+        int opened = 0;
+        for (int i = 0; i < tiles; ++i) {
+            if (pool.openSource(i, source, wall.tileWindow(i))) {
+                ++opened;
+            }
+        }
+        if (opened == 0) {
+            qDebug() << "Wall benchmark: cannot play" << source;
+            break;
+        }
+        // Live tiles start on the reactor's signal; let every port settle
+        wait(kWarmUpMs);
+
+        QVector<DWORD> framesStart;
+        for (int i = 0; i < tiles; ++i) {
+            framesStart.append(pool.player(i)->getPlayedFrames());
+        }
+        QElapsedTimer clock;
+        clock.start();
+        const quint64 cpuStart = CpuTime::processUs();
+        wait(kPhaseMs);
+        const quint64 cpuUs = CpuTime::processUs() - cpuStart;
+        const qint64 wallUs = qMax<qint64>(1, clock.nsecsElapsed() / 1000);
+
+        quint64 frames = 0;
+        double slowestFps = -1.0;
+        for (int i = 0; i < tiles; ++i) {
+            const DWORD played = pool.player(i)->getPlayedFrames();
+            const quint64 tileFrames = played >= framesStart.at(i) ? played - framesStart.at(i) : 0;
+            frames += tileFrames;
+            const double tileFps = tileFrames * 1000000.0 / wallUs;
+            if (pool.player(i)->isFileOpened() && (slowestFps < 0 || tileFps < slowestFps)) {
+                slowestFps = tileFps;
+            }
+        }
+
+        const int active = qMax(1, pool.activeCount());
+        const double fps = frames * 1000000.0 / wallUs;
+        const double cpuPercent = cpuUs * 100.0 / wallUs;
+        qDebug().noquote() << QString("Wall benchmark, %1 tiles (%2 playing): %3 fps aggregate, %4 fps per tile, "
+                                      "slowest tile %5 fps, CPU %6% total, %7% per tile")
+            .arg(tiles).arg(pool.activeCount())
+            .arg(QString::number(fps, 'f', 1)).arg(QString::number(fps / active, 'f', 1))
+            .arg(QString::number(qMax(0.0, slowestFps), 'f', 1))
+            .arg(QString::number(cpuPercent, 'f', 1)).arg(QString::number(cpuPercent / active, 'f', 2));
+
+        pool.closeAll();
+    }
+
+    pool.resize(0);
+}
@@ -0,0 +1,69 @@
+#ifndef PLAYERPOOL_H
+#define PLAYERPOOL_H
+
+#include <QObject>
+#include <QVector>
+#include <QString>
+#include <QElapsedTimer>
+#include <Windows.h>
+
+class MediaPlayerWrapper;
+class StreamIngestReactor;
+class QTimer;
+
+// Owns one MediaPlayerWrapper (and so one PlayM4 port) per video-wall tile.
+// Every port decodes on its own PlayM4 thread and, for live sources, is fed
+// by its own StreamFeeder; the network side of all live tiles shares the
+// given ingest reactor. Sources are files or rtsp:// URLs.
+class PlayerPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PlayerPool(StreamIngestReactor *reactor, QObject *parent = nullptr);
+    ~PlayerPool();
+
+    // Grows or shrinks the pool; tiles past the new size are closed.
+    void resize(int count);
+    int size() const { return m_tiles.size(); }
+    int activeCount() const;
+    MediaPlayerWrapper *player(int index) const;
+
+    bool openSource(int index, const QString &source, HWND displayWnd);
+    void closeSource(int index);
+    void closeAll();
+
+    // Period of the wall statistics log, 0 disables it.
+    void setStatisticsInterval(int ms);
+
+    // Plays the source in every tile of a wall of 1, 4, 9, 16, 36 and then
+    // 64 tiles and logs the rendered fps and process CPU per tile of each.
+    static void runBenchmark(const QString &source);
+
+signals:
+    void sourceError(int index, const QString &error);
+
+private slots:
+    void onSourceStarted(int sourceId);
+    void onSourceError(int sourceId, const QString &error);
+    void logStatistics();
+
+private:
+    struct Tile {
+        MediaPlayerWrapper *player;
+        int sourceId;           // ingest source for live tiles, else -1
+        QString source;
+        HWND displayWnd;
+        DWORD playedFrames;     // at the last statistics sample
+    };
+
+    int tileForSource(int sourceId) const;
+
+    QVector<Tile> m_tiles;
+    StreamIngestReactor *m_reactor;
+    QTimer *m_statsTimer;
+    QElapsedTimer m_statsClock;
+    quint64 m_statsCpuUs;
+};
+
+#endif // PLAYERPOOL_H
@@ -0,0 +1,471 @@
+#include "PlaylistPlayer.h"
+#include "MediaPlayerWrapper.h"
+#include "PlaybackClock.h"
+#include <QStackedLayout>
+#include <QTimer>
+#include <QDir>
+#include <QFileInfo>
+#include <QEventLoop>
+#include <QDebug>
+
+static const char *kPageStyle = "background-color:black;";
+// First-frame poll of a segment being pre-rolled
+static const int kPrerollPollMs = 5;
+// A pre-roll with a seek waits this long at most for the seek to land
+static const qint64 kSeekWaitMs = 1000;
+
+PlaylistPlayer::PlaylistPlayer(QWidget *parent)
+    : QWidget(parent)
+    , m_stack(new QStackedLayout(this))
+    , m_front(0)
+    , m_durationMs(0)
+    , m_paused(false)
+    , m_lastState(MediaPlayerWrapper::Stopped)
+    , m_prerollTimer(new QTimer(this))
+    , m_lastSwitchGapMs(-1)
+{
+    // Both pages stay visible, the waiting one underneath, so its port
+    // renders into a live window and is on screen the moment it is raised
+    m_stack->setStackingMode(QStackedLayout::StackAll);
+    m_stack->setContentsMargins(0, 0, 0, 0);
+
+    for (int i = 0; i < 2; ++i) {
+        Slot &slot = m_slots[i];
+        slot.page = new QWidget(this);
+        slot.page->setAttribute(Qt::WA_NativeWindow);
+        slot.page->setAttribute(Qt::WA_StyledBackground);
+        slot.page->setStyleSheet(kPageStyle);
+        m_stack->addWidget(slot.page);
+
+        slot.player = new MediaPlayerWrapper(this);
+        slot.player->initialize();
+        slot.segment = -1;
+        slot.ready = false;
+        slot.switchWhenReady = false;
+        slot.seekMs = 0;
+        slot.targetMs = -1;
+        slot.seekLanded = true;
+
+        connect(slot.player, &MediaPlayerWrapper::fileOpened, this,
+                [this, i](const QString &filePath) { onSlotOpened(i, filePath); });
+        connect(slot.player, &MediaPlayerWrapper::fileOpenFailed, this,
+                [this, i](const QString &filePath, const QString &error) { onSlotFailed(i, filePath, error); });
+        connect(slot.player, &MediaPlayerWrapper::fileEnded, this, [this, i]() { onSlotFileEnded(i); });
+        connect(slot.player, &MediaPlayerWrapper::seekCompleted, this, [this, i]() { m_slots[i].seekLanded = true; });
+        PlaybackClock::instance()->watch(slot.player);
+    }
+    connect(PlaybackClock::instance(), &PlaybackClock::stateChanged, this, &PlaylistPlayer::onPlaybackStateChanged);
+
+    m_prerollTimer->setTimerType(Qt::PreciseTimer);
+    m_prerollTimer->setInterval(kPrerollPollMs);
+    connect(m_prerollTimer, &QTimer::timeout, this, &PlaylistPlayer::checkPreroll);
+}
+
+PlaylistPlayer::~PlaylistPlayer()
+{
+    stop();
+}
+
+QStringList PlaylistPlayer::segmentsInDirectory(const QString &directory)
+{
+    const QStringList filters = { "*.mp4", "*.avi", "*.mkv", "*.264", "*.h264" };
+    QStringList files;
+    const QFileInfoList entries = QDir(directory).entryInfoList(filters, QDir::Files, QDir::Name);
+    for (const QFileInfo &entry : entries) {
+        files.append(entry.absoluteFilePath());
+    }
+    return files;
+}
+
+bool PlaylistPlayer::open(const QStringList &files)
+{
+    stop();
+    if (files.isEmpty()) {
+        return false;
+    }
+
+    for (const QString &filePath : files) {
+        Segment segment;
+        segment.filePath = filePath;
+        segment.bytes = QFileInfo(filePath).size();
+        segment.startMs = 0;
+        segment.durationMs = 0;
+        segment.durationKnown = false;
+        m_segments.append(segment);
+    }
+    updateTimeline();
+    m_paused = false;
+
+    load(1 - m_front, 0, 0, true);
+    return true;
+}
+
+void PlaylistPlayer::stop()
+{
+    m_prerollTimer->stop();
+    m_switchTimer.invalidate();
+    m_lastSwitchGapMs = -1;
+    unload(0);
+    unload(1);
+    m_segments.clear();
+    m_durationMs = 0;
+    m_paused = false;
+    if (m_lastState != MediaPlayerWrapper::Stopped) {
+        m_lastState = MediaPlayerWrapper::Stopped;
+        emit stateChanged(m_lastState);
+    }
+}
+
+bool PlaylistPlayer::pause()
+{
+    MediaPlayerWrapper *player = currentPlayer();
+    if (!player || m_paused) {
+        return false;
+    }
+    m_paused = true;
+    player->stopSound();
+    return player->pause();
+}
+
+bool PlaylistPlayer::resume()
+{
+    MediaPlayerWrapper *player = currentPlayer();
+    if (!player || !m_paused) {
+        return false;
+    }
+    m_paused = false;
+    if (!player->resume()) {
+        return false;
+    }
+    player->playSound();
+    return true;
+}
+
+bool PlaylistPlayer::seek(qint64 positionMs)
+{
+    const int segment = segmentAt(positionMs);
+    if (segment < 0) {
+        return false;
+    }
+    const qint64 localMs = positionMs - m_segments.at(segment).startMs;
+
+    Slot &front = m_slots[m_front];
+    if (front.segment == segment) {
+        return front.player->seekToTime(localMs);
+    }
+    // Another segment: pre-roll it at the target, then raise it. Its start
+    // may still be an estimate, so the target is kept to correct once the
+    // segment has opened.
+    load(1 - m_front, segment, localMs, true);
+    m_slots[1 - m_front].targetMs = positionMs;
+    return true;
+}
+
+qint64 PlaylistPlayer::position() const
+{
+    const Slot &front = m_slots[m_front];
+    if (front.segment < 0) {
+        return 0;
+    }
+    // The clock's whole seconds would make the readout jump; an estimated
+    // length may also be shorter than what is played
+    const Segment &segment = m_segments.at(front.segment);
+    return segment.startMs + qBound<qint64>(0, front.player->getPlayedTimeMs(), segment.durationMs);
+}
+
+int PlaylistPlayer::currentIndex() const
+{
+    return m_slots[m_front].segment;
+}
+
+QString PlaylistPlayer::segmentPath(int index) const
+{
+    return (index >= 0 && index < m_segments.size()) ? m_segments.at(index).filePath : QString();
+}
+
+MediaPlayerWrapper *PlaylistPlayer::currentPlayer() const
+{
+    const Slot &front = m_slots[m_front];
+    return front.segment >= 0 ? front.player : nullptr;
+}
+
+void PlaylistPlayer::load(int slotIndex, int segment, qint64 seekMs, bool switchWhenReady)
+{
+    unload(slotIndex);
+
+    Slot &slot = m_slots[slotIndex];
+    slot.segment = segment;
+    slot.switchWhenReady = switchWhenReady;
+    slot.seekMs = seekMs;
+    slot.targetMs = -1;
+    slot.seekLanded = (seekMs <= 0);
+    slot.loadTimer.start();
+    slot.player->openFileAsync(m_segments.at(segment).filePath);
+}
+
+void PlaylistPlayer::unload(int slotIndex)
+{
+    Slot &slot = m_slots[slotIndex];
+    slot.player->cancelPendingOpen();
+    slot.player->stopSound();
+    slot.player->closeFile();
+    slot.segment = -1;
+    slot.ready = false;
+    slot.switchWhenReady = false;
+}
+
+void PlaylistPlayer::onSlotOpened(int slotIndex, const QString &filePath)
+{
+    Slot &slot = m_slots[slotIndex];
+    if (slot.segment < 0 || filePath != m_segments.at(slot.segment).filePath) {
+        return;
+    }
+
+    Segment &segment = m_segments[slot.segment];
+    const qint64 durationMs = slot.player->duration() * 1000;
+    if (durationMs > 0 && !segment.durationKnown) {
+        segment.durationMs = durationMs;
+        segment.durationKnown = true;
+        updateTimeline();
+        emit positionChanged(position(), m_durationMs);
+    }
+
+    // The seek was placed on estimated lengths; place it again on the
+    // timeline as it is now, which may put it in a neighbouring segment
+    if (slot.targetMs >= 0) {
+        const qint64 targetMs = qMin(slot.targetMs, m_durationMs);
+        const int target = segmentAt(targetMs);
+        if (target != slot.segment) {
+            qDebug() << "Playlist seek to" << targetMs << "ms moved from segment" << slot.segment + 1 << "to" << target + 1;
+            const bool switchWhenReady = slot.switchWhenReady;
+            load(slotIndex, target, targetMs - m_segments.at(target).startMs, switchWhenReady);
+            slot.targetMs = targetMs;
+            return;
+        }
+        slot.seekMs = qBound<qint64>(0, targetMs - segment.startMs, segment.durationMs);
+        slot.seekLanded = (slot.seekMs <= 0);
+        slot.targetMs = -1;
+    }
+
+    // Silent until it is the segment on screen
+    if (!slot.player->play(reinterpret_cast<HWND>(slot.page->winId()))) {
+        emit errorOccurred("Failed to play " + filePath);
+        return;
+    }
+    if (slot.seekMs > 0) {
+        slot.player->seekToTime(slot.seekMs);
+    }
+    m_prerollTimer->start();
+}
+
+void PlaylistPlayer::onSlotFailed(int slotIndex, const QString &filePath, const QString &error)
+{
+    Slot &slot = m_slots[slotIndex];
+    if (slot.segment < 0 || filePath != m_segments.at(slot.segment).filePath) {
+        return;
+    }
+    qDebug() << "Playlist segment" << slot.segment + 1 << "failed:" << error;
+    emit errorOccurred(QFileInfo(filePath).fileName() + ": " + error);
+
+    // Skip it; a broken segment should not end the whole recording
+    const int next = slot.segment + 1;
+    const bool switchWhenReady = slot.switchWhenReady;
+    unload(slotIndex);
+    if (next < m_segments.size()) {
+        load(slotIndex, next, 0, switchWhenReady);
+    }
+}
+
+void PlaylistPlayer::checkPreroll()
+{
+    bool pending = false;
+    for (int i = 0; i < 2; ++i) {
+        Slot &slot = m_slots[i];
+        if (slot.segment < 0 || slot.ready || !slot.player->isPlaying()) {
+            continue;
+        }
+        // The first frame is in the window and a seek, if any, has landed
+        if (slot.player->getPlayedFrames() == 0
+            || (!slot.seekLanded && slot.loadTimer.elapsed() < kSeekWaitMs)) {
+            pending = true;
+            continue;
+        }
+
+        if (slot.switchWhenReady) {
+            switchTo(i);
+        } else {
+            slot.player->pause();
+            slot.ready = true;
+            qDebug() << "Playlist segment" << slot.segment + 1 << "pre-rolled in" << slot.loadTimer.elapsed() << "ms";
+            // The current segment ended while this one was still opening
+            if (m_switchTimer.isValid()) {
+                switchTo(i);
+            }
+        }
+    }
+    if (!pending) {
+        m_prerollTimer->stop();
+    }
+}
+
+void PlaylistPlayer::switchTo(int slotIndex)
+{
+    Slot &next = m_slots[slotIndex];
+    const int previous = m_front;
+
+    // Raise first and redraw the held frame, so there is never an empty window
+    m_stack->setCurrentWidget(next.page);
+    next.player->refreshDisplay();
+    if (m_paused) {
+        if (next.player->isPlaying()) {
+            next.player->pause();
+        }
+    } else {
+        if (next.player->isPaused()) {
+            next.player->resume();
+        }
+        next.player->playSound();
+    }
+    next.ready = true;
+    next.switchWhenReady = false;
+    m_front = slotIndex;
+
+    if (previous != slotIndex) {
+        unload(previous);
+    }
+    if (m_switchTimer.isValid()) {
+        m_lastSwitchGapMs = m_switchTimer.elapsed();
+        qDebug() << "Playlist switched to segment" << next.segment + 1 << m_lastSwitchGapMs
+                 << "ms after the end of the previous one";
+        m_switchTimer.invalidate();
+    }
+
+    emit segmentChanged(next.segment, m_segments.at(next.segment).filePath);
+    emit positionChanged(position(), m_durationMs);
+
+    // Pre-open and pre-roll what follows on the other port
+    if (next.segment + 1 < m_segments.size()) {
+        load(1 - m_front, next.segment + 1, 0, false);
+    }
+}
+
+void PlaylistPlayer::onSlotFileEnded(int slotIndex)
+{
+    if (slotIndex != m_front || m_slots[slotIndex].segment < 0) {
+        return;
+    }
+
+    // Played to the end, the segment's length is known to the millisecond
+    // rather than the whole seconds of the file time
+    Segment &segment = m_segments[m_slots[slotIndex].segment];
+    const qint64 playedMs = m_slots[slotIndex].player->getPlayedTimeMs();
+    if (playedMs > 0 && playedMs != segment.durationMs) {
+        segment.durationMs = playedMs;
+        segment.durationKnown = true;
+        updateTimeline();
+    }
+
+    const int nextSegment = m_slots[slotIndex].segment + 1;
+    if (nextSegment >= m_segments.size()) {
+        qDebug() << "Playlist finished after" << m_segments.size() << "segments";
+        emit finished();
+        return;
+    }
+
+    m_switchTimer.start();
+    Slot &back = m_slots[1 - m_front];
+    if (back.segment == nextSegment && back.ready) {
+        switchTo(1 - m_front);
+    } else if (back.segment != nextSegment) {
+        // Nothing pre-rolled, e.g. right after a seek near the end
+        load(1 - m_front, nextSegment, 0, true);
+    }
+    // else still opening; checkPreroll() switches once its first frame is up
+}
+
+void PlaylistPlayer::onPlaybackStateChanged(MediaPlayerWrapper *player, const PlaybackState &state)
+{
+    if (player != currentPlayer()) {
+        return;
+    }
+    if (state.playState != m_lastState) {
+        m_lastState = state.playState;
+        emit stateChanged(m_lastState);
+    }
+    emit positionChanged(position(), m_durationMs);
+}
+
+void PlaylistPlayer::updateTimeline()
+{
+    // Bit rate of the segments opened so far stands in for the others
+    qint64 knownMs = 0;
+    qint64 knownBytes = 0;
+    for (const Segment &segment : m_segments) {
+        if (segment.durationKnown) {
+            knownMs += segment.durationMs;
+            knownBytes += segment.bytes;
+        }
+    }
+
+    qint64 startMs = 0;
+    for (Segment &segment : m_segments) {
+        if (!segment.durationKnown) {
+            segment.durationMs = knownBytes > 0 ? segment.bytes * knownMs / knownBytes : 0;
+        }
+        segment.startMs = startMs;
+        startMs += segment.durationMs;
+    }
+    m_durationMs = startMs;
+}
+
+int PlaylistPlayer::segmentAt(qint64 positionMs) const
+{
+    if (m_segments.isEmpty()) {
+        return -1;
+    }
+    for (int i = m_segments.size() - 1; i >= 0; --i) {
+        if (positionMs >= m_segments.at(i).startMs) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+void PlaylistPlayer::runBenchmark(const QString &directory)
+{
+    // Played of each segment before the switch
+    static const qint64 kTailMs = 3000;
+
+    const QStringList files = segmentsInDirectory(directory);
+    if (files.size() < 2) {
+        qDebug() << "Playlist benchmark: need at least two media files in" << directory;
+        return;
+    }
+
+    PlaylistPlayer playlist;
+    playlist.resize(640, 360);
+    playlist.show();
+
+    QEventLoop loop;
+    qint64 maxGapMs = -1;
+    int switches = 0;
+    connect(&playlist, &PlaylistPlayer::finished, &loop, &QEventLoop::quit);
+    connect(&playlist, &PlaylistPlayer::segmentChanged, &loop, [&](int index) {
+        if (playlist.lastSwitchGapMs() >= 0) {
+            maxGapMs = qMax(maxGapMs, playlist.lastSwitchGapMs());
+            ++switches;
+        }
+        // Straight to the tail; the next segment pre-rolls meanwhile
+        const Segment &segment = playlist.m_segments.at(index);
+        if (segment.durationMs > kTailMs) {
+            playlist.seek(segment.startMs + segment.durationMs - kTailMs);
+        }
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    playlist.open(files);
+    loop.exec();
+    qDebug() << "Playlist benchmark:" << switches << "switches over" << files.size() << "segments in"
+             << timer.elapsed() << "ms, largest gap" << maxGapMs << "ms";
+}
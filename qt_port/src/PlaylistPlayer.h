@@ -0,0 +1,114 @@
+#ifndef PLAYLISTPLAYER_H
+#define PLAYLISTPLAYER_H
+
+#include <QWidget>
+#include <QVector>
+#include <QStringList>
+#include <QElapsedTimer>
+
+class MediaPlayerWrapper;
+class QStackedLayout;
+class QTimer;
+struct PlaybackState;
+
+// Plays consecutive segment files, e.g. an NVR export, as one recording.
+// Two ports alternate: while one plays, the other opens the next segment
+// into a render window stacked underneath, shows its first frame and
+// pauses. When the file end callback of the current segment fires, the
+// waiting window is raised and resumed, so the picture never goes black
+// between segments. Position and duration are given on the joined
+// timeline in milliseconds; lengths of segments not opened yet are
+// estimated from their size at the bit rate of those that have been, and a
+// seek into one of them is placed again once it has opened.
+class PlaylistPlayer : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit PlaylistPlayer(QWidget *parent = nullptr);
+    ~PlaylistPlayer();
+
+    // Media files of a directory in name order, which for NVR exports is
+    // recording order
+    static QStringList segmentsInDirectory(const QString &directory);
+
+    bool open(const QStringList &files);
+    void stop();
+    bool isActive() const { return !m_segments.isEmpty(); }
+
+    bool pause();
+    bool resume();
+    bool isPaused() const { return m_paused; }
+    bool seek(qint64 positionMs);
+    qint64 position() const;
+    qint64 duration() const { return m_durationMs; }
+
+    int count() const { return m_segments.size(); }
+    int currentIndex() const;
+    QString segmentPath(int index) const;
+    // Port of the segment on screen; null while the first one is opening
+    MediaPlayerWrapper *currentPlayer() const;
+    // Time from the end of a segment to the next one on screen, -1 before
+    // the first switch
+    qint64 lastSwitchGapMs() const { return m_lastSwitchGapMs; }
+
+    // Plays the segments of directory, skipping to the last seconds of each,
+    // and logs every switch gap and the largest.
+    static void runBenchmark(const QString &directory);
+
+signals:
+    void segmentChanged(int index, const QString &filePath);
+    void positionChanged(qint64 positionMs, qint64 durationMs);
+    // MediaPlayerWrapper::PlayState of the segment on screen
+    void stateChanged(int state);
+    void finished();
+    void errorOccurred(const QString &error);
+
+private slots:
+    void checkPreroll();
+
+private:
+    struct Segment {
+        QString filePath;
+        qint64 bytes;
+        qint64 startMs;
+        qint64 durationMs;
+        bool durationKnown;
+    };
+
+    struct Slot {
+        MediaPlayerWrapper *player;
+        QWidget *page;
+        int segment;            // -1 when idle
+        bool ready;             // first frame shown, paused
+        bool switchWhenReady;   // a seek or a late next segment
+        qint64 seekMs;
+        qint64 targetMs;        // seek on the joined timeline, -1 when none
+        bool seekLanded;
+        QElapsedTimer loadTimer;
+    };
+
+    void load(int slot, int segment, qint64 seekMs, bool switchWhenReady);
+    void unload(int slot);
+    void switchTo(int slot);
+    void onSlotOpened(int slot, const QString &filePath);
+    void onSlotFailed(int slot, const QString &filePath, const QString &error);
+    void onSlotFileEnded(int slot);
+    void onPlaybackStateChanged(MediaPlayerWrapper *player, const PlaybackState &state);
+    void updateTimeline();
+    int segmentAt(qint64 positionMs) const;
+
+    QStackedLayout *m_stack;
+    Slot m_slots[2];
+    int m_front;
+    QVector<Segment> m_segments;
+    qint64 m_durationMs;
+    bool m_paused;
+    int m_lastState;
+    QTimer *m_prerollTimer;
+    // From the end of one segment to the next one on screen
+    QElapsedTimer m_switchTimer;
+    qint64 m_lastSwitchGapMs;
+};
+
+#endif // PLAYLISTPLAYER_H
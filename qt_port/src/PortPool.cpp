@@ -0,0 +1,139 @@
+#include "PortPool.h"
+#include "MediaPlayerWrapper.h"
+#include <QMutexLocker>
+#include <QDebug>
+
+PortPool *PortPool::instance()
+{
+    static PortPool pool;
+    return &pool;
+}
+
+PortPool::PortPool()
+    : m_maxIdle(16)
+    , m_enabled(true)
+{
+}
+
+void PortPool::setEnabled(bool enabled)
+{
+    QVector<LONG> drained;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_enabled = enabled;
+        if (!enabled) {
+            drained.swap(m_idle);
+        }
+    }
+    for (LONG port : drained) {
+        freePort(port);
+    }
+}
+
+bool PortPool::isEnabled() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_enabled;
+}
+
+void PortPool::setMaxIdle(int count)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxIdle = qMax(0, count);
+}
+
+void PortPool::prewarm(int count)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_enabled) {
+        return;
+    }
+
+    count = qMin(count, m_maxIdle);
+    while (m_idle.size() < count) {
+        const LONG port = createPort();
+        if (port < 0) {
+            break;
+        }
+        m_idle.append(port);
+    }
+    qDebug() << "Port pool pre-warmed with" << m_idle.size() << "ports";
+}
+
+int PortPool::idleCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_idle.size();
+}
+
+LONG PortPool::acquire()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_enabled && !m_idle.isEmpty()) {
+            return m_idle.takeLast();
+        }
+    }
+    return createPort();
+}
+
+void PortPool::release(LONG port)
+{
+    if (port < 0) {
+        return;
+    }
+
+    // The last owner's callbacks carry it as user data and may outlive it;
+    // the next owner registers its own
+    NAME(PlayM4_SetFileRefCallBack)(port, nullptr, nullptr);
+    NAME(PlayM4_SetCheckWatermarkCallBack)(port, nullptr, nullptr);
+    NAME(PlayM4_SetFileEndCallback)(port, nullptr, nullptr);
+    NAME(PlayM4_SetDisplayCallBackYUV)(port, nullptr, TRUE, nullptr);
+    NAME(PlayM4_SetDecCallBackMend)(port, nullptr, nullptr);
+    NAME(PlayM4_SetSourceBufCallBack)(port, 0, nullptr, nullptr, nullptr);
+
+    // Drop anything the last session left queued so the next open starts
+    // from empty buffers.
+    NAME(PlayM4_ResetBuffer)(port, BUF_VIDEO_SRC);
+    NAME(PlayM4_ResetBuffer)(port, BUF_AUDIO_SRC);
+    NAME(PlayM4_ResetBuffer)(port, BUF_VIDEO_RENDER);
+    NAME(PlayM4_ResetBuffer)(port, BUF_AUDIO_RENDER);
+
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_enabled && m_idle.size() < m_maxIdle) {
+            m_idle.append(port);
+            return;
+        }
+    }
+    freePort(port);
+}
+
+void PortPool::clear()
+{
+    QVector<LONG> drained;
+    {
+        QMutexLocker locker(&m_mutex);
+        drained.swap(m_idle);
+    }
+    for (LONG port : drained) {
+        freePort(port);
+    }
+}
+
+LONG PortPool::createPort()
+{
+    LONG port = -1;
+    if (!NAME(PlayM4_GetPort)(&port)) {
+        return -1;
+    }
+
+    // Set DirectDraw device for this port
+    NAME(PlayM4_SetDDrawDevice)(port, 0);
+    return port;
+}
+
+void PortPool::freePort(LONG port)
+{
+    NAME(PlayM4_FreePort)(port);
+}
@@ -0,0 +1,45 @@
+#ifndef PORTPOOL_H
+#define PORTPOOL_H
+
+#include <QMutex>
+#include <QVector>
+#include <Windows.h>
+
+// Process-wide cache of PlayM4 ports that already went through
+// PlayM4_GetPort and PlayM4_SetDDrawDevice. A closed file or stream hands
+// its port back here; the port is flushed with PlayM4_ResetBuffer and kept
+// for the next open instead of being freed and re-acquired.
+class PortPool
+{
+public:
+    static PortPool *instance();
+
+    // With the pool disabled every acquire/release goes straight to the SDK.
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+    void setMaxIdle(int count);
+    void prewarm(int count);
+    int idleCount() const;
+
+    // Returns -1 when no port could be obtained.
+    LONG acquire();
+    // Clears every callback of the closed port before pooling or freeing it
+    void release(LONG port);
+    // Frees every idle port; call before the SDK is torn down.
+    void clear();
+
+private:
+    PortPool();
+    Q_DISABLE_COPY(PortPool)
+
+    static LONG createPort();
+    static void freePort(LONG port);
+
+    mutable QMutex m_mutex;
+    QVector<LONG> m_idle;
+    int m_maxIdle;
+    bool m_enabled;
+};
+
+#endif // PORTPOOL_H
@@ -0,0 +1,475 @@
+#include "RangeExporter.h"
+#include "MediaPlayerWrapper.h"
+#include "YuvConvert.h"
+#include <QRunnable>
+#include <QImage>
+#include <QBuffer>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QEventLoop>
+#include <QMutexLocker>
+#include <QDebug>
+#include <string.h>
+
+static const int kJpegQuality = 90;
+// Frames allowed between the decode callback and the disk, per encoder
+static const int kFramesPerEncoder = 3;
+// How long to wait for the file index before filtering on time stamps
+static const int kIndexWaitMs = 3000;
+
+// Encodes one copied frame and hands the bytes to the writer in order.
+class RangeEncodeTask : public QRunnable
+{
+public:
+    RangeEncodeTask(RangeExporter *exporter, int serial, int index, QByteArray buffer,
+                    const DecodedFrame &frame, const QString &filePath)
+        : m_exporter(exporter)
+        , m_serial(serial)
+        , m_index(index)
+        , m_buffer(std::move(buffer))
+        , m_frame(frame)
+        , m_filePath(filePath)
+    {
+        m_frame.data = reinterpret_cast<const uchar *>(m_buffer.constData());
+    }
+
+    void run() override
+    {
+        QByteArray encoded;
+        if (m_exporter->m_format == RangeExporter::Jpeg) {
+            if (!m_exporter->m_jpegEncoder.encode(m_frame, &encoded)) {
+                encoded.clear();
+            }
+        } else {
+            const QImage image = YuvConvert::toImage(m_frame);
+            QBuffer device(&encoded);
+            if (image.isNull() || !device.open(QIODevice::WriteOnly) || !image.save(&device, "PNG")) {
+                encoded.clear();
+            }
+        }
+        if (encoded.isEmpty()) {
+            qDebug() << "Failed to encode exported frame" << m_filePath;
+        }
+
+        m_exporter->releaseBuffer(std::move(m_buffer));
+        QMetaObject::invokeMethod(m_exporter, "onFrameEncoded", Qt::QueuedConnection, Q_ARG(int, m_serial),
+                                  Q_ARG(int, m_index), Q_ARG(QString, m_filePath), Q_ARG(QByteArray, encoded));
+    }
+
+private:
+    RangeExporter *m_exporter;
+    int m_serial;
+    int m_index;
+    QByteArray m_buffer;
+    DecodedFrame m_frame;
+    QString m_filePath;
+};
+
+// Writes one encoded frame; runs on the single writer thread.
+class RangeWriteTask : public QRunnable
+{
+public:
+    RangeWriteTask(RangeExporter *exporter, int serial, const QString &filePath, const QByteArray &data)
+        : m_exporter(exporter)
+        , m_serial(serial)
+        , m_filePath(filePath)
+        , m_data(data)
+    {
+    }
+
+    void run() override
+    {
+        QFile file(m_filePath);
+        const bool ok = file.open(QIODevice::WriteOnly) && file.write(m_data) == m_data.size();
+        if (!ok) {
+            qDebug() << "Failed to write exported frame" << m_filePath << file.errorString();
+        }
+        QMetaObject::invokeMethod(m_exporter, "onFrameWritten", Qt::QueuedConnection,
+                                  Q_ARG(int, m_serial), Q_ARG(bool, ok));
+    }
+
+private:
+    RangeExporter *m_exporter;
+    int m_serial;
+    QString m_filePath;
+    QByteArray m_data;
+};
+
+RangeExporter::RangeExporter(QObject *parent)
+    : QObject(parent)
+    , m_player(nullptr)
+    , m_jpegEncoder(kJpegQuality)
+    , m_serial(0)
+    , m_format(Jpeg)
+    , m_startMs(0)
+    , m_endMs(0)
+    , m_active(false)
+    , m_decodeStarted(false)
+    , m_decodeComplete(false)
+    , m_byFrame(false)
+    , m_firstFrame(0)
+    , m_lastFrame(0)
+    , m_lastKey(-1)
+    , m_baseStampMs(-1)
+    , m_accepting(false)
+    , m_taken(0)
+    , m_slotCount(0)
+    , m_nextWrite(0)
+    , m_written(0)
+    , m_failed(0)
+{
+    m_encodePool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+    m_writePool.setMaxThreadCount(1);
+    m_slotCount = m_encodePool.maxThreadCount() * kFramesPerEncoder;
+    m_indexWaitTimer.setSingleShot(true);
+    m_indexWaitTimer.setInterval(kIndexWaitMs);
+    connect(&m_indexWaitTimer, &QTimer::timeout, this, &RangeExporter::beginDecode);
+
+    m_player = new MediaPlayerWrapper(this);
+    m_player->initialize();
+    connect(m_player, &MediaPlayerWrapper::fileOpened, this, &RangeExporter::onFileOpened);
+    connect(m_player, &MediaPlayerWrapper::fileOpenFailed, this, &RangeExporter::onFileOpenFailed);
+    connect(m_player, &MediaPlayerWrapper::fileRefCreated, this, &RangeExporter::onIndexReady);
+}
+
+RangeExporter::~RangeExporter()
+{
+    cancel();
+}
+
+bool RangeExporter::start(const QString &filePath, qint64 startMs, qint64 endMs, const QString &directory, int format)
+{
+    if (m_active || startMs < 0 || endMs < startMs || !QDir().mkpath(directory)) {
+        return false;
+    }
+
+    ++m_serial;
+    m_filePath = filePath;
+    m_directory = directory;
+    m_namePrefix = QString("%1_%2").arg(QFileInfo(filePath).completeBaseName()).arg(startMs);
+    m_format = format;
+    m_startMs = startMs;
+    m_endMs = endMs;
+    m_decodeStarted = false;
+    m_decodeComplete = false;
+    m_byFrame = false;
+    m_lastKey = -1;
+    m_baseStampMs = -1;
+    m_taken = 0;
+    // Slots held by frames of a cancelled job are never given back
+    m_slots.acquire(m_slots.available());
+    m_slots.release(m_slotCount);
+    m_encoded.clear();
+    m_nextWrite = 0;
+    m_written = 0;
+    m_failed = 0;
+    m_active = true;
+    m_timer.start();
+
+    m_player->openFileAsync(filePath);
+    return true;
+}
+
+void RangeExporter::cancel()
+{
+    if (!m_active) {
+        return;
+    }
+
+    // Queued results of this job are told apart by the serial and dropped
+    m_accepting = false;
+    m_indexWaitTimer.stop();
+    m_player->cancelPendingOpen();
+    m_player->stopHeadless();
+    m_encodePool.clear();
+    m_encodePool.waitForDone();
+    m_writePool.clear();
+    m_writePool.waitForDone();
+    m_player->closeFile();
+    ++m_serial;
+
+    m_active = false;
+    qDebug() << "Range export cancelled after" << m_written << "frames";
+    emit finished(m_written, m_failed, 0.0, m_directory);
+}
+
+void RangeExporter::onFileOpened(const QString &filePath)
+{
+    if (!m_active || m_decodeStarted || filePath != m_filePath) {
+        return;
+    }
+
+    // Frame-exact bounds need the index; a cached one is there already
+    if (m_player->keyFrameIndex().isEmpty()) {
+        m_indexWaitTimer.start();
+    } else {
+        beginDecode();
+    }
+}
+
+void RangeExporter::onFileOpenFailed(const QString &filePath, const QString &error)
+{
+    if (m_active && filePath == m_filePath) {
+        abort(error);
+    }
+}
+
+void RangeExporter::onIndexReady()
+{
+    if (m_active && m_player->isFileOpened()) {
+        beginDecode();
+    }
+}
+
+void RangeExporter::beginDecode()
+{
+    if (!m_active || m_decodeStarted || !m_player->isFileOpened()) {
+        return;
+    }
+    m_decodeStarted = true;
+    m_indexWaitTimer.stop();
+
+    const quint32 totalFrames = m_player->getTotalFrames();
+    const quint32 totalMs = static_cast<quint32>(m_player->duration() * 1000);
+    const KeyFrameIndex &index = m_player->keyFrameIndex();
+    m_byFrame = !index.isEmpty() && totalFrames > 0;
+    if (m_byFrame) {
+        m_firstFrame = index.frameForTime(static_cast<quint32>(m_startMs), totalFrames, totalMs);
+        m_lastFrame = index.frameForTime(static_cast<quint32>(qMin<qint64>(m_endMs, totalMs)), totalFrames, totalMs);
+    } else {
+        qDebug() << "Range export without file index, bounds by time stamp";
+    }
+
+    m_accepting = true;
+    if (!m_player->startHeadless(this)) {
+        abort("Failed to start decoding " + m_filePath);
+        return;
+    }
+    // Frames decoded before the seek lands fall outside the range. Without
+    // the index the seek waits for the first stamp, the base of the range
+    if (m_byFrame && m_startMs > 0) {
+        m_player->seekToTime(m_startMs);
+    }
+}
+
+void RangeExporter::onFirstStamp(int serial)
+{
+    if (serial == m_serial && m_active && m_startMs > 0) {
+        m_player->seekToTime(m_startMs);
+    }
+}
+
+void RangeExporter::onFrame(const DecodedFrame &frame)
+{
+    if (!m_accepting.load(std::memory_order_acquire) || !frame.data || frame.size <= 0) {
+        return;
+    }
+
+    // Decoder stamps do not start at zero; the range is on the 0-based timeline
+    if (!m_byFrame && m_baseStampMs < 0) {
+        m_baseStampMs = frame.timestampMs;
+        QMetaObject::invokeMethod(this, "onFirstStamp", Qt::QueuedConnection, Q_ARG(int, m_serial));
+    }
+    const qint64 key = m_byFrame ? static_cast<qint64>(frame.frameNum) : frame.timestampMs - m_baseStampMs;
+    const qint64 first = m_byFrame ? static_cast<qint64>(m_firstFrame) : m_startMs;
+    const qint64 last = m_byFrame ? static_cast<qint64>(m_lastFrame) : m_endMs;
+    if (key > last) {
+        m_accepting = false;
+        QMetaObject::invokeMethod(this, "onDecodeComplete", Qt::QueuedConnection, Q_ARG(int, m_serial));
+        return;
+    }
+    // Before the range, or repeated while the seek settles
+    if (key < first || key <= m_lastKey) {
+        return;
+    }
+
+    // Hold the decoder back while encoders and disk catch up
+    while (!m_slots.tryAcquire(1, 20)) {
+        if (!m_accepting.load(std::memory_order_acquire)) {
+            return;
+        }
+    }
+    m_lastKey = key;
+
+    QByteArray buffer = acquireBuffer(frame.size);
+    memcpy(buffer.data(), frame.data, static_cast<size_t>(frame.size));
+
+    const int index = m_taken.fetch_add(1, std::memory_order_relaxed);
+    const QString filePath = QString("%1/%2_%3_f%4.%5").arg(m_directory, m_namePrefix)
+        .arg(index, 6, 10, QChar('0')).arg(frame.frameNum).arg(m_format == Jpeg ? "jpg" : "png");
+    m_encodePool.start(new RangeEncodeTask(this, m_serial, index, std::move(buffer), frame, filePath));
+
+    if (key == last) {
+        m_accepting = false;
+        QMetaObject::invokeMethod(this, "onDecodeComplete", Qt::QueuedConnection, Q_ARG(int, m_serial));
+    }
+}
+
+void RangeExporter::onEndOfStream()
+{
+    m_accepting = false;
+    QMetaObject::invokeMethod(this, "onDecodeComplete", Qt::QueuedConnection, Q_ARG(int, m_serial));
+}
+
+QByteArray RangeExporter::acquireBuffer(int size)
+{
+    {
+        QMutexLocker locker(&m_bufferMutex);
+        for (int i = 0; i < m_freeBuffers.size(); ++i) {
+            if (m_freeBuffers.at(i).size() == size) {
+                return m_freeBuffers.takeAt(i);
+            }
+        }
+    }
+    return QByteArray(size, Qt::Uninitialized);
+}
+
+void RangeExporter::releaseBuffer(QByteArray buffer)
+{
+    QMutexLocker locker(&m_bufferMutex);
+    if (m_freeBuffers.size() < m_slotCount) {
+        m_freeBuffers.append(std::move(buffer));
+    }
+}
+
+void RangeExporter::onDecodeComplete(int serial)
+{
+    if (serial != m_serial || !m_active || m_decodeComplete) {
+        return;
+    }
+    m_decodeComplete = true;
+    m_accepting = false;
+    // Returns once no onFrame() is running, so m_taken is final afterwards
+    m_player->stopHeadless();
+    finishIfDone();
+}
+
+void RangeExporter::onFrameEncoded(int serial, int index, const QString &filePath, const QByteArray &data)
+{
+    if (serial != m_serial) {
+        return;
+    }
+    m_encoded.insert(index, qMakePair(filePath, data));
+    writeReadyFrames();
+}
+
+void RangeExporter::writeReadyFrames()
+{
+    while (!m_encoded.isEmpty() && m_encoded.firstKey() == m_nextWrite) {
+        const QPair<QString, QByteArray> frame = m_encoded.take(m_nextWrite++);
+        if (frame.second.isEmpty()) {
+            onFrameWritten(m_serial, false);
+        } else {
+            m_writePool.start(new RangeWriteTask(this, m_serial, frame.first, frame.second));
+        }
+    }
+}
+
+void RangeExporter::onFrameWritten(int serial, bool ok)
+{
+    if (serial != m_serial) {
+        return;
+    }
+    if (ok) {
+        ++m_written;
+    } else {
+        ++m_failed;
+    }
+    m_slots.release();
+
+    const int total = m_byFrame ? static_cast<int>(m_lastFrame - m_firstFrame + 1) : 0;
+    emit progress(m_written, total);
+    finishIfDone();
+}
+
+void RangeExporter::finishIfDone()
+{
+    if (!m_active || !m_decodeComplete || m_written + m_failed < m_taken.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    m_active = false;
+    m_player->closeFile();
+    const qint64 elapsedMs = m_timer.elapsed();
+    const double fps = elapsedMs > 0 ? m_written * 1000.0 / elapsedMs : 0.0;
+    qDebug() << "Range export:" << m_written << "frames written," << m_failed << "failed in" << elapsedMs
+             << "ms =" << QString::number(fps, 'f', 1) << "fps on" << m_encodePool.maxThreadCount() << "encoders";
+    emit finished(m_written, m_failed, fps, m_directory);
+}
+
+void RangeExporter::abort(const QString &error)
+{
+    qDebug() << "Range export failed:" << error;
+    cancel();
+    emit exportFailed(error);
+}
+
+void RangeExporter::runBenchmark(const QString &filePath, qint64 startMs, qint64 endMs)
+{
+    const QString root = QDir::temp().filePath("range_export_bench");
+    QDir(root).removeRecursively();
+
+    // Headless decode with parallel encoding
+    int exported = 0;
+    qint64 exportMs = 0;
+    {
+        RangeExporter exporter;
+        QEventLoop loop;
+        connect(&exporter, &RangeExporter::finished, &loop, [&](int written, int, double, const QString &) {
+            exported = written;
+            loop.quit();
+        });
+        connect(&exporter, &RangeExporter::exportFailed, &loop, &QEventLoop::quit);
+
+        QElapsedTimer timer;
+        timer.start();
+        if (!exporter.start(filePath, startMs, endMs, root + "/export", Jpeg)) {
+            qDebug() << "Range export benchmark: cannot start";
+            return;
+        }
+        loop.exec();
+        exportMs = timer.elapsed();
+    }
+    if (exported == 0) {
+        qDebug() << "Range export benchmark: nothing exported from" << filePath;
+        return;
+    }
+
+    // Manual path: step one frame, snapshot it, wait for the file
+    int stepped = 0;
+    qint64 manualMs = 0;
+    {
+        MediaPlayerWrapper player;
+        player.initialize();
+        if (!player.openFile(filePath) || !player.play(nullptr)) {
+            qDebug() << "Range export benchmark: cannot open" << filePath << "for stepping";
+            return;
+        }
+        player.pause();
+        player.seekToTime(startMs);
+
+        QEventLoop loop;
+        connect(&player, &MediaPlayerWrapper::snapshotSaved, &loop, &QEventLoop::quit);
+        connect(&player, &MediaPlayerWrapper::snapshotFailed, &loop, &QEventLoop::quit);
+        QDir().mkpath(root + "/manual");
+
+        QElapsedTimer timer;
+        timer.start();
+        for (; stepped < exported; ++stepped) {
+            if (!player.stepFrame(1)
+                || !player.snapshot(QString("%1/manual/%2.jpg").arg(root).arg(stepped, 6, 10, QChar('0')),
+                                    MediaPlayerWrapper::Format_JPEG)) {
+                break;
+            }
+            loop.exec();
+        }
+        manualMs = timer.elapsed();
+        player.closeFile();
+    }
+
+    qDebug() << "Range export benchmark:" << exported << "frames exported in" << exportMs << "ms ="
+             << QString::number(exported * 1000.0 / qMax<qint64>(1, exportMs), 'f', 1) << "fps;"
+             << stepped << "frames stepped and snapshotted in" << manualMs << "ms ="
+             << QString::number(stepped * 1000.0 / qMax<qint64>(1, manualMs), 'f', 1) << "fps";
+}
@@ -0,0 +1,119 @@
+#ifndef RANGEEXPORTER_H
+#define RANGEEXPORTER_H
+
+#include <QObject>
+#include <QMutex>
+#include <QVector>
+#include <QMap>
+#include <QPair>
+#include <QByteArray>
+#include <QThreadPool>
+#include <QSemaphore>
+#include <QElapsedTimer>
+#include <QString>
+#include <QTimer>
+#include <atomic>
+#include "FrameConsumer.h"
+#include "JpegEncoder.h"
+
+class MediaPlayerWrapper;
+
+// Exports every frame of a time range of a recording as numbered stills.
+// The file is opened on a port of its own and decoded headlessly, so the
+// player window is not disturbed. The decode thread only copies frames;
+// encoding fans out over one thread per core, and a single writer puts the
+// results into the output directory in frame order.
+class RangeExporter : public QObject, public FrameConsumer
+{
+    Q_OBJECT
+
+public:
+    enum Format {
+        Jpeg = 0,
+        Png = 1
+    };
+
+    explicit RangeExporter(QObject *parent = nullptr);
+    ~RangeExporter();
+
+    // Frames shown from startMs to endMs inclusive. Returns false if an
+    // export is running or the directory cannot be created; later errors
+    // arrive as exportFailed().
+    bool start(const QString &filePath, qint64 startMs, qint64 endMs, const QString &directory, int format);
+    void cancel();
+    bool isActive() const { return m_active; }
+
+    // FrameConsumer, on the SDK decode thread
+    void onFrame(const DecodedFrame &frame) override;
+    void onEndOfStream() override;
+
+    // Exports the range, then saves the same number of frames the manual
+    // way (stepForward() plus a snapshot each) and logs both rates.
+    static void runBenchmark(const QString &filePath, qint64 startMs, qint64 endMs);
+
+signals:
+    // total is 0 while the frame count of the range is unknown
+    void progress(int written, int total);
+    void finished(int written, int failed, double fps, const QString &directory);
+    void exportFailed(const QString &error);
+
+private slots:
+    void onFileOpened(const QString &filePath);
+    void onFileOpenFailed(const QString &filePath, const QString &error);
+    void onIndexReady();
+    void beginDecode();
+    void onFirstStamp(int serial);
+    void onDecodeComplete(int serial);
+    void onFrameEncoded(int serial, int index, const QString &filePath, const QByteArray &data);
+    void onFrameWritten(int serial, bool ok);
+
+private:
+    friend class RangeEncodeTask;
+
+    QByteArray acquireBuffer(int size);
+    void releaseBuffer(QByteArray buffer);
+    void writeReadyFrames();
+    void finishIfDone();
+    void abort(const QString &error);
+
+    MediaPlayerWrapper *m_player;
+    QThreadPool m_encodePool;
+    QThreadPool m_writePool;            // one thread, so files land in order
+    JpegEncoder m_jpegEncoder;
+    QTimer m_indexWaitTimer;
+
+    // Job; the serial tells results of a cancelled job from the current one
+    int m_serial;
+    QString m_filePath;
+    QString m_directory;
+    QString m_namePrefix;
+    int m_format;
+    qint64 m_startMs;
+    qint64 m_endMs;
+    bool m_active;
+    bool m_decodeStarted;
+    bool m_decodeComplete;
+
+    // Range filter; frame numbers once the file index exists, else stamps
+    bool m_byFrame;
+    quint32 m_firstFrame;
+    quint32 m_lastFrame;
+    qint64 m_lastKey;                   // decode thread only
+    qint64 m_baseStampMs;               // decode thread only; stamp of frame 0
+    std::atomic<bool> m_accepting;
+    std::atomic<int> m_taken;
+    QSemaphore m_slots;                 // frames copied but not yet written
+    int m_slotCount;
+
+    // Finished out of order, by index; empty data means encoding failed
+    QMap<int, QPair<QString, QByteArray> > m_encoded;
+    int m_nextWrite;
+    int m_written;
+    int m_failed;
+    QElapsedTimer m_timer;
+
+    QMutex m_bufferMutex;
+    QVector<QByteArray> m_freeBuffers;
+};
+
+#endif // RANGEEXPORTER_H
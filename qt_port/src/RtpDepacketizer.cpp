@@ -0,0 +1,284 @@
+#include "RtpDepacketizer.h"
+
+static const uchar kStartCode[4] = { 0x00, 0x00, 0x00, 0x01 };
+
+RtpDepacketizer::RtpDepacketizer(Codec codec)
+    : m_codec(codec)
+    , m_payloadType(-1)
+    , m_sink(nullptr)
+{
+    reset();
+}
+
+void RtpDepacketizer::setCodec(Codec codec)
+{
+    m_codec = codec;
+    reset();
+}
+
+void RtpDepacketizer::setParameterSets(const QList<QByteArray> &nalUnits)
+{
+    m_parameterSets = nalUnits;
+}
+
+void RtpDepacketizer::reset()
+{
+    m_haveSequence = false;
+    m_lastSequence = 0;
+    m_haveTimestamp = false;
+    m_currentTimestamp = 0;
+    m_auOpen = false;
+    m_auKeyFrame = false;
+    m_auHasParameterSets = false;
+    m_auDamaged = false;
+    m_inFragment = false;
+    m_receivedPackets = 0;
+    m_lostPackets = 0;
+}
+
+bool RtpDepacketizer::inputRtpPacket(const uchar *data, int size)
+{
+    if (!m_sink || !data || size < 12) {
+        return false;
+    }
+
+    // Fixed header: V=2, P, X, CC | M, PT | sequence | timestamp | SSRC
+    if ((data[0] >> 6) != 2) {
+        return false;
+    }
+
+    const bool padding = (data[0] & 0x20) != 0;
+    const bool extension = (data[0] & 0x10) != 0;
+    const int csrcCount = data[0] & 0x0F;
+    const bool marker = (data[1] & 0x80) != 0;
+    const int payloadType = data[1] & 0x7F;
+
+    if (m_payloadType >= 0 && payloadType != m_payloadType) {
+        return false;
+    }
+
+    const quint16 sequence = static_cast<quint16>((data[2] << 8) | data[3]);
+    const quint32 timestamp = (quint32(data[4]) << 24) | (quint32(data[5]) << 16)
+                            | (quint32(data[6]) << 8) | quint32(data[7]);
+
+    int offset = 12 + csrcCount * 4;
+    if (extension) {
+        if (size < offset + 4) {
+            return false;
+        }
+        offset += 4 + ((data[offset + 2] << 8) | data[offset + 3]) * 4;
+    }
+
+    int end = size;
+    if (padding) {
+        end -= data[size - 1];
+    }
+    if (offset >= end) {
+        return false;
+    }
+
+    bool lost = false;
+    if (m_haveSequence) {
+        const quint16 expected = static_cast<quint16>(m_lastSequence + 1);
+        if (sequence != expected) {
+            const quint16 gap = static_cast<quint16>(sequence - expected);
+            if (gap >= 0x8000) {
+                // Late or duplicated packet, already past it.
+                return false;
+            }
+            m_lostPackets += gap;
+            lost = true;
+        }
+    }
+    m_haveSequence = true;
+    m_lastSequence = sequence;
+    ++m_receivedPackets;
+
+    // A new timestamp starts a new access unit even if the marker was lost.
+    if (m_haveTimestamp && timestamp != m_currentTimestamp) {
+        if (lost) {
+            m_auDamaged = true;
+        }
+        flushAccessUnit();
+    }
+    m_haveTimestamp = true;
+    m_currentTimestamp = timestamp;
+
+    if (lost) {
+        // The gap may hold the start of this unit as well.
+        m_auDamaged = true;
+        m_inFragment = false;
+    }
+
+    inputPayload(data + offset, end - offset);
+
+    if (marker) {
+        flushAccessUnit();
+    }
+
+    return true;
+}
+
+void RtpDepacketizer::inputPayload(const uchar *payload, int size)
+{
+    if (m_codec == CodecH265) {
+        inputH265(payload, size);
+    } else {
+        inputH264(payload, size);
+    }
+}
+
+void RtpDepacketizer::inputH264(const uchar *payload, int size)
+{
+    const int type = payload[0] & 0x1F;
+
+    if (type >= 1 && type <= 23) {
+        // Single NAL unit packet
+        writeNal(payload, size);
+    } else if (type == 24) {
+        // STAP-A: [16-bit size][NAL]...
+        int pos = 1;
+        while (pos + 2 <= size) {
+            const int nalSize = (payload[pos] << 8) | payload[pos + 1];
+            pos += 2;
+            if (nalSize == 0 || pos + nalSize > size) {
+                break;
+            }
+            writeNal(payload + pos, nalSize);
+            pos += nalSize;
+        }
+    } else if (type == 28) {
+        // FU-A: indicator, FU header, fragment
+        if (size < 2) {
+            return;
+        }
+        const uchar fuHeader = payload[1];
+        if (fuHeader & 0x80) {
+            const uchar nalHeader = static_cast<uchar>((payload[0] & 0xE0) | (fuHeader & 0x1F));
+            beginNal(&nalHeader, 1);
+            m_inFragment = true;
+        } else if (!m_inFragment) {
+            return;
+        }
+        m_sink->write(payload + 2, size - 2);
+        if (fuHeader & 0x40) {
+            m_inFragment = false;
+        }
+    }
+}
+
+void RtpDepacketizer::inputH265(const uchar *payload, int size)
+{
+    if (size < 2) {
+        return;
+    }
+
+    const int type = (payload[0] >> 1) & 0x3F;
+
+    if (type < 48) {
+        writeNal(payload, size);
+    } else if (type == 48) {
+        // Aggregation packet: 2-byte payload header, then [16-bit size][NAL]...
+        int pos = 2;
+        while (pos + 2 <= size) {
+            const int nalSize = (payload[pos] << 8) | payload[pos + 1];
+            pos += 2;
+            if (nalSize == 0 || pos + nalSize > size) {
+                break;
+            }
+            writeNal(payload + pos, nalSize);
+            pos += nalSize;
+        }
+    } else if (type == 49) {
+        // Fragmentation unit: 2-byte payload header, FU header, fragment
+        if (size < 3) {
+            return;
+        }
+        const uchar fuHeader = payload[2];
+        if (fuHeader & 0x80) {
+            uchar nalHeader[2];
+            nalHeader[0] = static_cast<uchar>((payload[0] & 0x81) | ((fuHeader & 0x3F) << 1));
+            nalHeader[1] = payload[1];
+            beginNal(nalHeader, 2);
+            m_inFragment = true;
+        } else if (!m_inFragment) {
+            return;
+        }
+        m_sink->write(payload + 3, size - 3);
+        if (fuHeader & 0x40) {
+            m_inFragment = false;
+        }
+    }
+}
+
+void RtpDepacketizer::writeNal(const uchar *nal, int size)
+{
+    m_inFragment = false;
+    beginNal(nal, size);
+}
+
+void RtpDepacketizer::beginNal(const uchar *header, int headerSize)
+{
+    const int nalType = (m_codec == CodecH265) ? ((header[0] >> 1) & 0x3F) : (header[0] & 0x1F);
+
+    m_auOpen = true;
+    noteNalType(nalType);
+
+    if (isKeyNal(nalType) && !m_auHasParameterSets && !m_parameterSets.isEmpty()) {
+        for (const QByteArray &nal : m_parameterSets) {
+            m_sink->write(kStartCode, sizeof(kStartCode));
+            m_sink->write(reinterpret_cast<const uchar *>(nal.constData()), nal.size());
+        }
+        m_auHasParameterSets = true;
+    }
+
+    m_sink->write(kStartCode, sizeof(kStartCode));
+    m_sink->write(header, headerSize);
+}
+
+void RtpDepacketizer::noteNalType(int nalType)
+{
+    if (isKeyNal(nalType)) {
+        m_auKeyFrame = true;
+    }
+    if (isParameterSetNal(nalType)) {
+        m_auHasParameterSets = true;
+    }
+}
+
+bool RtpDepacketizer::isKeyNal(int nalType) const
+{
+    if (m_codec == CodecH265) {
+        return nalType >= 16 && nalType <= 21;  // BLA/IDR/CRA
+    }
+    return nalType == 5;  // IDR slice
+}
+
+bool RtpDepacketizer::isParameterSetNal(int nalType) const
+{
+    if (m_codec == CodecH265) {
+        return nalType == 32 || nalType == 33;  // VPS/SPS
+    }
+    return nalType == 7;  // SPS
+}
+
+void RtpDepacketizer::flushAccessUnit()
+{
+    if (m_auOpen) {
+        if (m_auDamaged) {
+            m_sink->discardAccessUnit();
+        } else {
+            m_sink->endAccessUnit(m_auKeyFrame);
+        }
+    }
+    dropAccessUnit();
+}
+
+void RtpDepacketizer::dropAccessUnit()
+{
+    m_auOpen = false;
+    m_auKeyFrame = false;
+    m_auHasParameterSets = false;
+    m_auDamaged = false;
+    m_inFragment = false;
+}
@@ -0,0 +1,84 @@
+#ifndef RTPDEPACKETIZER_H
+#define RTPDEPACKETIZER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QtGlobal>
+
+// Reassembles RTP H.264 (RFC 6184) and H.265 (RFC 7798) payloads into an
+// Annex-B elementary stream, the same format PlayM4_InputData accepted from
+// the old "ffmpeg -f h264" pipe.
+class RtpDepacketizer
+{
+public:
+    enum Codec {
+        CodecH264 = 0,
+        CodecH265 = 1
+    };
+
+    // Receives the reassembled stream. Bytes of one access unit arrive through
+    // write() and are closed by endAccessUnit(); a damaged unit is dropped
+    // with discardAccessUnit().
+    class Sink
+    {
+    public:
+        virtual ~Sink() {}
+        virtual void write(const uchar *data, int size) = 0;
+        virtual void endAccessUnit(bool keyFrame) = 0;
+        virtual void discardAccessUnit() = 0;
+    };
+
+    explicit RtpDepacketizer(Codec codec = CodecH264);
+
+    void setCodec(Codec codec);
+    Codec codec() const { return m_codec; }
+    void setPayloadType(int payloadType) { m_payloadType = payloadType; }
+    void setSink(Sink *sink) { m_sink = sink; }
+
+    // Out-of-band parameter sets (sprop-*) written ahead of the first key frame
+    // when the stream does not carry them inline.
+    void setParameterSets(const QList<QByteArray> &nalUnits);
+    void reset();
+
+    // One complete RTP packet, header included.
+    bool inputRtpPacket(const uchar *data, int size);
+
+    quint64 receivedPackets() const { return m_receivedPackets; }
+    quint64 lostPackets() const { return m_lostPackets; }
+    // RTP timestamp of the access unit being reassembled, also while the
+    // sink's endAccessUnit() runs for it
+    quint32 currentTimestamp() const { return m_currentTimestamp; }
+
+private:
+    void inputPayload(const uchar *payload, int size);
+    void inputH264(const uchar *payload, int size);
+    void inputH265(const uchar *payload, int size);
+    void writeNal(const uchar *nal, int size);
+    void beginNal(const uchar *header, int headerSize);
+    void noteNalType(int nalType);
+    bool isKeyNal(int nalType) const;
+    bool isParameterSetNal(int nalType) const;
+    void flushAccessUnit();
+    void dropAccessUnit();
+
+    Codec m_codec;
+    int m_payloadType;
+    Sink *m_sink;
+    QList<QByteArray> m_parameterSets;
+
+    bool m_haveSequence;
+    quint16 m_lastSequence;
+    bool m_haveTimestamp;
+    quint32 m_currentTimestamp;
+
+    bool m_auOpen;
+    bool m_auKeyFrame;
+    bool m_auHasParameterSets;
+    bool m_auDamaged;
+    bool m_inFragment;
+
+    quint64 m_receivedPackets;
+    quint64 m_lostPackets;
+};
+
+#endif // RTPDEPACKETIZER_H
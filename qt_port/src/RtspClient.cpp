@@ -0,0 +1,699 @@
+#include "RtspClient.h"
+#include "MediaPlayerWrapper.h"
+#include "StreamRingBuffer.h"
+#include <QDebug>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QHostAddress>
+#include <QList>
+#include <QPair>
+
+static const int kRtspPort = 554;
+static const int kMaxControlBuffer = 4 * 1024 * 1024;
+static const int kMaxDatagram = 65536;
+
+typedef QList<QPair<QByteArray, QByteArray> > HeaderList;
+
+static QByteArray md5Hex(const QByteArray &data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Md5).toHex();
+}
+
+// Parses the comma separated key="value" list of a WWW-Authenticate header.
+static QMap<QByteArray, QByteArray> parseAuthParams(const QByteArray &params)
+{
+    QMap<QByteArray, QByteArray> result;
+    int pos = 0;
+    while (pos < params.size()) {
+        while (pos < params.size() && (params[pos] == ' ' || params[pos] == ',')) {
+            ++pos;
+        }
+        int eq = params.indexOf('=', pos);
+        if (eq < 0) {
+            break;
+        }
+        QByteArray key = params.mid(pos, eq - pos).trimmed().toLower();
+        pos = eq + 1;
+        QByteArray value;
+        if (pos < params.size() && params[pos] == '"') {
+            int close = params.indexOf('"', pos + 1);
+            if (close < 0) {
+                close = params.size();
+            }
+            value = params.mid(pos + 1, close - pos - 1);
+            pos = close + 1;
+        } else {
+            int comma = params.indexOf(',', pos);
+            if (comma < 0) {
+                comma = params.size();
+            }
+            value = params.mid(pos, comma - pos).trimmed();
+            pos = comma;
+        }
+        result.insert(key, value);
+    }
+    return result;
+}
+
+RtspClient::RtspClient(MediaPlayerWrapper *player, const QString &url, Transport transport, QObject *parent)
+    : QObject(parent)
+    , m_player(player)
+    , m_url(url)
+    , m_transport(transport)
+    , m_state(Idle)
+    , m_socket(nullptr)
+    , m_rtpSocket(nullptr)
+    , m_rtcpSocket(nullptr)
+    , m_keepAliveTimer(nullptr)
+    , m_ring(nullptr)
+    , m_ringOverflow(false)
+    , m_dropUntilKeyFrame(false)
+    , m_cseq(0)
+    , m_authRetried(false)
+    , m_nonceCount(0)
+    , m_sessionTimeout(60)
+    , m_rtpChannel(0)
+    , m_receivedBytes(0)
+    , m_statWakeups(0)
+    , m_statBytes(0)
+    , m_statAccessUnits(0)
+    , m_statLatencyTotalUs(0)
+    , m_statLatencyMaxUs(0)
+    , m_statDroppedGops(0)
+    , m_statDroppedUnits(0)
+{
+    QUrl plain(m_url);
+    plain.setUserInfo(QString());
+    if (plain.port() == kRtspPort) {
+        plain.setPort(-1);
+    }
+    m_requestUrl = plain.toString();
+
+    m_depacketizer.setSink(this);
+}
+
+RtspClient::~RtspClient()
+{
+    stop();
+}
+
+void RtspClient::start()
+{
+    if (m_state != Idle) {
+        return;
+    }
+
+    if (m_url.scheme().compare("rtsp", Qt::CaseInsensitive) != 0 || m_url.host().isEmpty()) {
+        fail(QString("Unsupported stream URL: %1").arg(m_url.toString(QUrl::RemoveUserInfo)));
+        return;
+    }
+
+    m_ring = m_player ? m_player->streamRing() : nullptr;
+    if (!m_ring) {
+        fail("Stream is not open for input");
+        return;
+    }
+
+    m_socket = new QTcpSocket(this);
+    m_socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    connect(m_socket, &QTcpSocket::connected, this, &RtspClient::onConnected);
+    connect(m_socket, &QTcpSocket::readyRead, this, &RtspClient::onControlReadyRead);
+    connect(m_socket, static_cast<void (QAbstractSocket::*)(QAbstractSocket::SocketError)>(&QAbstractSocket::error),
+            this, &RtspClient::onSocketError);
+
+    m_keepAliveTimer = new QTimer(this);
+    connect(m_keepAliveTimer, &QTimer::timeout, this, &RtspClient::onKeepAlive);
+
+    m_rxBuffer.reserve(64 * 1024);
+    m_state = Options;
+    m_socket->connectToHost(m_url.host(), static_cast<quint16>(m_url.port(kRtspPort)));
+}
+
+void RtspClient::stop()
+{
+    // The player frees the ring once stop() has returned
+    m_ring = nullptr;
+    if (m_state == Idle) {
+        return;
+    }
+
+    if (m_keepAliveTimer) {
+        m_keepAliveTimer->stop();
+    }
+
+    if (m_socket && m_socket->state() == QAbstractSocket::ConnectedState && !m_sessionId.isEmpty()) {
+        m_state = Teardown;
+        sendRequest("TEARDOWN", m_sessionControl.isEmpty() ? m_requestUrl : m_sessionControl);
+        m_socket->waitForBytesWritten(500);
+    }
+
+    if (m_socket) {
+        m_socket->disconnect(this);
+        m_socket->abort();
+    }
+    if (m_rtpSocket) {
+        m_rtpSocket->close();
+    }
+    if (m_rtcpSocket) {
+        m_rtcpSocket->close();
+    }
+
+    m_state = Idle;
+    m_sessionId.clear();
+    emit streamStopped();
+}
+
+void RtspClient::onConnected()
+{
+    qDebug() << "RTSP connected to" << m_url.host();
+    sendRequest("OPTIONS", m_requestUrl);
+}
+
+void RtspClient::onSocketError(QAbstractSocket::SocketError error)
+{
+    Q_UNUSED(error)
+    if (m_state == Idle || m_state == Teardown) {
+        return;
+    }
+    fail(QString("RTSP connection error: %1").arg(m_socket->errorString()));
+}
+
+void RtspClient::onKeepAlive()
+{
+    if (m_state == Playing) {
+        sendRequest("OPTIONS", m_requestUrl);
+    }
+}
+
+void RtspClient::fail(const QString &error)
+{
+    qDebug() << "RTSP error:" << error;
+    emit streamError(error);
+    stop();
+}
+
+void RtspClient::sendRequest(const QByteArray &method, const QString &uri, const HeaderList &headers)
+{
+    m_pendingMethod = method;
+    m_pendingUri = uri;
+    m_pendingHeaders = headers;
+
+    QByteArray request;
+    request.reserve(512);
+    request += method + ' ' + uri.toUtf8() + " RTSP/1.0\r\n";
+    request += "CSeq: " + QByteArray::number(++m_cseq) + "\r\n";
+    request += "User-Agent: ShinPlayer\r\n";
+
+    QByteArray authorization = authorizationHeader(method, uri);
+    if (!authorization.isEmpty()) {
+        request += "Authorization: " + authorization + "\r\n";
+    }
+    if (!m_sessionId.isEmpty()) {
+        request += "Session: " + m_sessionId + "\r\n";
+    }
+    for (const QPair<QByteArray, QByteArray> &header : headers) {
+        request += header.first + ": " + header.second + "\r\n";
+    }
+    request += "\r\n";
+
+    m_socket->write(request);
+}
+
+void RtspClient::resendWithAuthorization()
+{
+    sendRequest(m_pendingMethod, m_pendingUri, m_pendingHeaders);
+}
+
+QByteArray RtspClient::authorizationHeader(const QByteArray &method, const QString &uri) const
+{
+    if (m_authScheme.isEmpty() || m_url.userName().isEmpty()) {
+        return QByteArray();
+    }
+
+    const QByteArray user = m_url.userName().toUtf8();
+    const QByteArray password = m_url.password().toUtf8();
+
+    if (m_authScheme == "basic") {
+        return "Basic " + (user + ':' + password).toBase64();
+    }
+
+    // Digest (RFC 2617), MD5 with optional qop=auth
+    const QByteArray ha1 = md5Hex(user + ':' + m_realm + ':' + password);
+    const QByteArray ha2 = md5Hex(method + ':' + uri.toUtf8());
+    QByteArray header = "Digest username=\"" + user + "\", realm=\"" + m_realm
+                      + "\", nonce=\"" + m_nonce + "\", uri=\"" + uri.toUtf8() + "\"";
+
+    if (m_qop.split(',').contains("auth")) {
+        const QByteArray nc = QByteArray::number(++m_nonceCount, 16).rightJustified(8, '0');
+        const QByteArray cnonce = md5Hex(QByteArray::number(QDateTime::currentMSecsSinceEpoch())).left(16);
+        const QByteArray response = md5Hex(ha1 + ':' + m_nonce + ':' + nc + ':' + cnonce + ":auth:" + ha2);
+        header += ", qop=auth, nc=" + nc + ", cnonce=\"" + cnonce + "\", response=\"" + response + "\"";
+    } else {
+        header += ", response=\"" + md5Hex(ha1 + ':' + m_nonce + ':' + ha2) + "\"";
+    }
+    return header;
+}
+
+void RtspClient::onControlReadyRead()
+{
+    m_wakeTimer.start();
+    ++m_statWakeups;
+
+    // Read straight into the reserved buffer instead of readAll() so the
+    // interleaved RTP path does not allocate per read.
+    qint64 available = m_socket->bytesAvailable();
+    while (available > 0) {
+        const int oldSize = m_rxBuffer.size();
+        if (oldSize + available > kMaxControlBuffer) {
+            fail("RTSP receive buffer overflow");
+            return;
+        }
+        m_rxBuffer.resize(oldSize + static_cast<int>(available));
+        qint64 got = m_socket->read(m_rxBuffer.data() + oldSize, available);
+        if (got < 0) {
+            got = 0;
+        }
+        m_rxBuffer.resize(oldSize + static_cast<int>(got));
+        m_receivedBytes += got;
+        m_statBytes += got;
+
+        processControlBuffer();
+        if (m_state == Idle) {
+            return;
+        }
+        available = m_socket->bytesAvailable();
+    }
+}
+
+void RtspClient::processControlBuffer()
+{
+    const uchar *data = reinterpret_cast<const uchar *>(m_rxBuffer.constData());
+    const int size = m_rxBuffer.size();
+    int pos = 0;
+
+    while (pos < size && m_state != Idle) {
+        if (data[pos] == '$') {
+            // Interleaved binary data: '$', channel, 16-bit length
+            if (size - pos < 4) {
+                break;
+            }
+            const int channel = data[pos + 1];
+            const int length = (data[pos + 2] << 8) | data[pos + 3];
+            if (size - pos - 4 < length) {
+                break;
+            }
+            if (channel == m_rtpChannel) {
+                m_depacketizer.inputRtpPacket(data + pos + 4, length);
+            }
+            pos += 4 + length;
+            continue;
+        }
+
+        if (data[pos] != 'R') {
+            // Resynchronise on the next message or interleaved frame
+            ++pos;
+            continue;
+        }
+
+        const int headerEnd = m_rxBuffer.indexOf("\r\n\r\n", pos);
+        if (headerEnd < 0) {
+            break;
+        }
+
+        const QList<QByteArray> lines = m_rxBuffer.mid(pos, headerEnd - pos).split('\n');
+        Response response;
+        response.statusCode = 0;
+        if (!lines.isEmpty()) {
+            const QList<QByteArray> status = lines.first().trimmed().split(' ');
+            if (status.size() >= 2 && status.first().startsWith("RTSP/")) {
+                response.statusCode = status.at(1).toInt();
+            }
+        }
+        for (int i = 1; i < lines.size(); ++i) {
+            const int colon = lines.at(i).indexOf(':');
+            if (colon > 0) {
+                response.headers.insert(lines.at(i).left(colon).trimmed().toLower(),
+                                        lines.at(i).mid(colon + 1).trimmed());
+            }
+        }
+
+        const int contentLength = response.headers.value("content-length").toInt();
+        const int bodyStart = headerEnd + 4;
+        if (size - bodyStart < contentLength) {
+            break;
+        }
+        response.body = m_rxBuffer.mid(bodyStart, contentLength);
+        pos = bodyStart + contentLength;
+
+        if (response.statusCode > 0) {
+            handleResponse(response);
+        }
+    }
+
+    if (m_state == Idle) {
+        m_rxBuffer.resize(0);
+    } else if (pos > 0) {
+        m_rxBuffer.remove(0, pos);
+    }
+}
+
+void RtspClient::handleResponse(const Response &response)
+{
+    if (response.statusCode == 401 && !m_authRetried && !m_url.userName().isEmpty()) {
+        const QByteArray challenge = response.headers.value("www-authenticate");
+        const int space = challenge.indexOf(' ');
+        m_authScheme = challenge.left(space).toLower();
+        const QMap<QByteArray, QByteArray> params = parseAuthParams(challenge.mid(space + 1));
+        m_realm = params.value("realm");
+        m_nonce = params.value("nonce");
+        m_qop = params.value("qop");
+        m_nonceCount = 0;
+        m_authRetried = true;
+        resendWithAuthorization();
+        return;
+    }
+
+    if (m_state == Teardown) {
+        return;
+    }
+
+    if (response.statusCode != 200) {
+        fail(QString("RTSP %1 failed with status %2")
+             .arg(QString::fromLatin1(m_pendingMethod))
+             .arg(response.statusCode));
+        return;
+    }
+    m_authRetried = false;
+
+    switch (m_state) {
+    case Options: {
+        HeaderList headers;
+        headers << qMakePair(QByteArray("Accept"), QByteArray("application/sdp"));
+        m_state = Describe;
+        sendRequest("DESCRIBE", m_requestUrl, headers);
+        break;
+    }
+    case Describe: {
+        m_contentBase = QString::fromUtf8(response.headers.value("content-base"));
+        if (m_contentBase.isEmpty()) {
+            m_contentBase = QString::fromUtf8(response.headers.value("content-location"));
+        }
+        if (m_contentBase.isEmpty()) {
+            m_contentBase = m_requestUrl;
+        }
+        if (!parseSdp(response.body)) {
+            fail("No H.264/H.265 video track in stream description");
+            return;
+        }
+
+        QByteArray transport;
+        if (m_transport == TransportUdp) {
+            if (!bindUdpPorts()) {
+                fail("Failed to bind RTP/RTCP UDP ports");
+                return;
+            }
+            transport = "RTP/AVP;unicast;client_port=" + QByteArray::number(m_rtpSocket->localPort())
+                      + '-' + QByteArray::number(m_rtcpSocket->localPort());
+        } else {
+            transport = "RTP/AVP/TCP;unicast;interleaved=0-1";
+        }
+
+        HeaderList headers;
+        headers << qMakePair(QByteArray("Transport"), transport);
+        m_state = Setup;
+        sendRequest("SETUP", m_trackControl, headers);
+        break;
+    }
+    case Setup: {
+        const QByteArray session = response.headers.value("session");
+        const QList<QByteArray> sessionParts = session.split(';');
+        m_sessionId = sessionParts.first().trimmed();
+        for (int i = 1; i < sessionParts.size(); ++i) {
+            const QByteArray part = sessionParts.at(i).trimmed();
+            if (part.startsWith("timeout=")) {
+                m_sessionTimeout = qMax(10, part.mid(8).toInt());
+            }
+        }
+
+        const QByteArray transport = response.headers.value("transport");
+        const int interleaved = transport.indexOf("interleaved=");
+        if (interleaved >= 0) {
+            m_rtpChannel = transport.mid(interleaved + 12).split('-').first().toInt();
+        }
+
+        HeaderList headers;
+        headers << qMakePair(QByteArray("Range"), QByteArray("npt=0.000-"));
+        m_state = Play;
+        sendRequest("PLAY", m_sessionControl.isEmpty() ? m_requestUrl : m_sessionControl, headers);
+        break;
+    }
+    case Play:
+        m_state = Playing;
+        m_keepAliveTimer->start(m_sessionTimeout * 1000 / 2);
+        qDebug() << "RTSP playing, session" << m_sessionId << "channel" << m_rtpChannel;
+        emit streamStarted();
+        break;
+    default:
+        break;
+    }
+}
+
+bool RtspClient::parseSdp(const QByteArray &sdp)
+{
+    const QList<QByteArray> lines = sdp.split('\n');
+    bool inMedia = false;
+    bool inVideo = false;
+    bool found = false;
+    int payloadType = -1;
+    RtpDepacketizer::Codec codec = RtpDepacketizer::CodecH264;
+    QString trackControl;
+    QList<QByteArray> parameterSets;
+
+    for (const QByteArray &rawLine : lines) {
+        const QByteArray line = rawLine.trimmed();
+
+        if (line.startsWith("m=")) {
+            if (found) {
+                break;  // first video track only
+            }
+            inMedia = true;
+            inVideo = line.startsWith("m=video");
+            if (inVideo) {
+                const QList<QByteArray> fields = line.split(' ');
+                if (fields.size() >= 4) {
+                    payloadType = fields.at(3).toInt();
+                }
+            }
+            continue;
+        }
+
+        if (line.startsWith("a=control:")) {
+            const QString control = QString::fromUtf8(line.mid(10));
+            if (inVideo) {
+                trackControl = control;
+            } else if (!inMedia) {
+                m_sessionControl = resolveControlUrl(control);
+            }
+            continue;
+        }
+
+        if (!inVideo) {
+            continue;
+        }
+
+        if (line.startsWith("a=rtpmap:")) {
+            const QByteArray encoding = line.mid(line.indexOf(' ') + 1).toUpper();
+            if (encoding.startsWith("H264")) {
+                codec = RtpDepacketizer::CodecH264;
+                found = true;
+            } else if (encoding.startsWith("H265") || encoding.startsWith("HEVC")) {
+                codec = RtpDepacketizer::CodecH265;
+                found = true;
+            }
+        } else if (line.startsWith("a=fmtp:")) {
+            const QList<QByteArray> params = line.mid(line.indexOf(' ') + 1).split(';');
+            QList<QByteArray> vps, sps, pps;
+            for (const QByteArray &rawParam : params) {
+                const QByteArray param = rawParam.trimmed();
+                const int eq = param.indexOf('=');
+                if (eq < 0) {
+                    continue;
+                }
+                const QByteArray key = param.left(eq).toLower();
+                const QByteArray value = param.mid(eq + 1);
+                if (key == "sprop-parameter-sets") {
+                    for (const QByteArray &set : value.split(',')) {
+                        sps << QByteArray::fromBase64(set);
+                    }
+                } else if (key == "sprop-vps") {
+                    vps << QByteArray::fromBase64(value);
+                } else if (key == "sprop-sps") {
+                    sps << QByteArray::fromBase64(value);
+                } else if (key == "sprop-pps") {
+                    pps << QByteArray::fromBase64(value);
+                }
+            }
+            parameterSets = vps + sps + pps;
+        }
+    }
+
+    if (!found) {
+        return false;
+    }
+
+    m_trackControl = resolveControlUrl(trackControl);
+    m_depacketizer.setCodec(codec);
+    m_depacketizer.setPayloadType(payloadType);
+    m_depacketizer.setParameterSets(parameterSets);
+
+    qDebug() << "RTSP video track:" << (codec == RtpDepacketizer::CodecH265 ? "H.265" : "H.264")
+             << "pt" << payloadType << "control" << m_trackControl;
+    return true;
+}
+
+QString RtspClient::resolveControlUrl(const QString &control) const
+{
+    if (control.isEmpty() || control == "*") {
+        return m_contentBase;
+    }
+    if (control.startsWith("rtsp://", Qt::CaseInsensitive)) {
+        return control;
+    }
+    if (m_contentBase.endsWith('/')) {
+        return m_contentBase + control;
+    }
+    return m_contentBase + '/' + control;
+}
+
+bool RtspClient::bindUdpPorts()
+{
+    m_rtpSocket = new QUdpSocket(this);
+    m_rtcpSocket = new QUdpSocket(this);
+    m_datagram.resize(kMaxDatagram);
+
+    // RTP wants an even port with RTCP on the next one up.
+    for (int attempt = 0; attempt < 32; ++attempt) {
+        if (!m_rtpSocket->bind(QHostAddress::AnyIPv4, 0)) {
+            continue;
+        }
+        quint16 rtpPort = m_rtpSocket->localPort();
+        if (rtpPort % 2 != 0) {
+            m_rtpSocket->close();
+            if (!m_rtpSocket->bind(QHostAddress::AnyIPv4, rtpPort + 1)) {
+                continue;
+            }
+            rtpPort = m_rtpSocket->localPort();
+        }
+        if (m_rtcpSocket->bind(QHostAddress::AnyIPv4, rtpPort + 1)) {
+            m_rtpSocket->setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption, 2 * 1024 * 1024);
+            connect(m_rtpSocket, &QUdpSocket::readyRead, this, &RtspClient::onRtpReadyRead);
+            return true;
+        }
+        m_rtpSocket->close();
+    }
+    return false;
+}
+
+void RtspClient::onRtpReadyRead()
+{
+    m_wakeTimer.start();
+    ++m_statWakeups;
+
+    while (m_rtpSocket->hasPendingDatagrams()) {
+        const qint64 size = m_rtpSocket->readDatagram(m_datagram.data(), m_datagram.size());
+        if (size <= 0) {
+            continue;
+        }
+        m_receivedBytes += size;
+        m_statBytes += size;
+        m_depacketizer.inputRtpPacket(reinterpret_cast<const uchar *>(m_datagram.constData()),
+                                      static_cast<int>(size));
+    }
+}
+
+void RtspClient::write(const uchar *data, int size)
+{
+    // Stopped; the ring may be gone already
+    if (!m_ring) {
+        return;
+    }
+    if (!m_ringOverflow && !m_ring->write(data, size)) {
+        m_ringOverflow = true;
+    }
+}
+
+void RtspClient::endAccessUnit(bool keyFrame)
+{
+    if (!m_ring) {
+        return;
+    }
+    if (m_ring->resyncRequested()) {
+        // The decoder was re-opened; restart it at a key frame.
+        m_ring->acknowledgeResync();
+        m_dropUntilKeyFrame = true;
+    }
+
+    if (m_dropUntilKeyFrame && !keyFrame) {
+        // Inside a GOP whose head was dropped; nothing decodes without it.
+        m_ring->rollback();
+        ++m_statDroppedUnits;
+    } else if (m_ringOverflow) {
+        m_ring->rollback();
+        ++m_statDroppedUnits;
+        if (!m_dropUntilKeyFrame || keyFrame) {
+            ++m_statDroppedGops;
+            if (m_player) {
+                m_player->noteDroppedGop();
+            }
+        }
+        m_dropUntilKeyFrame = true;
+    } else {
+        m_ring->commit();
+        m_dropUntilKeyFrame = false;
+    }
+    m_ringOverflow = false;
+
+    if (m_wakeTimer.isValid()) {
+        const qint64 latencyUs = m_wakeTimer.nsecsElapsed() / 1000;
+        m_statLatencyTotalUs += latencyUs;
+        m_statLatencyMaxUs = qMax(m_statLatencyMaxUs, latencyUs);
+        ++m_statAccessUnits;
+    }
+}
+
+void RtspClient::discardAccessUnit()
+{
+    if (!m_ring) {
+        return;
+    }
+    m_ring->rollback();
+    m_ringOverflow = false;
+}
+
+void RtspClient::logIngestStatistics()
+{
+    if (m_state != Playing) {
+        return;
+    }
+
+    // "ShinPlayerBench ingest" measures the old polling loop against the same source
+    const qint64 averageUs = m_statAccessUnits > 0
+            ? m_statLatencyTotalUs / static_cast<qint64>(m_statAccessUnits) : 0;
+    qDebug() << "Ingest" << m_url.host() << ":" << m_statWakeups << "wakeups,"
+             << m_statBytes << "bytes," << m_statAccessUnits << "access units,"
+             << "latency avg" << averageUs << "us max" << m_statLatencyMaxUs << "us,"
+             << m_depacketizer.lostPackets() << "RTP packets lost,"
+             << "ring" << m_ring->fillLevel() << "/" << m_ring->capacity()
+             << "high-water" << m_ring->highWaterMark() << "overflows" << m_ring->overflowCount() << ","
+             << m_statDroppedGops << "GOPs /" << m_statDroppedUnits << "access units dropped,"
+             << "feeder stalled total" << m_player->streamStalledMs() << "ms";
+    m_ring->resetHighWaterMark();
+
+    m_statWakeups = 0;
+    m_statBytes = 0;
+    m_statAccessUnits = 0;
+    m_statLatencyTotalUs = 0;
+    m_statLatencyMaxUs = 0;
+    m_statDroppedGops = 0;
+    m_statDroppedUnits = 0;
+}
@@ -0,0 +1,149 @@
+#ifndef RTSPCLIENT_H
+#define RTSPCLIENT_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QMap>
+#include <QUrl>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QTcpSocket>
+#include <QUdpSocket>
+#include "RtpDepacketizer.h"
+
+class MediaPlayerWrapper;
+class StreamRingBuffer;
+
+// Minimal in-process RTSP client (RFC 2326) that pulls one H.264/H.265 video
+// track over RTP, either interleaved on the RTSP connection or on a UDP port
+// pair, and feeds the reassembled Annex-B stream to a MediaPlayerWrapper.
+// Lives in the thread that drives its sockets.
+class RtspClient : public QObject, private RtpDepacketizer::Sink
+{
+    Q_OBJECT
+
+public:
+    enum Transport {
+        TransportTcp = 0,   // RTP/AVP/TCP interleaved
+        TransportUdp = 1    // RTP/AVP unicast
+    };
+
+    explicit RtspClient(MediaPlayerWrapper *player, const QString &url,
+                        Transport transport = TransportTcp, QObject *parent = nullptr);
+    ~RtspClient();
+
+    bool isActive() const { return m_state != Idle; }
+    MediaPlayerWrapper *player() const { return m_player; }
+    quint64 receivedBytes() const { return m_receivedBytes; }
+    quint64 lostPackets() const { return m_depacketizer.lostPackets(); }
+
+public slots:
+    void start();
+    void stop();
+    // Logs wake-up/latency counters for the last window and resets them.
+    void logIngestStatistics();
+
+signals:
+    void streamStarted();
+    void streamError(const QString &error);
+    void streamStopped();
+
+private slots:
+    void onConnected();
+    void onControlReadyRead();
+    void onSocketError(QAbstractSocket::SocketError error);
+    void onRtpReadyRead();
+    void onKeepAlive();
+
+private:
+    // Drives the sink and the sockets directly
+    friend class RtspBench;
+
+    enum State {
+        Idle,
+        Options,
+        Describe,
+        Setup,
+        Play,
+        Playing,
+        Teardown
+    };
+
+    struct Response {
+        int statusCode;
+        QMap<QByteArray, QByteArray> headers;   // lower-case names
+        QByteArray body;
+    };
+
+    void sendRequest(const QByteArray &method, const QString &uri,
+                     const QList<QPair<QByteArray, QByteArray> > &headers = QList<QPair<QByteArray, QByteArray> >());
+    void resendWithAuthorization();
+    QByteArray authorizationHeader(const QByteArray &method, const QString &uri) const;
+    void processControlBuffer();
+    void handleResponse(const Response &response);
+    bool parseSdp(const QByteArray &sdp);
+    QString resolveControlUrl(const QString &control) const;
+    bool bindUdpPorts();
+    void fail(const QString &error);
+
+    // RtpDepacketizer::Sink
+    void write(const uchar *data, int size) override;
+    void endAccessUnit(bool keyFrame) override;
+    void discardAccessUnit() override;
+
+    MediaPlayerWrapper *m_player;
+    QUrl m_url;
+    QString m_requestUrl;       // URL without credentials
+    Transport m_transport;
+    State m_state;
+
+    QTcpSocket *m_socket;
+    QUdpSocket *m_rtpSocket;
+    QUdpSocket *m_rtcpSocket;
+    QTimer *m_keepAliveTimer;
+
+    QByteArray m_rxBuffer;
+    QByteArray m_datagram;
+
+    // Access units are staged straight into the player's input ring and
+    // committed whole. When one does not fit, the rest of its GOP is dropped
+    // and feeding resumes at the next key frame that fits.
+    StreamRingBuffer *m_ring;
+    bool m_ringOverflow;
+    bool m_dropUntilKeyFrame;
+
+    int m_cseq;
+    QByteArray m_pendingMethod;
+    QString m_pendingUri;
+    QList<QPair<QByteArray, QByteArray> > m_pendingHeaders;
+    bool m_authRetried;
+
+    QByteArray m_authScheme;
+    QByteArray m_realm;
+    QByteArray m_nonce;
+    QByteArray m_qop;
+    mutable int m_nonceCount;
+
+    QString m_contentBase;
+    QString m_sessionControl;
+    QString m_trackControl;
+    QByteArray m_sessionId;
+    int m_sessionTimeout;
+    int m_rtpChannel;
+
+    RtpDepacketizer m_depacketizer;
+    quint64 m_receivedBytes;
+
+    // Ingest latency: socket wake-up to PlayM4 hand-off of each access unit
+    QElapsedTimer m_wakeTimer;
+    quint64 m_statWakeups;
+    quint64 m_statBytes;
+    quint64 m_statAccessUnits;
+    qint64 m_statLatencyTotalUs;
+    qint64 m_statLatencyMaxUs;
+    quint64 m_statDroppedGops;
+    quint64 m_statDroppedUnits;
+};
+
+#endif // RTSPCLIENT_H
@@ -0,0 +1,92 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <QtGlobal>
+#include <QThread>
+#include <atomic>
+#include <type_traits>
+#include <string.h>
+
+// Single-writer sequence lock for a small POD. store() never blocks and
+// never allocates; load() copies the value out and retries while a store
+// is in progress, so the writer (an SDK callback thread) never waits on a
+// reader. The value is kept as atomic words, which keeps the racy copy
+// well defined.
+template <typename T>
+class SeqLock
+{
+    Q_STATIC_ASSERT(std::is_trivially_copyable<T>::value);
+
+public:
+    SeqLock()
+        : m_sequence(0)
+        , m_valid(0)
+    {
+        for (int i = 0; i < kWords; ++i) {
+            m_words[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Writer thread only
+    void store(const T &value)
+    {
+        quint32 words[kWords] = {};
+        memcpy(words, &value, sizeof(T));
+        write(words, 1);
+    }
+
+    // Forgets the value; only while the writer is known to be idle
+    void reset()
+    {
+        quint32 words[kWords] = {};
+        write(words, 0);
+    }
+
+    // False until the first store() and after reset()
+    bool load(T *value) const
+    {
+        quint32 words[kWords];
+        quint32 valid;
+        for (;;) {
+            const quint32 before = m_sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                QThread::yieldCurrentThread();
+                continue;
+            }
+            valid = m_valid.load(std::memory_order_relaxed);
+            for (int i = 0; i < kWords; ++i) {
+                words[i] = m_words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (m_sequence.load(std::memory_order_relaxed) == before) {
+                break;
+            }
+        }
+        if (!valid) {
+            return false;
+        }
+        memcpy(value, words, sizeof(T));
+        return true;
+    }
+
+private:
+    enum { kWords = (sizeof(T) + sizeof(quint32) - 1) / sizeof(quint32) };
+
+    void write(const quint32 *words, quint32 valid)
+    {
+        const quint32 sequence = m_sequence.load(std::memory_order_relaxed);
+        m_sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_valid.store(valid, std::memory_order_relaxed);
+        for (int i = 0; i < kWords; ++i) {
+            m_words[i].store(words[i], std::memory_order_relaxed);
+        }
+        m_sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    std::atomic<quint32> m_sequence;    // odd while a store is in progress
+    std::atomic<quint32> m_valid;
+    std::atomic<quint32> m_words[kWords];
+};
+
+#endif // SEQLOCK_H
@@ -0,0 +1,212 @@
+#include "SnapshotService.h"
+#include "MediaPlayerWrapper.h"
+#include "YuvConvert.h"
+#include <QMutexLocker>
+#include <QImage>
+#include <QFile>
+#include <QDebug>
+#include <string.h>
+
+// Requests beyond this are refused instead of piling up behind a slow disk.
+static const int kMaxQueued = 32;
+// Distinct frame sizes kept around, e.g. for a video wall of mixed sources.
+static const int kMaxFreeBuffers = 4;
+static const int kJpegQuality = 90;
+
+SnapshotService *SnapshotService::instance()
+{
+    static SnapshotService service;
+    return &service;
+}
+
+SnapshotService::SnapshotService()
+    : m_running(false)
+    , m_busy(false)
+    , m_nextId(1)
+    , m_jpegEncoder(kJpegQuality)
+{
+    setObjectName("SnapshotService");
+    // One picture at a time, so spread it over the cores
+    m_jpegEncoder.setThreadCount(QThread::idealThreadCount());
+}
+
+SnapshotService::~SnapshotService()
+{
+    shutdown();
+}
+
+int SnapshotService::reserveId()
+{
+    return m_nextId.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool SnapshotService::submit(int requestId, const DecodedFrame &frame, const QString &filePath, int format)
+{
+    if (!frame.data || frame.size <= 0) {
+        return false;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    if (m_queue.size() >= kMaxQueued) {
+        qDebug() << "Snapshot queue full, dropping" << filePath;
+        return false;
+    }
+
+    Request request;
+    request.id = requestId;
+    request.filePath = filePath;
+    request.format = format;
+    // The decoded picture itself is all the worker needs; a buffer of the
+    // frame's exact size from an earlier snapshot of the same source is
+    // reused as is
+    for (int i = 0; i < m_freeBuffers.size(); ++i) {
+        if (m_freeBuffers.at(i).size() == frame.size) {
+            request.buffer = m_freeBuffers.takeAt(i);
+            break;
+        }
+    }
+    if (request.buffer.isEmpty()) {
+        request.buffer = QByteArray(frame.size, Qt::Uninitialized);
+    }
+    memcpy(request.buffer.data(), frame.data, static_cast<size_t>(frame.size));
+    request.frame = frame;
+    request.frame.data = reinterpret_cast<const uchar *>(request.buffer.constData());
+    request.queuedTimer.start();
+    m_queue.enqueue(request);
+
+    if (!m_running) {
+        m_running = true;
+        start(QThread::LowPriority);
+    }
+    m_requestQueued.wakeOne();
+    return true;
+}
+
+void SnapshotService::shutdown()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_running) {
+            return;
+        }
+        m_running = false;
+        m_queue.clear();
+        m_requestQueued.wakeAll();
+    }
+    wait();
+    m_freeBuffers.clear();
+    m_bmpBuffer.clear();
+    m_jpegBuffer.clear();
+}
+
+int SnapshotService::pendingCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_queue.size() + (m_busy ? 1 : 0);
+}
+
+int SnapshotService::bmpSize(int width, int height)
+{
+    const int stride = (width * 3 + 3) & ~3;
+    return static_cast<int>(sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER)) + stride * height;
+}
+
+bool SnapshotService::writeBmp(const Request &request)
+{
+    const DecodedFrame &frame = request.frame;
+    YuvConvert::SourceFormat format;
+    if (!YuvConvert::formatFromFrameType(frame.type, &format)) {
+        return false;
+    }
+
+    // Top-down 24-bit BMP, converted straight into the file image
+    const int stride = (frame.width * 3 + 3) & ~3;
+    const int headerSize = static_cast<int>(sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER));
+    const int fileSize = bmpSize(frame.width, frame.height);
+    m_bmpBuffer.resize(fileSize);
+    uchar *bytes = reinterpret_cast<uchar *>(m_bmpBuffer.data());
+
+    BITMAPFILEHEADER fileHeader;
+    memset(&fileHeader, 0, sizeof(fileHeader));
+    fileHeader.bfType = 0x4D42;     // "BM"
+    fileHeader.bfSize = static_cast<DWORD>(fileSize);
+    fileHeader.bfOffBits = static_cast<DWORD>(headerSize);
+    BITMAPINFOHEADER infoHeader;
+    memset(&infoHeader, 0, sizeof(infoHeader));
+    infoHeader.biSize = sizeof(BITMAPINFOHEADER);
+    infoHeader.biWidth = frame.width;
+    infoHeader.biHeight = -frame.height;
+    infoHeader.biPlanes = 1;
+    infoHeader.biBitCount = 24;
+    infoHeader.biCompression = BI_RGB;
+    infoHeader.biSizeImage = static_cast<DWORD>(stride * frame.height);
+    memcpy(bytes, &fileHeader, sizeof(fileHeader));
+    memcpy(bytes + sizeof(fileHeader), &infoHeader, sizeof(infoHeader));
+
+    uchar *pixels = bytes + headerSize;
+    if (!YuvConvert::convert(frame.data, frame.width, frame.height, format,
+                             pixels, frame.width, frame.height, stride, YuvConvert::BGR24)) {
+        return false;
+    }
+    const int padding = stride - frame.width * 3;
+    if (padding > 0) {
+        for (int row = 0; row < frame.height; ++row) {
+            memset(pixels + row * stride + frame.width * 3, 0, static_cast<size_t>(padding));
+        }
+    }
+
+    QFile file(request.filePath);
+    return file.open(QIODevice::WriteOnly) && file.write(m_bmpBuffer) == fileSize;
+}
+
+bool SnapshotService::writeJpeg(const Request &request)
+{
+    if (m_jpegEncoder.encode(request.frame, &m_jpegBuffer)) {
+        QFile file(request.filePath);
+        return file.open(QIODevice::WriteOnly) && file.write(m_jpegBuffer) == m_jpegBuffer.size();
+    }
+    // A frame layout the JPEG encoder does not take
+    const QImage image = YuvConvert::toImage(request.frame);
+    return !image.isNull() && image.save(request.filePath, "JPG", kJpegQuality);
+}
+
+void SnapshotService::run()
+{
+    for (;;) {
+        Request request;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (m_running && m_queue.isEmpty()) {
+                m_requestQueued.wait(&m_mutex);
+            }
+            if (!m_running) {
+                return;
+            }
+            request = m_queue.dequeue();
+            m_busy = true;
+        }
+
+        QElapsedTimer encodeTimer;
+        encodeTimer.start();
+        const bool ok = request.format == Bmp ? writeBmp(request) : writeJpeg(request);
+        if (ok) {
+            qDebug() << "Snapshot" << request.frame.width << "x" << request.frame.height
+                     << (request.format == Bmp ? "BMP" : "JPEG") << "encoded and written in"
+                     << encodeTimer.nsecsElapsed() / 1000 / 1000.0 << "ms";
+        } else {
+            qDebug() << "Failed to write snapshot" << request.filePath;
+        }
+
+        {
+            QMutexLocker locker(&m_mutex);
+            m_busy = false;
+            if (m_freeBuffers.size() >= kMaxFreeBuffers) {
+                m_freeBuffers.removeFirst();
+            }
+            // Moved, so the pooled copy is the only reference and stays reusable
+            m_freeBuffers.append(std::move(request.buffer));
+        }
+
+        emit snapshotFinished(request.id, ok, request.filePath, request.queuedTimer.elapsed());
+    }
+}
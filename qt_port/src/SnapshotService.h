@@ -0,0 +1,86 @@
+#ifndef SNAPSHOTSERVICE_H
+#define SNAPSHOTSERVICE_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QVector>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QString>
+#include <atomic>
+#include "FrameConsumer.h"
+#include "JpegEncoder.h"
+
+// Process-wide snapshot worker. The player copies the frame on screen into
+// one of the service's reused buffers from its display callback, right when
+// the snapshot is asked for; this thread only encodes the copy and writes
+// the file, one request at a time, so neither the GUI thread nor the SDK
+// display thread waits on the encoder or the disk.
+class SnapshotService : public QThread
+{
+    Q_OBJECT
+
+public:
+    enum Format {
+        Bmp = 0,
+        Jpeg = 1
+    };
+
+    static SnapshotService *instance();
+    ~SnapshotService();
+
+    // Id for a snapshot that is submitted once its frame is displayed
+    int reserveId();
+    // Copies the frame and queues its encode under a reserved id. Returns
+    // false when the queue is full. Called on the SDK display thread.
+    bool submit(int requestId, const DecodedFrame &frame, const QString &filePath, int format);
+    // Stops the worker and drops what is queued; the next submit()
+    // restarts it.
+    void shutdown();
+
+    int pendingCount() const;
+
+    // File size of a 24-bit BMP of the picture
+    static int bmpSize(int width, int height);
+
+signals:
+    // Emitted from the worker thread
+    void snapshotFinished(int requestId, bool ok, const QString &filePath, qint64 elapsedMs);
+
+protected:
+    void run() override;
+
+private:
+    SnapshotService();
+    Q_DISABLE_COPY(SnapshotService)
+
+    struct Request {
+        int id;
+        QString filePath;
+        int format;
+        DecodedFrame frame;         // planes point into buffer
+        QByteArray buffer;
+        QElapsedTimer queuedTimer;
+    };
+
+    bool writeBmp(const Request &request);
+    bool writeJpeg(const Request &request);
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_requestQueued;
+    QQueue<Request> m_queue;
+    bool m_running;
+    bool m_busy;
+    std::atomic<int> m_nextId;
+    // Frame copies, handed back by the worker; under m_mutex
+    QVector<QByteArray> m_freeBuffers;
+
+    // Touched by the worker only; keep their capacity between snapshots
+    QByteArray m_bmpBuffer;
+    QByteArray m_jpegBuffer;
+    JpegEncoder m_jpegEncoder;
+};
+
+#endif // SNAPSHOTSERVICE_H
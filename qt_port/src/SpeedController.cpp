@@ -0,0 +1,38 @@
+#include "SpeedController.h"
+#include "MediaPlayerWrapper.h"
+#include <QDebug>
+#include <cmath>
+
+int SpeedController::stepFor(float speed)
+{
+    if (speed <= 0.0f) {
+        return 0;
+    }
+    const int step = static_cast<int>(std::lround(std::log2(speed)));
+    return qBound(kMinStep, step, kMaxStep);
+}
+
+float SpeedController::speedFor(int step)
+{
+    return static_cast<float>(std::ldexp(1.0, step));
+}
+
+bool SpeedController::moveTo(LONG port, int step)
+{
+    step = qBound(kMinStep, step, kMaxStep);
+    while (m_step < step) {
+        if (!NAME(PlayM4_Fast)(port)) {
+            qDebug() << "PlayM4_Fast refused at x" << speed() << "error" << NAME(PlayM4_GetLastError)(port);
+            return false;
+        }
+        ++m_step;
+    }
+    while (m_step > step) {
+        if (!NAME(PlayM4_Slow)(port)) {
+            qDebug() << "PlayM4_Slow refused at x" << speed() << "error" << NAME(PlayM4_GetLastError)(port);
+            return false;
+        }
+        --m_step;
+    }
+    return true;
+}
@@ -0,0 +1,36 @@
+#ifndef SPEEDCONTROLLER_H
+#define SPEEDCONTROLLER_H
+
+#include <Windows.h>
+
+// Absolute speeds on top of the PlayM4 speed ladder, which only knows
+// relative steps: PlayM4_Fast doubles and PlayM4_Slow halves the speed
+// between /16 and x16, and PlayM4_Play starts over at x1. The controller
+// remembers which rung the port is on, so a jump such as x1 to x8 issues
+// three steps instead of one.
+class SpeedController
+{
+public:
+    static const int kMinStep = -4;     // /16
+    static const int kMaxStep = 4;      // x16
+
+    SpeedController() : m_step(0) {}
+
+    // The port was (re)started with PlayM4_Play
+    void reset() { m_step = 0; }
+    int step() const { return m_step; }
+    float speed() const { return speedFor(m_step); }
+
+    // Nearest rung to a speed, clamped to the ladder
+    static int stepFor(float speed);
+    static float speedFor(int step);
+
+    // Steps the port to the rung. If the SDK refuses a step, stops there
+    // and returns false; step() is where the port really is.
+    bool moveTo(LONG port, int step);
+
+private:
+    int m_step;
+};
+
+#endif // SPEEDCONTROLLER_H
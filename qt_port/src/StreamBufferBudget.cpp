@@ -0,0 +1,84 @@
+#include "StreamBufferBudget.h"
+#include "MediaPlayerWrapper.h"
+#include <QMutexLocker>
+
+StreamBufferBudget *StreamBufferBudget::instance()
+{
+    static StreamBufferBudget budget;
+    return &budget;
+}
+
+StreamBufferBudget::StreamBufferBudget()
+    : m_totalBytes(256 * 1024 * 1024)
+{
+}
+
+void StreamBufferBudget::setTotalBytes(quint64 bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_totalBytes = bytes;
+}
+
+quint64 StreamBufferBudget::totalBytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_totalBytes;
+}
+
+quint64 StreamBufferBudget::allocatedBytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    quint64 sum = 0;
+    for (quint32 grant : m_grants) {
+        sum += grant;
+    }
+    return sum;
+}
+
+quint32 StreamBufferBudget::acquire(MediaPlayerWrapper *owner, quint32 desiredBytes)
+{
+    QMap<MediaPlayerWrapper *, quint32> shrink;
+    quint32 result;
+    {
+        QMutexLocker locker(&m_mutex);
+
+        quint64 others = 0;
+        for (QMap<MediaPlayerWrapper *, quint32>::const_iterator it = m_grants.constBegin(); it != m_grants.constEnd(); ++it) {
+            if (it.key() != owner) {
+                others += it.value();
+            }
+        }
+
+        const int ports = m_grants.size() + (m_grants.contains(owner) ? 0 : 1);
+        const quint64 fairShare = m_totalBytes / static_cast<quint64>(qMax(1, ports));
+        const quint64 available = m_totalBytes > others ? m_totalBytes - others : 0;
+
+        quint64 granted = qMin<quint64>(desiredBytes, qMax(available, fairShare));
+        granted = qBound<quint64>(SOURCE_BUF_MIN, granted, SOURCE_BUF_MAX);
+        result = static_cast<quint32>(granted);
+        m_grants.insert(owner, result);
+
+        // Over budget: the ports above their fair share give the excess back
+        if (others + granted > m_totalBytes) {
+            const quint32 share = static_cast<quint32>(qMax<quint64>(SOURCE_BUF_MIN, fairShare));
+            for (QMap<MediaPlayerWrapper *, quint32>::const_iterator it = m_grants.constBegin(); it != m_grants.constEnd(); ++it) {
+                if (it.key() != owner && it.value() > share) {
+                    shrink.insert(it.key(), share);
+                }
+            }
+        }
+    }
+
+    // Queued, so they re-open on their own thread and re-acquire from there
+    for (QMap<MediaPlayerWrapper *, quint32>::const_iterator it = shrink.constBegin(); it != shrink.constEnd(); ++it) {
+        QMetaObject::invokeMethod(it.key(), "resizeStreamPool", Qt::QueuedConnection,
+                                  Q_ARG(uint, static_cast<uint>(it.value())));
+    }
+    return result;
+}
+
+void StreamBufferBudget::release(MediaPlayerWrapper *owner)
+{
+    QMutexLocker locker(&m_mutex);
+    m_grants.remove(owner);
+}
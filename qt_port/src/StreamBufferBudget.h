@@ -0,0 +1,37 @@
+#ifndef STREAMBUFFERBUDGET_H
+#define STREAMBUFFERBUDGET_H
+
+#include <QMutex>
+#include <QMap>
+
+class MediaPlayerWrapper;
+
+// Process-wide memory budget for PlayM4 stream source buffers. Every open
+// stream port asks for the pool size its measured bitrate needs and is
+// granted at most that, capped so the sum across ports stays within the
+// budget. A port is always allowed its fair share (total / ports); when
+// that overcommits, ports holding more than theirs are told to re-open at
+// their share, and the sum is back within the budget once they have.
+class StreamBufferBudget
+{
+public:
+    static StreamBufferBudget *instance();
+
+    void setTotalBytes(quint64 bytes);
+    quint64 totalBytes() const;
+    quint64 allocatedBytes() const;
+
+    // Returns the pool size the owner may open with and records it.
+    quint32 acquire(MediaPlayerWrapper *owner, quint32 desiredBytes);
+    void release(MediaPlayerWrapper *owner);
+
+private:
+    StreamBufferBudget();
+    Q_DISABLE_COPY(StreamBufferBudget)
+
+    mutable QMutex m_mutex;
+    quint64 m_totalBytes;
+    QMap<MediaPlayerWrapper *, quint32> m_grants;
+};
+
+#endif // STREAMBUFFERBUDGET_H
@@ -0,0 +1,136 @@
+#include "StreamFeeder.h"
+#include "StreamRingBuffer.h"
+#include "MediaPlayerWrapper.h"
+#include <QElapsedTimer>
+#include <QMutexLocker>
+
+// Do not hand PlayM4 slivers while it is nearly full; wait for real room.
+static const DWORD kMinFeedBytes = 4 * 1024;
+// Fallback poll in case the drain callback is missed or not supported.
+static const unsigned long kStallPollMs = 20;
+// Input rate sampling for source buffer sizing: a short first window to
+// size the pool early, then a slower one to follow bitrate changes.
+static const qint64 kFirstRateWindowMs = 3000;
+static const qint64 kRateWindowMs = 10000;
+
+StreamFeeder::StreamFeeder(MediaPlayerWrapper *player, StreamRingBuffer *ring, QObject *parent)
+    : QThread(parent)
+    , m_player(player)
+    , m_ring(ring)
+    , m_running(false)
+    , m_spaceSignalled(false)
+    , m_stalledUs(0)
+    , m_stallCount(0)
+{
+    setObjectName("StreamFeeder");
+}
+
+StreamFeeder::~StreamFeeder()
+{
+    stopFeeding();
+    wait(3000);
+}
+
+void StreamFeeder::stopFeeding()
+{
+    m_running = false;
+    if (m_ring) {
+        m_ring->wakeConsumer();
+    }
+    notifySpaceAvailable();
+}
+
+void StreamFeeder::notifySpaceAvailable()
+{
+    QMutexLocker locker(&m_spaceMutex);
+    m_spaceSignalled = true;
+    m_spaceAvailable.wakeOne();
+}
+
+void StreamFeeder::waitForSpace()
+{
+    QMutexLocker locker(&m_spaceMutex);
+    if (!m_spaceSignalled && m_running) {
+        m_spaceAvailable.wait(&m_spaceMutex, kStallPollMs);
+    }
+    m_spaceSignalled = false;
+}
+
+void StreamFeeder::run()
+{
+    m_running = true;
+
+    QElapsedTimer stallTimer;
+    QElapsedTimer rateTimer;
+    rateTimer.start();
+    qint64 rateWindowMs = kFirstRateWindowMs;
+    quint64 rateBaseBytes = m_ring->totalCommitted();
+
+    while (m_running) {
+        if (rateTimer.elapsed() >= rateWindowMs) {
+            const quint64 total = m_ring->totalCommitted();
+            const qint64 elapsedMs = rateTimer.restart();
+            if (total > rateBaseBytes) {
+                m_player->updateStreamPoolEstimate((total - rateBaseBytes) * 1000 / static_cast<quint64>(elapsedMs));
+                rateWindowMs = kRateWindowMs;
+            }
+            rateBaseBytes = total;
+        }
+
+        // Taken before the resync check: a re-open requests the resync
+        // first, so a span read under the new generation is never stale.
+        const quint32 generation = m_player->streamGeneration();
+
+        // After a port re-open, feed nothing until the producer has marked
+        // where its next key frame starts, then skip the stale tail.
+        if (m_ring->resyncPending() && !m_ring->completeResync()) {
+            msleep(5);
+            continue;
+        }
+
+        if (!m_ring->waitForData(100)) {
+            continue;
+        }
+
+        int size = 0;
+        const uchar *data = m_ring->peek(&size);
+        if (size <= 0) {
+            continue;
+        }
+
+        // Never offer more than the source buffer can take, so InputData
+        // does not reject the span outright.
+        const DWORD freeBytes = m_player->sourceBufferFree();
+        DWORD chunk = qMin(static_cast<DWORD>(size), freeBytes);
+        MediaPlayerWrapper::InputResult result = MediaPlayerWrapper::InputBufferFull;
+        if (chunk >= kMinFeedBytes || chunk == static_cast<DWORD>(size)) {
+            result = m_player->feedStreamData(const_cast<PBYTE>(data), chunk, generation);
+        }
+        if (result == MediaPlayerWrapper::InputStale) {
+            // The resync check above skips past it
+            continue;
+        }
+
+        if (result == MediaPlayerWrapper::InputBufferFull) {
+            if (!stallTimer.isValid()) {
+                stallTimer.start();
+                m_stallCount.fetch_add(1, std::memory_order_relaxed);
+            }
+            waitForSpace();
+            continue;
+        }
+
+        if (stallTimer.isValid()) {
+            m_stalledUs.fetch_add(stallTimer.nsecsElapsed() / 1000, std::memory_order_relaxed);
+            stallTimer.invalidate();
+        }
+
+        // A hard failure is logged by the wrapper; skip the span rather than
+        // spinning on it.
+        m_ring->consume(result == MediaPlayerWrapper::InputOk ? static_cast<int>(chunk) : size);
+    }
+
+    if (stallTimer.isValid()) {
+        m_stalledUs.fetch_add(stallTimer.nsecsElapsed() / 1000, std::memory_order_relaxed);
+    }
+}
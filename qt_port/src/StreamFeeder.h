@@ -0,0 +1,52 @@
+#ifndef STREAMFEEDER_H
+#define STREAMFEEDER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+
+class MediaPlayerWrapper;
+class StreamRingBuffer;
+
+// Drains a StreamRingBuffer into PlayM4_InputData. Spans are handed over in
+// place from the ring, so the feed path does not allocate or copy.
+//
+// The feeder never drops data. When the PlayM4 source buffer is full it
+// holds the span and sleeps until the source-buffer callback reports that
+// the decoder has drained it; meanwhile the ring absorbs the burst, and only
+// when the ring itself is full does the producer drop whole GOPs.
+class StreamFeeder : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit StreamFeeder(MediaPlayerWrapper *player, StreamRingBuffer *ring, QObject *parent = nullptr);
+    ~StreamFeeder();
+
+    void stopFeeding();
+    // Called from the PlayM4 source-buffer callback thread.
+    void notifySpaceAvailable();
+
+    qint64 stalledUs() const { return m_stalledUs.load(std::memory_order_relaxed); }
+    quint64 stallCount() const { return m_stallCount.load(std::memory_order_relaxed); }
+
+protected:
+    void run() override;
+
+private:
+    void waitForSpace();
+
+    MediaPlayerWrapper *m_player;
+    StreamRingBuffer *m_ring;
+    volatile bool m_running;
+
+    QMutex m_spaceMutex;
+    QWaitCondition m_spaceAvailable;
+    bool m_spaceSignalled;
+
+    std::atomic<qint64> m_stalledUs;
+    std::atomic<quint64> m_stallCount;
+};
+
+#endif // STREAMFEEDER_H
@@ -0,0 +1,98 @@
+#include "StreamIngestReactor.h"
+#include "MediaPlayerWrapper.h"
+#include <QDebug>
+#include <QTimer>
+
+StreamIngestReactor::StreamIngestReactor(QObject *parent)
+    : QObject(parent)
+    , m_statsTimer(nullptr)
+    , m_nextSourceId(1)
+{
+    m_thread.setObjectName("StreamIngest");
+
+    m_statsTimer = new QTimer();
+    m_statsTimer->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_statsTimer, &QObject::deleteLater);
+
+    m_thread.start(QThread::TimeCriticalPriority);
+}
+
+StreamIngestReactor::~StreamIngestReactor()
+{
+    removeAllSources();
+    m_thread.quit();
+    m_thread.wait(3000);
+}
+
+int StreamIngestReactor::addSource(MediaPlayerWrapper *player, const QString &url, RtspClient::Transport transport)
+{
+    if (!player || !m_thread.isRunning()) {
+        return -1;
+    }
+
+    const int sourceId = m_nextSourceId++;
+    RtspClient *client = new RtspClient(player, url, transport);
+    client->moveToThread(&m_thread);
+
+    // Context object is the reactor, so these run queued on the GUI thread.
+    connect(client, &RtspClient::streamStarted, this, [this, sourceId]() {
+        emit sourceStarted(sourceId);
+    });
+    connect(client, &RtspClient::streamError, this, [this, sourceId](const QString &error) {
+        emit sourceError(sourceId, error);
+    });
+    connect(client, &RtspClient::streamStopped, this, [this, sourceId]() {
+        emit sourceStopped(sourceId);
+    });
+    connect(m_statsTimer, &QTimer::timeout, client, &RtspClient::logIngestStatistics);
+
+    m_sources.insert(sourceId, client);
+    // The player detaches the source itself before it frees the ring
+    player->setIngestSource(this, sourceId);
+    QMetaObject::invokeMethod(client, "start", Qt::QueuedConnection);
+
+    qDebug() << "Ingest source" << sourceId << "added," << m_sources.size() << "active";
+    return sourceId;
+}
+
+void StreamIngestReactor::removeSource(int sourceId)
+{
+    // From the network thread the blocking stop below would wait on itself,
+    // and m_sources is not guarded against any other thread either
+    if (QThread::currentThread() != thread()) {
+        qDebug() << "Ingest source" << sourceId << "not removed: called off the thread that owns the reactor";
+        Q_ASSERT(QThread::currentThread() == thread());
+        return;
+    }
+
+    RtspClient *client = m_sources.take(sourceId);
+    if (!client) {
+        return;
+    }
+
+    // Stop on the reactor thread so TEARDOWN goes out before the socket dies.
+    QMetaObject::invokeMethod(client, "stop", Qt::BlockingQueuedConnection);
+    if (client->player() && client->player()->ingestSourceId() == sourceId) {
+        client->player()->setIngestSource(nullptr, -1);
+    }
+    client->deleteLater();
+
+    qDebug() << "Ingest source" << sourceId << "removed," << m_sources.size() << "active";
+}
+
+void StreamIngestReactor::removeAllSources()
+{
+    const QList<int> ids = m_sources.keys();
+    for (int sourceId : ids) {
+        removeSource(sourceId);
+    }
+}
+
+void StreamIngestReactor::setStatisticsInterval(int ms)
+{
+    if (ms > 0) {
+        QMetaObject::invokeMethod(m_statsTimer, "start", Qt::QueuedConnection, Q_ARG(int, ms));
+    } else {
+        QMetaObject::invokeMethod(m_statsTimer, "stop", Qt::QueuedConnection);
+    }
+}
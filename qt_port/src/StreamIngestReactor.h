@@ -0,0 +1,53 @@
+#ifndef STREAMINGESTREACTOR_H
+#define STREAMINGESTREACTOR_H
+
+#include <QObject>
+#include <QThread>
+#include <QMap>
+#include <QString>
+#include "RtspClient.h"
+
+class MediaPlayerWrapper;
+class QTimer;
+
+// One network thread for all live sources. Every RtspClient is moved onto the
+// reactor thread, whose event loop sleeps in the platform socket notifier
+// (WSAPoll/epoll) and only wakes when one of the sockets has bytes ready.
+class StreamIngestReactor : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StreamIngestReactor(QObject *parent = nullptr);
+    ~StreamIngestReactor();
+
+    // Returns the source id used by the signals below, or -1 on failure.
+    int addSource(MediaPlayerWrapper *player, const QString &url,
+                  RtspClient::Transport transport = RtspClient::TransportTcp);
+    // Blocks until the client has stopped. Only from the thread the reactor
+    // object lives in, never from its network thread.
+    void removeSource(int sourceId);
+    void removeAllSources();
+
+    int sourceCount() const { return m_sources.size(); }
+    bool hasSource(int sourceId) const { return m_sources.contains(sourceId); }
+
+    // Period of the ingest statistics log, 0 disables it.
+    void setStatisticsInterval(int ms);
+
+signals:
+    void sourceStarted(int sourceId);
+    void sourceError(int sourceId, const QString &error);
+    void sourceStopped(int sourceId);
+
+private:
+    // Reaches the clients to measure them
+    friend class RtspBench;
+
+    QThread m_thread;
+    QMap<int, RtspClient *> m_sources;
+    QTimer *m_statsTimer;
+    int m_nextSourceId;
+};
+
+#endif // STREAMINGESTREACTOR_H
@@ -0,0 +1,159 @@
+#include "StreamRingBuffer.h"
+#include <QMutexLocker>
+#include <string.h>
+
+static const int kCacheLine = 64;
+
+static int roundUpToPowerOfTwo(int value)
+{
+    int result = 4096;
+    while (result < value && result < (1 << 30)) {
+        result <<= 1;
+    }
+    return result;
+}
+
+StreamRingBuffer::StreamRingBuffer(int capacity)
+    : m_data(nullptr)
+    , m_capacity(roundUpToPowerOfTwo(capacity))
+    , m_mask(static_cast<quint64>(m_capacity) - 1)
+    , m_writePos(0)
+    , m_stagedPos(0)
+    , m_readPos(0)
+    , m_highWater(0)
+    , m_overflows(0)
+    , m_consumerWaiting(false)
+    , m_resyncState(ResyncNone)
+    , m_resyncPos(0)
+{
+    m_data = static_cast<uchar *>(qMallocAligned(static_cast<size_t>(m_capacity), kCacheLine));
+    Q_CHECK_PTR(m_data);
+}
+
+StreamRingBuffer::~StreamRingBuffer()
+{
+    qFreeAligned(m_data);
+}
+
+int StreamRingBuffer::freeSpace() const
+{
+    const quint64 readPos = m_readPos.load(std::memory_order_acquire);
+    return m_capacity - static_cast<int>(m_stagedPos - readPos);
+}
+
+bool StreamRingBuffer::write(const uchar *data, int size)
+{
+    if (size <= 0) {
+        return true;
+    }
+    if (size > freeSpace()) {
+        m_overflows.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    const int index = static_cast<int>(m_stagedPos & m_mask);
+    const int firstPart = qMin(size, m_capacity - index);
+    memcpy(m_data + index, data, static_cast<size_t>(firstPart));
+    if (firstPart < size) {
+        memcpy(m_data, data + firstPart, static_cast<size_t>(size - firstPart));
+    }
+    m_stagedPos += static_cast<quint64>(size);
+    return true;
+}
+
+void StreamRingBuffer::commit()
+{
+    m_writePos.store(m_stagedPos, std::memory_order_seq_cst);
+
+    const int fill = static_cast<int>(m_stagedPos - m_readPos.load(std::memory_order_acquire));
+    if (fill > m_highWater.load(std::memory_order_relaxed)) {
+        m_highWater.store(fill, std::memory_order_relaxed);
+    }
+
+    // Only touch the mutex when the feeder is actually asleep.
+    if (m_consumerWaiting.load(std::memory_order_seq_cst)) {
+        QMutexLocker locker(&m_waitMutex);
+        m_dataReady.wakeOne();
+    }
+}
+
+void StreamRingBuffer::rollback()
+{
+    m_stagedPos = m_writePos.load(std::memory_order_relaxed);
+}
+
+int StreamRingBuffer::pendingSize() const
+{
+    return static_cast<int>(m_stagedPos - m_writePos.load(std::memory_order_relaxed));
+}
+
+const uchar *StreamRingBuffer::peek(int *size) const
+{
+    const quint64 writePos = m_writePos.load(std::memory_order_acquire);
+    const quint64 readPos = m_readPos.load(std::memory_order_relaxed);
+    const int available = static_cast<int>(writePos - readPos);
+    const int index = static_cast<int>(readPos & m_mask);
+
+    *size = qMin(available, m_capacity - index);
+    return m_data + index;
+}
+
+void StreamRingBuffer::consume(int size)
+{
+    const quint64 readPos = m_readPos.load(std::memory_order_relaxed);
+    m_readPos.store(readPos + static_cast<quint64>(size), std::memory_order_release);
+}
+
+bool StreamRingBuffer::waitForData(int timeoutMs)
+{
+    if (fillLevel() > 0) {
+        return true;
+    }
+
+    QMutexLocker locker(&m_waitMutex);
+    m_consumerWaiting.store(true, std::memory_order_seq_cst);
+    if (m_writePos.load(std::memory_order_seq_cst) == m_readPos.load(std::memory_order_relaxed)) {
+        m_dataReady.wait(&m_waitMutex, static_cast<unsigned long>(timeoutMs));
+    }
+    m_consumerWaiting.store(false, std::memory_order_relaxed);
+
+    return fillLevel() > 0;
+}
+
+void StreamRingBuffer::wakeConsumer()
+{
+    QMutexLocker locker(&m_waitMutex);
+    m_dataReady.wakeAll();
+}
+
+void StreamRingBuffer::requestResync()
+{
+    m_resyncState.store(ResyncRequested, std::memory_order_release);
+}
+
+void StreamRingBuffer::acknowledgeResync()
+{
+    m_resyncPos = m_writePos.load(std::memory_order_relaxed);
+    m_resyncState.store(ResyncAcknowledged, std::memory_order_release);
+}
+
+bool StreamRingBuffer::completeResync()
+{
+    if (m_resyncState.load(std::memory_order_acquire) != ResyncAcknowledged) {
+        return false;
+    }
+
+    const quint64 readPos = m_readPos.load(std::memory_order_relaxed);
+    if (m_resyncPos > readPos) {
+        m_readPos.store(m_resyncPos, std::memory_order_release);
+    }
+    m_resyncState.store(ResyncNone, std::memory_order_release);
+    return true;
+}
+
+int StreamRingBuffer::fillLevel() const
+{
+    const quint64 writePos = m_writePos.load(std::memory_order_acquire);
+    const quint64 readPos = m_readPos.load(std::memory_order_acquire);
+    return static_cast<int>(writePos - readPos);
+}
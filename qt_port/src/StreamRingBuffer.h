@@ -0,0 +1,85 @@
+#ifndef STREAMRINGBUFFER_H
+#define STREAMRINGBUFFER_H
+
+#include <QtGlobal>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+
+// Preallocated single-producer/single-consumer byte ring between the network
+// reader and the PlayM4 feeder. The producer stages bytes with write() and
+// publishes them with commit(), so a whole access unit becomes visible at
+// once or, after rollback(), not at all. The consumer reads contiguous spans
+// in place with peek()/consume(). Nothing is allocated after construction.
+class StreamRingBuffer
+{
+public:
+    explicit StreamRingBuffer(int capacity);
+    ~StreamRingBuffer();
+
+    int capacity() const { return m_capacity; }
+
+    // Producer side
+    int freeSpace() const;
+    bool write(const uchar *data, int size);
+    void commit();
+    void rollback();
+    int pendingSize() const;
+    // Total bytes ever committed; the producer's input rate.
+    quint64 totalCommitted() const { return m_writePos.load(std::memory_order_relaxed); }
+
+    // Consumer side
+    const uchar *peek(int *size) const;
+    void consume(int size);
+    bool waitForData(int timeoutMs);
+    void wakeConsumer();
+
+    // Resync handshake for a decoder that was reopened mid-GOP: the consumer
+    // requests it, the producer marks the last committed byte before it
+    // restarts at a key frame, and the consumer then skips up to that mark.
+    void requestResync();
+    bool resyncRequested() const { return m_resyncState.load(std::memory_order_acquire) == ResyncRequested; }
+    void acknowledgeResync();
+    bool resyncPending() const { return m_resyncState.load(std::memory_order_acquire) != ResyncNone; }
+    bool completeResync();
+
+    // Sizing statistics, readable from any thread
+    int fillLevel() const;
+    int highWaterMark() const { return m_highWater.load(std::memory_order_relaxed); }
+    void resetHighWaterMark() { m_highWater.store(fillLevel(), std::memory_order_relaxed); }
+    quint64 overflowCount() const { return m_overflows.load(std::memory_order_relaxed); }
+
+private:
+    Q_DISABLE_COPY(StreamRingBuffer)
+
+    enum ResyncState {
+        ResyncNone = 0,
+        ResyncRequested = 1,
+        ResyncAcknowledged = 2
+    };
+
+    // Producer and consumer indices sit on separate cache lines so the two
+    // threads do not false-share; padding instead of alignas because the
+    // object itself is heap allocated without over-alignment guarantees.
+    uchar *m_data;
+    int m_capacity;
+    quint64 m_mask;
+    char m_pad0[64];
+
+    std::atomic<quint64> m_writePos;    // published by the producer
+    quint64 m_stagedPos;                // producer private
+    char m_pad1[64];
+
+    std::atomic<quint64> m_readPos;     // published by the consumer
+    char m_pad2[64];
+
+    std::atomic<int> m_highWater;
+    std::atomic<quint64> m_overflows;
+    std::atomic<bool> m_consumerWaiting;
+    std::atomic<int> m_resyncState;
+    quint64 m_resyncPos;
+    QMutex m_waitMutex;
+    QWaitCondition m_dataReady;
+};
+
+#endif // STREAMRINGBUFFER_H
@@ -0,0 +1,312 @@
+#include "ThumbnailCache.h"
+#include "MediaPlayerWrapper.h"
+#include "YuvConvert.h"
+#include "CacheFile.h"
+#include <QBuffer>
+#include <QDataStream>
+#include <QDateTime>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+#include <algorithm>
+
+static const quint32 kThumbnailMagic = 0x53544832;  // "STH2", times from the first frame
+static const int kDefaultWidth = 160;
+static const int kJpegQuality = 80;
+// Slot spacing: at most this many thumbnails per file, at least this far
+// apart, and this when the length is not known
+static const int kMaxThumbnails = 400;
+static const int kMinIntervalMs = 1000;
+static const int kDefaultIntervalMs = 5000;
+
+static QString cachePath(const QString &mediaPath)
+{
+    return CacheFile::path("thumbnails", QFileInfo(mediaPath).absoluteFilePath(), ".thumbs");
+}
+
+ThumbnailCache::ThumbnailCache(QObject *parent)
+    : QObject(parent)
+    , m_player(nullptr)
+    , m_serial(0)
+    , m_building(false)
+    , m_complete(false)
+    , m_fixedIntervalMs(0)
+    , m_intervalMs(kDefaultIntervalMs)
+    , m_width(kDefaultWidth)
+    , m_accepting(false)
+    , m_nextSlotMs(0)
+    , m_baseStampMs(-1)
+{
+    m_player = new MediaPlayerWrapper(this);
+    m_player->initialize();
+    connect(m_player, &MediaPlayerWrapper::fileOpened, this, &ThumbnailCache::onFileOpened);
+    connect(m_player, &MediaPlayerWrapper::fileOpenFailed, this, &ThumbnailCache::onFileOpenFailed);
+}
+
+ThumbnailCache::~ThumbnailCache()
+{
+    close();
+}
+
+bool ThumbnailCache::open(const QString &filePath)
+{
+    if (filePath == m_filePath && (m_building || m_complete)) {
+        return true;
+    }
+    close();
+
+    m_filePath = filePath;
+    if (load()) {
+        m_complete = true;
+        emit ready(m_times.size());
+        return true;
+    }
+
+    m_building = true;
+    m_buildTimer.start();
+    m_player->openFileAsync(filePath);
+    return true;
+}
+
+void ThumbnailCache::close()
+{
+    stopBuild();
+    m_filePath.clear();
+    m_complete = false;
+    m_times.clear();
+    m_images.clear();
+    m_jpegs.clear();
+}
+
+void ThumbnailCache::stopBuild()
+{
+    if (!m_building) {
+        return;
+    }
+    // Queued thumbnails of this build are told apart by the serial
+    m_accepting = false;
+    m_player->cancelPendingOpen();
+    m_player->stopHeadless();
+    m_player->closeFile();
+    ++m_serial;
+    m_building = false;
+}
+
+QImage ThumbnailCache::thumbnailAt(qint64 timeMs) const
+{
+    auto it = std::upper_bound(m_times.constBegin(), m_times.constEnd(), timeMs);
+    if (it == m_times.constBegin()) {
+        return QImage();
+    }
+    const int index = static_cast<int>(it - m_times.constBegin()) - 1;
+    // Past the last thumbnail built so far; a GOP may be longer than a slot
+    if (!m_complete && timeMs - m_times.at(index) >= 2 * m_intervalMs) {
+        return QImage();
+    }
+    return m_images.at(index);
+}
+
+void ThumbnailCache::onFileOpened(const QString &filePath)
+{
+    if (!m_building || filePath != m_filePath) {
+        return;
+    }
+
+    const qint64 durationMs = m_player->duration() * 1000;
+    if (m_fixedIntervalMs > 0) {
+        m_intervalMs = m_fixedIntervalMs;
+    } else if (durationMs > 0) {
+        m_intervalMs = static_cast<int>(qMax<qint64>(kMinIntervalMs, durationMs / kMaxThumbnails));
+    } else {
+        m_intervalMs = kDefaultIntervalMs;
+    }
+    m_nextSlotMs = 0;
+    m_baseStampMs = -1;
+
+    // Still works without, only slower: every frame is decoded and dropped
+    if (!m_player->setKeyFramesOnly(true)) {
+        qDebug() << "Thumbnail build decodes all frames of" << filePath;
+    }
+    m_accepting = true;
+    if (!m_player->startHeadless(this)) {
+        stopBuild();
+        emit buildFailed("Failed to start decoding " + filePath);
+    }
+}
+
+void ThumbnailCache::onFileOpenFailed(const QString &filePath, const QString &error)
+{
+    if (m_building && filePath == m_filePath) {
+        stopBuild();
+        emit buildFailed(error);
+    }
+}
+
+void ThumbnailCache::onFrame(const DecodedFrame &frame)
+{
+    if (!m_accepting.load(std::memory_order_acquire) || !frame.data || frame.width <= 0) {
+        return;
+    }
+    // Decoder stamps do not start at zero; the slider timeline does
+    if (m_baseStampMs < 0) {
+        m_baseStampMs = frame.timestampMs;
+    }
+    const qint64 timeMs = frame.timestampMs - m_baseStampMs;
+    if (timeMs < m_nextSlotMs) {
+        return;
+    }
+    // Skip the slots this key frame jumped over; they show it too
+    m_nextSlotMs = (timeMs / m_intervalMs + 1) * m_intervalMs;
+
+    const int height = qMax(2, (m_width * frame.height / frame.width) & ~1);
+    const QImage image = YuvConvert::toImage(frame, QSize(m_width, height));
+    if (image.isNull()) {
+        return;
+    }
+    QByteArray jpeg;
+    QBuffer device(&jpeg);
+    if (!device.open(QIODevice::WriteOnly) || !image.save(&device, "JPG", kJpegQuality)) {
+        jpeg.clear();
+    }
+    QMetaObject::invokeMethod(this, "onThumbnail", Qt::QueuedConnection, Q_ARG(int, m_serial),
+                              Q_ARG(qint64, timeMs), Q_ARG(QImage, image), Q_ARG(QByteArray, jpeg));
+}
+
+void ThumbnailCache::onEndOfStream()
+{
+    m_accepting = false;
+    QMetaObject::invokeMethod(this, "onBuildComplete", Qt::QueuedConnection, Q_ARG(int, m_serial));
+}
+
+void ThumbnailCache::onThumbnail(int serial, qint64 timeMs, const QImage &image, const QByteArray &jpeg)
+{
+    if (serial != m_serial || !m_building) {
+        return;
+    }
+    // Key frames arrive in file order; a stray stamp going back is dropped
+    if (!m_times.isEmpty() && timeMs <= m_times.last()) {
+        return;
+    }
+    m_times.append(timeMs);
+    m_images.append(image);
+    m_jpegs.append(jpeg);
+    emit thumbnailAdded(timeMs);
+}
+
+void ThumbnailCache::onBuildComplete(int serial)
+{
+    if (serial != m_serial || !m_building) {
+        return;
+    }
+    const qint64 elapsedMs = m_buildTimer.elapsed();
+    stopBuild();
+    m_complete = true;
+
+    qDebug() << "Thumbnails of" << QFileInfo(m_filePath).fileName() << ":" << m_times.size() << "every"
+             << m_intervalMs << "ms, built in" << elapsedMs << "ms";
+    if (!save()) {
+        qDebug() << "Failed to store thumbnails of" << m_filePath;
+    }
+    emit ready(m_times.size());
+}
+
+bool ThumbnailCache::load()
+{
+    QFile file(cachePath(m_filePath));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const QFileInfo media(m_filePath);
+    QDataStream in(&file);
+    quint32 magic = 0;
+    qint64 mediaSize = 0;
+    qint64 mediaTime = 0;
+    qint32 intervalMs = 0;
+    qint32 width = 0;
+    quint32 count = 0;
+    in >> magic >> mediaSize >> mediaTime >> intervalMs >> width >> count;
+    // Stale once the recording is replaced, or made for another size
+    if (in.status() != QDataStream::Ok || magic != kThumbnailMagic || mediaSize != media.size()
+        || mediaTime != media.lastModified().toMSecsSinceEpoch() || width != m_width || intervalMs <= 0) {
+        return false;
+    }
+
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        qint64 timeMs = 0;
+        QByteArray jpeg;
+        in >> timeMs >> jpeg;
+        const QImage image = QImage::fromData(jpeg, "JPG");
+        if (image.isNull()) {
+            break;
+        }
+        m_times.append(timeMs);
+        m_images.append(image.convertToFormat(QImage::Format_RGB32));
+        m_jpegs.append(jpeg);
+    }
+    if (in.status() != QDataStream::Ok || static_cast<quint32>(m_times.size()) != count) {
+        m_times.clear();
+        m_images.clear();
+        m_jpegs.clear();
+        return false;
+    }
+    m_intervalMs = intervalMs;
+    return true;
+}
+
+bool ThumbnailCache::save() const
+{
+    const QFileInfo media(m_filePath);
+    return CacheFile::write(cachePath(m_filePath), [this, &media](QDataStream &out) {
+        out << kThumbnailMagic << static_cast<qint64>(media.size())
+            << static_cast<qint64>(media.lastModified().toMSecsSinceEpoch()) << static_cast<qint32>(m_intervalMs)
+            << static_cast<qint32>(m_width) << static_cast<quint32>(m_times.size());
+        for (int i = 0; i < m_times.size(); ++i) {
+            out << m_times.at(i) << m_jpegs.at(i);
+        }
+    });
+}
+
+void ThumbnailCache::runBenchmark(const QString &filePath)
+{
+    static const int kLookups = 100000;
+
+    QFile::remove(cachePath(filePath));
+    ThumbnailCache cache;
+    QEventLoop loop;
+    connect(&cache, &ThumbnailCache::ready, &loop, &QEventLoop::quit);
+    connect(&cache, &ThumbnailCache::buildFailed, &loop, [&loop](const QString &error) {
+        qDebug() << "Thumbnail benchmark:" << error;
+        loop.quit();
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    cache.open(filePath);
+    if (!cache.isComplete()) {
+        loop.exec();
+    }
+    qDebug() << "Thumbnail benchmark, cold build:" << cache.count() << "thumbnails in" << timer.elapsed() << "ms";
+    if (!cache.isComplete() || cache.count() == 0) {
+        return;
+    }
+
+    cache.close();
+    timer.restart();
+    cache.open(filePath);
+    qDebug() << "Thumbnail benchmark, warm load:" << cache.count() << "thumbnails in" << timer.elapsed() << "ms";
+
+    const qint64 spanMs = cache.m_times.last() + cache.intervalMs();
+    quint32 seed = 12345;
+    int hits = 0;
+    timer.restart();
+    for (int i = 0; i < kLookups; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        if (!cache.thumbnailAt(static_cast<qint64>(seed % static_cast<quint32>(spanMs))).isNull()) {
+            ++hits;
+        }
+    }
+    qDebug() << "Thumbnail benchmark, lookup:" << timer.nsecsElapsed() / 1000.0 / kLookups << "us each,"
+             << hits << "of" << kLookups << "hit";
+}
@@ -0,0 +1,95 @@
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QObject>
+#include <QVector>
+#include <QImage>
+#include <QString>
+#include <QElapsedTimer>
+#include <atomic>
+#include "FrameConsumer.h"
+
+class MediaPlayerWrapper;
+
+// Seek-bar preview images of one recording, one per fixed time slot. They
+// are built in the background on a port of its own that decodes I-frames
+// only, headless and unpaced; each slot keeps the first key frame at or
+// after its start, shrunk in the same pass as the colour conversion. A
+// finished set is stored in the cache directory, tied to the file's size
+// and modification time, so opening the file again is warm at once.
+//
+// Lookups are a binary search over the slot times and hand out an
+// implicitly shared QImage; all calls are for the GUI thread.
+class ThumbnailCache : public QObject, public FrameConsumer
+{
+    Q_OBJECT
+
+public:
+    explicit ThumbnailCache(QObject *parent = nullptr);
+    ~ThumbnailCache();
+
+    // Loads the stored set of filePath or starts building it. Thumbnails
+    // become available in time order while the build runs.
+    bool open(const QString &filePath);
+    void close();
+    QString filePath() const { return m_filePath; }
+    bool isBuilding() const { return m_building; }
+    bool isComplete() const { return m_complete; }
+    int count() const { return m_times.size(); }
+
+    // Thumbnail of the slot containing timeMs, or a null image when that
+    // part of the file has not been reached yet
+    QImage thumbnailAt(qint64 timeMs) const;
+
+    // 0 picks the spacing from the file length
+    void setIntervalMs(int intervalMs) { m_fixedIntervalMs = qMax(0, intervalMs); }
+    int intervalMs() const { return m_intervalMs; }
+    void setThumbnailWidth(int width) { m_width = qMax(16, width & ~1); }
+
+    // FrameConsumer, on the SDK decode thread
+    void onFrame(const DecodedFrame &frame) override;
+    void onEndOfStream() override;
+
+    // Builds the set of filePath from scratch, loads it back from the cache
+    // directory, and times random lookups; logs all three.
+    static void runBenchmark(const QString &filePath);
+
+signals:
+    void thumbnailAdded(qint64 timeMs);
+    // The whole file is covered
+    void ready(int count);
+    void buildFailed(const QString &error);
+
+private slots:
+    void onFileOpened(const QString &filePath);
+    void onFileOpenFailed(const QString &filePath, const QString &error);
+    void onThumbnail(int serial, qint64 timeMs, const QImage &image, const QByteArray &jpeg);
+    void onBuildComplete(int serial);
+
+private:
+    bool load();
+    bool save() const;
+    void stopBuild();
+
+    MediaPlayerWrapper *m_player;
+    QString m_filePath;
+    int m_serial;
+    bool m_building;
+    bool m_complete;
+    int m_fixedIntervalMs;
+    int m_intervalMs;
+    int m_width;
+    QElapsedTimer m_buildTimer;
+
+    // Written by the decode thread only while accepting
+    std::atomic<bool> m_accepting;
+    qint64 m_nextSlotMs;
+    qint64 m_baseStampMs;               // stamp of the first frame, -1 until seen
+
+    // Ordered by time; the JPEG bytes are what gets stored
+    QVector<qint64> m_times;
+    QVector<QImage> m_images;
+    QVector<QByteArray> m_jpegs;
+};
+
+#endif // THUMBNAILCACHE_H
@@ -0,0 +1,393 @@
+#include "TimelineIndex.h"
+#include "MediaPlayerWrapper.h"
+#include "PlaylistPlayer.h"
+#include "watermarkdialog.h"
+#include "CacheFile.h"
+#include <QDataStream>
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QDebug>
+#include <algorithm>
+
+static const quint32 kTimelineMagic = 0x53544c31;  // "STL1"
+static const char *kSidecarName = "timeline.stlidx";
+
+// Where the index goes when the recordings' directory is read-only
+static QString cachePath(const QString &directory)
+{
+    return CacheFile::path("timeline", QDir(directory).absolutePath(), ".stlidx");
+}
+
+// Device times carry no zone; UTC keeps them free of DST shifts
+static qint64 toDeviceMs(const QDateTime &time)
+{
+    return QDateTime(time.date(), time.time(), Qt::UTC).toMSecsSinceEpoch();
+}
+
+static QDateTime fromDeviceMs(qint64 ms)
+{
+    const QDateTime utc = QDateTime::fromMSecsSinceEpoch(ms, Qt::UTC);
+    return QDateTime(utc.date(), utc.time());
+}
+
+static qint64 systemTimeMs(const PLAYM4_SYSTEM_TIME &time)
+{
+    const QDate date(static_cast<int>(time.dwYear), static_cast<int>(time.dwMon), static_cast<int>(time.dwDay));
+    const QTime clock(static_cast<int>(time.dwHour), static_cast<int>(time.dwMin),
+                      static_cast<int>(time.dwSec), static_cast<int>(time.dwMs));
+    if (!date.isValid() || !clock.isValid()) {
+        return -1;
+    }
+    return QDateTime(date, clock, Qt::UTC).toMSecsSinceEpoch();
+}
+
+static qint64 globalTimeMs(DWORD time)
+{
+    const QDate date(GET_FILE_YEAR(time), GET_FILE_MONTH(time), GET_FILE_DAY(time));
+    const QTime clock(GET_FILE_HOUR(time), GET_FILE_MINUTE(time), GET_FILE_SECOND(time));
+    if (!date.isValid() || !clock.isValid()) {
+        return -1;
+    }
+    return QDateTime(date, clock, Qt::UTC).toMSecsSinceEpoch();
+}
+
+// NVR exports name files like "ch05_20240312143000.mp4"
+static int channelFromName(const QString &fileName)
+{
+    static const QRegularExpression pattern("(?:ch|chan|channel|cam|camera)[ _-]?0*(\\d+)",
+                                            QRegularExpression::CaseInsensitiveOption);
+    const QRegularExpressionMatch match = pattern.match(fileName);
+    return match.hasMatch() ? match.captured(1).toInt() : 0;
+}
+
+static bool entryLess(int channel, qint64 startMs, int otherChannel, qint64 otherStartMs)
+{
+    return channel != otherChannel ? channel < otherChannel : startMs < otherStartMs;
+}
+
+TimelineIndex::TimelineIndex(QObject *parent)
+    : QObject(parent)
+    , m_player(nullptr)
+    , m_probing(-1)
+    , m_changed(false)
+{
+    m_player = new MediaPlayerWrapper(this);
+    m_player->initialize();
+    connect(m_player, &MediaPlayerWrapper::fileOpened, this, &TimelineIndex::onFileOpened);
+    connect(m_player, &MediaPlayerWrapper::fileOpenFailed, this, &TimelineIndex::onFileOpenFailed);
+}
+
+TimelineIndex::~TimelineIndex()
+{
+    cancel();
+}
+
+bool TimelineIndex::open(const QString &directory)
+{
+    if (QDir(directory).absolutePath() == m_directory && (isBuilding() || isReady())) {
+        return true;
+    }
+    cancel();
+    m_entries.clear();
+    m_directory = QDir(directory).absolutePath();
+    if (!QDir(m_directory).exists()) {
+        m_directory.clear();
+        return false;
+    }
+
+    QVector<Entry> stored;
+    if (load()) {
+        stored.swap(m_entries);
+    }
+
+    // Keep what is still current, probe the rest
+    const QStringList files = PlaylistPlayer::segmentsInDirectory(m_directory);
+    for (const QString &filePath : files) {
+        const QFileInfo info(filePath);
+        Entry entry;
+        entry.fileName = info.fileName();
+        entry.bytes = info.size();
+        entry.modifiedMs = info.lastModified().toMSecsSinceEpoch();
+        entry.channel = 0;
+        entry.startMs = -1;
+        entry.endMs = -1;
+
+        auto it = std::find_if(stored.constBegin(), stored.constEnd(), [&entry](const Entry &old) {
+            return old.fileName == entry.fileName;
+        });
+        if (it != stored.constEnd() && it->bytes == entry.bytes && it->modifiedMs == entry.modifiedMs) {
+            m_entries.append(*it);
+        } else {
+            m_pending.append(entry);
+        }
+    }
+    // Files that went away
+    m_changed = m_entries.size() != stored.size();
+
+    m_buildTimer.start();
+    if (m_pending.isEmpty()) {
+        finish();
+        return true;
+    }
+    m_probing = 0;
+    probeNext();
+    return true;
+}
+
+void TimelineIndex::cancel()
+{
+    if (m_probing < 0) {
+        return;
+    }
+    m_player->cancelPendingOpen();
+    m_player->closeFile();
+    m_pending.clear();
+    m_probing = -1;
+    m_directory.clear();
+}
+
+void TimelineIndex::probeNext()
+{
+    emit progress(m_probing, m_pending.size());
+    if (m_probing >= m_pending.size()) {
+        finish();
+        return;
+    }
+    m_player->openFileAsync(QDir(m_directory).filePath(m_pending.at(m_probing).fileName));
+}
+
+void TimelineIndex::onFileOpened(const QString &filePath)
+{
+    if (m_probing < 0 || QFileInfo(filePath).fileName() != m_pending.at(m_probing).fileName) {
+        return;
+    }
+
+    Entry &entry = m_pending[m_probing];
+    const qint64 durationMs = m_player->duration() * 1000;
+    PLAYM4_SYSTEM_TIME begin;
+    PLAYM4_SYSTEM_TIME end;
+    if (m_player->getFileTimeRange(&begin, &end)) {
+        entry.startMs = systemTimeMs(begin);
+        entry.endMs = systemTimeMs(end);
+    }
+    // The stored watermark index has the device time and the channel
+    const WatermarkIndex &watermarks = m_player->watermarkIndex();
+    if (!watermarks.isEmpty()) {
+        const WatermarkRecord &first = watermarks.records().first();
+        entry.channel = first.data.channelNum;
+        if (entry.startMs < 0) {
+            entry.startMs = globalTimeMs(first.data.globalTime);
+            entry.endMs = entry.startMs >= 0 ? entry.startMs + durationMs : -1;
+        }
+    } else {
+        entry.channel = channelFromName(entry.fileName);
+    }
+    if (entry.endMs < entry.startMs) {
+        entry.endMs = entry.startMs + durationMs;
+    }
+    m_player->closeFile();
+
+    if (entry.startMs < 0) {
+        qDebug() << "Timeline: no device time in" << filePath;
+    } else {
+        m_entries.append(entry);
+    }
+    m_changed = true;
+    ++m_probing;
+    probeNext();
+}
+
+void TimelineIndex::onFileOpenFailed(const QString &filePath, const QString &error)
+{
+    if (m_probing < 0 || QFileInfo(filePath).fileName() != m_pending.at(m_probing).fileName) {
+        return;
+    }
+    qDebug() << "Timeline: skipping" << filePath << error;
+    ++m_probing;
+    probeNext();
+}
+
+void TimelineIndex::finish()
+{
+    m_pending.clear();
+    m_probing = -1;
+    sortEntries();
+    if (m_changed && !save()) {
+        qDebug() << "Timeline: failed to store the index of" << m_directory;
+    }
+    qDebug() << "Timeline of" << m_directory << ":" << m_entries.size() << "files in" << m_buildTimer.elapsed() << "ms";
+    emit ready(m_entries.size());
+}
+
+void TimelineIndex::sortEntries()
+{
+    std::sort(m_entries.begin(), m_entries.end(), [](const Entry &a, const Entry &b) {
+        return entryLess(a.channel, a.startMs, b.channel, b.startMs);
+    });
+}
+
+QVector<int> TimelineIndex::channels() const
+{
+    QVector<int> result;
+    for (const Entry &entry : m_entries) {
+        if (result.isEmpty() || result.last() != entry.channel) {
+            result.append(entry.channel);
+        }
+    }
+    return result;
+}
+
+QDateTime TimelineIndex::firstTime(int channel) const
+{
+    auto it = std::lower_bound(m_entries.constBegin(), m_entries.constEnd(), channel,
+                               [](const Entry &entry, int value) { return entry.channel < value; });
+    return (it != m_entries.constEnd() && it->channel == channel) ? fromDeviceMs(it->startMs) : QDateTime();
+}
+
+QDateTime TimelineIndex::lastTime(int channel) const
+{
+    auto it = std::upper_bound(m_entries.constBegin(), m_entries.constEnd(), channel,
+                               [](int value, const Entry &entry) { return value < entry.channel; });
+    if (it == m_entries.constBegin() || (it - 1)->channel != channel) {
+        return QDateTime();
+    }
+    return fromDeviceMs((it - 1)->endMs);
+}
+
+bool TimelineIndex::locate(int channel, const QDateTime &time, Location *location) const
+{
+    if (!location || !time.isValid()) {
+        return false;
+    }
+    const qint64 timeMs = toDeviceMs(time);
+
+    // First entry starting after the time; the one before it may hold it
+    auto it = std::upper_bound(m_entries.constBegin(), m_entries.constEnd(), timeMs,
+                               [channel](qint64 value, const Entry &entry) {
+        return entryLess(channel, value, entry.channel, entry.startMs);
+    });
+    if (it != m_entries.constBegin()) {
+        const Entry &previous = *(it - 1);
+        if (previous.channel == channel && timeMs < previous.endMs) {
+            location->filePath = QDir(m_directory).filePath(previous.fileName);
+            location->offsetMs = timeMs - previous.startMs;
+            location->exact = true;
+            return true;
+        }
+    }
+    // In a gap, or before the first recording: the next one of the channel
+    if (it != m_entries.constEnd() && it->channel == channel) {
+        location->filePath = QDir(m_directory).filePath(it->fileName);
+        location->offsetMs = 0;
+        location->exact = false;
+        return true;
+    }
+    return false;
+}
+
+bool TimelineIndex::load()
+{
+    m_entries.clear();
+
+    const QString paths[2] = { QDir(m_directory).filePath(kSidecarName), cachePath(m_directory) };
+    for (const QString &path : paths) {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+
+        QDataStream in(&file);
+        quint32 magic = 0;
+        quint32 count = 0;
+        in >> magic >> count;
+        if (in.status() != QDataStream::Ok || magic != kTimelineMagic) {
+            continue;
+        }
+
+        m_entries.reserve(static_cast<int>(qMin<quint32>(count, 1u << 20)));
+        for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+            Entry entry;
+            qint32 channel = 0;
+            qint64 durationMs = 0;
+            in >> entry.fileName >> entry.bytes >> entry.modifiedMs >> channel >> entry.startMs >> durationMs;
+            entry.channel = channel;
+            entry.endMs = entry.startMs + durationMs;
+            m_entries.append(entry);
+        }
+        if (in.status() != QDataStream::Ok) {
+            m_entries.clear();
+            continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+bool TimelineIndex::save() const
+{
+    const QString paths[2] = { QDir(m_directory).filePath(kSidecarName), cachePath(m_directory) };
+    auto serialize = [this](QDataStream &out) {
+        out << kTimelineMagic << static_cast<quint32>(m_entries.size());
+        for (const Entry &entry : m_entries) {
+            out << entry.fileName << entry.bytes << entry.modifiedMs << static_cast<qint32>(entry.channel)
+                << entry.startMs << (entry.endMs - entry.startMs);
+        }
+    };
+    for (const QString &path : paths) {
+        if (CacheFile::write(path, serialize)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TimelineIndex::runBenchmark(const QString &directory)
+{
+    static const int kLookups = 100000;
+
+    QFile::remove(QDir(directory).filePath(kSidecarName));
+    QFile::remove(cachePath(directory));
+
+    TimelineIndex index;
+    QEventLoop loop;
+    connect(&index, &TimelineIndex::ready, &loop, &QEventLoop::quit);
+
+    QElapsedTimer timer;
+    timer.start();
+    index.open(directory);
+    if (index.isBuilding()) {
+        loop.exec();
+    }
+    qDebug() << "Timeline benchmark, cold build:" << index.count() << "files in" << timer.elapsed() << "ms";
+    if (index.count() == 0) {
+        return;
+    }
+
+    TimelineIndex warm;
+    timer.restart();
+    warm.open(directory);
+    qDebug() << "Timeline benchmark, warm load:" << warm.count() << "files in" << timer.elapsed() << "ms,"
+             << (warm.isReady() ? "no" : "some") << "files probed";
+
+    const QVector<int> channels = warm.channels();
+    quint32 seed = 12345;
+    int hits = 0;
+    timer.restart();
+    for (int i = 0; i < kLookups; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        const int channel = channels.at(static_cast<int>(seed % static_cast<quint32>(channels.size())));
+        const qint64 firstMs = toDeviceMs(warm.firstTime(channel));
+        const qint64 spanMs = qMax<qint64>(1, toDeviceMs(warm.lastTime(channel)) - firstMs);
+        seed = seed * 1664525u + 1013904223u;
+        Location location;
+        if (warm.locate(channel, fromDeviceMs(firstMs + static_cast<qint64>(seed) % spanMs), &location)
+            && location.exact) {
+            ++hits;
+        }
+    }
+    qDebug() << "Timeline benchmark, lookup:" << timer.nsecsElapsed() / 1000.0 / kLookups << "us each,"
+             << hits << "of" << kLookups << "inside a recording";
+}
@@ -0,0 +1,92 @@
+#ifndef TIMELINEINDEX_H
+#define TIMELINEINDEX_H
+
+#include <QObject>
+#include <QVector>
+#include <QStringList>
+#include <QDateTime>
+#include <QElapsedTimer>
+
+class MediaPlayerWrapper;
+
+// Wall-clock index of a directory of recordings: for every file, the
+// camera channel and the device time of its first and last frame. Each
+// file is opened once, on a port of its own, to read its time range
+// (PlayM4_GetFileTotalTime, or the global time of its stored watermark
+// index); the result is kept in a small sidecar in the directory (or the
+// cache directory when that is read-only) and only new or changed files are
+// probed again.
+//
+// Entries are sorted by channel and start time, so "14:32:07 on camera 5"
+// resolves to a file and an offset with one binary search.
+class TimelineIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Location
+    {
+        QString filePath;
+        qint64 offsetMs;
+        // False when the time fell into a gap and the next recording of
+        // the channel was taken instead
+        bool exact;
+    };
+
+    explicit TimelineIndex(QObject *parent = nullptr);
+    ~TimelineIndex();
+
+    // Loads the stored index of directory and probes what it does not
+    // cover; ready() follows, at once if nothing had to be probed
+    bool open(const QString &directory);
+    void cancel();
+    QString directory() const { return m_directory; }
+    bool isBuilding() const { return m_probing >= 0; }
+    bool isReady() const { return !m_directory.isEmpty() && m_probing < 0; }
+    int count() const { return m_entries.size(); }
+
+    QVector<int> channels() const;
+    // Device time is kept as recorded, without a time zone
+    QDateTime firstTime(int channel) const;
+    QDateTime lastTime(int channel) const;
+    bool locate(int channel, const QDateTime &time, Location *location) const;
+
+    // Indexes directory from scratch, again from the sidecar, and times
+    // random lookups; logs all three.
+    static void runBenchmark(const QString &directory);
+
+signals:
+    void progress(int done, int total);
+    void ready(int files);
+
+private slots:
+    void onFileOpened(const QString &filePath);
+    void onFileOpenFailed(const QString &filePath, const QString &error);
+
+private:
+    struct Entry
+    {
+        QString fileName;       // relative to the directory
+        qint64 bytes;
+        qint64 modifiedMs;
+        int channel;
+        qint64 startMs;         // device time as ms since 1970, no zone
+        qint64 endMs;
+    };
+
+    void probeNext();
+    void finish();
+    bool load();
+    bool save() const;
+    void sortEntries();
+
+    MediaPlayerWrapper *m_player;
+    QString m_directory;
+    QVector<Entry> m_entries;   // by channel, then start time
+    QVector<Entry> m_pending;   // files still to be probed
+    int m_probing;              // index into m_pending, -1 when idle
+    bool m_changed;
+    QElapsedTimer m_buildTimer;
+};
+
+#endif // TIMELINEINDEX_H
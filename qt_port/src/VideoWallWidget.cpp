@@ -0,0 +1,87 @@
+#include "VideoWallWidget.h"
+#include <QGridLayout>
+#include <QMouseEvent>
+#include <qmath.h>
+
+static const char *kTileStyle = "background-color:black;";
+static const char *kSelectedTileStyle = "background-color:black; border:1px solid #3399ff;";
+
+VideoWallWidget::VideoWallWidget(QWidget *parent)
+    : QWidget(parent)
+    , m_layout(new QGridLayout(this))
+    , m_selectedTile(-1)
+{
+    m_layout->setContentsMargins(0, 0, 0, 0);
+    m_layout->setSpacing(1);
+    setStyleSheet("background-color:#202020;");
+}
+
+bool VideoWallWidget::isSupportedTileCount(int tiles)
+{
+    return tiles == 1 || tiles == 4 || tiles == 9 || tiles == 16 || tiles == 36 || tiles == 64;
+}
+
+void VideoWallWidget::setTileCount(int tiles)
+{
+    if (!isSupportedTileCount(tiles)) {
+        return;
+    }
+
+    while (m_tiles.size() > tiles) {
+        QWidget *tile = m_tiles.takeLast();
+        m_layout->removeWidget(tile);
+        delete tile;
+    }
+    while (m_tiles.size() < tiles) {
+        QWidget *tile = new QWidget(this);
+        tile->setAttribute(Qt::WA_NativeWindow);
+        tile->setAttribute(Qt::WA_StyledBackground);
+        tile->setStyleSheet(kTileStyle);
+        tile->installEventFilter(this);
+        m_tiles.append(tile);
+    }
+
+    // Re-place every tile row-major for the new grid side
+    const int side = qRound(qSqrt(tiles));
+    for (int i = 0; i < m_tiles.size(); ++i) {
+        m_layout->removeWidget(m_tiles.at(i));
+        m_layout->addWidget(m_tiles.at(i), i / side, i % side);
+    }
+    for (int i = 0; i < m_layout->rowCount() || i < side; ++i) {
+        m_layout->setRowStretch(i, i < side ? 1 : 0);
+        m_layout->setColumnStretch(i, i < side ? 1 : 0);
+    }
+
+    selectTile(m_selectedTile < tiles ? qMax(0, m_selectedTile) : 0);
+}
+
+HWND VideoWallWidget::tileWindow(int index) const
+{
+    if (index < 0 || index >= m_tiles.size()) {
+        return nullptr;
+    }
+    return reinterpret_cast<HWND>(m_tiles.at(index)->winId());
+}
+
+bool VideoWallWidget::eventFilter(QObject *obj, QEvent *event)
+{
+    if (event->type() == QEvent::MouseButtonPress) {
+        const int index = m_tiles.indexOf(static_cast<QWidget *>(obj));
+        if (index >= 0) {
+            selectTile(index);
+        }
+    }
+    return QWidget::eventFilter(obj, event);
+}
+
+void VideoWallWidget::selectTile(int index)
+{
+    if (m_selectedTile >= 0 && m_selectedTile < m_tiles.size()) {
+        m_tiles.at(m_selectedTile)->setStyleSheet(kTileStyle);
+    }
+    m_selectedTile = index;
+    if (index >= 0 && index < m_tiles.size()) {
+        m_tiles.at(index)->setStyleSheet(kSelectedTileStyle);
+        emit tileSelected(index);
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef VIDEOWALLWIDGET_H
+#define VIDEOWALLWIDGET_H
+
+#include <QWidget>
+#include <QVector>
+#include <Windows.h>
+
+class QGridLayout;
+
+// Square grid of native render targets for PlayerPool tiles. Existing tiles
+// keep their window handle when the grid is resized, so ports rendering into
+// them do not need to be re-attached.
+class VideoWallWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit VideoWallWidget(QWidget *parent = nullptr);
+
+    static bool isSupportedTileCount(int tiles);
+
+    void setTileCount(int tiles);
+    int tileCount() const { return m_tiles.size(); }
+    HWND tileWindow(int index) const;
+    int selectedTile() const { return m_selectedTile; }
+
+signals:
+    void tileSelected(int index);
+
+protected:
+    bool eventFilter(QObject *obj, QEvent *event) override;
+
+private:
+    void selectTile(int index);
+
+    QGridLayout *m_layout;
+    QVector<QWidget *> m_tiles;
+    int m_selectedTile;
+};
+
+#endif // VIDEOWALLWIDGET_H
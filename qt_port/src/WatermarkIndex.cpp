@@ -0,0 +1,219 @@
+#include "WatermarkIndex.h"
+#include "CacheFile.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+#include <algorithm>
+#include <string.h>
+
+static const quint32 kIndexMagic = 0x53574d31;  // "SWM1"
+// Records further apart than this are not assumed to cover the frames between
+static const quint32 kMaxRecordGap = 250;
+
+QString WatermarkData::macString() const
+{
+    static const char kHex[] = "0123456789abcdef";
+    char text[17];
+    for (int i = 0; i < 6; ++i) {
+        text[i * 3] = kHex[mac[i] >> 4];
+        text[i * 3 + 1] = kHex[mac[i] & 15];
+        if (i < 5) {
+            text[i * 3 + 2] = ':';
+        }
+    }
+    return QString::fromLatin1(text, sizeof(text));
+}
+
+static bool sameContent(const WatermarkRecord &a, const WatermarkRecord &b)
+{
+    return a.rsaValid == b.rsaValid && a.data.globalTime == b.data.globalTime
+        && a.data.deviceSN == b.data.deviceSN && memcmp(a.data.mac, b.data.mac, sizeof(a.data.mac)) == 0
+        && a.data.deviceType == b.data.deviceType && a.data.deviceInfo == b.data.deviceInfo
+        && a.data.channelNum == b.data.channelNum;
+}
+
+static bool frameLess(const WatermarkRecord &record, quint32 frameNum)
+{
+    return record.frameNum < frameNum;
+}
+
+WatermarkIndex::WatermarkIndex()
+    : m_currentSpan(-1)
+    , m_complete(false)
+{
+}
+
+void WatermarkIndex::clear()
+{
+    m_records.clear();
+    m_spans.clear();
+    m_currentSpan = -1;
+    m_complete = false;
+}
+
+void WatermarkIndex::add(const WatermarkRecord &record)
+{
+    coverFrame(record.frameNum);
+
+    QVector<WatermarkRecord>::iterator it =
+        std::lower_bound(m_records.begin(), m_records.end(), record.frameNum, frameLess);
+    if (it != m_records.end() && it->frameNum == record.frameNum) {
+        *it = record;
+        return;
+    }
+    if (it != m_records.begin() && sameContent(*(it - 1), record)) {
+        return;
+    }
+    m_records.insert(it, record);
+}
+
+void WatermarkIndex::coverFrame(quint32 frameNum)
+{
+    // Continue the span of the previous record while decoding runs forward
+    if (m_currentSpan >= 0) {
+        Span &span = m_spans[m_currentSpan];
+        if (frameNum >= span.first && frameNum <= span.last) {
+            return;
+        }
+        if (frameNum > span.last && frameNum - span.last <= kMaxRecordGap) {
+            span.last = frameNum;
+            // Ran into the next span
+            if (m_currentSpan + 1 < m_spans.size() && m_spans.at(m_currentSpan + 1).first <= span.last + kMaxRecordGap) {
+                span.last = qMax(span.last, m_spans.at(m_currentSpan + 1).last);
+                m_spans.remove(m_currentSpan + 1);
+            }
+            return;
+        }
+    }
+
+    int i = 0;
+    while (i < m_spans.size() && m_spans.at(i).last < frameNum) {
+        ++i;
+    }
+    if (i < m_spans.size() && m_spans.at(i).first <= frameNum) {
+        m_currentSpan = i;
+        return;
+    }
+    Span span;
+    span.first = frameNum;
+    span.last = frameNum;
+    m_spans.insert(i, span);
+    m_currentSpan = i;
+}
+
+bool WatermarkIndex::coversWholeFile() const
+{
+    return m_spans.size() == 1 && m_spans.first().first <= kMaxRecordGap;
+}
+
+const WatermarkRecord *WatermarkIndex::recordAt(quint32 frameNum) const
+{
+    if (!m_complete) {
+        bool covered = false;
+        for (const Span &span : m_spans) {
+            if (frameNum >= span.first && frameNum <= span.last) {
+                covered = true;
+                break;
+            }
+        }
+        if (!covered) {
+            return nullptr;
+        }
+    }
+
+    // Last record at or before the frame
+    QVector<WatermarkRecord>::const_iterator it =
+        std::lower_bound(m_records.constBegin(), m_records.constEnd(), frameNum + 1, frameLess);
+    if (it == m_records.constBegin()) {
+        return nullptr;
+    }
+    return &*(it - 1);
+}
+
+QString WatermarkIndex::sidecarPath(const QString &mediaPath)
+{
+    return mediaPath + ".wmidx";
+}
+
+// Where the index goes when the recording's directory is read-only
+static QString cachePath(const QString &mediaPath)
+{
+    return CacheFile::path("watermark", QFileInfo(mediaPath).absoluteFilePath(), ".wmidx");
+}
+
+bool WatermarkIndex::load(const QString &mediaPath)
+{
+    clear();
+
+    const QFileInfo media(mediaPath);
+    const QString paths[2] = { sidecarPath(mediaPath), cachePath(mediaPath) };
+    for (const QString &path : paths) {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+
+        QDataStream in(&file);
+        quint32 magic = 0;
+        qint64 mediaSize = 0;
+        qint64 mediaTime = 0;
+        quint32 count = 0;
+        in >> magic >> mediaSize >> mediaTime >> count;
+        // Stale once the recording is replaced or rewritten
+        if (in.status() != QDataStream::Ok || magic != kIndexMagic || mediaSize != media.size()
+            || mediaTime != media.lastModified().toMSecsSinceEpoch()) {
+            continue;
+        }
+
+        m_records.reserve(static_cast<int>(qMin<quint32>(count, 1u << 24)));
+        for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+            WatermarkRecord record;
+            quint8 rsaValid = 0;
+            quint32 globalTime = 0;
+            quint32 deviceSN = 0;
+            in >> record.frameNum >> rsaValid >> globalTime >> deviceSN;
+            in.readRawData(reinterpret_cast<char *>(record.data.mac), sizeof(record.data.mac));
+            in >> record.data.deviceType >> record.data.deviceInfo >> record.data.channelNum;
+            record.rsaValid = rsaValid != 0;
+            record.data.globalTime = globalTime;
+            record.data.deviceSN = deviceSN;
+            m_records.append(record);
+        }
+        if (in.status() != QDataStream::Ok) {
+            clear();
+            continue;
+        }
+
+        m_complete = true;
+        return true;
+    }
+    return false;
+}
+
+bool WatermarkIndex::save(const QString &mediaPath) const
+{
+    if (!m_complete) {
+        return false;
+    }
+
+    const QFileInfo media(mediaPath);
+    const QString paths[2] = { sidecarPath(mediaPath), cachePath(mediaPath) };
+    auto serialize = [this, &media](QDataStream &out) {
+        out << kIndexMagic << static_cast<qint64>(media.size())
+            << static_cast<qint64>(media.lastModified().toMSecsSinceEpoch()) << static_cast<quint32>(m_records.size());
+        for (const WatermarkRecord &record : m_records) {
+            out << record.frameNum << static_cast<quint8>(record.rsaValid ? 1 : 0)
+                << static_cast<quint32>(record.data.globalTime) << static_cast<quint32>(record.data.deviceSN);
+            out.writeRawData(reinterpret_cast<const char *>(record.data.mac), sizeof(record.data.mac));
+            out << record.data.deviceType << record.data.deviceInfo << record.data.channelNum;
+        }
+    };
+    for (const QString &path : paths) {
+        if (CacheFile::write(path, serialize)) {
+            return true;
+        }
+    }
+    return false;
+}
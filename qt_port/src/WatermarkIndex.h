@@ -0,0 +1,78 @@
+#ifndef WATERMARKINDEX_H
+#define WATERMARKINDEX_H
+
+#include <QString>
+#include <QVector>
+#include <Windows.h>
+
+// Watermark fields as carried in the stream. Kept raw so the decode thread
+// neither formats nor allocates; the MAC is formatted by whoever shows it.
+struct WatermarkData{
+    DWORD globalTime;
+    DWORD deviceSN;
+    unsigned char mac[6];
+    unsigned char deviceType;
+    unsigned char deviceInfo;
+    unsigned char channelNum;
+
+    QString macString() const;
+};
+
+// One watermark record as met while decoding
+struct WatermarkRecord
+{
+    quint32 frameNum;
+    bool rsaValid;
+    WatermarkData data;
+};
+
+// Frame number to watermark record table of one file, so the watermark of
+// any position is known without waiting for the decoder to reach the next
+// watermark frame. Filled from a verification scan or from the records of
+// a playback; only a complete table is stored, in a sidecar file next to
+// the recording (or in the cache directory when that is read-only) and
+// tied to the file's size and modification time.
+class WatermarkIndex
+{
+public:
+    WatermarkIndex();
+
+    void clear();
+    bool isEmpty() const { return m_records.isEmpty(); }
+    int size() const { return m_records.size(); }
+    const QVector<WatermarkRecord> &records() const { return m_records; }
+
+    // Records in decode order. One that only repeats its predecessor is
+    // folded into it; a jump backwards or far ahead starts a new covered
+    // span, as after a seek during playback.
+    void add(const WatermarkRecord &record);
+
+    // Covers the whole file: set after a scan, or after a playback whose
+    // records form one span from the start of the file
+    bool isComplete() const { return m_complete; }
+    bool coversWholeFile() const;
+    void setComplete(bool complete) { m_complete = complete; }
+
+    // The record in effect at frameNum, or null when frameNum lies outside
+    // what has been seen so far
+    const WatermarkRecord *recordAt(quint32 frameNum) const;
+
+    bool load(const QString &mediaPath);
+    bool save(const QString &mediaPath) const;
+    static QString sidecarPath(const QString &mediaPath);
+
+private:
+    struct Span {
+        quint32 first;
+        quint32 last;
+    };
+
+    void coverFrame(quint32 frameNum);
+
+    QVector<WatermarkRecord> m_records;     // ordered by frame number
+    QVector<Span> m_spans;                  // ordered and disjoint
+    int m_currentSpan;                      // span the last record extended
+    bool m_complete;
+};
+
+#endif // WATERMARKINDEX_H
@@ -0,0 +1,254 @@
+#include "WatermarkVerifier.h"
+#include "FrameConsumer.h"
+#include "watermarkdialog.h"
+#include <QFile>
+#include <QTextStream>
+#include <QThread>
+#include <QDebug>
+#include <string.h>
+
+// Headless decode of one file, collecting its watermark records
+class WatermarkScan : public FrameConsumer
+{
+public:
+    WatermarkScan(int index, const QString &filePath, QObject *parent)
+        : m_index(index)
+        , m_player(new MediaPlayerWrapper(parent))
+        , m_frames(0)
+        , m_done(false)
+    {
+        m_result.filePath = filePath;
+        m_result.frames = 0;
+        m_result.invalidRecords = 0;
+        m_result.elapsedMs = 0;
+        m_timer.start();
+    }
+
+    // On the SDK decode thread; read back only after stopHeadless()
+    void onFrame(const DecodedFrame &frame) override
+    {
+        Q_UNUSED(frame)
+        ++m_frames;
+    }
+
+    void onWatermark(const WatermarkData &data, quint32 frameNum, bool rsaValid) override
+    {
+        WatermarkRecord record;
+        record.frameNum = frameNum;
+        record.rsaValid = rsaValid;
+        record.data = data;
+        m_result.records.append(record);
+        if (!rsaValid) {
+            ++m_result.invalidRecords;
+        }
+    }
+
+    int m_index;
+    MediaPlayerWrapper *m_player;
+    quint64 m_frames;
+    bool m_done;
+    WatermarkVerifier::FileResult m_result;
+    QElapsedTimer m_timer;
+};
+
+static QString formatGlobalTime(DWORD time)
+{
+    return QString("%1-%2-%3 %4:%5:%6").arg(GET_FILE_YEAR(time))
+        .arg(GET_FILE_MONTH(time), 2, 10, QChar('0')).arg(GET_FILE_DAY(time), 2, 10, QChar('0'))
+        .arg(GET_FILE_HOUR(time), 2, 10, QChar('0')).arg(GET_FILE_MINUTE(time), 2, 10, QChar('0'))
+        .arg(GET_FILE_SECOND(time), 2, 10, QChar('0'));
+}
+
+// Records that only differ in frame and time belong to the same run
+static bool sameSource(const WatermarkRecord &a, const WatermarkRecord &b)
+{
+    return a.rsaValid == b.rsaValid && a.data.deviceSN == b.data.deviceSN
+        && memcmp(a.data.mac, b.data.mac, sizeof(a.data.mac)) == 0
+        && a.data.channelNum == b.data.channelNum && a.data.deviceType == b.data.deviceType
+        && a.data.deviceInfo == b.data.deviceInfo;
+}
+
+WatermarkVerifier::WatermarkVerifier(QObject *parent)
+    : QObject(parent)
+    , m_maxParallel(qMax(1, QThread::idealThreadCount()))
+    , m_total(0)
+{
+}
+
+WatermarkVerifier::~WatermarkVerifier()
+{
+    cancel();
+}
+
+bool WatermarkVerifier::start(const QStringList &files, const QString &reportPath)
+{
+    if (isActive() || files.isEmpty()) {
+        return false;
+    }
+
+    m_queue = files;
+    m_reportPath = reportPath;
+    m_total = files.size();
+    m_results.clear();
+    m_results.resize(m_total);
+    m_timer.start();
+    m_startedAt = QDateTime::currentDateTime();
+    startNext();
+    return true;
+}
+
+void WatermarkVerifier::cancel()
+{
+    if (!isActive()) {
+        return;
+    }
+
+    const int firstQueued = m_total - m_queue.size();
+    for (int i = 0; i < m_queue.size(); ++i) {
+        m_results[firstQueued + i].filePath = m_queue.at(i);
+        m_results[firstQueued + i].error = "Cancelled";
+    }
+    m_queue.clear();
+
+    const QVector<WatermarkScan *> running = m_running;
+    for (WatermarkScan *scan : running) {
+        scan->m_result.error = "Cancelled";
+        onScanDone(scan);
+    }
+}
+
+void WatermarkVerifier::startNext()
+{
+    while (m_running.size() < m_maxParallel && !m_queue.isEmpty()) {
+        const int index = m_total - m_queue.size();
+        WatermarkScan *scan = new WatermarkScan(index, m_queue.takeFirst(), this);
+        m_running.append(scan);
+
+        MediaPlayerWrapper *player = scan->m_player;
+        player->initialize();
+        connect(player, &MediaPlayerWrapper::fileOpened, this, [this, scan]() {
+            if (!scan->m_player->startHeadless(scan)) {
+                scan->m_result.error = "Failed to start decoding";
+                onScanDone(scan);
+            }
+        });
+        connect(player, &MediaPlayerWrapper::fileOpenFailed, this, [this, scan](const QString &, const QString &error) {
+            scan->m_result.error = error;
+            onScanDone(scan);
+        });
+        connect(player, &MediaPlayerWrapper::fileEnded, this, [this, scan]() {
+            onScanDone(scan);
+        });
+        player->openFileAsync(scan->m_result.filePath);
+    }
+}
+
+void WatermarkVerifier::onScanDone(WatermarkScan *scan)
+{
+    if (scan->m_done) {
+        return;
+    }
+    scan->m_done = true;
+
+    // Detaches the consumer, so the decode thread is done with the scan
+    scan->m_player->cancelPendingOpen();
+    scan->m_player->stopHeadless();
+
+    // Every record of the file was seen; the player's own index may have
+    // dropped some at full decode speed
+    FileResult &result = scan->m_result;
+    if (result.error.isEmpty() && !result.records.isEmpty() && !scan->m_player->watermarkIndex().isComplete()) {
+        WatermarkIndex index;
+        for (const WatermarkRecord &record : result.records) {
+            index.add(record);
+        }
+        index.setComplete(true);
+        index.save(result.filePath);
+    }
+    scan->m_player->closeFile();
+    scan->m_player->disconnect(this);
+    scan->m_player->deleteLater();
+
+    result.frames = scan->m_frames;
+    result.elapsedMs = scan->m_timer.elapsed();
+    const bool ok = passed(result);
+    qDebug() << "Watermark scan of" << result.filePath << (ok ? "passed:" : "failed:") << result.frames
+             << "frames," << result.records.size() << "records," << result.invalidRecords << "invalid in"
+             << result.elapsedMs << "ms";
+    emit fileVerified(result.filePath, ok, result.records.size(), result.invalidRecords);
+
+    m_results[scan->m_index] = result;
+    m_running.removeOne(scan);
+    delete scan;
+
+    emit progress(m_total - m_queue.size() - m_running.size(), m_total);
+    startNext();
+    if (isActive()) {
+        return;
+    }
+
+    int failedFiles = 0;
+    for (const FileResult &file : m_results) {
+        if (!passed(file)) {
+            ++failedFiles;
+        }
+    }
+    qDebug() << "Watermark verification of" << m_total << "files in" << m_timer.elapsed() << "ms with"
+             << m_maxParallel << "in parallel," << failedFiles << "failed";
+    if (!writeReport()) {
+        qDebug() << "Failed to write watermark report" << m_reportPath;
+    }
+    emit finished(m_total, failedFiles, m_reportPath);
+}
+
+bool WatermarkVerifier::passed(const FileResult &result)
+{
+    return result.error.isEmpty() && !result.records.isEmpty() && result.invalidRecords == 0;
+}
+
+QString WatermarkVerifier::formatReport(const FileResult &result)
+{
+    QString text;
+    QTextStream out(&text);
+    const char *verdict = !result.error.isEmpty() ? "ERROR" : (passed(result) ? "PASS" : "FAIL");
+    out << "[" << verdict << "] " << result.filePath << "\n";
+    if (!result.error.isEmpty()) {
+        out << "  " << result.error << "\n";
+        return text;
+    }
+    out << "  " << result.frames << " frames, " << result.records.size() << " records, "
+        << result.invalidRecords << " invalid, " << result.elapsedMs << " ms\n";
+
+    for (int first = 0; first < result.records.size();) {
+        int last = first;
+        while (last + 1 < result.records.size() && sameSource(result.records.at(last + 1), result.records.at(first))) {
+            ++last;
+        }
+        const WatermarkRecord &a = result.records.at(first);
+        const WatermarkRecord &b = result.records.at(last);
+        out << "  frames " << a.frameNum << "-" << b.frameNum
+            << "  " << formatGlobalTime(a.data.globalTime) << " .. " << formatGlobalTime(b.data.globalTime)
+            << "  SN " << a.data.deviceSN << "  MAC " << a.data.macString()
+            << "  ch " << int(a.data.channelNum) << "  type " << int(a.data.deviceType)
+            << "  info " << int(a.data.deviceInfo)
+            << "  " << (last - first + 1) << " records  RSA " << (a.rsaValid ? "ok" : "INVALID") << "\n";
+        first = last + 1;
+    }
+    return text;
+}
+
+bool WatermarkVerifier::writeReport()
+{
+    QFile file(m_reportPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return false;
+    }
+
+    QTextStream out(&file);
+    out << "Watermark verification " << m_startedAt.toString("yyyy-MM-dd hh:mm:ss") << ", " << m_total
+        << " files, " << m_timer.elapsed() << " ms, " << m_maxParallel << " in parallel\n\n";
+    for (const FileResult &result : m_results) {
+        out << formatReport(result) << "\n";
+    }
+    return out.status() == QTextStream::Ok;
+}
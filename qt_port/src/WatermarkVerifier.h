@@ -0,0 +1,71 @@
+#ifndef WATERMARKVERIFIER_H
+#define WATERMARKVERIFIER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QDateTime>
+#include "MediaPlayerWrapper.h"
+
+class WatermarkScan;
+
+// Checks the watermark of whole files: each file is decoded headlessly at
+// full speed on a port of its own and every watermark record is kept with
+// its frame number, global time and RSA result. Several files run at once,
+// one per core, since every port decodes on its own SDK thread. The outcome
+// is one text report with runs of identical records collapsed into ranges,
+// and each fully scanned file gets its watermark index stored.
+class WatermarkVerifier : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct FileResult
+    {
+        QString filePath;
+        QString error;              // open or decode failure; empty if scanned
+        quint64 frames;
+        QVector<WatermarkRecord> records;
+        int invalidRecords;
+        qint64 elapsedMs;
+    };
+
+    explicit WatermarkVerifier(QObject *parent = nullptr);
+    ~WatermarkVerifier();
+
+    // Returns false if a verification is running or there is nothing to do
+    bool start(const QStringList &files, const QString &reportPath);
+    void cancel();
+    bool isActive() const { return !m_queue.isEmpty() || !m_running.isEmpty(); }
+
+    void setMaxParallel(int files) { m_maxParallel = qMax(1, files); }
+    int maxParallel() const { return m_maxParallel; }
+
+    // A file passes with at least one record and no invalid one
+    static bool passed(const FileResult &result);
+    static QString formatReport(const FileResult &result);
+
+signals:
+    void fileVerified(const QString &filePath, bool passed, int records, int invalidRecords);
+    void progress(int done, int total);
+    // failedFiles counts files that did not pass, including unreadable ones
+    void finished(int files, int failedFiles, const QString &reportPath);
+
+private:
+    void startNext();
+    void onScanDone(WatermarkScan *scan);
+    bool writeReport();
+
+    int m_maxParallel;
+    QStringList m_queue;
+    QVector<WatermarkScan *> m_running;
+    QVector<FileResult> m_results;
+    QString m_reportPath;
+    int m_total;
+    QElapsedTimer m_timer;
+    QDateTime m_startedAt;
+};
+
+#endif // WATERMARKVERIFIER_H
@@ -0,0 +1,655 @@
+#include "YuvConvert.h"
+#include "FrameConsumer.h"
+#include "MediaPlayerWrapper.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <atomic>
+#include <vector>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define YUV_HAVE_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit SSE2/AVX2 instructions inside functions that ask
+// for them; MSVC accepts the intrinsics anywhere.
+#if defined(YUV_HAVE_X86) && (defined(__GNUC__) || defined(__clang__))
+#define YUV_TARGET_SSE2 __attribute__((target("sse2")))
+#define YUV_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define YUV_TARGET_SSE2
+#define YUV_TARGET_AVX2
+#endif
+
+// BT.601 limited range in 2.13 fixed point. Every kernel computes
+// (x * 8 * coef) >> 16 per term, which is exactly what _mm_mulhi_epi16 does,
+// so the SIMD and scalar paths agree to the bit.
+static const int kCoefY = 9535;     // 1.164
+static const int kCoefVR = 13074;   // 1.596
+static const int kCoefUG = 3203;    // 0.391
+static const int kCoefVG = 6660;    // 0.813
+static const int kCoefUB = 16531;   // 2.018
+
+struct RowKernels {
+    // 4:2:x chroma: one U/V sample per two pixels
+    void (*rowSubsampled)(const uchar *y, const uchar *u, const uchar *v, uchar *dst, int width);
+    // one U/V sample per pixel, used after horizontal resampling
+    void (*rowFull)(const uchar *y, const uchar *u, const uchar *v, uchar *dst, int width);
+    void (*splitUV)(const uchar *uv, uchar *u, uchar *v, int chromaWidth);
+    void (*splitUYVY)(const uchar *src, uchar *y, uchar *u, uchar *v, int width);
+    // 2x2 box average of two luma rows into dstWidth samples
+    void (*halveLuma)(const uchar *row0, const uchar *row1, uchar *dst, int dstWidth);
+};
+
+// ---- Scalar ----------------------------------------------------------------
+
+static inline int mulHi(int value, int coef)
+{
+    return (value * coef) >> 16;
+}
+
+static inline uchar clampByte(int value)
+{
+    return static_cast<uchar>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+static inline void storePixel(uchar *dst, int y, int u, int v)
+{
+    const int yy = mulHi((y - 16) * 8, kCoefY);
+    const int uu = (u - 128) * 8;
+    const int vv = (v - 128) * 8;
+    dst[0] = clampByte(yy + mulHi(uu, kCoefUB));
+    dst[1] = clampByte(yy - mulHi(uu, kCoefUG) - mulHi(vv, kCoefVG));
+    dst[2] = clampByte(yy + mulHi(vv, kCoefVR));
+    dst[3] = 0xff;
+}
+
+static inline uchar average(int a, int b)
+{
+    return static_cast<uchar>((a + b + 1) >> 1);
+}
+
+template <bool Subsampled>
+static void rowToRgb32Scalar(const uchar *y, const uchar *u, const uchar *v, uchar *dst, int width)
+{
+    for (int x = 0; x < width; ++x) {
+        const int c = Subsampled ? (x >> 1) : x;
+        storePixel(dst + x * 4, y[x], u[c], v[c]);
+    }
+}
+
+static void splitUVScalar(const uchar *uv, uchar *u, uchar *v, int chromaWidth)
+{
+    for (int i = 0; i < chromaWidth; ++i) {
+        u[i] = uv[i * 2];
+        v[i] = uv[i * 2 + 1];
+    }
+}
+
+static void splitUYVYScalar(const uchar *src, uchar *y, uchar *u, uchar *v, int width)
+{
+    for (int i = 0; i < width / 2; ++i) {
+        u[i] = src[i * 4];
+        y[i * 2] = src[i * 4 + 1];
+        v[i] = src[i * 4 + 2];
+        y[i * 2 + 1] = src[i * 4 + 3];
+    }
+}
+
+// Same rounding as the SIMD version: vertical average first, then the pair.
+static void halveLumaScalar(const uchar *row0, const uchar *row1, uchar *dst, int dstWidth)
+{
+    for (int i = 0; i < dstWidth; ++i) {
+        dst[i] = average(average(row0[i * 2], row1[i * 2]), average(row0[i * 2 + 1], row1[i * 2 + 1]));
+    }
+}
+
+static const RowKernels s_scalarKernels = {
+    rowToRgb32Scalar<true>,
+    rowToRgb32Scalar<false>,
+    splitUVScalar,
+    splitUYVYScalar,
+    halveLumaScalar
+};
+
+#ifdef YUV_HAVE_X86
+
+// ---- SSE2 ------------------------------------------------------------------
+
+// y, u, v: eight 16-bit samples already offset and scaled by 8
+YUV_TARGET_SSE2
+static inline void yuvToRgbSse2(__m128i y, __m128i u, __m128i v, __m128i *b, __m128i *g, __m128i *r)
+{
+    const __m128i yy = _mm_mulhi_epi16(y, _mm_set1_epi16(kCoefY));
+    *b = _mm_add_epi16(yy, _mm_mulhi_epi16(u, _mm_set1_epi16(kCoefUB)));
+    *g = _mm_sub_epi16(_mm_sub_epi16(yy, _mm_mulhi_epi16(u, _mm_set1_epi16(kCoefUG))),
+                       _mm_mulhi_epi16(v, _mm_set1_epi16(kCoefVG)));
+    *r = _mm_add_epi16(yy, _mm_mulhi_epi16(v, _mm_set1_epi16(kCoefVR)));
+}
+
+YUV_TARGET_SSE2
+static inline __m128i offsetSse2(__m128i value, __m128i bias)
+{
+    return _mm_slli_epi16(_mm_sub_epi16(value, bias), 3);
+}
+
+template <bool Subsampled>
+YUV_TARGET_SSE2
+static void rowToRgb32Sse2(const uchar *y, const uchar *u, const uchar *v, uchar *dst, int width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha = _mm_set1_epi8(static_cast<char>(0xff));
+    const __m128i lumaBias = _mm_set1_epi16(16);
+    const __m128i chromaBias = _mm_set1_epi16(128);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m128i yv = _mm_loadu_si128(reinterpret_cast<const __m128i *>(y + x));
+        __m128i uLo, uHi, vLo, vHi;
+        if (Subsampled) {
+            const __m128i u16 = offsetSse2(_mm_unpacklo_epi8(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i *>(u + x / 2)), zero), chromaBias);
+            const __m128i v16 = offsetSse2(_mm_unpacklo_epi8(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i *>(v + x / 2)), zero), chromaBias);
+            uLo = _mm_unpacklo_epi16(u16, u16);
+            uHi = _mm_unpackhi_epi16(u16, u16);
+            vLo = _mm_unpacklo_epi16(v16, v16);
+            vHi = _mm_unpackhi_epi16(v16, v16);
+        } else {
+            const __m128i u8 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(u + x));
+            const __m128i v8 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(v + x));
+            uLo = offsetSse2(_mm_unpacklo_epi8(u8, zero), chromaBias);
+            uHi = offsetSse2(_mm_unpackhi_epi8(u8, zero), chromaBias);
+            vLo = offsetSse2(_mm_unpacklo_epi8(v8, zero), chromaBias);
+            vHi = offsetSse2(_mm_unpackhi_epi8(v8, zero), chromaBias);
+        }
+
+        __m128i bLo, gLo, rLo, bHi, gHi, rHi;
+        yuvToRgbSse2(offsetSse2(_mm_unpacklo_epi8(yv, zero), lumaBias), uLo, vLo, &bLo, &gLo, &rLo);
+        yuvToRgbSse2(offsetSse2(_mm_unpackhi_epi8(yv, zero), lumaBias), uHi, vHi, &bHi, &gHi, &rHi);
+
+        const __m128i b8 = _mm_packus_epi16(bLo, bHi);
+        const __m128i g8 = _mm_packus_epi16(gLo, gHi);
+        const __m128i r8 = _mm_packus_epi16(rLo, rHi);
+        const __m128i bg0 = _mm_unpacklo_epi8(b8, g8);
+        const __m128i bg1 = _mm_unpackhi_epi8(b8, g8);
+        const __m128i ra0 = _mm_unpacklo_epi8(r8, alpha);
+        const __m128i ra1 = _mm_unpackhi_epi8(r8, alpha);
+
+        __m128i *out = reinterpret_cast<__m128i *>(dst + x * 4);
+        _mm_storeu_si128(out, _mm_unpacklo_epi16(bg0, ra0));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(bg0, ra0));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(bg1, ra1));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(bg1, ra1));
+    }
+
+    if (x < width) {
+        const int c = Subsampled ? x / 2 : x;
+        rowToRgb32Scalar<Subsampled>(y + x, u + c, v + c, dst + x * 4, width - x);
+    }
+}
+
+YUV_TARGET_SSE2
+static void splitUVSse2(const uchar *uv, uchar *u, uchar *v, int chromaWidth)
+{
+    const __m128i lowBytes = _mm_set1_epi16(0x00ff);
+
+    int i = 0;
+    for (; i + 16 <= chromaWidth; i += 16) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(uv + i * 2));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(uv + i * 2 + 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(u + i),
+                         _mm_packus_epi16(_mm_and_si128(a, lowBytes), _mm_and_si128(b, lowBytes)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(v + i),
+                         _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+    }
+
+    if (i < chromaWidth) {
+        splitUVScalar(uv + i * 2, u + i, v + i, chromaWidth - i);
+    }
+}
+
+YUV_TARGET_SSE2
+static void splitUYVYSse2(const uchar *src, uchar *y, uchar *u, uchar *v, int width)
+{
+    const __m128i lowBytes = _mm_set1_epi16(0x00ff);
+    const __m128i zero = _mm_setzero_si128();
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 2));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 2 + 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(y + x),
+                         _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+
+        const __m128i uv = _mm_packus_epi16(_mm_and_si128(a, lowBytes), _mm_and_si128(b, lowBytes));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(u + x / 2),
+                         _mm_packus_epi16(_mm_and_si128(uv, lowBytes), zero));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(v + x / 2),
+                         _mm_packus_epi16(_mm_srli_epi16(uv, 8), zero));
+    }
+
+    if (x < width) {
+        splitUYVYScalar(src + x * 2, y + x, u + x / 2, v + x / 2, width - x);
+    }
+}
+
+YUV_TARGET_SSE2
+static inline __m128i averagePairsSse2(__m128i value)
+{
+    const __m128i even = _mm_and_si128(value, _mm_set1_epi16(0x00ff));
+    const __m128i odd = _mm_srli_epi16(value, 8);
+    return _mm_avg_epu16(even, odd);
+}
+
+YUV_TARGET_SSE2
+static void halveLumaSse2(const uchar *row0, const uchar *row1, uchar *dst, int dstWidth)
+{
+    int i = 0;
+    for (; i + 16 <= dstWidth; i += 16) {
+        const __m128i a = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + i * 2)),
+                                       _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + i * 2)));
+        const __m128i b = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + i * 2 + 16)),
+                                       _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + i * 2 + 16)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                         _mm_packus_epi16(averagePairsSse2(a), averagePairsSse2(b)));
+    }
+
+    if (i < dstWidth) {
+        halveLumaScalar(row0 + i * 2, row1 + i * 2, dst + i, dstWidth - i);
+    }
+}
+
+static const RowKernels s_sse2Kernels = {
+    rowToRgb32Sse2<true>,
+    rowToRgb32Sse2<false>,
+    splitUVSse2,
+    splitUYVYSse2,
+    halveLumaSse2
+};
+
+// ---- AVX2 ------------------------------------------------------------------
+
+// Sixteen pixels starting at x, widened to 16 bits, offset and scaled
+template <bool Subsampled>
+YUV_TARGET_AVX2
+static inline void convertGroupAvx2(const uchar *y, const uchar *u, const uchar *v, int x,
+                                    __m256i *b, __m256i *g, __m256i *r)
+{
+    __m128i u8, v8;
+    if (Subsampled) {
+        const __m128i uHalf = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(u + x / 2));
+        const __m128i vHalf = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(v + x / 2));
+        u8 = _mm_unpacklo_epi8(uHalf, uHalf);
+        v8 = _mm_unpacklo_epi8(vHalf, vHalf);
+    } else {
+        u8 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(u + x));
+        v8 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(v + x));
+    }
+
+    const __m256i y16 = _mm256_slli_epi16(_mm256_sub_epi16(
+        _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(y + x))), _mm256_set1_epi16(16)), 3);
+    const __m256i u16 = _mm256_slli_epi16(_mm256_sub_epi16(_mm256_cvtepu8_epi16(u8), _mm256_set1_epi16(128)), 3);
+    const __m256i v16 = _mm256_slli_epi16(_mm256_sub_epi16(_mm256_cvtepu8_epi16(v8), _mm256_set1_epi16(128)), 3);
+
+    const __m256i yy = _mm256_mulhi_epi16(y16, _mm256_set1_epi16(kCoefY));
+    *b = _mm256_add_epi16(yy, _mm256_mulhi_epi16(u16, _mm256_set1_epi16(kCoefUB)));
+    *g = _mm256_sub_epi16(_mm256_sub_epi16(yy, _mm256_mulhi_epi16(u16, _mm256_set1_epi16(kCoefUG))),
+                          _mm256_mulhi_epi16(v16, _mm256_set1_epi16(kCoefVG)));
+    *r = _mm256_add_epi16(yy, _mm256_mulhi_epi16(v16, _mm256_set1_epi16(kCoefVR)));
+}
+
+template <bool Subsampled>
+YUV_TARGET_AVX2
+static void rowToRgb32Avx2(const uchar *y, const uchar *u, const uchar *v, uchar *dst, int width)
+{
+    const __m256i alpha = _mm256_set1_epi8(static_cast<char>(0xff));
+
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i bA, gA, rA, bB, gB, rB;
+        convertGroupAvx2<Subsampled>(y, u, v, x, &bA, &gA, &rA);
+        convertGroupAvx2<Subsampled>(y, u, v, x + 16, &bB, &gB, &rB);
+
+        // packus works per 128-bit lane: each lane now holds eight pixels
+        // of group A followed by eight of group B.
+        const __m256i b8 = _mm256_packus_epi16(bA, bB);
+        const __m256i g8 = _mm256_packus_epi16(gA, gB);
+        const __m256i r8 = _mm256_packus_epi16(rA, rB);
+        const __m256i bgA = _mm256_unpacklo_epi8(b8, g8);   // A0-7 | A8-15
+        const __m256i bgB = _mm256_unpackhi_epi8(b8, g8);   // B0-7 | B8-15
+        const __m256i raA = _mm256_unpacklo_epi8(r8, alpha);
+        const __m256i raB = _mm256_unpackhi_epi8(r8, alpha);
+
+        const __m256i a0 = _mm256_unpacklo_epi16(bgA, raA); // A0-3 | A8-11
+        const __m256i a1 = _mm256_unpackhi_epi16(bgA, raA); // A4-7 | A12-15
+        const __m256i b0 = _mm256_unpacklo_epi16(bgB, raB);
+        const __m256i b1 = _mm256_unpackhi_epi16(bgB, raB);
+
+        __m256i *out = reinterpret_cast<__m256i *>(dst + x * 4);
+        _mm256_storeu_si256(out, _mm256_permute2x128_si256(a0, a1, 0x20));
+        _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(a0, a1, 0x31));
+        _mm256_storeu_si256(out + 2, _mm256_permute2x128_si256(b0, b1, 0x20));
+        _mm256_storeu_si256(out + 3, _mm256_permute2x128_si256(b0, b1, 0x31));
+    }
+
+    if (x < width) {
+        const int c = Subsampled ? x / 2 : x;
+        rowToRgb32Sse2<Subsampled>(y + x, u + c, v + c, dst + x * 4, width - x);
+    }
+}
+
+// The shuffles around the colour maths are memory bound; only the row
+// conversion gains from the wider registers.
+static const RowKernels s_avx2Kernels = {
+    rowToRgb32Avx2<true>,
+    rowToRgb32Avx2<false>,
+    splitUVSse2,
+    splitUYVYSse2,
+    halveLumaSse2
+};
+
+static bool cpuHasSse2()
+{
+#if defined(_M_X64) || defined(__x86_64__)
+    return true;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+static bool cpuHasAvx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    // The OS must also save the YMM registers across context switches
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // YUV_HAVE_X86
+
+static YuvConvert::Isa detectIsa()
+{
+#ifdef YUV_HAVE_X86
+    if (cpuHasAvx2()) {
+        return YuvConvert::IsaAvx2;
+    }
+    if (cpuHasSse2()) {
+        return YuvConvert::IsaSse2;
+    }
+#endif
+    return YuvConvert::IsaScalar;
+}
+
+static YuvConvert::Isa supportedIsa()
+{
+    static const YuvConvert::Isa isa = detectIsa();
+    return isa;
+}
+
+static std::atomic<int> s_maxIsa(YuvConvert::IsaAvx2);
+
+static const RowKernels &kernelsFor(YuvConvert::Isa isa)
+{
+#ifdef YUV_HAVE_X86
+    if (isa == YuvConvert::IsaAvx2) {
+        return s_avx2Kernels;
+    }
+    if (isa == YuvConvert::IsaSse2) {
+        return s_sse2Kernels;
+    }
+#else
+    Q_UNUSED(isa)
+#endif
+    return s_scalarKernels;
+}
+
+YuvConvert::Isa YuvConvert::isa()
+{
+    return static_cast<Isa>(qMin(static_cast<int>(supportedIsa()), s_maxIsa.load(std::memory_order_relaxed)));
+}
+
+YuvConvert::Isa YuvConvert::setMaxIsa(Isa maxIsa)
+{
+    s_maxIsa.store(maxIsa, std::memory_order_relaxed);
+    return isa();
+}
+
+const char *YuvConvert::isaName(Isa isa)
+{
+    switch (isa) {
+    case IsaAvx2:
+        return "AVX2";
+    case IsaSse2:
+        return "SSE2";
+    default:
+        return "scalar";
+    }
+}
+
+bool YuvConvert::convert(const uchar *src, int srcWidth, int srcHeight, SourceFormat format,
+                         uchar *dst, int dstWidth, int dstHeight, int dstStride, TargetFormat target)
+{
+    const int bytesPerPixel = (target == RGB32) ? 4 : 3;
+    if (!src || !dst || srcWidth <= 0 || srcHeight <= 0 || dstWidth <= 0 || dstHeight <= 0
+            || dstStride < dstWidth * bytesPerPixel || (srcWidth & 1)
+            || (format != UYVY && (srcHeight & 1))) {
+        return false;
+    }
+
+    const RowKernels &kernels = kernelsFor(isa());
+    const int chromaWidth = srcWidth / 2;
+    const uchar *lumaPlane = src;
+    const uchar *firstChroma = src + srcWidth * srcHeight;
+    const uchar *secondChroma = firstChroma + chromaWidth * (srcHeight / 2);
+
+    // Exact 2:1 on both axes of a 4:2:0 frame: chroma already has the output
+    // resolution and only luma needs filtering.
+    const bool halfSize = (format != UYVY) && dstWidth * 2 == srcWidth && dstHeight * 2 == srcHeight;
+    const bool sameWidth = (dstWidth == srcWidth);
+
+    // Scratch rows: unpacked source, resampled row, RGB32 row for BGR24
+    std::vector<uchar> scratch(static_cast<size_t>(srcWidth * 2 + dstWidth * 3 + dstWidth * 4 + 64));
+    uchar *unpackY = scratch.data();
+    uchar *unpackU = unpackY + srcWidth;
+    uchar *unpackV = unpackU + chromaWidth;
+    uchar *sampleY = unpackV + chromaWidth;
+    uchar *sampleU = sampleY + dstWidth;
+    uchar *sampleV = sampleU + dstWidth;
+    uchar *rgbRow = sampleV + dstWidth;
+
+    // 16.16 step for nearest-sample horizontal resampling
+    const quint32 xStep = (static_cast<quint32>(srcWidth) << 16) / static_cast<quint32>(dstWidth);
+
+    for (int dy = 0; dy < dstHeight; ++dy) {
+        uchar *out = (target == RGB32) ? dst + static_cast<ptrdiff_t>(dy) * dstStride : rgbRow;
+
+        if (halfSize) {
+            const uchar *row0 = lumaPlane + static_cast<ptrdiff_t>(dy * 2) * srcWidth;
+            kernels.halveLuma(row0, row0 + srcWidth, sampleY, dstWidth);
+            const uchar *u;
+            const uchar *v;
+            if (format == YV12) {
+                v = firstChroma + static_cast<ptrdiff_t>(dy) * chromaWidth;
+                u = secondChroma + static_cast<ptrdiff_t>(dy) * chromaWidth;
+            } else {
+                kernels.splitUV(firstChroma + static_cast<ptrdiff_t>(dy) * srcWidth, unpackU, unpackV, chromaWidth);
+                u = unpackU;
+                v = unpackV;
+            }
+            kernels.rowFull(sampleY, u, v, out, dstWidth);
+        } else {
+            const int sy = static_cast<int>((static_cast<qint64>(dy) * 2 + 1) * srcHeight / (static_cast<qint64>(dstHeight) * 2));
+            const uchar *y;
+            const uchar *u;
+            const uchar *v;
+            if (format == YV12) {
+                y = lumaPlane + static_cast<ptrdiff_t>(sy) * srcWidth;
+                v = firstChroma + static_cast<ptrdiff_t>(sy / 2) * chromaWidth;
+                u = secondChroma + static_cast<ptrdiff_t>(sy / 2) * chromaWidth;
+            } else if (format == NV12) {
+                y = lumaPlane + static_cast<ptrdiff_t>(sy) * srcWidth;
+                kernels.splitUV(firstChroma + static_cast<ptrdiff_t>(sy / 2) * srcWidth, unpackU, unpackV, chromaWidth);
+                u = unpackU;
+                v = unpackV;
+            } else {
+                kernels.splitUYVY(src + static_cast<ptrdiff_t>(sy) * srcWidth * 2, unpackY, unpackU, unpackV, srcWidth);
+                y = unpackY;
+                u = unpackU;
+                v = unpackV;
+            }
+
+            if (sameWidth) {
+                kernels.rowSubsampled(y, u, v, out, dstWidth);
+            } else {
+                quint32 pos = xStep / 2;
+                for (int dx = 0; dx < dstWidth; ++dx, pos += xStep) {
+                    const int sx = static_cast<int>(pos >> 16);
+                    sampleY[dx] = y[sx];
+                    sampleU[dx] = u[sx >> 1];
+                    sampleV[dx] = v[sx >> 1];
+                }
+                kernels.rowFull(sampleY, sampleU, sampleV, out, dstWidth);
+            }
+        }
+
+        if (target == BGR24) {
+            uchar *line = dst + static_cast<ptrdiff_t>(dy) * dstStride;
+            for (int dx = 0; dx < dstWidth; ++dx) {
+                line[dx * 3] = rgbRow[dx * 4];
+                line[dx * 3 + 1] = rgbRow[dx * 4 + 1];
+                line[dx * 3 + 2] = rgbRow[dx * 4 + 2];
+            }
+        }
+    }
+
+    return true;
+}
+
+QImage YuvConvert::toImage(const uchar *src, int width, int height, SourceFormat format, const QSize &size)
+{
+    const QSize target = size.isEmpty() ? QSize(width, height) : size;
+    QImage image(target, QImage::Format_RGB32);
+    if (image.isNull()) {
+        return QImage();
+    }
+    if (!convert(src, width, height, format, image.bits(), target.width(), target.height(),
+                 image.bytesPerLine(), RGB32)) {
+        return QImage();
+    }
+    return image;
+}
+
+QImage YuvConvert::toImage(const DecodedFrame &frame, const QSize &size)
+{
+    SourceFormat format;
+    if (!formatFromFrameType(frame.type, &format)) {
+        return QImage();
+    }
+    return toImage(frame.data, frame.width, frame.height, format, size);
+}
+
+bool YuvConvert::formatFromFrameType(int frameType, SourceFormat *format)
+{
+    switch (frameType) {
+    case T_YV12:
+        *format = YV12;
+        return true;
+    case T_UYVY:
+        *format = UYVY;
+        return true;
+    case YUV_NV12:  // display callback after PlayM4_SetYUVCallBackType
+        *format = NV12;
+        return true;
+    default:
+        return false;
+    }
+}
+
+void YuvConvert::runBenchmark()
+{
+    struct Resolution {
+        int width;
+        int height;
+        const char *name;
+    };
+    static const Resolution resolutions[] = {
+        { 1280, 720, "720p" },
+        { 1920, 1080, "1080p" },
+        { 3840, 2160, "4K" }
+    };
+    static const SourceFormat formats[] = { YV12, NV12, UYVY };
+    static const char *const formatNames[] = { "YV12", "NV12", "UYVY" };
+    static const int kIterations = 20;
+
+    const Isa previousMax = static_cast<Isa>(s_maxIsa.load(std::memory_order_relaxed));
+    const Isa best = supportedIsa();
+    qDebug() << "YUV conversion benchmark, best kernels:" << isaName(best);
+
+    for (const Resolution &res : resolutions) {
+        // A deterministic pattern that sweeps every Y, U and V value
+        const int srcBytes = res.width * res.height * 2;
+        std::vector<uchar> source(static_cast<size_t>(srcBytes));
+        for (int i = 0; i < srcBytes; ++i) {
+            source[static_cast<size_t>(i)] = static_cast<uchar>((i * 7) ^ (i >> 9));
+        }
+
+        for (int f = 0; f < 3; ++f) {
+            for (int half = 0; half < 2; ++half) {
+                const int dstWidth = half ? res.width / 2 : res.width;
+                const int dstHeight = half ? res.height / 2 : res.height;
+                const int stride = dstWidth * 4;
+                std::vector<uchar> reference(static_cast<size_t>(stride * dstHeight));
+                std::vector<uchar> output(reference.size());
+
+                for (int level = IsaScalar; level <= best; ++level) {
+                    setMaxIsa(static_cast<Isa>(level));
+                    uchar *target = (level == IsaScalar) ? reference.data() : output.data();
+
+                    QElapsedTimer timer;
+                    timer.start();
+                    for (int i = 0; i < kIterations; ++i) {
+                        convert(source.data(), res.width, res.height, formats[f],
+                                target, dstWidth, dstHeight, stride, RGB32);
+                    }
+                    const double msPerFrame = timer.nsecsElapsed() / 1e6 / kIterations;
+
+                    const bool matches = (level == IsaScalar)
+                        || memcmp(reference.data(), output.data(), reference.size()) == 0;
+                    qDebug().nospace() << res.name << " " << formatNames[f]
+                                       << (half ? " -> half" : " -> full") << " " << isaName(static_cast<Isa>(level))
+                                       << ": " << QString::number(msPerFrame, 'f', 2) << " ms/frame, "
+                                       << QString::number(1000.0 / msPerFrame, 'f', 0) << " fps"
+                                       << (matches ? "" : " (MISMATCH against scalar)");
+                }
+            }
+        }
+    }
+
+    setMaxIsa(previousMax);
+}
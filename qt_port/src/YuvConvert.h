@@ -0,0 +1,60 @@
+#ifndef YUVCONVERT_H
+#define YUVCONVERT_H
+
+#include <QtGlobal>
+#include <QImage>
+#include <QSize>
+
+struct DecodedFrame;
+
+// Colour conversion of decoded PlayM4 frames (BT.601, limited range) to the
+// RGB layouts Qt draws with, with an optional resize fused into the same
+// pass so a thumbnail never materialises the full-size RGB image.
+//
+// Row kernels exist in scalar, SSE2 and AVX2 form and are picked once at
+// runtime from CPUID; all three produce bit-identical output. Resizing is
+// nearest-row vertically; horizontally it is exact at 1:1, a 2x2 box filter
+// at exactly half size, and nearest-sample otherwise.
+class YuvConvert
+{
+public:
+    enum SourceFormat {
+        YV12,       // Y plane, V plane, U plane (PlayM4 T_YV12)
+        NV12,       // Y plane, interleaved UV plane
+        UYVY        // packed 4:2:2 (PlayM4 T_UYVY)
+    };
+
+    enum TargetFormat {
+        RGB32,      // QImage::Format_RGB32 byte order (B, G, R, 0xff)
+        BGR24       // B, G, R
+    };
+
+    enum Isa {
+        IsaScalar = 0,
+        IsaSse2 = 1,
+        IsaAvx2 = 2
+    };
+
+    // Source planes are tightly packed as PlayM4 delivers them.
+    static bool convert(const uchar *src, int srcWidth, int srcHeight, SourceFormat format,
+                        uchar *dst, int dstWidth, int dstHeight, int dstStride,
+                        TargetFormat target = RGB32);
+
+    // Convenience wrappers; an empty size keeps the source size.
+    static QImage toImage(const uchar *src, int width, int height, SourceFormat format,
+                          const QSize &size = QSize());
+    static QImage toImage(const DecodedFrame &frame, const QSize &size = QSize());
+    static bool formatFromFrameType(int frameType, SourceFormat *format);
+
+    // Kernel selection; setMaxIsa() caps the dispatch below what the CPU
+    // supports and returns the level now in use.
+    static Isa isa();
+    static Isa setMaxIsa(Isa maxIsa);
+    static const char *isaName(Isa isa);
+
+    // Times every format at 720p, 1080p and 4K, full size and fused half
+    // size, for each kernel level the CPU supports, and logs the results.
+    static void runBenchmark();
+};
+
+#endif // YUVCONVERT_H
@@ -23,27 +23,38 @@ WatermarkDialog::WatermarkDialog(MediaPlayerWrapper* player, QWidget* parent)
 
     m_timer = new QTimer(this);
     connect(m_timer, &QTimer::timeout, this, &WatermarkDialog::updateWatermarkInfo);
+    // The watermark index answers for the new position at once
+    connect(m_player, &MediaPlayerWrapper::positionChanged, this, [this]() {
+        if (m_timer->isActive()) {
+            updateWatermarkInfo();
+        }
+    });
+    connect(m_player, &MediaPlayerWrapper::seekCompleted, this, [this]() {
+        if (m_timer->isActive()) {
+            updateWatermarkInfo();
+        }
+    });
 //    m_timer->start(1000);
 }
 
 void WatermarkDialog::updateWatermarkInfo()
 {
     QString info;
-    auto data = m_player->getWatermarkData();
-    if (data) {
+    WatermarkData data;
+    if (m_player->currentWatermark(&data)) {
 
         info = QString("Mac: %1\nDeviceSn: %2\nChan: %3\nGTime: %4\nDeviceInfo: %5\nDeviceType: %6")
-            .arg(data->mac)
-            .arg(data->deviceSN)
-            .arg(data->channelNum)
-            .arg(QString("%1-%2-%3 %4:%5:%6").arg(GET_FILE_YEAR(data->globalTime))
-                                             .arg(GET_FILE_MONTH(data->globalTime))
-                                             .arg(GET_FILE_DAY(data->globalTime))
-                                             .arg(GET_FILE_HOUR(data->globalTime))
-                                             .arg(GET_FILE_MINUTE(data->globalTime))
-                                             .arg(GET_FILE_SECOND(data->globalTime)))
-            .arg(data->deviceInfo)
-            .arg(data->deviceType);
+            .arg(data.macString())
+            .arg(data.deviceSN)
+            .arg(data.channelNum)
+            .arg(QString("%1-%2-%3 %4:%5:%6").arg(GET_FILE_YEAR(data.globalTime))
+                                             .arg(GET_FILE_MONTH(data.globalTime))
+                                             .arg(GET_FILE_DAY(data.globalTime))
+                                             .arg(GET_FILE_HOUR(data.globalTime))
+                                             .arg(GET_FILE_MINUTE(data.globalTime))
+                                             .arg(GET_FILE_SECOND(data.globalTime)))
+            .arg(data.deviceInfo)
+            .arg(data.deviceType);
     } else {
         info = "Mac\nDeviceSn\nChan\nGTime\nDeviceInfo\nDeviceType";
     }
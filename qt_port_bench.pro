@@ -0,0 +1,25 @@
+QT += core widgets network
+
+CONFIG += c++11 console
+TARGET = ShinPlayerBench
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# The player itself; benchmark-only code stays out of ShinPlayer
+include(qt_port.pri)
+INCLUDEPATH += $$PWD/qt_port/src
+
+SOURCES += \
+    qt_port/bench/main.cpp \
+    qt_port/bench/AllocationCounter.cpp \
+    qt_port/bench/LoopbackRtspServer.cpp \
+    qt_port/bench/RtspBench.cpp
+
+HEADERS += \
+    qt_port/bench/AllocationCounter.h \
+    qt_port/bench/LoopbackRtspServer.h \
+    qt_port/bench/RtspBench.h
+
+RESOURCES += \
+    resource.qrc